@@ -0,0 +1,94 @@
+#ifndef ADMIN_H
+#define ADMIN_H
+
+/*
+ * 管理控制面：本机管理 Unix 域套接字
+ *
+ * 控制台命令（list、send、broadcast、reg get/set/dump 等）原先只能在调试版本的标准输入上执行，
+ * 纯数据流版本（DEBUG_MODE=0）无法在运行时管理。管理套接字（-a）把控制面移出事件循环：
+ * - 独立的控制线程接受管理连接、读取命令行，连接建立、读取和等待都不占用事件循环；
+ * - 每条命令打包为 AdminCommand，经无锁 MPSC 队列交给事件循环（数据面），
+ *   随后写 eventfd 唤醒事件循环；
+ * - 事件循环在 eventfd 可读时取出全部命令，在两批 Modbus 事件之间逐条执行，
+ *   输出写入内存流，完成后以信号量通知控制线程；
+ * - 控制线程把输出写回管理连接。管理客户端读取缓慢或断开只影响控制线程。
+ *
+ * 命令在事件循环线程上执行，直接访问寄存器组、客户端表等数据面状态而不需要加锁。
+ * 套接字文件权限为 0600，只有服务器所属用户可以连接。
+ * 协议为纯文本：每行一条命令，输出按原样返回；quit 关闭连接。命令行可以跨越多次读取，
+ * 最后一行可以不带换行符（100 毫秒内没有后续数据或对端关闭时执行）。
+ * 可以用 build/client -u <管理套接字> 交互使用。
+ */
+
+#include "common.h"
+#include "mpsc_queue.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+/* 同时服务的管理连接数 */
+#define ADMIN_MAX_CONNECTIONS 4
+
+/* 单条命令的最大长度 */
+#define ADMIN_COMMAND_LENGTH BUFFER_SIZE
+
+/* 一条排队等待事件循环执行的命令 */
+typedef struct {
+    MpscNode node;                      /* 队列链接 */
+    char text[ADMIN_COMMAND_LENGTH];    /* 命令行（不含换行符） */
+    char *output;                       /* 执行输出（malloc 分配，由控制线程释放） */
+    size_t output_length;
+    sem_t done;                         /* 事件循环执行完成后 post */
+} AdminCommand;
+
+/*
+ * 命令执行函数（在事件循环线程上调用）
+ *
+ * 参数：
+ *   command - 命令行，可被修改
+ *   out - 输出流
+ *   context - admin_server_drain 传入的上下文
+ */
+typedef void (*AdminExecuteFunc)(char *command, FILE *out, void *context);
+
+/* 管理控制面状态 */
+typedef struct {
+    int listen_fd;              /* 管理套接字监听描述符（未启用时为 -1） */
+    int wake_fd;                /* eventfd：控制线程通知事件循环有命令待执行 */
+    int stop_fd;                /* eventfd：通知控制线程退出 */
+    char path[UNIX_PATH_LENGTH];
+    MpscQueue queue;            /* 控制线程 → 事件循环 */
+    uint64_t commands;          /* 事件循环已执行的命令数 */
+    bool running;
+    bool thread_started;
+    pthread_t thread;           /* 控制线程 */
+} AdminServer;
+
+/*
+ * 创建管理套接字并启动控制线程
+ *
+ * 参数：
+ *   path - 套接字文件路径（残留的旧套接字文件会被删除）
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）；成功后调用者应把 wake_fd 加入 epoll 集合
+ */
+bool admin_server_start(AdminServer *admin, const char *path);
+
+/*
+ * 事件循环：wake_fd 可读时取出并执行全部排队命令
+ *
+ * 参数：
+ *   execute - 命令执行函数
+ *   context - 传给 execute 的上下文
+ */
+void admin_server_drain(AdminServer *admin, AdminExecuteFunc execute, void *context);
+
+/*
+ * 停止控制线程，关闭全部管理连接并删除套接字文件（在事件循环线程上调用）
+ */
+void admin_server_stop(AdminServer *admin);
+
+#endif /* ADMIN_H */
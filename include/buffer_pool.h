@@ -0,0 +1,80 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+/*
+ * 连接缓冲池
+ *
+ * 连接上只有两类数据需要跨事件保存：跨两次读取的半帧，以及一次没能写完或主动发出的待写数据。
+ * 绝大多数连接（轮询主站）在两次请求之间既没有半帧也没有待写数据，
+ * 因此这些缓冲区不随连接常驻，而是在需要时从缓冲池按尺寸档位借用，用完立即归还：
+ * - 档位为 512 字节、2 KB、8 KB 和 32 KB，请求的大小向上取整到最近的档位，更大的直接 malloc；
+ * - 归还的缓冲区挂在所属档位的空闲链表上供下次复用，每档缓存的数量有上限，超出的直接释放；
+ * - 全局内存上限覆盖在用和缓存的全部缓冲区，将超出时先释放空闲缓存，仍不够则分配失败，
+ *   由调用者按各自的方式降级（丢弃半帧、发送队列按已满处理）。
+ *
+ * 缓冲池只在事件循环线程中使用，不加锁。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 尺寸档位数，最小档位为 2^BUFFER_POOL_MIN_SHIFT 字节，每档是上一档的 4 倍 */
+#define BUFFER_POOL_CLASSES 4
+#define BUFFER_POOL_MIN_SHIFT 9
+
+/* 每档最多缓存的空闲缓冲区数 */
+#define BUFFER_POOL_CACHE_PER_CLASS 64
+
+/* 默认内存上限（字节） */
+#define BUFFER_POOL_DEFAULT_LIMIT (16 * 1024 * 1024)
+
+/* 单个尺寸档位 */
+typedef struct {
+    size_t size;                /* 档位容量（字节，不含块头） */
+    void *free_list;            /* 空闲缓冲区链表 */
+    uint32_t in_use;            /* 借出未归还的缓冲区数 */
+    uint32_t cached;            /* 空闲链表上的缓冲区数 */
+    uint64_t allocations;       /* 累计借出次数 */
+    uint64_t reuses;            /* 其中直接取自空闲链表的次数 */
+} BufferPoolClass;
+
+/* 缓冲池 */
+typedef struct BufferPool {
+    BufferPoolClass classes[BUFFER_POOL_CLASSES];
+    size_t limit;               /* 内存上限：在用与缓存之和（字节） */
+    size_t bytes_in_use;        /* 借出未归还的字节数（按档位容量计） */
+    size_t bytes_cached;        /* 空闲链表上的字节数 */
+    size_t peak_bytes;          /* 在用与缓存之和的峰值 */
+    uint32_t oversize_in_use;   /* 超过最大档位、直接 malloc 的缓冲区数 */
+    uint64_t oversize;          /* 累计超大分配次数 */
+    uint64_t failures;          /* 超出上限被拒绝的分配次数 */
+} BufferPool;
+
+/*
+ * 初始化缓冲池
+ *
+ * 参数：
+ *   limit - 内存上限（字节），0 表示使用默认值
+ */
+void buffer_pool_init(BufferPool *pool, size_t limit);
+
+/*
+ * 借用一个至少 size 字节的缓冲区
+ *
+ * 返回：
+ *   缓冲区指针；超出内存上限或内存不足返回 NULL
+ */
+void *buffer_pool_alloc(BufferPool *pool, size_t size);
+
+/*
+ * 归还缓冲区（NULL 忽略）
+ */
+void buffer_pool_free(BufferPool *pool, void *buffer);
+
+/*
+ * 释放全部空闲缓存
+ */
+void buffer_pool_trim(BufferPool *pool);
+
+#endif /* BUFFER_POOL_H */
@@ -16,14 +16,20 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <termios.h>
+#include "outbound.h"
 
 /* 允许同时保持的最大客户端连接数。 */
-#define MAX_CLIENTS 128
+#define MAX_CLIENTS 1024
 /* 应用层缓冲区大小，用于收发数据。 */
 #define BUFFER_SIZE 4096
 /* listen 系统调用的等待队列长度。 */
 #define LISTEN_BACKLOG 128
+/* 连接半帧暂存区的大小（最大 MBAP 帧 260 字节，RTU 帧 256 字节）。 */
+#define CLIENT_PENDING_SIZE 260
+/* Unix 域套接字路径的最大长度（与 sockaddr_un.sun_path 一致）。 */
+#define UNIX_PATH_LENGTH 108
 /* 客户端标识符的最大长度。 */
 #define CLIENT_ID_LENGTH 32
 
@@ -31,12 +37,56 @@
 #define MAX_HISTORY_SIZE 100       /* 最大历史记录数量 */
 #define MAX_COMMAND_LENGTH 1024    /* 单条命令的最大长度 */
 
+/* TLS 会话（定义见 tls_server.h，这里只需要不透明指针）。 */
+struct TlsSession;
+
+/* 模拟设备（定义见 device.h）。 */
+struct Device;
+
+/* 每个连接单独统计请求数的功能码范围（去掉异常位后为 0..127）。 */
+#define CLIENT_FUNCTION_CODES 128
+
+/* 单个连接的流量统计（服务器 list/top 命令显示）。 */
+typedef struct {
+    uint64_t requests;                              /* 已应答的请求数。 */
+    uint32_t function_requests[CLIENT_FUNCTION_CODES]; /* 按功能码的请求数。 */
+    uint64_t exceptions;                            /* 异常响应数。 */
+    uint64_t bytes_in;                              /* 读到的字节数。 */
+    uint64_t bytes_out;                             /* 写出的字节数。 */
+    uint64_t connected_ns;                          /* 连接建立时刻（CLOCK_MONOTONIC 纳秒）。 */
+    uint64_t last_activity_ns;                      /* 最近一次收到数据的时刻。 */
+    double latency_ewma_us;                         /* 请求延迟的指数加权移动平均（微秒，新样本权重 1/8）。 */
+    uint64_t top_requests;                          /* top 上次刷新时的请求数，用于计算刷新间隔内的速率。 */
+} ClientTraffic;
+
+/*
+ * 连接上使用的协议。RTU-over-TCP 监听上的连接固定为 RTU，其余连接由最先到达的字节判定，
+ * 判定后绑定到对应的处理函数，之后的数据不再逐次猜测。
+ */
+typedef enum {
+    CLIENT_PROTOCOL_UNKNOWN = 0,    /* 尚未判定（已到达的字节不足以区分）。 */
+    CLIENT_PROTOCOL_MODBUS_TCP,     /* Modbus TCP：按 MBAP 长度字段分帧。 */
+    CLIENT_PROTOCOL_MODBUS_RTU,     /* RTU-over-TCP：按功能码推算帧长。 */
+    CLIENT_PROTOCOL_TEXT            /* 文本消息（回显协议）：按换行拆分。 */
+} ClientProtocol;
+
 /* 描述客户端会话的信息结构体。 */
 typedef struct {
     int fd;                         /* 客户端对应的文件描述符。 */
     char id[CLIENT_ID_LENGTH];      /* 分配给客户端的唯一编号。 */
-    struct sockaddr_in addr;        /* 客户端远端地址信息。 */
+    struct sockaddr_in addr;        /* 客户端远端地址信息（仅 TCP 连接有效）。 */
     bool active;                    /* 连接是否处于活跃状态。 */
+    bool is_unix;                   /* 是否为 Unix 域套接字连接。 */
+    ClientProtocol protocol;        /* 连接上的协议，判定后不再改变。 */
+    unsigned char *pending;         /* 未凑满一帧的剩余字节，有半帧时才从缓冲池借用，否则为 NULL。 */
+    size_t pending_length;          /* 剩余字节数。 */
+    struct TlsSession *tls;         /* TLS 会话，明文连接为 NULL。 */
+    struct Device *device;          /* 从设备端点接受的连接所属的设备，其余连接为 NULL。 */
+    bool tls_ready;                 /* TLS 握手是否已完成。 */
+    ClientTraffic traffic;          /* 流量统计。 */
+    OutboundQueue outbound;         /* 发送队列：服务器主动发出的消息和未能一次写完的响应。 */
+    bool want_write;                /* 是否已在 epoll 中关注可写事件（发送缓冲区已满时）。 */
+    bool flush_scheduled;           /* 是否在本轮事件循环末尾的待刷新列表中。 */
 } ClientInfo;
 
 /* 命令历史记录管理结构体 */
@@ -0,0 +1,141 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+/*
+ * 模拟设备与设备模板
+ *
+ * 仿真一座工厂时，大多数设备的寄存器初值相同，每台设备只有少数寄存器不同：
+ * - 设备模板是具名的只读寄存器映像，启动时加载一次（来自快照文件，或取默认寄存器的初值）；
+ * - 设备实例的保持/输入寄存器组以模板为写时复制的基础（见 register_bank_init_cow），
+ *   不写就不占寄存器内存，写过的页才有私有副本；
+ * - 设备可按单元 ID 路由：请求的单元 ID 挂有设备时读写该设备的寄存器，否则读写服务器默认的寄存器。
+ *
+ * 设备表只在事件循环线程中修改。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "register_bank.h"
+
+/* 模板名称最大长度（含结尾的 '\0'） */
+#define DEVICE_NAME_LENGTH 32
+
+/* 最多模板数（-T 定义的模板和寄存器映射的单元段共用） */
+#define DEVICE_MAX_TEMPLATES 80
+
+/* 可按单元 ID 路由的范围（与串行链路的从站地址一致） */
+#define DEVICE_MIN_UNIT 1
+#define DEVICE_MAX_UNIT 247
+
+/* 设备模板（加载后只读） */
+typedef struct {
+    char name[DEVICE_NAME_LENGTH];
+    RegisterBank holding;           /* 保持寄存器映像 */
+    RegisterBank input;             /* 输入寄存器映像 */
+    uint32_t instances;             /* 引用本模板的设备数 */
+} DeviceTemplate;
+
+/* 模拟设备 */
+typedef struct Device {
+    uint32_t id;                    /* 设备编号（按创建顺序，从 1 开始） */
+    uint8_t unit_id;                /* 路由到本设备的单元 ID，0 表示不按单元 ID 路由（例如挂在端点上） */
+    const DeviceTemplate *template; /* 所用模板 */
+    RegisterBank holding;           /* 写时复制的保持寄存器 */
+    RegisterBank input;             /* 写时复制的输入寄存器 */
+} Device;
+
+/* 设备表 */
+typedef struct {
+    DeviceTemplate templates[DEVICE_MAX_TEMPLATES];
+    size_t template_count;
+    Device **devices;               /* 全部设备（按创建顺序，单独分配，地址不变） */
+    size_t device_count;
+    size_t device_capacity;
+    Device *units[256];             /* 按单元 ID 路由的设备 */
+} DeviceTable;
+
+/*
+ * 初始化空设备表
+ */
+void device_table_init(DeviceTable *table);
+
+/*
+ * 释放全部设备和模板
+ */
+void device_table_destroy(DeviceTable *table);
+
+/*
+ * 添加模板（复制寄存器映像）
+ *
+ * 参数：
+ *   name - 模板名称
+ *   holding - 保持寄存器初值
+ *   input - 输入寄存器初值
+ *   register_count - 每类寄存器数量
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   新模板；名称无效、重名、模板已满或内存不足返回 NULL
+ */
+DeviceTemplate *device_template_add(DeviceTable *table, const char *name, const uint16_t *holding,
+                                    const uint16_t *input, uint32_t register_count,
+                                    char *error, size_t error_size);
+
+/*
+ * 按名称查找模板
+ *
+ * 返回：
+ *   找到的模板，不存在返回 NULL
+ */
+DeviceTemplate *device_template_find(DeviceTable *table, const char *name);
+
+/*
+ * 用新的寄存器映像替换模板，引用该模板的设备丢弃全部私有页、重新从新映像开始
+ *
+ * 模板的地址不变（设备仍指向同一个模板），交换后 holding/input 持有旧映像，由调用者释放。
+ * 只能在没有读者访问这些设备时调用（事件循环线程在两次事件之间）。
+ *
+ * 参数：
+ *   template - 模板
+ *   holding - 输入输出：新的保持寄存器映像，返回时为旧映像
+ *   input - 输入输出：新的输入寄存器映像，返回时为旧映像
+ */
+void device_template_reset(DeviceTable *table, DeviceTemplate *template, RegisterBank *holding, RegisterBank *input);
+
+/*
+ * 以模板创建设备（不按单元 ID 路由）
+ *
+ * 返回：
+ *   新设备，内存不足返回 NULL
+ */
+Device *device_create(DeviceTable *table, DeviceTemplate *template);
+
+/*
+ * 按规格创建一组按单元 ID 路由的设备
+ *
+ * 参数：
+ *   spec - 规格，格式为 <单元ID>[-<单元ID>]=<模板名>，例如 1-100=meter
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true；格式无效、模板不存在或单元 ID 已被占用时返回 false，且不创建任何设备
+ */
+bool device_table_add_units(DeviceTable *table, const char *spec, char *error, size_t error_size);
+
+/*
+ * 按单元 ID 查找设备
+ *
+ * 返回：
+ *   路由到的设备，未挂设备返回 NULL
+ */
+Device *device_table_route(const DeviceTable *table, uint8_t unit_id);
+
+/*
+ * 设备的私有内存（写时复制的页表与已复制的页，字节）
+ */
+size_t device_private_bytes(const Device *device);
+
+#endif /* DEVICE_H */
@@ -0,0 +1,84 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+/*
+ * 设备端点
+ *
+ * 按 IP 和端口区分设备的主站（一个端点一台设备）以往需要为每台设备启动一个服务器进程。
+ * 端点集合让一个进程绑定成百上千个地址/端口（包括 127.0.0.2 这类回环别名），
+ * 每个端点挂一台以模板创建的模拟设备（见 device.h），所有监听套接字加入同一个 epoll 集合：
+ * - 从端点接受的连接上的请求读写该端点的设备，不再按单元 ID 路由；
+ * - 端点由规格批量定义：<地址>[-<地址>]:<端口>[-<端口>]=<模板名>，地址范围与端口范围逐一组合；
+ * - 规格可以写在配置文件中，每行一条，# 之后为注释。
+ *
+ * 端点集合只在事件循环线程中使用。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include "device.h"
+
+/* 单条规格最多展开的端点数 */
+#define ENDPOINT_SPEC_MAX 65536
+
+/* 设备端点 */
+typedef struct {
+    int fd;                         /* 监听描述符 */
+    struct sockaddr_in addr;        /* 绑定地址 */
+    Device *device;                 /* 端点上的设备 */
+    uint64_t connections;           /* 累计接受的连接数 */
+} Endpoint;
+
+/* 端点集合 */
+typedef struct {
+    Endpoint *endpoints;            /* 全部端点（按创建顺序） */
+    size_t count;
+    size_t capacity;
+    uint32_t *by_fd;                /* 按监听描述符索引：端点下标加 1，0 表示不是端点 */
+    size_t by_fd_size;
+} EndpointSet;
+
+/*
+ * 初始化空端点集合
+ */
+void endpoint_set_init(EndpointSet *set);
+
+/*
+ * 关闭全部监听套接字并释放集合（设备由设备表释放）
+ */
+void endpoint_set_close(EndpointSet *set);
+
+/*
+ * 按规格创建一组端点：为每个地址/端口组合创建设备并绑定监听套接字（非阻塞）
+ *
+ * 参数：
+ *   devices - 设备表（提供模板，新设备加入其中）
+ *   spec - 规格，格式为 [<地址>[-<地址>]:]<端口>[-<端口>]=<模板名>，省略地址时绑定所有网络接口
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true；格式无效、模板不存在时不创建任何端点，
+ *   绑定失败时此前已创建的端点保留在集合中（由 endpoint_set_close 关闭）
+ */
+bool endpoint_set_add(EndpointSet *set, DeviceTable *devices, const char *spec, char *error, size_t error_size);
+
+/*
+ * 从配置文件按行创建端点（空行和 # 之后的注释忽略）
+ *
+ * 返回：
+ *   全部成功返回 true，否则 error 中带有出错的行号
+ */
+bool endpoint_set_load(EndpointSet *set, DeviceTable *devices, const char *path, char *error, size_t error_size);
+
+/*
+ * 按监听描述符查找端点
+ *
+ * 返回：
+ *   对应的端点，不是端点的监听描述符返回 NULL
+ */
+Endpoint *endpoint_set_find(const EndpointSet *set, int fd);
+
+#endif /* ENDPOINT_H */
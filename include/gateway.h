@@ -0,0 +1,304 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+/*
+ * Modbus TCP 网关
+ *
+ * 现场的 PLC 往往只接受 1 到 4 条 TCP 连接，成百上千个主站无法各自直连。网关模式下服务器把
+ * 指定单元 ID 的请求转发给上游 Modbus TCP 服务器（真实设备或另一个模拟服务器），其余单元照常在本地处理：
+ * - 每个上游维持少量持久连接，断开后按退避间隔重连；
+ * - 每条上游连接上可以同时有多个请求在途（流水线），请求按在途数最少的连接分配；
+ * - 转发时把主站的事务标识符换成网关分配的标识符：低 6 位是在途槽位下标，高 10 位是轮转序号，
+ *   响应按槽位直接找回主站连接和原事务标识符（O(1)），迟到的过期响应因序号不符而丢弃；
+ * - 所有连接都忙时请求在上游的等待队列中排队，连接空出槽位时按到达顺序发出；
+ * - 上游超时未响应时断开该连接并重连，连接上的在途请求回复异常 0B（网关目标设备未响应），
+ *   上游不可达时回复异常 0A（网关路径不可用），
+ *   等待队列已满时回复异常 06（服务器设备忙）；
+ * - RTU-over-TCP 主站的请求转换为 MBAP 后同样转发，响应转换回 RTU 帧；串口线路逐帧半双工应答，
+ *   无法等待上游，网关单元的请求回复异常 0A。
+ *
+ * 读请求合并（singleflight）：单元 ID、功能码（FC03/FC04）、起始地址和数量都相同的读请求，
+ * 若已有一个在途或排队，后来者只挂到它的等待者链表上，不再发往上游；响应到达后按各自的事务标识符
+ * 分发给全部等待者（超时或失败时同样一并回复异常）。经网关转发的写请求之后，同一单元此前的读请求
+ * 不再接纳等待者，以免后来者读到写入之前的值。
+ *
+ * 读缓存（-c，可选）：按单元 ID 和寄存器范围配置存活时间，完全落在范围内的读请求在存活期内
+ * 直接以缓存的响应应答。经网关转发的写请求使同一单元重叠范围的缓存失效（无法确定写入范围的功能码
+ * 使整个单元失效）。缓存是固定容量的组相联表，组内满时替换最早过期的项。
+ *
+ * 上游连接和定时器描述符加入服务器的 epoll 集合，网关只在事件循环线程中使用。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include "modbus.h"
+
+/* 最多的上游数（-U） */
+#define GATEWAY_MAX_UPSTREAMS 16
+
+/* 每个上游最多的持久连接数 */
+#define GATEWAY_MAX_CONNECTIONS 8
+
+/* 每条上游连接最多的在途请求数（槽位数，事务标识符的低 6 位） */
+#define GATEWAY_MAX_INFLIGHT 64
+
+/* 默认的连接数与流水线深度 */
+#define GATEWAY_DEFAULT_CONNECTIONS 1
+#define GATEWAY_DEFAULT_DEPTH 8
+
+/* 每个上游的等待队列长度 */
+#define GATEWAY_BACKLOG 256
+
+/* 每个上游最多的合并等待者数 */
+#define GATEWAY_MAX_WAITERS 1024
+
+/* 读缓存规则数上限（-c）与缓存项数（组数 × 每组项数） */
+#define GATEWAY_MAX_CACHE_RULES 32
+#define GATEWAY_CACHE_SETS 256
+#define GATEWAY_CACHE_WAYS 4
+
+/* 默认的上游响应超时（毫秒，-O） */
+#define GATEWAY_DEFAULT_TIMEOUT_MS 1000
+
+/*
+ * 响应投递函数：把发给主站的一帧（已恢复原事务标识符）交给服务器写出
+ *
+ * 参数：
+ *   client_fd - 主站连接的描述符
+ *   frame - MBAP 帧
+ *   length - 帧长度
+ *   request_ns - 请求到达网关的时刻（CLOCK_MONOTONIC 纳秒），用于统计延迟
+ *   context - gateway_start 传入的上下文
+ */
+typedef void (*GatewayDeliverFunc)(int client_fd, const uint8_t *frame, size_t length,
+                                   uint64_t request_ns, void *context);
+
+/* 在途槽位 */
+typedef struct {
+    bool active;
+    int client_fd;                  /* 主站连接，-1 表示主站已断开（响应到达后丢弃） */
+    uint16_t client_txid;           /* 主站的事务标识符 */
+    uint16_t upstream_txid;         /* 网关分配的事务标识符 */
+    uint8_t unit_id;
+    uint8_t function_code;
+    uint16_t start;                 /* 读请求的起始地址和数量（合并与缓存的键） */
+    uint16_t quantity;
+    bool joinable;                  /* 是否可合并：FC03/FC04 且之后没有转发过同一单元的写请求 */
+    int32_t waiters;                /* 合并等待者链表头（下标），-1 表示没有 */
+    uint64_t request_ns;            /* 请求到达网关的时刻 */
+    uint64_t sent_ns;               /* 发往上游的时刻 */
+} GatewaySlot;
+
+/* 合并到某个请求上的等待者 */
+typedef struct {
+    int client_fd;                  /* -1 表示主站已断开（或空闲项） */
+    uint16_t client_txid;
+    uint64_t request_ns;
+    int32_t next;                   /* 链表中的下一个（或空闲链表中的下一个），-1 表示结尾 */
+} GatewayWaiter;
+
+/* 上游连接状态 */
+typedef enum {
+    GATEWAY_LINK_DOWN = 0,          /* 未连接，等待重连 */
+    GATEWAY_LINK_CONNECTING,        /* 非阻塞连接进行中 */
+    GATEWAY_LINK_UP                 /* 已连接 */
+} GatewayLinkState;
+
+/* 一条上游持久连接 */
+typedef struct {
+    int fd;
+    GatewayLinkState state;
+    uint64_t state_ns;              /* 进入当前状态的时刻 */
+    uint64_t retry_ns;              /* DOWN：下次重连的时刻 */
+    uint32_t retry_ms;              /* 当前退避间隔 */
+    bool want_write;                /* 是否关注 EPOLLOUT */
+    GatewaySlot slots[GATEWAY_MAX_INFLIGHT];
+    uint32_t inflight;
+    uint16_t sequence;              /* 事务标识符高 10 位的轮转序号 */
+    uint8_t rx[1024];               /* 收到的未成帧数据 */
+    size_t rx_length;
+    uint8_t tx[GATEWAY_MAX_INFLIGHT * MODBUS_MAX_MESSAGE_LENGTH];  /* 未写出的请求（放不下时断开连接） */
+    size_t tx_length;
+    uint64_t connects;              /* 建立连接的次数 */
+    uint64_t failures;              /* 连接失败或断开的次数 */
+} GatewayLink;
+
+/* 等待队列中的请求 */
+typedef struct {
+    int client_fd;                  /* -1 表示主站已断开 */
+    uint64_t request_ns;
+    bool joinable;
+    int32_t waiters;
+    uint16_t length;
+    uint8_t frame[MODBUS_MAX_MESSAGE_LENGTH];
+} GatewayQueued;
+
+/* 上游 */
+typedef struct {
+    struct sockaddr_in addr;
+    char name[32];                  /* "地址:端口" */
+    uint8_t first_unit;             /* 转发的单元 ID 范围 */
+    uint8_t last_unit;
+    uint32_t depth;                 /* 每条连接的流水线深度 */
+    GatewayLink *links;
+    uint32_t link_count;
+    GatewayQueued *backlog;         /* 等待队列（环形） */
+    uint32_t backlog_head;
+    uint32_t backlog_count;
+    GatewayWaiter *waiters;         /* 合并等待者池 */
+    int32_t free_waiter;            /* 空闲链表头，-1 表示已用完（之后的相同请求不再合并） */
+    uint64_t forwarded;             /* 发往上游的请求数 */
+    uint64_t responses;             /* 转回主站的响应数 */
+    uint64_t timeouts;              /* 超时回复异常 0B 的请求数 */
+    uint64_t unavailable;           /* 上游不可达回复异常 0A 的请求数 */
+    uint64_t busy;                  /* 等待队列已满回复异常 06 的请求数 */
+    uint64_t stale;                 /* 无法匹配（超时后迟到或主站已断开）的响应数 */
+    uint64_t queued;                /* 进入过等待队列的请求数 */
+    uint64_t coalesced;             /* 合并到相同在途请求上、未发往上游的读请求数 */
+    uint64_t cache_hits;            /* 以缓存应答的读请求数 */
+    uint32_t peak_inflight;         /* 全部连接在途数之和的峰值 */
+    uint64_t latency_total_us;      /* 上游往返耗时累计（用于平均值） */
+} GatewayUpstream;
+
+/* 读缓存规则：单元 ID 范围内、寄存器范围内的读响应缓存 ttl_ms 毫秒 */
+typedef struct {
+    uint8_t first_unit;
+    uint8_t last_unit;
+    uint8_t function_code;          /* FC03（holding）或 FC04（input） */
+    uint16_t first_address;
+    uint16_t last_address;
+    uint32_t ttl_ms;
+} GatewayCacheRule;
+
+/* 缓存项：一个读请求（单元、功能码、起始地址、数量）的响应 PDU */
+typedef struct {
+    bool valid;
+    uint8_t unit_id;
+    uint8_t function_code;
+    uint16_t start;
+    uint16_t quantity;
+    uint8_t length;                 /* PDU 长度 */
+    uint64_t expires_ns;
+    uint8_t pdu[MODBUS_MAX_PDU_LENGTH];
+} GatewayCacheEntry;
+
+/* 网关 */
+typedef struct {
+    GatewayUpstream upstreams[GATEWAY_MAX_UPSTREAMS];
+    size_t upstream_count;
+    uint8_t unit_upstream[256];     /* 单元 ID -> 上游下标加 1，0 表示在本地处理 */
+    uint32_t timeout_ms;
+    GatewayCacheRule cache_rules[GATEWAY_MAX_CACHE_RULES];
+    size_t cache_rule_count;
+    GatewayCacheEntry *cache;       /* GATEWAY_CACHE_SETS × GATEWAY_CACHE_WAYS 项，配置了规则时才分配 */
+    uint64_t cache_misses;          /* 落在缓存范围内但没有有效缓存的读请求数 */
+    uint64_t cache_fills;           /* 写入缓存的响应数 */
+    uint64_t cache_invalidations;   /* 因写入而失效的缓存项数 */
+    int epoll_fd;
+    int timer_fd;                   /* 周期检查超时和重连 */
+    GatewayDeliverFunc deliver;
+    void *context;
+} Gateway;
+
+/*
+ * 初始化空网关（未配置上游时其余函数均为空操作）
+ */
+void gateway_init(Gateway *gateway);
+
+/*
+ * 按规格添加一个上游
+ *
+ * 参数：
+ *   spec - 规格，格式为 <单元ID>[-<单元ID>]=<地址>:<端口>[,<连接数>[,<流水线深度>]]
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true；格式无效、单元 ID 已分配给其他上游或内存不足时返回 false
+ */
+bool gateway_add(Gateway *gateway, const char *spec, char *error, size_t error_size);
+
+/*
+ * 添加一条读缓存规则（单元 ID 须已由 gateway_add 转发给上游）
+ *
+ * 参数：
+ *   spec - 规格，格式为 <单元ID>[-<单元ID>]:<holding|input>:<起始地址>[-<结束地址>]=<毫秒>
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true
+ */
+bool gateway_add_cache_rule(Gateway *gateway, const char *spec, char *error, size_t error_size);
+
+/*
+ * 当前有效（未过期）的缓存项数
+ */
+size_t gateway_cache_entries(const Gateway *gateway);
+
+/*
+ * 创建定时器、分配读缓存、发起全部上游连接并加入 epoll 集合
+ *
+ * 参数：
+ *   epoll_fd - 服务器的 epoll 描述符
+ *   timeout_ms - 上游响应超时
+ *   deliver - 响应投递函数
+ *   context - 传给 deliver 的上下文
+ *
+ * 返回：
+ *   成功返回 true（上游暂时连不上不算失败，之后自动重连）
+ */
+bool gateway_start(Gateway *gateway, int epoll_fd, uint32_t timeout_ms, GatewayDeliverFunc deliver, void *context);
+
+/*
+ * 单元 ID 是否转发给上游
+ */
+bool gateway_routes(const Gateway *gateway, uint8_t unit_id);
+
+/*
+ * 转发一帧主站请求（帧须完整，单元 ID 须由 gateway_routes 确认）
+ *
+ * 读请求先查缓存，再尝试合并到相同的在途或排队请求上；其余请求发往上游或进入等待队列，
+ * 写请求使缓存失效。以缓存应答或无法转发时立即经投递函数回复。
+ *
+ * 参数：
+ *   client_fd - 主站连接的描述符
+ *   frame - MBAP 请求帧
+ *   length - 帧长度
+ */
+void gateway_forward(Gateway *gateway, int client_fd, const uint8_t *frame, size_t length);
+
+/*
+ * 描述符是否属于网关（上游连接或定时器）
+ */
+bool gateway_owns_fd(const Gateway *gateway, int fd);
+
+/*
+ * 处理网关描述符上的事件：连接完成、响应到达、可写或定时器到期
+ */
+void gateway_handle_event(Gateway *gateway, int fd, uint32_t events);
+
+/*
+ * 主站断开：它的在途和排队请求改由第一个仍连接的合并等待者接替，没有等待者时响应到达后丢弃
+ * （描述符可能被新连接复用）
+ */
+void gateway_client_closed(Gateway *gateway, int client_fd);
+
+/*
+ * 关闭全部上游连接和定时器并释放内存
+ */
+void gateway_close(Gateway *gateway);
+
+/*
+ * 上游当前的在途请求数（全部连接之和）
+ */
+uint32_t gateway_upstream_inflight(const GatewayUpstream *upstream);
+
+/*
+ * 连接状态名称
+ */
+const char *gateway_link_state_name(GatewayLinkState state);
+
+#endif /* GATEWAY_H */
@@ -0,0 +1,141 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+/*
+ * 寄存器值生成器模块
+ *
+ * 为单个寄存器或一段地址挂接生成器（常量、锯齿斜坡、正弦、随机游走、文件回放）。
+ * 生成器不使用定时器批量刷新，而是在寄存器被读取时按时钟惰性计算：
+ * 没人读的寄存器不消耗任何 CPU。
+ *
+ * 时钟默认跟随 CLOCK_MONOTONIC；可以调整倍速或直接快进（虚拟时钟），
+ * 测试中无需真实等待即可观察长周期的变化。
+ *
+ * 生成器规格字符串：
+ *   <holding|input>:<起始地址>[-<结束地址>]:<类型>[:<参数>=<值>,...]
+ * 类型与参数：
+ *   const   value
+ *   ramp    min, max, period（毫秒）
+ *   sine    base, amp, period（毫秒）
+ *   walk    base, step, interval（毫秒）, min, max, seed
+ *   replay  file（每行一个值）, interval（毫秒）
+ * 所有类型都支持 phase（毫秒）：地址段中第 i 个寄存器的时间偏移 i*phase，
+ * 使同一段内的各点互不相同。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 生成器规格字符串的最大长度 */
+#define GENERATOR_SPEC_LENGTH 256
+
+/* 生成器作用的寄存器组 */
+typedef enum {
+    GENERATOR_BANK_HOLDING = 0,
+    GENERATOR_BANK_INPUT
+} GeneratorBank;
+
+/* 生成器类型 */
+typedef enum {
+    GENERATOR_CONSTANT = 0,
+    GENERATOR_RAMP,
+    GENERATOR_SINE,
+    GENERATOR_RANDOM_WALK,
+    GENERATOR_REPLAY
+} GeneratorType;
+
+/* 单个生成器（作用于一段连续地址） */
+typedef struct {
+    GeneratorBank bank;                  /* 寄存器组 */
+    uint32_t start;                      /* 起始地址 */
+    uint32_t count;                      /* 寄存器数量 */
+    GeneratorType type;                  /* 类型 */
+    double value;                        /* const：值；sine/walk：基准值 */
+    double minimum;                      /* ramp/walk：下限 */
+    double maximum;                      /* ramp/walk：上限 */
+    double amplitude;                    /* sine：振幅 */
+    double step;                         /* walk：每步最大变化量 */
+    uint64_t period_ms;                  /* ramp/sine：周期；walk/replay：步长间隔 */
+    uint64_t phase_ms;                   /* 段内每个寄存器的时间偏移 */
+    uint64_t seed;                       /* walk：随机种子 */
+    uint16_t *samples;                   /* replay：样本 */
+    size_t sample_count;                 /* replay：样本数 */
+    uint16_t *walk_values;               /* walk：每个寄存器最后一次计算的值 */
+    uint64_t *walk_steps;                /* walk：每个寄存器已推进到的步数 */
+    char spec[GENERATOR_SPEC_LENGTH];    /* 原始规格字符串 */
+} Generator;
+
+/* 生成器集合（按寄存器组和起始地址排序）及其时钟 */
+typedef struct {
+    Generator *items;
+    size_t count;
+    size_t capacity;
+    double clock_speed;                  /* 时钟倍速，1.0 为真实时间 */
+    uint64_t clock_real_base_ns;         /* 上次调整时钟时的真实时间 */
+    double clock_virtual_base_ms;        /* 上次调整时钟时的虚拟时间 */
+    uint64_t evaluations;                /* 惰性计算的寄存器值个数 */
+} GeneratorSet;
+
+/*
+ * 初始化生成器集合（时钟从 0 开始，倍速 1.0）
+ */
+void generator_set_init(GeneratorSet *set);
+
+/*
+ * 释放全部生成器
+ */
+void generator_set_free(GeneratorSet *set);
+
+/*
+ * 按规格字符串添加生成器
+ *
+ * 参数：
+ *   spec - 规格字符串
+ *   register_count - 寄存器组大小，用于检查地址范围
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true；格式错误、地址越界或与已有生成器重叠时返回 false
+ */
+bool generator_set_add(GeneratorSet *set, const char *spec, uint32_t register_count,
+                       char *error, size_t error_size);
+
+/*
+ * 移除全部生成器（时钟保持不变）
+ */
+void generator_set_clear(GeneratorSet *set);
+
+/*
+ * 交换两个集合中的生成器（时钟和计数保持不变），用于整体替换预先在别处构建好的一组生成器
+ */
+void generator_set_swap_items(GeneratorSet *set, GeneratorSet *other);
+
+/*
+ * 用生成器的当前值覆盖读取结果中被生成器接管的寄存器
+ *
+ * 参数：
+ *   bank - 寄存器组
+ *   start - 读取起始地址
+ *   count - 读取数量
+ *   values - 输入输出：寄存器组中读出的值
+ */
+void generator_set_apply(GeneratorSet *set, GeneratorBank bank, uint32_t start, uint32_t count, uint16_t *values);
+
+/*
+ * 当前时钟（毫秒）
+ */
+uint64_t generator_clock_now_ms(GeneratorSet *set);
+
+/*
+ * 设置时钟倍速（从当前时刻起生效）
+ */
+void generator_clock_set_speed(GeneratorSet *set, double speed);
+
+/*
+ * 时钟快进指定毫秒
+ */
+void generator_clock_advance(GeneratorSet *set, uint64_t milliseconds);
+
+#endif /* GENERATOR_H */
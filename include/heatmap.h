@@ -0,0 +1,116 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+/*
+ * 寄存器访问热度统计模块
+ *
+ * 按地址记录每个寄存器被主站读取和写入的次数，用于调整页布局、预热范围
+ * 以及主站的轮询列表：
+ * - 热点范围：把相邻的、被访问过的寄存器合并成段，按访问次数排序；
+ * - 热度图：每页一行，每个寄存器一个字符，按对数刻度显示访问强度；
+ * - 二进制导出：文件头之后依次是保持寄存器读/写、输入寄存器读/写计数数组。
+ *
+ * 计数只在事件循环线程中累加（一个请求一段连续地址，一次批量加一），
+ * 不需要原子操作，也没有多个线程争用同一缓存行。
+ *
+ * 导出文件布局（主机字节序）：
+ * // 文件头(32字节) | 保持读(N*8) | 保持写(N*8) | 输入读(N*8) | 输入写(N*8)
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* 文件魔数 "MBHM" 与格式版本 */
+#define HEATMAP_MAGIC 0x4D42484Du
+#define HEATMAP_VERSION 1
+
+/* 字节序标记（含义同寄存器持久化文件） */
+#define HEATMAP_BYTE_ORDER_MARK 0x0102u
+
+/* 寄存器组编号 */
+typedef enum {
+    HEATMAP_BANK_HOLDING = 0,
+    HEATMAP_BANK_INPUT,
+    HEATMAP_BANK_COUNT
+} HeatmapBank;
+
+/* 导出文件头 */
+typedef struct {
+    uint32_t magic;              /* HEATMAP_MAGIC */
+    uint16_t version;            /* HEATMAP_VERSION */
+    uint16_t byte_order_mark;    /* HEATMAP_BYTE_ORDER_MARK */
+    uint32_t register_count;     /* 每类寄存器数量 */
+    uint32_t reserved;           /* 保留，写 0 */
+    uint64_t elapsed_ms;         /* 统计时长（自启动或上次清零） */
+    uint64_t timestamp_ns;       /* 导出时刻（CLOCK_REALTIME 纳秒） */
+} HeatmapFileHeader;
+
+/* 一个热点范围 */
+typedef struct {
+    HeatmapBank bank;
+    uint32_t start;
+    uint32_t count;
+    uint64_t reads;
+    uint64_t writes;
+} HeatRange;
+
+/* 访问计数 */
+typedef struct {
+    uint32_t register_count;
+    uint64_t *reads[HEATMAP_BANK_COUNT];
+    uint64_t *writes[HEATMAP_BANK_COUNT];
+    uint64_t started_ns;         /* 开始统计的时刻（CLOCK_MONOTONIC 纳秒） */
+} AccessHeatmap;
+
+/*
+ * 初始化访问计数
+ *
+ * 返回：
+ *   成功返回 true，内存不足返回 false
+ */
+bool heatmap_init(AccessHeatmap *map, uint32_t register_count);
+
+/*
+ * 释放访问计数
+ */
+void heatmap_destroy(AccessHeatmap *map);
+
+/*
+ * 清零全部计数并重新开始计时
+ */
+void heatmap_reset(AccessHeatmap *map);
+
+/*
+ * 记录一次读取/写入（地址范围由调用者保证有效）
+ */
+void heatmap_record_read(AccessHeatmap *map, HeatmapBank bank, uint32_t start, uint32_t count);
+void heatmap_record_write(AccessHeatmap *map, HeatmapBank bank, uint32_t start, uint32_t count);
+
+/*
+ * 找出访问次数最多的热点范围
+ *
+ * 参数：
+ *   ranges - 输出：按访问次数（读 + 写）降序排列
+ *   max_ranges - ranges 容量
+ *
+ * 返回：
+ *   实际输出的范围数
+ */
+size_t heatmap_top_ranges(const AccessHeatmap *map, HeatRange *ranges, size_t max_ranges);
+
+/*
+ * 打印一个寄存器组的热度图（每页一行，只打印有访问的页）
+ */
+void heatmap_print(const AccessHeatmap *map, HeatmapBank bank, FILE *out);
+
+/*
+ * 把全部计数导出到二进制文件（临时文件 + rename）
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool heatmap_dump(const AccessHeatmap *map, const char *path);
+
+#endif /* HEATMAP_H */
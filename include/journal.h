@@ -0,0 +1,140 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/*
+ * 寄存器写入日志模块（预写日志 + 组提交）
+ *
+ * 每次寄存器写入追加一条定长记录到内存缓冲区，由事件循环统一提交：
+ * - 组提交：一次 write() + fdatasync() 落盘一批记录，而不是每次写入都同步一次；
+ * - 提交时机：默认每轮事件循环结束时提交；指定组提交窗口后，最早的未提交记录
+ *   等待满窗口时长或缓冲字节数达到阈值时提交（事件循环据此缩短 epoll_wait 超时）。
+ *
+ * 文件布局（主机字节序）：
+ * // 文件头(16字节) | 记录(24字节) | 记录(24字节) | ...
+ *
+ * 每条记录带 CRC16，启动重放时遇到第一条校验失败的记录即认为是崩溃时写了一半的尾部，
+ * 截断后继续追加。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 文件魔数 "MBJL" 与格式版本 */
+#define JOURNAL_MAGIC 0x4D424A4Cu
+#define JOURNAL_VERSION 1
+
+/* 字节序标记（含义同寄存器持久化文件） */
+#define JOURNAL_BYTE_ORDER_MARK 0x0102u
+
+/* 记录所属的寄存器组：日志文件只记录保持寄存器，主备复制还推送默认输入寄存器的写入 */
+#define JOURNAL_BANK_HOLDING 0
+#define JOURNAL_BANK_INPUT 1
+
+/* 内存缓冲区大小；缓冲区满时立即提交 */
+#define JOURNAL_BUFFER_SIZE 65536
+
+/* 设置组提交窗口时，未提交数据达到此字节数即提前提交 */
+#define JOURNAL_GROUP_COMMIT_BYTES 32768
+
+/* 文件头 */
+typedef struct {
+    uint32_t magic;              /* JOURNAL_MAGIC */
+    uint16_t version;            /* JOURNAL_VERSION */
+    uint16_t byte_order_mark;    /* JOURNAL_BYTE_ORDER_MARK */
+    uint32_t register_count;     /* 每类寄存器数量 */
+    uint32_t reserved;           /* 保留，写 0 */
+} JournalHeader;
+
+/* 单条写入记录 */
+typedef struct {
+    uint64_t sequence;           /* 序列号，从 1 开始连续递增 */
+    uint64_t timestamp_ns;       /* 写入时刻（CLOCK_REALTIME 纳秒） */
+    uint16_t address;            /* 寄存器地址 */
+    uint16_t value;              /* 写入的值 */
+    uint8_t unit_id;             /* 请求中的单元标识符 */
+    uint8_t bank;                /* 寄存器组 JOURNAL_BANK_*（旧版本写 0，即保持寄存器） */
+    uint16_t checksum;           /* 前 22 字节的 CRC16 */
+} JournalRecord;
+
+/* 重放回调：按序列号顺序对每条需要重放的记录调用一次 */
+typedef void (*JournalApplyFunc)(const JournalRecord *record, void *context);
+
+/* 日志状态 */
+typedef struct {
+    int fd;                                  /* 日志文件，未启用时为 -1 */
+    uint8_t buffer[JOURNAL_BUFFER_SIZE];     /* 未提交的记录 */
+    size_t buffered;                         /* 未提交的字节数 */
+    uint64_t next_sequence;                  /* 下一条记录的序列号 */
+    uint64_t first_pending_ns;               /* 最早一条未提交记录的时刻（CLOCK_MONOTONIC） */
+    uint32_t group_window_ms;                /* 组提交窗口，0 表示每轮事件循环提交 */
+    uint64_t records;                        /* 本次运行追加的记录数 */
+    uint64_t commits;                        /* 本次运行的提交次数 */
+    uint64_t largest_group;                  /* 单次提交的最大记录数 */
+    uint64_t commit_usec_total;              /* 提交（write + fdatasync）累计耗时 */
+} Journal;
+
+/*
+ * 打开（必要时创建）日志文件并重放已有记录
+ *
+ * 参数：
+ *   journal - 日志状态
+ *   path - 日志文件路径
+ *   register_count - 每类寄存器数量，必须与已有日志一致
+ *   group_window_ms - 组提交窗口（毫秒），0 表示每轮事件循环提交
+ *   after_sequence - 只重放序列号大于此值的记录（例如已加载快照中的序列号）
+ *   apply - 重放回调
+ *   context - 回调参数
+ *   replayed - 输出：重放的记录数
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool journal_open(Journal *journal, const char *path, uint32_t register_count, uint32_t group_window_ms,
+                  uint64_t after_sequence, JournalApplyFunc apply, void *context, uint64_t *replayed);
+
+/*
+ * 填写一条写入记录（时刻取当前时间，并计算 CRC16）；主备复制推送的记录与日志文件中的记录格式相同
+ */
+void journal_fill_record(JournalRecord *record, uint64_t sequence, uint8_t bank, uint8_t unit_id,
+                         uint16_t address, uint16_t value);
+
+/*
+ * 记录的 CRC16 是否正确
+ */
+bool journal_record_valid(const JournalRecord *record);
+
+/*
+ * 追加一条写入记录（仅写入内存缓冲区，缓冲区满时先提交）
+ */
+void journal_append(Journal *journal, uint8_t unit_id, uint16_t address, uint16_t value);
+
+/*
+ * 是否应当提交（有未提交记录且已到提交时机）
+ */
+bool journal_commit_due(Journal *journal);
+
+/*
+ * 距离下一次必须提交的毫秒数，供 epoll_wait 使用；没有未提交记录时返回 -1
+ */
+int journal_timeout_ms(Journal *journal);
+
+/*
+ * 提交全部未提交记录：一次 write() + fdatasync()
+ *
+ * 返回：
+ *   成功返回 true
+ */
+bool journal_commit(Journal *journal);
+
+/*
+ * 最后一条已追加记录的序列号（没有记录时为 0）
+ */
+uint64_t journal_last_sequence(const Journal *journal);
+
+/*
+ * 提交剩余记录并关闭日志
+ */
+void journal_close(Journal *journal);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * 运行指标模块
+ *
+ * 统计请求数、收发字节数、按功能码和异常码分类的异常响应数、连接建立/关闭次数，
+ * 以及每个功能码从帧到达到响应写出的延迟直方图，并以 Prometheus 文本格式输出：
+ * - 控制台 metrics 命令直接打印；
+ * - 可选的本机 HTTP 端口（-M），GET /metrics 返回同样的内容后关闭连接。响应经连接的发送队列
+ *   非阻塞写出，慢速抓取方不会卡住事件循环；超过期限仍未应答完的抓取连接被关闭。
+ *
+ * 延迟直方图采用对数-线性分桶（与 HdrHistogram 思路相同）：1 到 8 微秒每微秒一个桶，
+ * 之后每个 2 的幂区间再等分为 4 个桶，相对误差不超过 25%，上限约 4.2 秒，更慢的计入 +Inf。
+ * 记录一次延迟只是一次移位和一次计数加一。
+ *
+ * 所有计数只在事件循环线程中累加，HTTP 请求也由同一个事件循环应答，
+ * 读者和写者不会并发，因此不需要原子操作或锁。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* 延迟直方图的有限桶数量（另有一个 +Inf 溢出桶） */
+#define METRICS_LATENCY_BUCKETS 84
+
+/* 抓取连接从接受到响应写完的期限（毫秒），超过后关闭连接 */
+#define METRICS_HTTP_TIMEOUT_MS 3000
+
+/* 单独计数的 Modbus 异常码上限（1..11，更大的计入 0 号） */
+#define METRICS_EXCEPTION_CODES 12
+
+/* 单个功能码的指标 */
+typedef struct {
+    uint64_t requests;                                      /* 已应答的请求数 */
+    uint64_t exceptions[METRICS_EXCEPTION_CODES];           /* 按异常码分类的异常响应数 */
+    uint64_t latency_buckets[METRICS_LATENCY_BUCKETS + 1];  /* 各桶计数（非累积），最后一个为 +Inf */
+    uint64_t latency_sum_ns;                                /* 延迟总和 */
+} FunctionMetrics;
+
+/* 服务器运行指标 */
+typedef struct {
+    FunctionMetrics functions[128];  /* 按功能码（去掉异常位）索引 */
+    uint64_t bytes_received;         /* 从客户端和串口线路读到的字节数 */
+    uint64_t bytes_sent;             /* 写给客户端和串口线路的字节数 */
+    uint64_t connections_opened;     /* 接受的客户端连接数 */
+    uint64_t connections_closed;     /* 断开的客户端连接数 */
+    uint64_t scrapes;                /* 已应答的 HTTP 抓取次数 */
+    uint64_t scrape_timeouts;        /* 超过期限被关闭的抓取连接数 */
+    uint64_t started_ns;             /* 启动时刻（CLOCK_MONOTONIC 纳秒） */
+} ServerMetrics;
+
+/*
+ * 初始化指标（全部清零并记录启动时刻）
+ */
+void metrics_init(ServerMetrics *metrics);
+
+/*
+ * 当前单调时钟纳秒值，用于记录帧到达时刻
+ */
+uint64_t metrics_now_ns(void);
+
+/*
+ * 记录一次已应答的请求
+ *
+ * 参数：
+ *   function_code - 请求功能码（响应中的异常位已去掉）
+ *   exception_code - 异常码，正常响应为 0
+ *   latency_ns - 从帧到达到响应写出的耗时
+ */
+void metrics_record_request(ServerMetrics *metrics, uint8_t function_code, uint8_t exception_code,
+                            uint64_t latency_ns);
+
+/*
+ * 延迟直方图第 index 个桶的上界（微秒）
+ */
+uint64_t metrics_bucket_bound_us(size_t index);
+
+/*
+ * 以 Prometheus 文本格式（0.0.4）输出全部指标
+ *
+ * 参数：
+ *   out - 输出流
+ *   active_connections - 当前连接数（作为 gauge 输出）
+ */
+void metrics_write_prometheus(const ServerMetrics *metrics, FILE *out, int active_connections);
+
+/* 读取 HTTP 抓取请求的结果 */
+typedef enum {
+    METRICS_HTTP_PENDING = 0,       /* 请求头尚未收完，继续等待可读 */
+    METRICS_HTTP_READY,             /* 响应已生成，由调用者写出 */
+    METRICS_HTTP_CLOSED             /* 对端关闭或出错，调用者应关闭连接 */
+} MetricsHttpStatus;
+
+/*
+ * 读取 HTTP 抓取连接上的请求：请求头完整后读取请求行，GET /metrics 生成指标响应，其余路径生成 404
+ *
+ * 只生成完整的 HTTP 响应（含响应头），不写套接字，由调用者经发送队列非阻塞写出。
+ *
+ * 参数：
+ *   fd - 已接受的 HTTP 连接（非阻塞）
+ *   active_connections - 当前 Modbus 客户端连接数
+ *   response - 输出：METRICS_HTTP_READY 时为 malloc 分配的响应，调用者 free
+ *   response_length - 输出：响应长度
+ *   found - 输出：请求的是 /metrics（响应为 200）
+ *
+ * 返回：
+ *   见 MetricsHttpStatus
+ */
+MetricsHttpStatus metrics_read_http(const ServerMetrics *metrics, int fd, int active_connections,
+                                    char **response, size_t *response_length, bool *found);
+
+#endif /* METRICS_H */
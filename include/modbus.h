@@ -44,6 +44,40 @@
 /* FC10：写多个寄存器（Write Multiple Registers） */
 #define MODBUS_FC_WRITE_MULTIPLE_REGISTERS 0x10
 
+/*
+ * 厂商扩展功能码（0x41-0x48 为规范保留的用户自定义功能码范围）
+ *
+ * FC41 订阅寄存器变化 - 请求与响应格式相同（响应回显请求）
+ * // 功能码(1字节) | 读功能码(1字节) | 起始地址(2字节) | 数量(2字节)
+ * // 0x41         | 0x03           | 0x00 0x64      | 0x00 0x0A
+ * 读功能码 0x03 表示保持寄存器，0x04 表示输入寄存器；数量为 0 时取消本连接在该组上的全部订阅。
+ *
+ * FC42 寄存器变化推送 - 服务器主动发送，事务标识符为 0
+ * // 功能码(1字节) | 读功能码(1字节) | 段数(1字节) | 起始地址(2字节) | 数量(1字节) | 寄存器值(数量*2字节) | ...
+ * // 0x42         | 0x03           | 0x01        | 0x00 0x64      | 0x02        | 0x00 0x01 0x00 0x02
+ * 每轮事件循环结束时，把订阅范围内被写过的寄存器按连续地址合并成段推送给订阅者。
+ */
+#define MODBUS_FC_SUBSCRIBE 0x41
+#define MODBUS_FC_CHANGE_NOTIFY 0x42
+
+/*
+ * FC43 分散读（一次读取多段不相邻的寄存器）
+ * 请求：功能码(1字节) | 读功能码(1字节) | 段数(1字节) | {起始地址(2字节) 数量(2字节)}...
+ * 响应：功能码(1字节) | 读功能码(1字节) | 字节计数(1字节) | 寄存器值...（按请求中段的顺序排列）
+ * 各段寄存器总数不超过 MODBUS_MAX_READ_REGISTERS。
+ *
+ * FC44 原子多点写（一次写入多个不相邻的保持寄存器，读者要么看到全部新值，要么看到全部旧值）
+ * 请求：功能码(1字节) | 点数(1字节) | {地址(2字节) 值(2字节)}...
+ * 响应：功能码(1字节) | 点数(1字节)
+ * 任一地址越界时整个请求被拒绝，不写入任何寄存器。
+ */
+#define MODBUS_FC_READ_VECTOR 0x43
+#define MODBUS_FC_WRITE_VECTOR 0x44
+
+/* FC43 一次请求的最大段数、FC44 一次请求的最大点数（受 PDU 长度限制） */
+#define MODBUS_MAX_VECTOR_RANGES 62
+#define MODBUS_MAX_VECTOR_WRITES 62
+
 /* 错误响应标志（功能码最高位置1） */
 #define MODBUS_FC_ERROR 0x80
 
@@ -61,6 +95,15 @@
 /* 异常码04：服务器设备故障 */
 #define MODBUS_EXCEPTION_SERVER_DEVICE_FAILURE 0x04
 
+/* 异常码06：服务器设备忙 */
+#define MODBUS_EXCEPTION_SERVER_DEVICE_BUSY 0x06
+
+/* 异常码0A：网关路径不可用（网关无法连接目标设备） */
+#define MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE 0x0A
+
+/* 异常码0B：网关目标设备未响应 */
+#define MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED 0x0B
+
 /* ============= Modbus TCP MBAP Header 结构体 ============= */
 
 /*
@@ -190,6 +233,18 @@ typedef struct {
  */
 bool modbus_parse_request(const uint8_t *buffer, size_t length, ModbusTCPMessage *message);
 
+/*
+ * 根据已收到的字节推算 MBAP 帧的完整长度（用于 TCP 流式分帧）
+ *
+ * 参数：
+ *   buffer - 已接收数据
+ *   length - 已接收长度
+ *
+ * 返回：
+ *   >0 完整帧长度；0 数据不足 6 字节；-1 协议标识符或长度字段非法
+ */
+int modbus_tcp_frame_length(const uint8_t *buffer, size_t length);
+
 /*
  * 构建 FC03 读保持寄存器响应
  * 
@@ -208,6 +263,20 @@ size_t modbus_build_fc03_response(uint16_t transaction_id, uint8_t unit_id,
                                   const uint16_t *registers, uint16_t quantity,
                                   uint8_t *buffer, size_t buffer_size);
 
+/*
+ * 构建读寄存器响应（FC03 读保持寄存器 / FC04 读输入寄存器）
+ * 
+ * 参数：
+ *   function_code - MODBUS_FC_READ_HOLDING_REGISTERS 或 MODBUS_FC_READ_INPUT_REGISTERS
+ *   其余参数同 modbus_build_fc03_response
+ * 
+ * 返回：
+ *   响应消息的实际长度（字节数）
+ */
+size_t modbus_build_read_registers_response(uint16_t transaction_id, uint8_t unit_id, uint8_t function_code,
+                                            const uint16_t *registers, uint16_t quantity,
+                                            uint8_t *buffer, size_t buffer_size);
+
 /*
  * 构建 FC06 写单个寄存器响应
  * 
@@ -226,6 +295,109 @@ size_t modbus_build_fc06_response(uint16_t transaction_id, uint8_t unit_id,
                                   uint16_t register_address, uint16_t register_value,
                                   uint8_t *buffer, size_t buffer_size);
 
+/*
+ * 构建 FC10 写多个寄存器响应
+ * 
+ * 参数：
+ *   transaction_id - 事务标识符（来自请求）
+ *   unit_id - 单元标识符（来自请求）
+ *   start_address - 起始地址
+ *   quantity - 写入的寄存器数量
+ *   buffer - 输出：响应消息缓冲区
+ *   buffer_size - 缓冲区大小
+ * 
+ * 返回：
+ *   响应消息的实际长度（字节数）
+ */
+size_t modbus_build_fc10_response(uint16_t transaction_id, uint8_t unit_id,
+                                  uint16_t start_address, uint16_t quantity,
+                                  uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 构建 FC41 订阅请求（响应与请求格式相同，服务器也用它回显）
+ *
+ * 参数：
+ *   transaction_id - 事务标识符
+ *   unit_id - 单元标识符
+ *   read_function_code - 订阅的寄存器组：MODBUS_FC_READ_HOLDING_REGISTERS 或 MODBUS_FC_READ_INPUT_REGISTERS
+ *   start_address - 起始地址
+ *   quantity - 寄存器数量，0 表示取消订阅
+ *   buffer - 输出：消息缓冲区
+ *   buffer_size - 缓冲区大小
+ *
+ * 返回：
+ *   消息的实际长度（字节数）
+ */
+size_t modbus_build_subscribe_request(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                      uint16_t start_address, uint16_t quantity,
+                                      uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 构建 FC43 分散读请求
+ *
+ * 参数：
+ *   transaction_id - 事务标识符
+ *   unit_id - 单元标识符
+ *   read_function_code - MODBUS_FC_READ_HOLDING_REGISTERS 或 MODBUS_FC_READ_INPUT_REGISTERS
+ *   starts - 各段起始地址
+ *   quantities - 各段寄存器数量
+ *   range_count - 段数（1 到 MODBUS_MAX_VECTOR_RANGES）
+ *   buffer - 输出：请求消息缓冲区
+ *   buffer_size - 缓冲区大小
+ *
+ * 返回：
+ *   请求消息的实际长度（字节数），参数无效时返回 0
+ */
+size_t modbus_build_read_vector_request(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                        const uint16_t *starts, const uint16_t *quantities, size_t range_count,
+                                        uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 构建 FC43 分散读响应
+ *
+ * 参数：
+ *   registers - 按段顺序拼接的寄存器值
+ *   quantity - 寄存器总数（不超过 MODBUS_MAX_READ_REGISTERS）
+ *   其余参数同 modbus_build_read_vector_request
+ *
+ * 返回：
+ *   响应消息的实际长度（字节数）
+ */
+size_t modbus_build_read_vector_response(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                         const uint16_t *registers, uint16_t quantity,
+                                         uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 构建 FC44 原子多点写请求
+ *
+ * 参数：
+ *   transaction_id - 事务标识符
+ *   unit_id - 单元标识符
+ *   addresses - 地址数组
+ *   values - 值数组
+ *   count - 点数（1 到 MODBUS_MAX_VECTOR_WRITES）
+ *   buffer - 输出：请求消息缓冲区
+ *   buffer_size - 缓冲区大小
+ *
+ * 返回：
+ *   请求消息的实际长度（字节数），参数无效时返回 0
+ */
+size_t modbus_build_write_vector_request(uint16_t transaction_id, uint8_t unit_id,
+                                         const uint16_t *addresses, const uint16_t *values, size_t count,
+                                         uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 构建 FC44 原子多点写响应
+ *
+ * 参数：
+ *   count - 写入的点数
+ *
+ * 返回：
+ *   响应消息的实际长度（字节数）
+ */
+size_t modbus_build_write_vector_response(uint16_t transaction_id, uint8_t unit_id, uint8_t count,
+                                          uint8_t *buffer, size_t buffer_size);
+
 /*
  * 构建 Modbus 错误响应
  * 
@@ -0,0 +1,125 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Modbus RTU 帧格式头文件
+ *
+ * RTU ADU = 从站地址(1字节) + PDU + CRC16(2字节，低字节在前)。
+ * 服务器内部统一按 MBAP 格式处理请求，RTU 帧在收发两端与 MBAP 帧互相转换，
+ * 因此 RTU-over-TCP 与 PTY 串口从站复用同一套 Modbus 处理逻辑。
+ */
+
+/* ============= Modbus RTU 协议常量 ============= */
+
+/* RTU ADU 最大长度（地址1 + PDU253 + CRC2 = 256字节） */
+#define MODBUS_RTU_MAX_ADU_LENGTH 256
+
+/* RTU ADU 最小长度（地址1 + 功能码1 + CRC2 = 4字节） */
+#define MODBUS_RTU_MIN_ADU_LENGTH 4
+
+/* CRC 字段长度 */
+#define MODBUS_RTU_CRC_LENGTH 2
+
+/* RTU 广播地址（从站不应答） */
+#define MODBUS_RTU_BROADCAST_ADDRESS 0
+
+/* 波特率高于 19200 时，规范规定 t3.5 固定为 1750 微秒 */
+#define MODBUS_RTU_FIXED_T35_USEC 1750
+
+/* ============= 函数接口声明 ============= */
+
+/*
+ * 计算 Modbus CRC16（多项式 0xA001，初值 0xFFFF）
+ *
+ * 使用 slice-by-8 查表法，每轮处理 8 字节，尾部逐字节处理。
+ *
+ * 参数：
+ *   data - 数据缓冲区
+ *   length - 数据长度
+ *
+ * 返回：
+ *   CRC16 值（发送时低字节在前）
+ */
+uint16_t modbus_rtu_crc16(const uint8_t *data, size_t length);
+
+/*
+ * 校验 RTU 帧末尾的 CRC
+ *
+ * 参数：
+ *   frame - 完整 RTU 帧（含 CRC）
+ *   length - 帧长度
+ *
+ * 返回：
+ *   CRC 正确返回 true，否则返回 false
+ */
+bool modbus_rtu_check_crc(const uint8_t *frame, size_t length);
+
+/*
+ * 根据已收到的字节推算 RTU 请求帧的完整长度（用于 RTU-over-TCP 流式分帧）
+ *
+ * 参数：
+ *   buffer - 已接收数据
+ *   length - 已接收长度
+ *
+ * 返回：
+ *   >0 完整帧长度；0 数据不足以判断；-1 功能码未知，无法推算
+ */
+int modbus_rtu_request_length(const uint8_t *buffer, size_t length);
+
+/*
+ * 在功能码未知的数据开头查找 CRC 正确的最短帧（用于 RTU-over-TCP 流重新同步）
+ *
+ * 参数：
+ *   buffer - 已接收数据
+ *   length - 已接收长度
+ *
+ * 返回：
+ *   找到时返回帧长度；没有 CRC 正确的前缀返回 0
+ */
+size_t modbus_rtu_scan_frame(const uint8_t *buffer, size_t length);
+
+/*
+ * 将 RTU 帧转换为 MBAP 帧（校验并去掉 CRC，补上 MBAP Header）
+ *
+ * 参数：
+ *   rtu_frame - RTU 帧（含 CRC）
+ *   rtu_length - RTU 帧长度
+ *   transaction_id - 填入 MBAP 的事务标识符
+ *   buffer - 输出：MBAP 帧缓冲区
+ *   buffer_size - 缓冲区大小
+ *
+ * 返回：
+ *   MBAP 帧长度；CRC 错误或长度非法返回 0
+ */
+size_t modbus_rtu_to_tcp(const uint8_t *rtu_frame, size_t rtu_length,
+                         uint16_t transaction_id,
+                         uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 将 MBAP 帧转换为 RTU 帧（去掉 MBAP Header，追加 CRC）
+ *
+ * 参数：
+ *   tcp_frame - MBAP 帧
+ *   tcp_length - MBAP 帧长度
+ *   buffer - 输出：RTU 帧缓冲区
+ *   buffer_size - 缓冲区大小
+ *
+ * 返回：
+ *   RTU 帧长度，失败返回 0
+ */
+size_t modbus_tcp_to_rtu(const uint8_t *tcp_frame, size_t tcp_length,
+                         uint8_t *buffer, size_t buffer_size);
+
+/*
+ * 计算指定波特率下的 t3.5 帧间隔（微秒）
+ *
+ * 每个字符按 11 位（起始位 + 8 数据位 + 校验/停止位 + 停止位）计算；
+ * 波特率高于 19200 时使用规范推荐的固定值 1750 微秒。
+ */
+uint32_t modbus_rtu_t35_usec(uint32_t baud_rate);
+
+#endif /* MODBUS_RTU_H */
@@ -0,0 +1,48 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+/*
+ * 无锁多生产者单消费者队列（侵入式链表）
+ *
+ * 采用 Vyukov 的 MPSC 队列：生产者只做一次原子交换（把自己设为新的队尾）和一次
+ * 指针发布，不加锁也不循环重试；消费者独占队头，出队不需要原子读-改-写。
+ * 节点嵌入在调用者的结构体中（通常作为第一个成员），入队和出队都不分配内存。
+ *
+ * 生产者在交换队尾之后、链接前驱之前被抢占时，队列短暂处于"不一致"状态，
+ * 此时 mpsc_queue_pop 返回 NULL；该生产者完成入队后应再通知消费者
+ * （例如写 eventfd），消费者届时即可取到全部节点。
+ */
+
+#include <stdbool.h>
+
+/* 队列节点（嵌入在元素结构体中） */
+typedef struct MpscNode {
+    struct MpscNode *next;
+} MpscNode;
+
+/* 队列：head 由生产者原子交换，tail 只由消费者访问 */
+typedef struct {
+    MpscNode *head;     /* 最近入队的节点 */
+    MpscNode *tail;     /* 下一个出队的节点（可能是占位节点） */
+    MpscNode stub;      /* 占位节点，队列为空时 head 和 tail 都指向它 */
+} MpscQueue;
+
+/*
+ * 初始化空队列
+ */
+void mpsc_queue_init(MpscQueue *queue);
+
+/*
+ * 入队（任意线程，无锁且无等待）
+ */
+void mpsc_queue_push(MpscQueue *queue, MpscNode *node);
+
+/*
+ * 出队（只能由唯一的消费者线程调用）
+ *
+ * 返回：
+ *   最早入队的节点；队列为空或有生产者尚未完成入队时返回 NULL
+ */
+MpscNode *mpsc_queue_pop(MpscQueue *queue);
+
+#endif /* MPSC_QUEUE_H */
@@ -0,0 +1,120 @@
+#ifndef OUTBOUND_H
+#define OUTBOUND_H
+
+/*
+ * 连接发送队列与共享消息缓冲区
+ *
+ * 服务器主动发出的数据（广播、send、变化推送）以及一次没能写完的响应不再在事件循环中反复重试写入，
+ * 而是挂到连接的发送队列上，等套接字可写时再写出：
+ * - OutboundBuffer 是不可变的消息缓冲区，带引用计数。广播只创建一个缓冲区，
+ *   把同一个指针挂到每个连接的队列上（每个连接一次指针存储和一次计数加一），不复制数据；
+ * - 每个连接的队列记录队头缓冲区已写出的字节数，部分写入后从断点继续；
+ * - 每个连接写完或丢弃一个缓冲区时更新它的送达/丢弃计数，最后一个引用释放时调用完成回调，
+ *   由回调异步报告投递结果。
+ *
+ * 缓冲区从连接缓冲池借用，最后一个引用释放时归还。
+ * 缓冲区和队列只在事件循环线程中访问，引用计数不需要原子操作。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "buffer_pool.h"
+
+/* 每个连接最多排队的缓冲区数，写满后新的消息对该连接丢弃 */
+#define OUTBOUND_QUEUE_CAPACITY 64
+
+typedef struct OutboundBuffer OutboundBuffer;
+
+/*
+ * 缓冲区完成回调：最后一个引用释放时调用（送达与丢弃计数此时已确定）
+ */
+typedef void (*OutboundCompleteFunc)(const OutboundBuffer *buffer, void *context);
+
+/* 不可变的共享消息缓冲区 */
+struct OutboundBuffer {
+    uint32_t refs;                  /* 引用数：创建者一个，每个排队的连接一个 */
+    uint32_t targets;               /* 尝试排队的连接数 */
+    uint32_t delivered;             /* 完整写出的连接数 */
+    uint32_t dropped;               /* 队列已满或未写完即断开的连接数 */
+    uint64_t id;                    /* 调用者分配的编号（用于报告） */
+    uint64_t created_ns;            /* 创建时刻（CLOCK_MONOTONIC 纳秒） */
+    OutboundCompleteFunc complete;  /* 完成回调，可为 NULL */
+    void *context;
+    BufferPool *pool;               /* 借出本缓冲区的缓冲池 */
+    size_t length;
+    uint8_t data[];
+};
+
+/* 连接的发送队列（环形数组，元素为缓冲区引用） */
+typedef struct {
+    OutboundBuffer *items[OUTBOUND_QUEUE_CAPACITY];
+    uint32_t head;                  /* 队头下标 */
+    uint32_t count;                 /* 排队的缓冲区数 */
+    size_t offset;                  /* 队头缓冲区已写出的字节数 */
+} OutboundQueue;
+
+/*
+ * 写函数：与 write() 语义相同
+ */
+typedef ssize_t (*OutboundWriteFunc)(void *context, const void *data, size_t length);
+
+/* 刷新结果 */
+typedef enum {
+    OUTBOUND_FLUSH_DRAINED = 0,     /* 队列已写空 */
+    OUTBOUND_FLUSH_BLOCKED,         /* 套接字发送缓冲区已满，等待可写 */
+    OUTBOUND_FLUSH_ERROR            /* 写入出错，连接应断开 */
+} OutboundFlushResult;
+
+/*
+ * 从缓冲池创建缓冲区（复制数据），调用者持有一个引用
+ *
+ * 返回：
+ *   新缓冲区，超出缓冲池上限或内存不足返回 NULL
+ */
+OutboundBuffer *outbound_buffer_create(BufferPool *pool, const void *data, size_t length);
+
+/*
+ * 释放一个引用；最后一个引用释放时调用完成回调并归还缓冲池
+ */
+void outbound_buffer_release(OutboundBuffer *buffer);
+
+/*
+ * 初始化空队列
+ */
+void outbound_queue_init(OutboundQueue *queue);
+
+/*
+ * 把缓冲区挂到队尾（增加一个引用）
+ *
+ * 返回：
+ *   成功返回 true；队列已满返回 false（计入缓冲区的丢弃数）
+ */
+bool outbound_queue_push(OutboundQueue *queue, OutboundBuffer *buffer);
+
+/*
+ * 按顺序写出队列中的数据，直到写空、写不动或出错
+ *
+ * 参数：
+ *   write_func - 写函数
+ *   context - 传给写函数的上下文
+ */
+OutboundFlushResult outbound_queue_flush(OutboundQueue *queue, OutboundWriteFunc write_func, void *context);
+
+/*
+ * 丢弃队列中的全部缓冲区（连接断开时调用，计入各缓冲区的丢弃数）
+ */
+void outbound_queue_clear(OutboundQueue *queue);
+
+/*
+ * 队列是否为空
+ */
+bool outbound_queue_empty(const OutboundQueue *queue);
+
+/*
+ * 队列中尚未写出的字节数
+ */
+size_t outbound_queue_bytes(const OutboundQueue *queue);
+
+#endif /* OUTBOUND_H */
@@ -0,0 +1,157 @@
+#ifndef REGISTER_BANK_H
+#define REGISTER_BANK_H
+
+/*
+ * 分页寄存器组模块（每页一个 seqlock）
+ *
+ * 寄存器按 REGISTER_BANK_PAGE_REGISTERS 个一组分页，每页有独立的序列号：
+ * - 读者不加锁：记录所涉及各页的序列号 -> 复制数据 -> 再次检查序列号，
+ *   有变化（或读到奇数，表示写者正在写）就重试，保证读到的多个寄存器来自同一时刻，
+ *   跨页的 32 位值（高低两个字）也不会被撕裂；
+ * - 写者按页串行：以 CAS 把序列号从偶数改为奇数作为该页的写锁，
+ *   跨页写入按页号升序加锁，避免两个写者互相等待。
+ *
+ * 每页保存独立的数据指针，寄存器数据既可以是模块自行分配的连续内存，
+ * 也可以是调用者提供的外部内存（例如持久化文件的映射区域）。
+ *
+ * 写时复制的寄存器组（register_bank_init_cow）以另一个只读寄存器组为模板：
+ * 没写过的页直接读模板的页，某页第一次写入时才分配该页的私有副本（一页 128 字节加页头），
+ * 页表本身也在第一次写入时才分配。大量相同设备共享一份模板，内存只随各自写过的页增长。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 每页寄存器数量（64 个寄存器 = 128 字节，两个缓存行） */
+#define REGISTER_BANK_PAGE_SHIFT 6
+#define REGISTER_BANK_PAGE_REGISTERS (1u << REGISTER_BANK_PAGE_SHIFT)
+
+/* 一次一致性读取最多跨越的页数，更长的读取分段进行（每段内部一致） */
+#define REGISTER_BANK_READ_SPAN_PAGES 4
+
+/* 一次离散写入最多包含的寄存器数 */
+#define REGISTER_BANK_SCATTER_MAX 128
+
+/* 单页：序列号独占一个缓存行，避免相邻页的读写互相干扰 */
+typedef struct {
+    uint32_t sequence;       /* 序列号：偶数表示空闲，奇数表示正在写入 */
+    uint16_t *data;          /* 本页寄存器数据 */
+} __attribute__((aligned(64))) RegisterPage;
+
+/* 寄存器组 */
+typedef struct RegisterBank {
+    uint32_t register_count;     /* 寄存器数量 */
+    uint32_t page_count;         /* 页数 */
+    RegisterPage *pages;         /* 页数组（写时复制的寄存器组为 NULL） */
+    uint16_t *storage;           /* 连续数据区（外部提供或自行分配） */
+    bool owns_storage;           /* 数据区是否由本模块分配 */
+    const struct RegisterBank *base;  /* 写时复制的模板，普通寄存器组为 NULL */
+    RegisterPage **overlay;      /* 写时复制：各页的私有副本（NULL 表示仍读模板），第一次写入时分配 */
+    uint32_t private_pages;      /* 写时复制：已复制的页数 */
+    uint64_t read_retries;       /* 读者因并发写入而重试的次数（读者不维护其他计数，避免争用同一缓存行） */
+    uint64_t writes;             /* 写入次数 */
+} RegisterBank;
+
+/* 寄存器组统计信息 */
+typedef struct {
+    uint32_t register_count;
+    uint32_t page_count;
+    uint32_t private_pages;      /* 写时复制的寄存器组已复制的页数 */
+    uint64_t read_retries;
+    uint64_t writes;
+} RegisterBankStats;
+
+/*
+ * 初始化寄存器组
+ *
+ * 参数：
+ *   bank - 寄存器组
+ *   register_count - 寄存器数量
+ *   storage - 外部数据区（至少 register_count 个寄存器），为 NULL 时自行分配并清零
+ *
+ * 返回：
+ *   成功返回 true，内存不足返回 false
+ */
+bool register_bank_init(RegisterBank *bank, uint32_t register_count, uint16_t *storage);
+
+/*
+ * 以模板初始化写时复制的寄存器组（不复制任何数据）
+ *
+ * 参数：
+ *   bank - 寄存器组
+ *   base - 模板寄存器组，在本寄存器组的整个生命周期内不得再写入或释放
+ */
+void register_bank_init_cow(RegisterBank *bank, const RegisterBank *base);
+
+/*
+ * 写时复制的寄存器组占用的私有内存（页表与已复制的页，字节）
+ */
+size_t register_bank_private_bytes(const RegisterBank *bank);
+
+/*
+ * 释放寄存器组（外部数据区不会被释放）
+ */
+void register_bank_destroy(RegisterBank *bank);
+
+/*
+ * 无锁读取一段连续寄存器
+ *
+ * 参数：
+ *   start - 起始地址
+ *   count - 数量
+ *   values - 输出：寄存器值
+ *
+ * 返回：
+ *   成功返回 true，地址越界返回 false
+ */
+bool register_bank_read(RegisterBank *bank, uint32_t start, uint32_t count, uint16_t *values);
+
+/*
+ * 写入一段连续寄存器（对所有读者原子可见）
+ *
+ * 返回：
+ *   成功返回 true，地址越界（或写时复制时内存不足）返回 false
+ */
+bool register_bank_write(RegisterBank *bank, uint32_t start, uint32_t count, const uint16_t *values);
+
+/*
+ * 原子写入一组离散寄存器
+ *
+ * 涉及的全部页按页号升序加锁后统一写入再统一解锁，读者要么看到全部新值，要么看到全部旧值。
+ * 同一地址出现多次时以最后一次为准。
+ *
+ * 参数：
+ *   addresses - 地址数组
+ *   values - 值数组
+ *   count - 数量（1 到 REGISTER_BANK_SCATTER_MAX）
+ *
+ * 返回：
+ *   成功返回 true；数量无效、任一地址越界或写时复制时内存不足返回 false，此时不写入任何寄存器
+ */
+bool register_bank_write_scattered(RegisterBank *bank, const uint32_t *addresses, const uint16_t *values,
+                                   uint32_t count);
+
+/*
+ * 读取单个寄存器（地址必须有效）
+ */
+uint16_t register_bank_get(RegisterBank *bank, uint32_t address);
+
+/*
+ * 写入单个寄存器（地址必须有效）
+ */
+void register_bank_set(RegisterBank *bank, uint32_t address, uint16_t value);
+
+/*
+ * 获取寄存器在数据区中的地址（用于持久化同步等需要原始内存的场合）
+ *
+ * 写时复制的寄存器组中没写过的页返回模板中的地址，不得经此写入。
+ */
+uint16_t* register_bank_location(RegisterBank *bank, uint32_t address);
+
+/*
+ * 获取统计信息
+ */
+void register_bank_get_stats(RegisterBank *bank, RegisterBankStats *stats);
+
+#endif /* REGISTER_BANK_H */
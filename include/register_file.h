@@ -0,0 +1,110 @@
+#ifndef REGISTER_FILE_H
+#define REGISTER_FILE_H
+
+/*
+ * 寄存器持久化文件模块（mmap）
+ *
+ * 文件布局：
+ * // 文件头(4096字节，页对齐) | 保持寄存器(N*2字节) | 输入寄存器(N*2字节)
+ *
+ * 寄存器以主机字节序直接存放，启动时只需 mmap 和检查文件头，无需解析或复制；
+ * 服务器直接读写映射内存，因此写入在进程崩溃后依然保留（位于页缓存中）。
+ * msync 策略只决定数据何时落盘，用于抵御断电或内核崩溃。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 文件魔数 "MBRG" 与格式版本 */
+#define REGISTER_FILE_MAGIC 0x4D425247u
+#define REGISTER_FILE_VERSION 1
+
+/* 字节序标记：以主机字节序写入，读取时不相等说明文件来自不同字节序的机器 */
+#define REGISTER_FILE_BYTE_ORDER_MARK 0x0102u
+
+/* 文件头大小（一个页，保证寄存器数组页对齐） */
+#define REGISTER_FILE_HEADER_SIZE 4096
+
+/* msync 策略 */
+typedef enum {
+    REGISTER_SYNC_NEVER = 0,   /* 不主动 msync，由内核回写脏页 */
+    REGISTER_SYNC_PERIODIC,    /* 按固定周期 msync（timerfd 驱动） */
+    REGISTER_SYNC_EVERY_WRITE  /* 每次写请求后同步 msync 被修改的页 */
+} RegisterSyncPolicy;
+
+/* 文件头（位于文件开头，其余字节填零） */
+typedef struct {
+    uint32_t magic;              /* REGISTER_FILE_MAGIC */
+    uint16_t version;            /* REGISTER_FILE_VERSION */
+    uint16_t byte_order_mark;    /* REGISTER_FILE_BYTE_ORDER_MARK */
+    uint32_t register_count;     /* 每类寄存器数量 */
+    uint32_t initialized;        /* 初值写入完成后置 1，防止使用半初始化的文件 */
+    uint64_t open_count;         /* 被服务器打开的次数（诊断用） */
+} RegisterFileHeader;
+
+/* 已打开的持久化文件 */
+typedef struct {
+    int fd;                          /* 文件描述符 */
+    int timer_fd;                    /* 周期 msync 定时器（仅 PERIODIC 策略，否则为 -1） */
+    void *map;                       /* 映射起始地址 */
+    size_t map_size;                 /* 映射大小 */
+    RegisterFileHeader *header;      /* 文件头 */
+    uint16_t *holding_registers;     /* 保持寄存器数组（映射内存） */
+    uint16_t *input_registers;       /* 输入寄存器数组（映射内存） */
+    RegisterSyncPolicy policy;       /* msync 策略 */
+    bool dirty;                      /* 上次 msync 之后是否有写入 */
+    uint64_t sync_count;             /* 已执行的 msync 次数 */
+} RegisterFile;
+
+/*
+ * 打开（必要时创建）寄存器持久化文件并映射到内存
+ *
+ * 参数：
+ *   file - 输出：文件状态
+ *   path - 文件路径
+ *   register_count - 每类寄存器数量，必须与已有文件一致
+ *   created - 输出：文件是否为新建（新建文件需要调用者写入初值后调用 register_file_mark_initialized）
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool register_file_open(RegisterFile *file, const char *path, uint32_t register_count, bool *created);
+
+/*
+ * 标记初值已写入完成（仅新建文件需要）
+ */
+void register_file_mark_initialized(RegisterFile *file);
+
+/*
+ * 设置 msync 策略
+ *
+ * 参数：
+ *   policy - 策略
+ *   period_ms - PERIODIC 策略的周期（毫秒）
+ *
+ * 返回：
+ *   成功返回 true；PERIODIC 策略创建定时器失败时返回 false
+ */
+bool register_file_set_policy(RegisterFile *file, RegisterSyncPolicy policy, uint32_t period_ms);
+
+/*
+ * 通知文件某段寄存器已被写入（EVERY_WRITE 策略下立即同步所在页）
+ *
+ * 参数：
+ *   registers - 被写入的第一个寄存器地址（位于映射内存中）
+ *   count - 寄存器数量
+ */
+void register_file_note_write(RegisterFile *file, const uint16_t *registers, size_t count);
+
+/*
+ * 处理周期定时器事件：有脏数据时执行 msync
+ */
+void register_file_handle_timer(RegisterFile *file);
+
+/*
+ * 同步全部映射并关闭文件
+ */
+void register_file_close(RegisterFile *file);
+
+#endif /* REGISTER_FILE_H */
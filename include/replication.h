@@ -0,0 +1,277 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+/*
+ * 主备复制
+ *
+ * 长时间的测试中单个模拟服务器进程是单点故障。主机（-P）在本地 TCP 端口上接受备机（-F）连接，
+ * 以日志传送的方式把寄存器写入推给备机：
+ * - 备机连上后发送握手，主机先回一份完整快照（与快照文件相同的文件头和寄存器数据，
+ *   文件头的 journal_sequence 字段填复制序列号），之后推送写入记录（与写入日志相同的 24 字节定长记录）；
+ * - 每轮事件循环产生的记录攒成一批，在循环末尾对每个备机一次写出（与日志组提交同一时机）；
+ * - 备机按序列号连续应用记录，每处理完一批回送已应用的序列号，主机据此显示每个备机落后的记录数，
+ *   备机按记录中的写入时刻显示复制延迟；
+ * - 备机复制期间只读：读请求照常应答，写请求回复异常 01；提升（replica promote）后断开原主机，
+ *   寄存器保持复制到的值（不会回到初值），开始接受写入，配置了 -P 时也开始接受备机；
+ * - 备机不在复制中（未连上、等待快照或断线）时，默认寄存器的读请求回复异常 06（忙），
+ *   不把初值或过时的值当作主机的数据返回；从未应用过快照的备机拒绝提升，除非强制（replica promote force）；
+ * - 断线后备机按退避间隔重连，重连时重新接收完整快照；发送积压超过上限的备机被断开，之后同样重新同步。
+ *
+ * 复制覆盖默认寄存器组的写入：保持寄存器的写入同写入日志，输入寄存器的写入（reg set input、
+ * 映射重新加载的初值）由记录的 bank 字段区分。按单元 ID 或端点挂接的设备和生成器在各进程中各自运行，
+ * 主机统计设备寄存器上未复制的写入，replica 命令据此显示与备机的分歧。
+ * 套接字和定时器描述符加入服务器的 epoll 集合，复制只在事件循环线程中使用。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include "journal.h"
+#include "register_bank.h"
+
+/* 握手魔数 "MBRP" 与协议版本 */
+#define REPLICATION_MAGIC 0x4D425250u
+#define REPLICATION_VERSION 2
+
+/* 最多同时连接的备机数 */
+#define REPLICATION_MAX_BACKUPS 8
+
+/* 一轮事件循环的记录批次缓冲区大小；写满时提前发出 */
+#define REPLICATION_BATCH_SIZE 65536
+
+/* 单个备机的发送积压上限（字节），超过后断开该备机 */
+#define REPLICATION_MAX_PENDING (4 * 1024 * 1024)
+
+/* 备机的握手（主机字节序，两端须在同一种机器上） */
+typedef struct {
+    uint32_t magic;              /* REPLICATION_MAGIC */
+    uint16_t version;            /* REPLICATION_VERSION */
+    uint16_t byte_order_mark;    /* JOURNAL_BYTE_ORDER_MARK */
+    uint32_t register_count;     /* 每类寄存器数量，须与主机一致 */
+    uint32_t reserved;           /* 保留，写 0 */
+} ReplicationHello;
+
+/*
+ * 快照应用函数：备机收到完整快照后调用，用快照替换默认寄存器组
+ *
+ * 参数：
+ *   holding - 保持寄存器
+ *   input - 输入寄存器
+ *   register_count - 每类寄存器数量
+ *   context - replication_start 传入的上下文
+ */
+typedef void (*ReplicationLoadFunc)(const uint16_t *holding, const uint16_t *input, uint32_t register_count,
+                                    void *context);
+
+/* 角色 */
+typedef enum {
+    REPLICATION_ROLE_NONE = 0,      /* 未启用复制 */
+    REPLICATION_ROLE_PRIMARY,       /* 主机：接受写入并推送给备机 */
+    REPLICATION_ROLE_BACKUP         /* 备机：只读，应用主机推送的写入 */
+} ReplicationRole;
+
+/* 备机到主机的连接状态 */
+typedef enum {
+    REPLICATION_LINK_DOWN = 0,      /* 未连接，等待重连 */
+    REPLICATION_LINK_CONNECTING,    /* 非阻塞连接进行中 */
+    REPLICATION_LINK_SYNCING,       /* 已握手，等待完整快照 */
+    REPLICATION_LINK_STREAMING      /* 快照已应用，按序应用写入记录 */
+} ReplicationLinkState;
+
+/* 主机上的一个备机连接 */
+typedef struct {
+    int fd;                         /* -1 表示空闲 */
+    char name[32];                  /* 备机的 "地址:端口" */
+    bool streaming;                 /* 已握手并排入快照，之后的批次都推给它 */
+    bool want_write;                /* 是否关注 EPOLLOUT */
+    uint8_t rx[64];                 /* 握手和确认 */
+    size_t rx_length;
+    uint8_t *tx;                    /* 未写出的快照和记录 */
+    size_t tx_length;
+    size_t tx_capacity;
+    uint64_t acked_sequence;        /* 备机确认已应用的序列号 */
+    uint64_t snapshot_sequence;     /* 发给它的快照所含的序列号 */
+    uint64_t connected_ns;
+    uint64_t sent_bytes;
+} ReplicationPeer;
+
+/* 复制状态 */
+typedef struct {
+    ReplicationRole role;
+    uint32_t register_count;
+    int epoll_fd;
+    RegisterBank *holding;          /* 默认寄存器组（主机从中生成快照） */
+    RegisterBank *input;
+    JournalApplyFunc apply;         /* 备机应用一条写入记录 */
+    ReplicationLoadFunc load;       /* 备机应用完整快照 */
+    void *context;
+
+    /* 主机（-P；备机上配置时提升后才接受连接） */
+    struct sockaddr_in listen_addr;
+    char listen_name[32];
+    int listen_fd;
+    ReplicationPeer peers[REPLICATION_MAX_BACKUPS];
+    uint64_t sequence;              /* 最后一条记录的序列号 */
+    uint8_t batch[REPLICATION_BATCH_SIZE];  /* 本轮事件循环的记录 */
+    size_t batched;
+    uint64_t records;               /* 追加的记录数 */
+    uint64_t batches;               /* 发出的批次数 */
+    uint64_t largest_batch;         /* 单批最大记录数 */
+    uint64_t snapshots_sent;
+    uint64_t dropped;               /* 因积压过多或出错断开的备机数 */
+    uint64_t unreplicated;          /* 设备寄存器上未复制的写入个数（与备机的分歧） */
+
+    /* 备机（-F） */
+    struct sockaddr_in primary_addr;
+    char primary_name[32];
+    int link_fd;
+    int timer_fd;                   /* 周期检查重连 */
+    ReplicationLinkState link_state;
+    uint64_t state_ns;              /* 进入当前状态的时刻 */
+    uint64_t retry_ns;              /* DOWN：下次重连的时刻 */
+    uint32_t retry_ms;              /* 当前退避间隔 */
+    uint8_t *rx;                    /* 收到的未处理数据（容量至少能放下一份快照） */
+    size_t rx_length;
+    size_t rx_capacity;
+    uint16_t *image;                /* 快照的寄存器数据（保持寄存器在前） */
+    uint64_t applied_sequence;      /* 已应用的最后一条记录的序列号 */
+    uint64_t acked_sequence;        /* 已回送给主机的序列号 */
+    uint64_t applied_records;
+    uint64_t snapshots_loaded;
+    uint64_t connects;
+    uint64_t failures;
+    uint64_t last_lag_ns;           /* 最近一条记录从主机写入到备机应用的延迟 */
+    uint64_t max_lag_ns;
+    uint64_t lag_total_ns;          /* 延迟累计（用于平均值） */
+    uint64_t last_receive_ns;       /* 最后一次收到数据的时刻 */
+    uint64_t promoted_ns;           /* 提升的时刻，0 表示未提升 */
+} Replication;
+
+/*
+ * 初始化（未配置时其余函数均为空操作）
+ */
+void replication_init(Replication *replication);
+
+/*
+ * 设置接受备机连接的地址（-P）
+ *
+ * 参数：
+ *   spec - 规格，格式为 [<地址>:]<端口>，省略地址时只监听 127.0.0.1
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true
+ */
+bool replication_listen_on(Replication *replication, const char *spec, char *error, size_t error_size);
+
+/*
+ * 设置为备机并指定主机地址（-F）
+ *
+ * 参数：
+ *   spec - 规格，格式为 <地址>:<端口>
+ *   error - 输出：失败原因
+ *   error_size - error 缓冲区大小
+ *
+ * 返回：
+ *   成功返回 true
+ */
+bool replication_follow(Replication *replication, const char *spec, char *error, size_t error_size);
+
+/*
+ * 打开监听套接字或发起到主机的连接，并加入 epoll 集合
+ *
+ * 参数：
+ *   epoll_fd - 服务器的 epoll 描述符
+ *   holding - 默认保持寄存器组
+ *   input - 默认输入寄存器组
+ *   apply - 备机应用写入记录的函数
+ *   load - 备机应用完整快照的函数
+ *   context - 传给 apply 和 load 的上下文
+ *
+ * 返回：
+ *   成功返回 true（主机暂时连不上不算失败，之后自动重连）
+ */
+bool replication_start(Replication *replication, int epoll_fd, RegisterBank *holding, RegisterBank *input,
+                       JournalApplyFunc apply, ReplicationLoadFunc load, void *context);
+
+/*
+ * 主机追加一条默认寄存器组的写入记录（仅写入本轮批次，批次写满时先发出）
+ *
+ * 参数：
+ *   bank - JOURNAL_BANK_HOLDING 或 JOURNAL_BANK_INPUT
+ *   unit_id - 请求中的单元标识符
+ *   address - 寄存器地址
+ *   value - 写入的值
+ */
+void replication_append(Replication *replication, uint8_t bank, uint8_t unit_id, uint16_t address,
+                        uint16_t value);
+
+/*
+ * 主机记录设备寄存器上不会复制的写入个数，用于显示与备机的分歧
+ */
+void replication_note_unreplicated(Replication *replication, uint32_t count);
+
+/*
+ * 本轮是否有待发出的记录
+ */
+bool replication_pending(const Replication *replication);
+
+/*
+ * 把本轮的记录批次推给全部已同步的备机（每个备机一次写出）
+ */
+void replication_flush(Replication *replication);
+
+/*
+ * 是否处于只读的备机状态（尚未提升）
+ */
+bool replication_read_only(const Replication *replication);
+
+/*
+ * 备机是否尚未与主机同步（连接不在复制中状态），此时默认寄存器的读请求应回复忙
+ */
+bool replication_syncing(const Replication *replication);
+
+/*
+ * 把备机提升为主机：断开原主机，之后接受写入；配置了 -P 时开始接受备机
+ *
+ * 参数：
+ *   force - 从未应用过主机快照（寄存器仍是初值）时也提升
+ *
+ * 返回：
+ *   成功返回 true；不是备机，或未应用过快照且未强制时返回 false
+ */
+bool replication_promote(Replication *replication, bool force);
+
+/*
+ * 描述符是否属于复制（监听套接字、备机连接、主机连接或定时器）
+ */
+bool replication_owns_fd(const Replication *replication, int fd);
+
+/*
+ * 处理复制描述符上的事件
+ */
+void replication_handle_event(Replication *replication, int fd, uint32_t events);
+
+/*
+ * 关闭全部连接和定时器并释放内存（主机先尽量写出剩余批次）
+ */
+void replication_close(Replication *replication);
+
+/*
+ * 当前连接的备机数
+ */
+size_t replication_backup_count(const Replication *replication);
+
+/*
+ * 角色名称
+ */
+const char *replication_role_name(ReplicationRole role);
+
+/*
+ * 连接状态名称
+ */
+const char *replication_link_state_name(ReplicationLinkState state);
+
+#endif /* REPLICATION_H */
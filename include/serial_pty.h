@@ -0,0 +1,87 @@
+#ifndef SERIAL_PTY_H
+#define SERIAL_PTY_H
+
+/*
+ * 伪终端（PTY）串口从站模块
+ *
+ * 每条模拟串口线路由一个 PTY 主端和一个 timerfd 组成：
+ * - 外部主站打开 PTY 从端（如 /dev/pts/5），按 RTU 格式收发；
+ * - 服务器从主端读字节，每收到一批字节就重新设置 timerfd 为 t3.5；
+ * - timerfd 到期即表示线路空闲达到 t3.5，当前累积的字节构成一帧。
+ * 两个描述符都注册在服务器的 epoll 集合中，一个进程可以模拟几十条线路。
+ */
+
+#include "modbus_rtu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 同时模拟的最大串口线路数 */
+#define MAX_SERIAL_LINES 64
+
+/* PTY 从端设备名的最大长度 */
+#define SERIAL_NAME_LENGTH 64
+
+/* 单条串口线路状态 */
+typedef struct {
+    int master_fd;                              /* PTY 主端（服务器读写） */
+    int slave_fd;                               /* 保持打开的从端，避免无人连接时主端持续 HUP */
+    int timer_fd;                               /* t3.5 帧间隔定时器 */
+    char slave_name[SERIAL_NAME_LENGTH];        /* 从端设备路径，供外部主站打开 */
+    uint32_t baud_rate;                         /* 模拟波特率（仅用于计算 t3.5） */
+    uint32_t t35_usec;                          /* t3.5 帧间隔（微秒） */
+    uint8_t frame[MODBUS_RTU_MAX_ADU_LENGTH];   /* 当前正在累积的帧 */
+    size_t frame_length;                        /* 已累积字节数 */
+    bool overflow;                              /* 当前帧是否超长（超长帧整体丢弃） */
+    uint64_t frames_received;                   /* 收到的完整帧数 */
+    uint64_t frames_dropped;                    /* 因超长或 CRC 错误丢弃的帧数 */
+    bool active;                                /* 线路是否已打开 */
+} SerialLine;
+
+/*
+ * 打开一条 PTY 串口线路（主端非阻塞、从端 raw 模式）
+ *
+ * 参数：
+ *   line - 线路状态（输出）
+ *   baud_rate - 模拟波特率
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+bool serial_pty_open(SerialLine *line, uint32_t baud_rate);
+
+/*
+ * 关闭线路并释放描述符
+ */
+void serial_pty_close(SerialLine *line);
+
+/*
+ * 处理主端可读事件：读取所有可用字节并重新设置 t3.5 定时器
+ *
+ * 返回：
+ *   正常返回 true；主端出错返回 false
+ */
+bool serial_pty_handle_input(SerialLine *line);
+
+/*
+ * 处理定时器到期事件：取出已完成的帧
+ *
+ * 参数：
+ *   line - 线路状态
+ *   frame - 输出：指向帧数据（在下次读取前有效）
+ *   length - 输出：帧长度
+ *
+ * 返回：
+ *   有可用的完整帧返回 true；空帧或超长帧返回 false
+ */
+bool serial_pty_take_frame(SerialLine *line, const uint8_t **frame, size_t *length);
+
+/*
+ * 向主端写入响应帧
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+bool serial_pty_write(SerialLine *line, const uint8_t *data, size_t length);
+
+#endif /* SERIAL_PTY_H */
@@ -0,0 +1,121 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+ * 寄存器快照模块
+ *
+ * 快照由 fork() 出的子进程在后台写出：子进程继承父进程内存的写时复制视图，
+ * 因此看到的是 fork 那一刻的寄存器，父进程的事件循环不需要暂停。
+ * 寄存器数据位于 MAP_SHARED 持久化映射时不享有写时复制，此时父进程先把寄存器
+ * 复制到私有缓冲区（每个寄存器 2 字节，微秒级）再 fork。
+ *
+ * 文件布局（主机字节序）：
+ * // 文件头(40字节) | 保持寄存器(N*2字节) | 输入寄存器(N*2字节)
+ *
+ * 子进程先写入临时文件并 fsync，再 rename 到目标路径，读者不会看到写了一半的快照。
+ * 子进程只调用 open/write/fsync/rename/_exit，不使用 stdio，失败原因由父进程回收时输出。
+ * 文件头记录快照时刻的日志序列号，启动时加载快照后只需重放此后的日志记录。
+ */
+
+#include "register_bank.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* 文件魔数 "MBSN" 与格式版本 */
+#define SNAPSHOT_MAGIC 0x4D42534Eu
+#define SNAPSHOT_VERSION 2
+
+/* 字节序标记（含义同寄存器持久化文件） */
+#define SNAPSHOT_BYTE_ORDER_MARK 0x0102u
+
+/* 快照路径的最大长度 */
+#define SNAPSHOT_PATH_LENGTH 256
+
+/* 快照文件头 */
+typedef struct {
+    uint32_t magic;              /* SNAPSHOT_MAGIC */
+    uint16_t version;            /* SNAPSHOT_VERSION */
+    uint16_t byte_order_mark;    /* SNAPSHOT_BYTE_ORDER_MARK */
+    uint32_t register_count;     /* 每类寄存器数量 */
+    uint32_t reserved;           /* 保留，写 0 */
+    uint64_t journal_sequence;   /* 快照已包含的最后一条日志记录的序列号（未启用日志时为 0） */
+    uint64_t timestamp_ns;       /* 快照时刻（CLOCK_REALTIME 纳秒） */
+    uint64_t checksum;           /* 寄存器数据的 FNV-1a 64 位校验和 */
+} SnapshotHeader;
+
+/* 后台快照状态（同一时刻最多一个快照在进行） */
+typedef struct {
+    pid_t child_pid;                     /* 正在写快照的子进程，无则为 0 */
+    char path[SNAPSHOT_PATH_LENGTH];     /* 正在写的快照路径 */
+    uint64_t started_ns;                 /* 开始时刻（CLOCK_MONOTONIC 纳秒） */
+    uint64_t fork_usec;                  /* 父进程在 fork（及必要的复制）上花费的时间 */
+    uint64_t completed;                  /* 成功完成的快照数 */
+    uint64_t failed;                     /* 失败的快照数 */
+    const char *failure;                 /* 最近一次失败的原因（子进程的退出状态），成功后为 NULL */
+} SnapshotState;
+
+/*
+ * 把寄存器写入快照文件（临时文件 + fsync + rename）
+ *
+ * 参数：
+ *   path - 目标路径
+ *   holding - 保持寄存器
+ *   input - 输入寄存器
+ *   register_count - 每类寄存器数量
+ *   journal_sequence - 快照已包含的最后一条日志记录的序列号
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+bool snapshot_write_file(const char *path, const uint16_t *holding, const uint16_t *input, uint32_t register_count,
+                         uint64_t journal_sequence);
+
+/*
+ * 计算寄存器数据的校验和（文件头的 checksum 字段，复制时备机同样据此校验收到的快照）
+ */
+uint64_t snapshot_checksum(const uint16_t *holding, const uint16_t *input, uint32_t register_count);
+
+/*
+ * 读取快照文件并校验文件头与校验和
+ *
+ * 参数：
+ *   path - 快照路径
+ *   holding - 输出：保持寄存器
+ *   input - 输出：输入寄存器
+ *   register_count - 每类寄存器数量，必须与快照一致
+ *   header - 输出：文件头
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool snapshot_read_file(const char *path, uint16_t *holding, uint16_t *input, uint32_t register_count,
+                        SnapshotHeader *header);
+
+/*
+ * 在后台开始一次快照
+ *
+ * 参数：
+ *   state - 快照状态
+ *   path - 目标路径
+ *   holding - 保持寄存器组
+ *   input - 输入寄存器组
+ *   shared_storage - 寄存器数据是否位于 MAP_SHARED 映射（为 true 时先复制再 fork）
+ *   journal_sequence - 此刻最后一条日志记录的序列号
+ *
+ * 返回：
+ *   子进程已启动返回 true；已有快照在进行或 fork 失败返回 false
+ */
+bool snapshot_begin(SnapshotState *state, const char *path, RegisterBank *holding, RegisterBank *input,
+                    bool shared_storage, uint64_t journal_sequence);
+
+/*
+ * 回收已结束的快照子进程（收到 SIGCHLD 后调用）
+ *
+ * 返回：
+ *   有快照结束返回 true，并通过 success 返回是否成功（失败原因见 state->failure）
+ */
+bool snapshot_reap(SnapshotState *state, bool *success);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,125 @@
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+/*
+ * 寄存器变化订阅模块
+ *
+ * 主站通过 FC41 订阅一段地址后，不再需要周期性 FC03 轮询：
+ * - 每个寄存器组维护一张脏位图，写入路径只置位，代价是几条位运算；
+ * - 每轮事件循环结束时扫描一次位图，把每个订阅者范围内被写过的寄存器
+ *   按连续地址合并成段，编码为 FC42 帧，同一订阅者的全部帧一次写出；
+ * - 推送完成后清空位图（只清被置过位的字范围）。
+ *
+ * 推送的是寄存器组中存储的值；挂接了生成器的寄存器在读取时才计算，不会触发推送。
+ */
+
+#include "register_bank.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 全部连接合计的最大订阅数 */
+#define SUBSCRIPTION_MAX 256
+
+/* 寄存器组编号 */
+typedef enum {
+    SUBSCRIPTION_BANK_HOLDING = 0,
+    SUBSCRIPTION_BANK_INPUT,
+    SUBSCRIPTION_BANK_COUNT
+} SubscriptionBank;
+
+/* 单个订阅：某个连接上的一段地址 */
+typedef struct {
+    int fd;                      /* 订阅者连接 */
+    uint8_t unit_id;             /* 订阅请求中的单元标识符，推送帧沿用 */
+    SubscriptionBank bank;       /* 寄存器组 */
+    uint32_t start;              /* 起始地址 */
+    uint32_t count;              /* 寄存器数量 */
+} Subscription;
+
+/* 单个寄存器组的脏位图 */
+typedef struct {
+    uint64_t *words;             /* 每个寄存器 1 位 */
+    uint32_t word_count;
+    uint32_t first_dirty_word;   /* 被置过位的字范围，没有脏位时 first > last */
+    uint32_t last_dirty_word;
+} DirtyBitmap;
+
+/* 订阅表 */
+typedef struct {
+    uint32_t register_count;
+    DirtyBitmap dirty[SUBSCRIPTION_BANK_COUNT];
+    Subscription items[SUBSCRIPTION_MAX];    /* 按 fd 分组存放，同一连接的订阅相邻 */
+    size_t count;
+    uint64_t notify_writes;                  /* 推送写出次数（每个订阅者每轮至多一次） */
+    uint64_t notify_frames;                  /* 推送的 FC42 帧数 */
+    uint64_t notify_registers;               /* 推送的寄存器值个数 */
+} SubscriptionTable;
+
+/* 推送回调：把一个订阅者的全部 FC42 帧（MBAP 格式，首尾相接）一次发出 */
+typedef void (*SubscriptionSendFunc)(int fd, const uint8_t *data, size_t length, void *context);
+
+/*
+ * 初始化订阅表
+ *
+ * 返回：
+ *   成功返回 true，内存不足返回 false
+ */
+bool subscription_table_init(SubscriptionTable *table, uint32_t register_count);
+
+/*
+ * 释放订阅表
+ */
+void subscription_table_destroy(SubscriptionTable *table);
+
+/*
+ * 登记订阅
+ *
+ * 参数：
+ *   fd - 订阅者连接
+ *   unit_id - 单元标识符
+ *   bank - 寄存器组
+ *   start - 起始地址
+ *   count - 数量（大于 0）
+ *
+ * 返回：
+ *   成功返回 true；地址越界、与该连接已有订阅重叠或订阅表已满时返回 false
+ */
+bool subscription_add(SubscriptionTable *table, int fd, uint8_t unit_id, SubscriptionBank bank,
+                      uint32_t start, uint32_t count);
+
+/*
+ * 取消连接在指定寄存器组上的全部订阅
+ *
+ * 返回：
+ *   取消的订阅数
+ */
+size_t subscription_remove(SubscriptionTable *table, int fd, SubscriptionBank bank);
+
+/*
+ * 取消连接的全部订阅（连接断开时调用）
+ */
+void subscription_remove_client(SubscriptionTable *table, int fd);
+
+/*
+ * 标记一段寄存器被写入（没有任何订阅时直接返回）
+ */
+void subscription_mark_dirty(SubscriptionTable *table, SubscriptionBank bank, uint32_t start, uint32_t count);
+
+/*
+ * 是否有待推送的变化
+ */
+bool subscription_has_changes(const SubscriptionTable *table);
+
+/*
+ * 向所有受影响的订阅者推送变化，然后清空脏位图
+ *
+ * 参数：
+ *   banks - 按 SubscriptionBank 编号排列的寄存器组，用于读取当前值
+ *   send - 推送回调
+ *   context - 回调参数
+ */
+void subscription_push_changes(SubscriptionTable *table, RegisterBank *banks[SUBSCRIPTION_BANK_COUNT],
+                               SubscriptionSendFunc send, void *context);
+
+#endif /* SUBSCRIPTION_H */
@@ -0,0 +1,116 @@
+#ifndef TLS_SERVER_H
+#define TLS_SERVER_H
+
+/*
+ * Modbus/TCP Security（TLS）服务端模块
+ *
+ * 基于 OpenSSL 实现：
+ * - 会话票据（session ticket）与服务端会话缓存，频繁重连的主站可跳过完整握手；
+ * - 握手完成后尝试启用内核 TLS（kTLS，TCP_ULP "tls"），记录加解密下沉到内核，
+ *   数据路径继续使用普通 read()/write()，无需经过 OpenSSL 的用户态缓冲；
+ * - 内核不支持 kTLS 时自动回退到 SSL_read()/SSL_write()。
+ *
+ * 编译选项 WITH_TLS=0 时模块编译为空实现，tls_server_init() 返回失败。
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* 如果未定义 WITH_TLS，默认为 1（启用 TLS） */
+#ifndef WITH_TLS
+#define WITH_TLS 1
+#endif
+
+/* Modbus/TCP Security 的标准端口 */
+#define MODBUS_TLS_DEFAULT_PORT 802
+
+/* 单个 TLS 连接（不透明类型） */
+typedef struct TlsSession TlsSession;
+
+/* 握手推进结果 */
+typedef enum {
+    TLS_HANDSHAKE_DONE = 0,       /* 握手完成 */
+    TLS_HANDSHAKE_WANT_READ,      /* 等待套接字可读 */
+    TLS_HANDSHAKE_WANT_WRITE,     /* 等待套接字可写 */
+    TLS_HANDSHAKE_FAILED          /* 握手失败，应断开连接 */
+} TlsHandshakeResult;
+
+/* TLS 统计信息 */
+typedef struct {
+    uint64_t handshakes_full;     /* 完整握手次数 */
+    uint64_t handshakes_resumed;  /* 会话复用握手次数 */
+    uint64_t handshakes_failed;   /* 握手失败次数 */
+    uint64_t ktls_send;           /* 启用 kTLS 发送的连接数 */
+    uint64_t ktls_recv;           /* 启用 kTLS 接收的连接数 */
+} TlsStats;
+
+/*
+ * 初始化全局 TLS 上下文
+ *
+ * 参数：
+ *   cert_file - PEM 格式证书链文件
+ *   key_file - PEM 格式私钥文件
+ *   ca_file - 用于校验客户端证书的 CA 文件，为 NULL 时不要求客户端证书
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool tls_server_init(const char *cert_file, const char *key_file, const char *ca_file);
+
+/*
+ * 释放全局 TLS 上下文
+ */
+void tls_server_cleanup(void);
+
+/*
+ * 为已接受的连接创建 TLS 会话（此时尚未握手）
+ *
+ * 返回：
+ *   成功返回会话指针，失败返回 NULL
+ */
+TlsSession* tls_session_new(int fd);
+
+/*
+ * 推进非阻塞握手
+ */
+TlsHandshakeResult tls_session_handshake(TlsSession *session);
+
+/*
+ * 读取应用数据（kTLS 接收启用时直接 read()）
+ *
+ * 返回：
+ *   与 read() 相同：>0 字节数，0 对端关闭，<0 出错（errno 为 EAGAIN 表示暂无数据）
+ */
+ssize_t tls_session_read(TlsSession *session, void *buffer, size_t length);
+
+/*
+ * 写入应用数据（kTLS 发送启用时直接 write()）
+ *
+ * 返回：
+ *   与 write() 相同
+ */
+ssize_t tls_session_write(TlsSession *session, const void *buffer, size_t length);
+
+/*
+ * OpenSSL 内部是否还缓存有已解密但未读取的数据
+ */
+bool tls_session_pending(TlsSession *session);
+
+/*
+ * 描述会话状态（协议版本、密码套件、是否复用、kTLS 状态），用于日志
+ */
+void tls_session_describe(TlsSession *session, char *buffer, size_t size);
+
+/*
+ * 发送 close_notify 并释放会话（不关闭 fd）
+ */
+void tls_session_free(TlsSession *session);
+
+/*
+ * 获取 TLS 统计信息
+ */
+void tls_server_get_stats(TlsStats *stats);
+
+#endif /* TLS_SERVER_H */
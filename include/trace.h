@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * 静态跟踪点（USDT）
+ *
+ * 在请求处理的各阶段埋下 provider 为 modbus 的静态探针，供 bpftrace、perf 或 SystemTap
+ * 在生产环境中挂接，无需重新编译或打开调试输出：
+ * - request_receive(fd, bytes)                 从套接字读到数据 / 串口线路取出一帧
+ * - frame_complete(fd, length)                 切分出一条完整请求帧
+ * - dispatch(fd, function_code, transaction_id) 请求解析完成，即将按功能码处理
+ * - response_built(fd, function_code, length)  响应帧已编码（功能码含异常位）
+ * - response_flush(fd, length)                 响应已写出
+ * - decode(transaction_id, function_code, length) / decode_error(length)  MBAP 请求解码
+ * - encode(transaction_id, length)             编码 MBAP 帧头（每个响应/请求构建函数都会经过）
+ *
+ * 探针由 <sys/sdt.h> 展开为一条 nop 指令并在 ELF 的 .note.stapsdt 段记录参数位置，
+ * 未挂接时没有任何分支或函数调用。系统没有 <sys/sdt.h>（未安装 systemtap-sdt-dev）
+ * 或以 WITH_USDT=0 编译时，探针展开为空语句。
+ *
+ * 配套脚本 tools/modbus_stages.bt 按阶段输出延迟分布。
+ */
+
+#ifndef WITH_USDT
+#define WITH_USDT 1
+#endif
+
+#if WITH_USDT && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_USDT_AVAILABLE 1
+#endif
+#endif
+
+#ifdef TRACE_USDT_AVAILABLE
+#define TRACE_PROBE1(name, a1)             DTRACE_PROBE1(modbus, name, a1)
+#define TRACE_PROBE2(name, a1, a2)         DTRACE_PROBE2(modbus, name, a1, a2)
+#define TRACE_PROBE3(name, a1, a2, a3)     DTRACE_PROBE3(modbus, name, a1, a2, a3)
+#else
+/* 参数只做 void 转换，避免仅在探针中使用的变量产生未使用警告 */
+#define TRACE_PROBE1(name, a1)             do { (void)(a1); } while (0)
+#define TRACE_PROBE2(name, a1, a2)         do { (void)(a1); (void)(a2); } while (0)
+#define TRACE_PROBE3(name, a1, a2, a3)     do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#endif
+
+#endif /* TRACE_H */
@@ -0,0 +1,106 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+/*
+ * 事件循环卡顿看门狗
+ *
+ * 服务器的所有处理（包括控制台命令和向终端的 printf）都在同一个事件循环中执行，
+ * 任何一步阻塞都会让全部客户端停顿。看门狗是一个独立线程：
+ * - 事件循环每轮从 epoll_wait 返回时记下开始时刻，每调用一个处理函数前记下
+ *   当前处理函数编号和事件描述符（几次原子存储，不加锁）；
+ * - 看门狗线程每隔阈值的四分之一检查一次，发现本轮已运行超过阈值时，
+ *   打印当时正在运行的处理函数和描述符，并向事件循环线程发送信号，
+ *   由信号处理函数把该线程当时的调用栈写到标准错误（每轮卡顿只报告一次）；
+ * - 一轮结束时由事件循环自己统计卡顿次数和最长耗时。
+ *
+ * 看门狗线程只用 write() 输出，不经过 stdio 锁，事件循环卡在 printf 上时也能报告。
+ * 调用栈为 "程序(+偏移)[地址]" 形式，可用 addr2line -f -e build/server <偏移> 解析。
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* 事件循环中的处理函数编号（用于定位卡顿的处理函数） */
+typedef enum {
+    WATCHDOG_HANDLER_NONE = 0,          /* 本轮尚未进入处理函数（epoll_wait 刚返回） */
+    WATCHDOG_HANDLER_STDIN,             /* handle_stdin_input */
+    WATCHDOG_HANDLER_ACCEPT,            /* accept_clients */
+    WATCHDOG_HANDLER_METRICS,           /* 指标抓取连接 */
+    WATCHDOG_HANDLER_REGISTER_TIMER,    /* register_file_handle_timer */
+    WATCHDOG_HANDLER_SIGNAL,            /* handle_signal_event */
+    WATCHDOG_HANDLER_SERIAL,            /* handle_serial_event */
+    WATCHDOG_HANDLER_CLIENT,            /* handle_client_event */
+    WATCHDOG_HANDLER_JOURNAL_COMMIT,    /* journal_commit */
+    WATCHDOG_HANDLER_SUBSCRIPTION_PUSH, /* subscription_push_changes */
+    WATCHDOG_HANDLER_TOP,               /* handle_top_timer */
+    WATCHDOG_HANDLER_ADMIN,             /* admin_server_drain */
+    WATCHDOG_HANDLER_OUTBOUND_FLUSH,    /* flush_pending_clients */
+    WATCHDOG_HANDLER_REGISTER_MAP,      /* finish_register_map_reload */
+    WATCHDOG_HANDLER_GATEWAY,           /* gateway_handle_event */
+    WATCHDOG_HANDLER_REPLICATION,       /* replication_handle_event */
+    WATCHDOG_HANDLER_REPLICATION_SHIP,  /* replication_flush */
+    WATCHDOG_HANDLER_SERIAL_TIMER,      /* handle_serial_event（t3.5 定时器到期） */
+    WATCHDOG_HANDLER_COUNT
+} WatchdogHandler;
+
+/* 看门狗状态 */
+typedef struct {
+    /* 事件循环写、看门狗线程读（原子访问） */
+    uint64_t busy_since_ns;     /* 本轮开始时刻（CLOCK_MONOTONIC 纳秒），空闲等待时为 0 */
+    uint64_t iteration;         /* 轮次编号 */
+    uint32_t handler;           /* 当前处理函数（WatchdogHandler） */
+    int fd;                     /* 当前处理的事件描述符，-1 表示无 */
+
+    /* 只由事件循环访问 */
+    uint64_t stalls;            /* 超过阈值的轮次数 */
+    uint64_t longest_stall_ns;  /* 最长一轮的耗时 */
+    WatchdogHandler longest_handler;  /* 最长一轮结束时的处理函数 */
+
+    /* 只由看门狗线程访问 */
+    uint64_t reported_iteration;  /* 已报告过的轮次（每轮只报告一次） */
+    uint64_t reports;             /* 已报告次数 */
+
+    uint64_t threshold_ns;      /* 卡顿阈值 */
+    bool running;
+    pthread_t loop_thread;      /* 事件循环线程 */
+    pthread_t thread;           /* 看门狗线程 */
+} LoopWatchdog;
+
+/*
+ * 启动看门狗线程（必须在事件循环线程中调用）
+ *
+ * 参数：
+ *   threshold_ms - 一轮事件循环超过该时长即视为卡顿
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false（错误已打印）
+ */
+bool watchdog_start(LoopWatchdog *watchdog, uint32_t threshold_ms);
+
+/*
+ * 停止看门狗线程
+ */
+void watchdog_stop(LoopWatchdog *watchdog);
+
+/*
+ * 事件循环：epoll_wait 返回，开始新的一轮
+ */
+void watchdog_begin_iteration(LoopWatchdog *watchdog);
+
+/*
+ * 事件循环：即将调用处理函数
+ */
+void watchdog_enter(LoopWatchdog *watchdog, WatchdogHandler handler, int fd);
+
+/*
+ * 事件循环：本轮结束，即将进入 epoll_wait（统计本轮耗时）
+ */
+void watchdog_end_iteration(LoopWatchdog *watchdog);
+
+/*
+ * 处理函数编号对应的名称
+ */
+const char *watchdog_handler_name(WatchdogHandler handler);
+
+#endif /* WATCHDOG_H */
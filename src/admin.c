@@ -0,0 +1,431 @@
+/*
+ * 管理控制面实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "admin.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/eventfd.h>
+
+/* 等待事件循环执行命令时，每隔该时长检查一次服务器是否正在关闭 */
+#define ADMIN_WAIT_SLICE_MS 200
+
+/* 不带换行符的尾部在该时长内没有后续数据时，作为最后一行执行 */
+#define ADMIN_TAIL_IDLE_MS 100
+
+/* 控制线程上的一个管理连接 */
+typedef struct {
+    int fd;
+    char line[ADMIN_COMMAND_LENGTH];    /* 尚未遇到换行符的半行（跨越多次读取） */
+    size_t length;
+    uint64_t tail_ns;                   /* 半行最后一次收到数据的时刻 */
+    bool overflow;                      /* 当前行超长，丢弃到下一个换行符 */
+} AdminConnection;
+
+/*
+ * 读取单调时钟（毫秒）
+ */
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/*
+ * 阻塞写出全部数据（管理连接带发送超时）
+ */
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+/*
+ * 控制线程：把一条命令交给事件循环并等待执行完成，再把输出写回管理连接
+ *
+ * 返回：
+ *   输出已写回返回 true；写入失败或服务器正在关闭返回 false，调用者应关闭连接
+ */
+static bool submit_command(AdminServer *admin, int fd, const char *text) {
+    AdminCommand *command = calloc(1, sizeof(*command));
+    if (!command) {
+        return false;
+    }
+    snprintf(command->text, sizeof(command->text), "%s", text);
+    sem_init(&command->done, 0, 0);
+
+    mpsc_queue_push(&admin->queue, &command->node);
+    uint64_t one = 1;
+    if (write(admin->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("write");
+    }
+
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += ADMIN_WAIT_SLICE_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&command->done, &deadline) == 0) {
+            break;
+        }
+        /* 服务器关闭时事件循环可能不再取出这条命令：放弃等待，命令随进程退出释放 */
+        if (errno != EINTR && !__atomic_load_n(&admin->running, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+    }
+
+    bool ok = command->output == NULL || write_all(fd, command->output, command->output_length);
+    free(command->output);
+    sem_destroy(&command->done);
+    free(command);
+    return ok;
+}
+
+/*
+ * 控制线程：执行一行命令
+ *
+ * 返回：
+ *   连接仍然有效返回 true，输入 quit 或写入失败返回 false
+ */
+static bool run_line(AdminServer *admin, AdminConnection *connection, const char *line) {
+    if (line[0] == '\0') {
+        return true;
+    }
+    if (strcmp(line, "quit") == 0) {
+        return false;
+    }
+    return submit_command(admin, connection->fd, line);
+}
+
+/*
+ * 控制线程：把不带换行符的尾部作为最后一行执行（尾部空闲超时或对端关闭时调用）
+ */
+static bool flush_tail(AdminServer *admin, AdminConnection *connection) {
+    bool overflow = connection->overflow;
+    size_t length = connection->length;
+    connection->length = 0;
+    connection->overflow = false;
+    if (overflow || length == 0) {
+        return true;
+    }
+    connection->line[length] = '\0';
+    return run_line(admin, connection, connection->line);
+}
+
+/*
+ * 控制线程：读取管理连接上到达的数据并执行其中的完整命令行
+ *
+ * 命令按换行符切分，切分不依赖每次 read() 的边界：没有换行符的尾部留在连接的行缓冲区中，
+ * 与下次读到的数据拼接。客户端程序发送的每条命令都以换行结尾；其他工具发出的不带换行符的尾部
+ * 在 ADMIN_TAIL_IDLE_MS 内没有后续数据（或对端关闭）时作为最后一行执行。
+ *
+ * 返回：
+ *   连接仍然有效返回 true，对端关闭、输入 quit 或写入失败返回 false
+ */
+static bool handle_connection_input(AdminServer *admin, AdminConnection *connection) {
+    char buffer[ADMIN_COMMAND_LENGTH];
+    ssize_t n_read = read(connection->fd, buffer, sizeof(buffer));
+    if (n_read < 0) {
+        return errno == EINTR;
+    }
+    if (n_read == 0) {
+        flush_tail(admin, connection);
+        return false;
+    }
+
+    for (ssize_t i = 0; i < n_read; i++) {
+        char c = buffer[i];
+        if (c == '\r' || c == '\n') {
+            if (connection->overflow) {
+                connection->overflow = false;
+                connection->length = 0;
+                continue;
+            }
+            connection->line[connection->length] = '\0';
+            connection->length = 0;
+            if (!run_line(admin, connection, connection->line)) {
+                return false;
+            }
+        } else if (connection->overflow) {
+            continue;
+        } else if (connection->length < sizeof(connection->line) - 1) {
+            connection->line[connection->length++] = c;
+        } else {
+            char message[96];
+            int length = snprintf(message, sizeof(message), "[管理] 错误：命令过长（最多 %zu 字节），已丢弃\n",
+                                  sizeof(connection->line) - 1);
+            if (!write_all(connection->fd, message, (size_t)length)) {
+                return false;
+            }
+            connection->overflow = true;
+        }
+    }
+    connection->tail_ns = monotonic_ms();
+    return true;
+}
+
+/*
+ * 控制线程：接受新的管理连接
+ */
+static void accept_connection(AdminServer *admin, AdminConnection *connections, int *count) {
+    int fd = accept(admin->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    if (*count >= ADMIN_MAX_CONNECTIONS) {
+        static const char FULL[] = "[管理] 错误：管理连接数已满\n";
+        if (write(fd, FULL, sizeof(FULL) - 1) < 0) {
+            /* 对端已断开，直接关闭 */
+        }
+        close(fd);
+        return;
+    }
+    /* 读取由 poll 驱动；写回输出时阻塞，但不超过 1 秒，避免不读输出的客户端卡住控制线程 */
+    struct timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    AdminConnection *connection = &connections[(*count)++];
+    connection->fd = fd;
+    connection->length = 0;
+    connection->overflow = false;
+    printf("[管理] 管理连接已建立（fd:%d）\n", fd);
+}
+
+/*
+ * 控制线程：距最早一个待执行尾部超时的毫秒数，没有尾部时返回 -1（poll 无限等待）
+ */
+static int tail_timeout_ms(const AdminConnection *connections, int count) {
+    int timeout = -1;
+    uint64_t now = monotonic_ms();
+    for (int i = 0; i < count; i++) {
+        if (connections[i].length == 0 || connections[i].overflow) {
+            continue;
+        }
+        uint64_t elapsed = now - connections[i].tail_ns;
+        int remaining = elapsed >= ADMIN_TAIL_IDLE_MS ? 0 : (int)(ADMIN_TAIL_IDLE_MS - elapsed);
+        if (timeout < 0 || remaining < timeout) {
+            timeout = remaining;
+        }
+    }
+    return timeout;
+}
+
+/*
+ * 控制线程主循环
+ */
+static void *admin_thread(void *arg) {
+    AdminServer *admin = arg;
+    AdminConnection connections[ADMIN_MAX_CONNECTIONS];
+    int count = 0;
+
+    while (__atomic_load_n(&admin->running, __ATOMIC_ACQUIRE)) {
+        struct pollfd fds[ADMIN_MAX_CONNECTIONS + 2];
+        fds[0].fd = admin->stop_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = admin->listen_fd;
+        fds[1].events = POLLIN;
+        for (int i = 0; i < count; i++) {
+            fds[i + 2].fd = connections[i].fd;
+            fds[i + 2].events = POLLIN;
+        }
+        if (poll(fds, (nfds_t)count + 2, tail_timeout_ms(connections, count)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+
+        /* 从后往前处理，关闭连接时用最后一个填补空位不影响尚未处理的项 */
+        uint64_t now = monotonic_ms();
+        for (int i = count - 1; i >= 0; i--) {
+            AdminConnection *connection = &connections[i];
+            bool ok;
+            if (fds[i + 2].revents) {
+                ok = handle_connection_input(admin, connection);
+            } else if (connection->length > 0 && now - connection->tail_ns >= ADMIN_TAIL_IDLE_MS) {
+                ok = flush_tail(admin, connection);
+            } else {
+                ok = true;
+            }
+            if (!ok) {
+                printf("[管理] 管理连接已断开（fd:%d）\n", connection->fd);
+                close(connection->fd);
+                *connection = connections[--count];
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_connection(admin, connections, &count);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        close(connections[i].fd);
+    }
+    return NULL;
+}
+
+/*
+ * 创建管理套接字：残留的旧套接字文件先删除，权限限制为所属用户
+ */
+static int create_admin_listener(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "错误: 管理套接字路径过长（最多 %zu 字节）。\n", sizeof(addr.sun_path) - 1);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "错误: %s 已存在且不是套接字文件。\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (chmod(path, S_IRUSR | S_IWUSR) < 0 || listen(fd, ADMIN_MAX_CONNECTIONS) < 0) {
+        perror("listen");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+/*
+ * 创建管理套接字和 eventfd，并启动屏蔽全部信号的控制线程
+ */
+bool admin_server_start(AdminServer *admin, const char *path) {
+    memset(admin, 0, sizeof(*admin));
+    admin->wake_fd = -1;
+    admin->stop_fd = -1;
+    mpsc_queue_init(&admin->queue);
+    snprintf(admin->path, sizeof(admin->path), "%s", path);
+
+    admin->listen_fd = create_admin_listener(path);
+    if (admin->listen_fd < 0) {
+        return false;
+    }
+    admin->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    admin->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (admin->wake_fd < 0 || admin->stop_fd < 0) {
+        perror("eventfd");
+        admin->running = true;
+        admin_server_stop(admin);
+        return false;
+    }
+
+    /* 控制线程屏蔽全部信号，SIGINT 等进程信号只由事件循环线程处理 */
+    sigset_t all_signals, previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+    admin->running = true;
+    int error = pthread_create(&admin->thread, NULL, admin_thread, admin);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0) {
+        fprintf(stderr, "[管理] 错误：无法创建控制线程（%s）\n", strerror(error));
+        admin_server_stop(admin);
+        return false;
+    }
+    admin->thread_started = true;
+    return true;
+}
+
+/*
+ * 清空 wake_fd 计数，逐条执行排队命令并唤醒对应的控制线程等待者
+ */
+void admin_server_drain(AdminServer *admin, AdminExecuteFunc execute, void *context) {
+    uint64_t wakeups;
+    if (read(admin->wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+        perror("read");
+    }
+
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&admin->queue)) != NULL) {
+        AdminCommand *command = (AdminCommand *)node;
+        FILE *stream = open_memstream(&command->output, &command->output_length);
+        if (stream) {
+            execute(command->text, stream, context);
+            fclose(stream);
+        }
+        admin->commands++;
+        sem_post(&command->done);
+    }
+}
+
+/*
+ * 唤醒未执行命令的等待者，停止控制线程并释放套接字与 eventfd
+ */
+void admin_server_stop(AdminServer *admin) {
+    if (!admin->running) {
+        return;
+    }
+    __atomic_store_n(&admin->running, false, __ATOMIC_RELEASE);
+
+    /* 已排队但不会再执行的命令：直接唤醒等待者（无输出） */
+    MpscNode *node;
+    while ((node = mpsc_queue_pop(&admin->queue)) != NULL) {
+        sem_post(&((AdminCommand *)node)->done);
+    }
+
+    if (admin->thread_started) {
+        uint64_t one = 1;
+        if (write(admin->stop_fd, &one, sizeof(one)) < 0) {
+            perror("write");
+        }
+        pthread_join(admin->thread, NULL);
+        admin->thread_started = false;
+    }
+    if (admin->wake_fd >= 0) {
+        close(admin->wake_fd);
+    }
+    if (admin->stop_fd >= 0) {
+        close(admin->stop_fd);
+    }
+    close(admin->listen_fd);
+    unlink(admin->path);
+    admin->listen_fd = -1;
+    admin->wake_fd = -1;
+    admin->stop_fd = -1;
+}
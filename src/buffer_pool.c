@@ -0,0 +1,145 @@
+/*
+ * 连接缓冲池实现
+ */
+
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * 块头：记录所属档位，归还时不需要调用者提供大小。
+ * 借出时 next 不使用；16 字节保证其后的数据按 16 字节对齐。
+ */
+typedef struct PoolBlock {
+    struct PoolBlock *next;     /* 空闲链表中的下一块 */
+    uint32_t class_index;       /* 所属档位，BUFFER_POOL_CLASSES 表示超大分配 */
+    uint32_t size;              /* 超大分配的数据容量 */
+} PoolBlock;
+
+/*
+ * 请求大小对应的档位，超过最大档位返回 BUFFER_POOL_CLASSES
+ */
+static uint32_t class_for_size(const BufferPool *pool, size_t size) {
+    for (uint32_t i = 0; i < BUFFER_POOL_CLASSES; i++) {
+        if (size <= pool->classes[i].size) {
+            return i;
+        }
+    }
+    return BUFFER_POOL_CLASSES;
+}
+
+/*
+ * 释放空闲缓存，直到腾出 needed 字节或缓存释放完（从大档位开始）
+ */
+static void release_cached(BufferPool *pool, size_t needed) {
+    size_t released = 0;
+    for (int i = BUFFER_POOL_CLASSES - 1; i >= 0 && released < needed; i--) {
+        BufferPoolClass *cls = &pool->classes[i];
+        while (cls->free_list && released < needed) {
+            PoolBlock *block = cls->free_list;
+            cls->free_list = block->next;
+            cls->cached--;
+            pool->bytes_cached -= cls->size;
+            released += cls->size;
+            free(block);
+        }
+    }
+}
+
+/*
+ * 初始化缓冲池，设置内存上限和各档位大小
+ */
+void buffer_pool_init(BufferPool *pool, size_t limit) {
+    memset(pool, 0, sizeof(*pool));
+    pool->limit = limit ? limit : BUFFER_POOL_DEFAULT_LIMIT;
+    for (uint32_t i = 0; i < BUFFER_POOL_CLASSES; i++) {
+        pool->classes[i].size = (size_t)1 << (BUFFER_POOL_MIN_SHIFT + 2 * i);
+    }
+}
+
+/*
+ * 按档位分配缓冲区：优先复用空闲链表，需要新内存时受上限约束
+ */
+void *buffer_pool_alloc(BufferPool *pool, size_t size) {
+    uint32_t index = class_for_size(pool, size);
+    BufferPoolClass *cls = index < BUFFER_POOL_CLASSES ? &pool->classes[index] : NULL;
+
+    if (cls && cls->free_list) {
+        PoolBlock *block = cls->free_list;
+        cls->free_list = block->next;
+        cls->cached--;
+        cls->in_use++;
+        cls->allocations++;
+        cls->reuses++;
+        pool->bytes_cached -= cls->size;
+        pool->bytes_in_use += cls->size;
+        return block + 1;
+    }
+
+    /* 需要新内存：超出上限时先释放其他档位的空闲缓存 */
+    size_t capacity = cls ? cls->size : size;
+    size_t total = pool->bytes_in_use + pool->bytes_cached;
+    if (capacity > pool->limit || pool->bytes_in_use + capacity > pool->limit) {
+        pool->failures++;
+        return NULL;
+    }
+    if (total + capacity > pool->limit) {
+        release_cached(pool, total + capacity - pool->limit);
+    }
+
+    PoolBlock *block = malloc(sizeof(PoolBlock) + capacity);
+    if (!block) {
+        pool->failures++;
+        return NULL;
+    }
+    block->next = NULL;
+    block->class_index = index;
+    block->size = (uint32_t)capacity;
+    if (cls) {
+        cls->in_use++;
+        cls->allocations++;
+    } else {
+        pool->oversize_in_use++;
+        pool->oversize++;
+    }
+    pool->bytes_in_use += capacity;
+    if (pool->bytes_in_use + pool->bytes_cached > pool->peak_bytes) {
+        pool->peak_bytes = pool->bytes_in_use + pool->bytes_cached;
+    }
+    return block + 1;
+}
+
+/*
+ * 归还缓冲区：档位内空闲数未满时缓存，否则释放
+ */
+void buffer_pool_free(BufferPool *pool, void *buffer) {
+    if (!buffer) {
+        return;
+    }
+    PoolBlock *block = (PoolBlock *)buffer - 1;
+    if (block->class_index >= BUFFER_POOL_CLASSES) {
+        pool->bytes_in_use -= block->size;
+        pool->oversize_in_use--;
+        free(block);
+        return;
+    }
+
+    BufferPoolClass *cls = &pool->classes[block->class_index];
+    cls->in_use--;
+    pool->bytes_in_use -= cls->size;
+    if (cls->cached >= BUFFER_POOL_CACHE_PER_CLASS) {
+        free(block);
+        return;
+    }
+    block->next = cls->free_list;
+    cls->free_list = block;
+    cls->cached++;
+    pool->bytes_cached += cls->size;
+}
+
+/*
+ * 释放全部空闲缓存
+ */
+void buffer_pool_trim(BufferPool *pool) {
+    release_cached(pool, pool->bytes_cached);
+}
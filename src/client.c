@@ -2,10 +2,12 @@
  * TCP 客户端实现
  *
  * 功能描述：
- * - 连接指定的服务器地址和端口
+ * - 连接指定的服务器地址和端口，或通过 -u 连接同机的 Unix 域套接字
  * - 从命令行读取用户输入并发送给服务器
  * - 实时接收并显示服务器发送的消息（包括回显和服务器主动发送的消息）
  * - 支持 Modbus TCP 协议，可以发送 FC03 读寄存器和 FC06 写寄存器请求
+ * - 可以通过厂商扩展 FC41 订阅保持寄存器变化，并显示服务器推送的 FC42 变化帧
+ * - 支持厂商扩展 FC43 分散读和 FC44 原子多点写（modbus readv / modbus writev）
  * - 使用select()同时监听标准输入和套接字
  * - 支持 "quit" 命令和信号中断时的优雅退出
  * 
@@ -19,6 +21,7 @@
 #include "modbus.h"
 #include <signal.h>
 #include <sys/select.h>
+#include <sys/un.h>
 #include <stdbool.h>
 
 /* 如果未定义 DEBUG_MODE，默认为 1（调试模式） */
@@ -107,6 +110,62 @@ static void handle_modbus_response(const uint8_t *buffer, size_t length) {
             break;
         }
         
+        case MODBUS_FC_SUBSCRIBE: {
+            if (response.pdu.data_length >= 5) {
+                uint16_t address = (uint16_t)(response.pdu.data[1] << 8) | response.pdu.data[2];
+                uint16_t quantity = (uint16_t)(response.pdu.data[3] << 8) | response.pdu.data[4];
+                if (quantity == 0) {
+                    printf("[客户端] FC41 已取消订阅\n");
+                } else {
+                    printf("[客户端] FC41 订阅成功：寄存器[%u..%u]\n", address, address + quantity - 1);
+                }
+            } else {
+                printf("[客户端] FC41 响应格式不正确\n");
+            }
+            break;
+        }
+
+        case MODBUS_FC_CHANGE_NOTIFY: {
+            /* 读功能码(1字节) | 段数(1字节) | {起始地址(2字节) 数量(1字节) 值(数量*2字节)}... */
+            size_t offset = 2;
+            uint8_t runs = response.pdu.data_length >= 2 ? response.pdu.data[1] : 0;
+            for (uint8_t r = 0; r < runs && offset + 3 <= response.pdu.data_length; r++) {
+                uint16_t address = (uint16_t)(response.pdu.data[offset] << 8) | response.pdu.data[offset + 1];
+                uint8_t quantity = response.pdu.data[offset + 2];
+                offset += 3;
+                for (uint8_t i = 0; i < quantity && offset + 2 <= response.pdu.data_length; i++) {
+                    uint16_t value = (uint16_t)(response.pdu.data[offset] << 8) | response.pdu.data[offset + 1];
+                    printf("[客户端] FC42 变化推送：寄存器[%u] = %u (0x%04X)\n", address + i, value, value);
+                    offset += 2;
+                }
+            }
+            break;
+        }
+
+        case MODBUS_FC_READ_VECTOR: {
+            /* 读功能码(1字节) | 字节计数(1字节) | 寄存器值... */
+            uint8_t byte_count = response.pdu.data_length >= 2 ? response.pdu.data[1] : 0;
+            if (byte_count % 2 != 0 || response.pdu.data_length < (size_t)(2 + byte_count)) {
+                printf("[客户端] FC43 响应格式不正确\n");
+                break;
+            }
+            printf("[客户端] FC43 分散读成功，共 %u 个寄存器（按请求中段的顺序）：\n", byte_count / 2);
+            for (uint8_t i = 0; i < byte_count / 2; i++) {
+                uint16_t value = (uint16_t)(response.pdu.data[2 + i * 2] << 8) | response.pdu.data[3 + i * 2];
+                printf("  值[%u] = %u (0x%04X)\n", i, value, value);
+            }
+            break;
+        }
+
+        case MODBUS_FC_WRITE_VECTOR: {
+            if (response.pdu.data_length >= 1) {
+                printf("[客户端] FC44 原子多点写成功：%u 个寄存器\n", response.pdu.data[0]);
+            } else {
+                printf("[客户端] FC44 响应格式不正确\n");
+            }
+            break;
+        }
+
         default:
             printf("[客户端] 未知的功能码响应：0x%02X\n", response.pdu.function_code);
             break;
@@ -193,6 +252,102 @@ static bool send_modbus_write_request(uint16_t register_address, uint16_t regist
     return true;
 }
 
+/*
+ * 发送 FC41 订阅保持寄存器变化请求
+ *
+ * 参数：
+ *   start_address - 起始地址
+ *   quantity - 寄存器数量，0 表示取消订阅
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+static bool send_modbus_subscribe_request(uint16_t start_address, uint16_t quantity) {
+    uint8_t request_buffer[MODBUS_MAX_MESSAGE_LENGTH];
+
+    size_t request_length = modbus_build_subscribe_request(
+        transaction_id++,
+        0x01,  /* 单元ID */
+        MODBUS_FC_READ_HOLDING_REGISTERS,
+        start_address,
+        quantity,
+        request_buffer,
+        sizeof(request_buffer)
+    );
+
+    if (request_length == 0) {
+        printf("[客户端] 构建 Modbus 订阅请求失败\n");
+        return false;
+    }
+
+    ssize_t n_write = write(socket_fd, request_buffer, request_length);
+    if (n_write < 0) {
+        perror("write");
+        return false;
+    }
+
+    printf("[客户端] 已发送 FC41 订阅请求：起始地址=%u, 数量=%u (%zu 字节)\n",
+           start_address, quantity, request_length);
+    return true;
+}
+
+/*
+ * 发送 FC43 分散读或 FC44 原子多点写请求
+ *
+ * 参数：
+ *   is_write - true 为 FC44（参数形如 <地址>=<值>），false 为 FC43（参数形如 <起始地址>:<数量>）
+ *   args - 命令中 readv/writev 之后的部分，以空格分隔
+ *
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+static bool send_modbus_vector_request(bool is_write, const char *args) {
+    uint16_t first[MODBUS_MAX_VECTOR_RANGES];
+    uint16_t second[MODBUS_MAX_VECTOR_RANGES];
+    size_t count = 0;
+    char separator = is_write ? '=' : ':';
+
+    char copy[MAX_COMMAND_LENGTH];
+    strncpy(copy, args, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    for (char *item = strtok(copy, " \n"); item; item = strtok(NULL, " \n")) {
+        char *mark = strchr(item, separator);
+        if (!mark || count >= MODBUS_MAX_VECTOR_RANGES) {
+            printf("[客户端] 错误：参数 %s 格式不正确或数量超过 %d 个\n", item, MODBUS_MAX_VECTOR_RANGES);
+            return false;
+        }
+        first[count] = (uint16_t)atoi(item);
+        second[count] = (uint16_t)atoi(mark + 1);
+        count++;
+    }
+    if (count == 0) {
+        printf("[客户端] 错误：至少需要一个%s\n", is_write ? " <地址>=<值>" : " <起始地址>:<数量>");
+        return false;
+    }
+
+    uint8_t request_buffer[MODBUS_MAX_MESSAGE_LENGTH];
+    size_t request_length = is_write
+        ? modbus_build_write_vector_request(transaction_id++, 0x01, first, second, count,
+                                            request_buffer, sizeof(request_buffer))
+        : modbus_build_read_vector_request(transaction_id++, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS,
+                                           first, second, count, request_buffer, sizeof(request_buffer));
+    if (request_length == 0) {
+        printf("[客户端] 构建 Modbus %s 请求失败\n", is_write ? "FC44" : "FC43");
+        return false;
+    }
+
+    ssize_t n_write = write(socket_fd, request_buffer, request_length);
+    if (n_write < 0) {
+        perror("write");
+        return false;
+    }
+
+    printf("[客户端] 已发送 %s 请求：%zu %s (%zu 字节)\n",
+           is_write ? "FC44 原子多点写" : "FC43 分散读", count, is_write ? "个寄存器" : "段", request_length);
+    return true;
+}
+
 /*
  * 处理用户命令
  * 
@@ -209,6 +364,17 @@ static bool handle_user_command(const char *input) {
     }
     
     /* 检查是否为 Modbus 命令 */
+    if (strncmp(input, "modbus readv ", 13) == 0) {
+        /* modbus readv <起始地址>:<数量> ... */
+        send_modbus_vector_request(false, input + 13);
+        return true;
+    }
+    if (strncmp(input, "modbus writev ", 14) == 0) {
+        /* modbus writev <地址>=<值> ... */
+        send_modbus_vector_request(true, input + 14);
+        return true;
+    }
+
     if (strncmp(input, "modbus ", 7) == 0) {
         char cmd_type[32];
         int args[3];
@@ -231,19 +397,43 @@ static bool handle_user_command(const char *input) {
             uint16_t register_value = (uint16_t)args[1];
             
             send_modbus_write_request(register_address, register_value);
+        } else if (num_args >= 3 && strcmp(cmd_type, "subscribe") == 0) {
+            /* modbus subscribe <起始地址> <数量> */
+            if (args[1] <= 0 || args[1] > 65535) {
+                printf("[客户端] 错误：订阅数量必须在 1 到 65535 之间\n");
+                return true;
+            }
+            send_modbus_subscribe_request((uint16_t)args[0], (uint16_t)args[1]);
+        } else if (num_args >= 1 && strcmp(cmd_type, "unsubscribe") == 0) {
+            /* modbus unsubscribe */
+            send_modbus_subscribe_request(0, 0);
         } else {
             printf("[客户端] 用法：\n");
             printf("  modbus read <起始地址> <数量>   - 读取保持寄存器 (FC03)\n");
             printf("  modbus write <地址> <值>        - 写单个寄存器 (FC06)\n");
+            printf("  modbus subscribe <起始地址> <数量> - 订阅保持寄存器变化 (FC41)\n");
+            printf("  modbus unsubscribe              - 取消全部订阅\n");
+            printf("  modbus readv <地址>:<数量> ...  - 一次读取多段保持寄存器 (FC43)\n");
+            printf("  modbus writev <地址>=<值> ...   - 原子写入多个保持寄存器 (FC44)\n");
             printf("示例：\n");
             printf("  modbus read 100 5    - 读取地址100开始的5个寄存器\n");
             printf("  modbus write 100 1234 - 将地址100的寄存器设为1234\n");
+            printf("  modbus readv 100:2 500:3 - 读取 100-101 和 500-502\n");
+            printf("  modbus writev 100=1 500=2 - 同时写入 100 和 500\n");
         }
         return true;
     }
     
-    /* 普通文本消息，发送给服务器 */
-    ssize_t n_write = write(socket_fd, input, strlen(input));
+    /* 普通文本消息，以换行结尾发送给服务器（管理套接字按行切分命令，不依赖读取边界） */
+    char message[BUFFER_SIZE + 1];
+    int message_length = snprintf(message, sizeof(message), "%s\n", input);
+    if (message_length < 0) {
+        return false;
+    }
+    if ((size_t)message_length >= sizeof(message)) {
+        message_length = (int)sizeof(message) - 1;
+    }
+    ssize_t n_write = write(socket_fd, message, (size_t)message_length);
     if (n_write < 0) {
         perror("write");
         return false;
@@ -269,52 +459,88 @@ static bool is_modbus_response(const uint8_t *buffer, size_t length) {
  * 主函数：读取参数、初始化网络连接并处理用户交互。
  */
 int main(int argc, char *argv[]) {
-    /* 检查命令行参数：需要服务器 IP 和端口号 */
+    /* 检查命令行参数：需要服务器 IP 和端口号，或 -u 加 Unix 域套接字路径 */
     if (argc != 3) {
         fprintf(stderr, "用法: %s <服务器IP> <服务器端口>\n", argv[0]);
+        fprintf(stderr, "      %s -u <Unix套接字路径>\n", argv[0]);
         exit(1);
     }
 
+    bool use_unix = (strcmp(argv[1], "-u") == 0);
     const char *server_ip = argv[1];
-    int server_port = atoi(argv[2]);
+    int server_port = 0;
+    char server_desc[UNIX_PATH_LENGTH + 32];
 
-    /* 验证端口号合法性 */
-    if (server_port <= 0 || server_port > 65535) {
-        fprintf(stderr, "错误: 无效的端口号。端口必须在 1 到 65535 之间。\n");
-        exit(1);
+    if (use_unix) {
+        snprintf(server_desc, sizeof(server_desc), "unix:%s", argv[2]);
+    } else {
+        server_port = atoi(argv[2]);
+
+        /* 验证端口号合法性 */
+        if (server_port <= 0 || server_port > 65535) {
+            fprintf(stderr, "错误: 无效的端口号。端口必须在 1 到 65535 之间。\n");
+            exit(1);
+        }
+        snprintf(server_desc, sizeof(server_desc), "%s:%d", server_ip, server_port);
     }
 
     /* 注册信号处理器，支持 Ctrl+C 等信号的优雅退出 */
     signal(SIGINT, cleanup);
     signal(SIGTERM, cleanup);
 
-    /* 创建 TCP 套接字 */
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_fd < 0) {
-        perror("socket");
-        exit(1);
-    }
+    if (use_unix) {
+        /* 创建 Unix 域流式套接字 */
+        struct sockaddr_un unix_addr;
+        memset(&unix_addr, 0, sizeof(unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        if (strlen(argv[2]) >= sizeof(unix_addr.sun_path)) {
+            fprintf(stderr, "错误: Unix 套接字路径过长。\n");
+            exit(1);
+        }
+        strncpy(unix_addr.sun_path, argv[2], sizeof(unix_addr.sun_path) - 1);
 
-    /* 构造服务器地址结构 */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(server_port);
+        socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_fd < 0) {
+            perror("socket");
+            exit(1);
+        }
 
-    /* 将字符串形式的 IP 地址转换为网络字节序 */
-    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
-        fprintf(stderr, "错误: 无效的服务器 IP 地址。\n");
-        close(socket_fd);
-        exit(1);
-    }
+        printf("[客户端] 正在连接 %s...\n", server_desc);
 
-    printf("[客户端] 正在连接 %s:%d...\n", server_ip, server_port);
+        if (connect(socket_fd, (struct sockaddr *)&unix_addr, sizeof(unix_addr)) < 0) {
+            perror("connect");
+            close(socket_fd);
+            exit(1);
+        }
+    } else {
+        /* 创建 TCP 套接字 */
+        socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (socket_fd < 0) {
+            perror("socket");
+            exit(1);
+        }
 
-    /* 建立到服务器的 TCP 连接 */
-    if (connect(socket_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("connect");
-        close(socket_fd);
-        exit(1);
+        /* 构造服务器地址结构 */
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(server_port);
+
+        /* 将字符串形式的 IP 地址转换为网络字节序 */
+        if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
+            fprintf(stderr, "错误: 无效的服务器 IP 地址。\n");
+            close(socket_fd);
+            exit(1);
+        }
+
+        printf("[客户端] 正在连接 %s...\n", server_desc);
+
+        /* 建立到服务器的 TCP 连接 */
+        if (connect(socket_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+            perror("connect");
+            close(socket_fd);
+            exit(1);
+        }
     }
 
 #if DEBUG_MODE
@@ -322,11 +548,14 @@ int main(int argc, char *argv[]) {
     printf("[客户端] 可用命令：\n");
     printf("  modbus read <起始地址> <数量>   - 读取保持寄存器 (FC03)\n");
     printf("  modbus write <地址> <值>        - 写单个寄存器 (FC06)\n");
+    printf("  modbus subscribe <起始地址> <数量> - 订阅保持寄存器变化，服务器推送 (FC41/FC42)\n");
+    printf("  modbus readv <地址>:<数量> ...  - 一次读取多段保持寄存器 (FC43)\n");
+    printf("  modbus writev <地址>=<值> ...   - 原子写入多个保持寄存器 (FC44)\n");
     printf("  quit                             - 退出程序\n");
     printf("  或输入任意文本消息发送给服务器\n");
     printf("  使用上下箭头键导航命令历史\n\n");
 #else
-    printf("[客户端] 已连接到服务器 %s:%d\n\n", server_ip, server_port);
+    printf("[客户端] 已连接到服务器 %s\n\n", server_desc);
 #endif
 
     /* 初始化命令历史 */
@@ -353,10 +582,17 @@ int main(int argc, char *argv[]) {
                 printf("\n[客户端] 服务器已关闭连接。\n");
                 break;
             } else {
-                /* 检查是否为 Modbus 响应 */
+                /* 检查是否为 Modbus 响应（变化推送可能多帧首尾相接，逐帧处理） */
                 if (is_modbus_response(response, n_read)) {
                     printf("\n");
-                    handle_modbus_response(response, n_read);
+                    size_t offset = 0;
+                    while (offset + MODBUS_MBAP_HEADER_LENGTH <= (size_t)n_read &&
+                           is_modbus_response(&response[offset], (size_t)n_read - offset)) {
+                        size_t frame_length = MODBUS_MBAP_HEADER_LENGTH - 1 +
+                                              ((size_t)(response[offset + 4] << 8) | response[offset + 5]);
+                        handle_modbus_response(&response[offset], (size_t)n_read - offset);
+                        offset += frame_length;
+                    }
                 } else {
                     /* 普通文本消息 */
                     response[n_read] = '\0';
@@ -0,0 +1,211 @@
+/*
+ * 模拟设备与设备模板实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "device.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+/*
+ * 初始化空的设备表
+ */
+void device_table_init(DeviceTable *table) {
+    memset(table, 0, sizeof(*table));
+}
+
+/*
+ * 释放全部设备和模板
+ */
+void device_table_destroy(DeviceTable *table) {
+    for (size_t i = 0; i < table->device_count; i++) {
+        register_bank_destroy(&table->devices[i]->holding);
+        register_bank_destroy(&table->devices[i]->input);
+        free(table->devices[i]);
+    }
+    free(table->devices);
+    for (size_t i = 0; i < table->template_count; i++) {
+        register_bank_destroy(&table->templates[i].holding);
+        register_bank_destroy(&table->templates[i].input);
+    }
+    memset(table, 0, sizeof(*table));
+}
+
+/*
+ * 以给定的寄存器初值定义设备模板
+ */
+DeviceTemplate *device_template_add(DeviceTable *table, const char *name, const uint16_t *holding,
+                                    const uint16_t *input, uint32_t register_count,
+                                    char *error, size_t error_size) {
+    size_t length = strlen(name);
+    if (length == 0 || length >= DEVICE_NAME_LENGTH) {
+        snprintf(error, error_size, "模板名称长度必须在 1 到 %d 之间", DEVICE_NAME_LENGTH - 1);
+        return NULL;
+    }
+    if (device_template_find(table, name)) {
+        snprintf(error, error_size, "模板 %s 已存在", name);
+        return NULL;
+    }
+    if (table->template_count >= DEVICE_MAX_TEMPLATES) {
+        snprintf(error, error_size, "模板数已达上限（%d 个）", DEVICE_MAX_TEMPLATES);
+        return NULL;
+    }
+
+    DeviceTemplate *template = &table->templates[table->template_count];
+    memset(template, 0, sizeof(*template));
+    if (!register_bank_init(&template->holding, register_count, NULL) ||
+        !register_bank_init(&template->input, register_count, NULL)) {
+        register_bank_destroy(&template->holding);
+        register_bank_destroy(&template->input);
+        snprintf(error, error_size, "内存不足");
+        return NULL;
+    }
+    register_bank_write(&template->holding, 0, register_count, holding);
+    register_bank_write(&template->input, 0, register_count, input);
+    memcpy(template->name, name, length + 1);
+    table->template_count++;
+    return template;
+}
+
+/*
+ * 按名称查找模板
+ */
+DeviceTemplate *device_template_find(DeviceTable *table, const char *name) {
+    for (size_t i = 0; i < table->template_count; i++) {
+        if (strcmp(table->templates[i].name, name) == 0) {
+            return &table->templates[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 替换模板的寄存器（与传入的寄存器组交换），以该模板创建的设备丢弃私有页后重新共享新模板
+ */
+void device_template_reset(DeviceTable *table, DeviceTemplate *template, RegisterBank *holding, RegisterBank *input) {
+    for (size_t i = 0; i < table->device_count; i++) {
+        Device *device = table->devices[i];
+        if (device->template == template) {
+            register_bank_destroy(&device->holding);
+            register_bank_destroy(&device->input);
+        }
+    }
+
+    RegisterBank previous = template->holding;
+    template->holding = *holding;
+    *holding = previous;
+    previous = template->input;
+    template->input = *input;
+    *input = previous;
+
+    for (size_t i = 0; i < table->device_count; i++) {
+        Device *device = table->devices[i];
+        if (device->template == template) {
+            register_bank_init_cow(&device->holding, &template->holding);
+            register_bank_init_cow(&device->input, &template->input);
+        }
+    }
+}
+
+/*
+ * 以模板创建一台设备（寄存器与模板写时复制共享）
+ */
+Device *device_create(DeviceTable *table, DeviceTemplate *template) {
+    if (table->device_count == table->device_capacity) {
+        size_t capacity = table->device_capacity ? table->device_capacity * 2 : 64;
+        Device **devices = realloc(table->devices, capacity * sizeof(Device *));
+        if (!devices) {
+            return NULL;
+        }
+        table->devices = devices;
+        table->device_capacity = capacity;
+    }
+
+    Device *device = calloc(1, sizeof(*device));
+    if (!device) {
+        return NULL;
+    }
+    device->id = (uint32_t)table->device_count + 1;
+    device->template = template;
+    register_bank_init_cow(&device->holding, &template->holding);
+    register_bank_init_cow(&device->input, &template->input);
+    template->instances++;
+    table->devices[table->device_count++] = device;
+    return device;
+}
+
+/*
+ * 解析单元 ID（DEVICE_MIN_UNIT 到 DEVICE_MAX_UNIT）
+ *
+ * 返回：
+ *   成功返回 true，end 指向数字之后的字符
+ */
+static bool parse_unit(const char *text, char **end, unsigned long *unit) {
+    if (!isdigit((unsigned char)*text)) {
+        return false;
+    }
+    *unit = strtoul(text, end, 10);
+    return *unit >= DEVICE_MIN_UNIT && *unit <= DEVICE_MAX_UNIT;
+}
+
+/*
+ * 解析 <单元ID>[-<单元ID>]=<模板名>，为每个单元 ID 创建一台设备
+ */
+bool device_table_add_units(DeviceTable *table, const char *spec, char *error, size_t error_size) {
+    char *end = NULL;
+    unsigned long first = 0, last = 0;
+    if (!parse_unit(spec, &end, &first)) {
+        snprintf(error, error_size, "单元 ID 必须在 %d 到 %d 之间", DEVICE_MIN_UNIT, DEVICE_MAX_UNIT);
+        return false;
+    }
+    last = first;
+    if (*end == '-' && !parse_unit(end + 1, &end, &last)) {
+        snprintf(error, error_size, "单元 ID 必须在 %d 到 %d 之间", DEVICE_MIN_UNIT, DEVICE_MAX_UNIT);
+        return false;
+    }
+    if (*end != '=' || last < first) {
+        snprintf(error, error_size, "格式应为 <单元ID>[-<单元ID>]=<模板名>");
+        return false;
+    }
+
+    DeviceTemplate *template = device_template_find(table, end + 1);
+    if (!template) {
+        snprintf(error, error_size, "模板 %s 不存在", end + 1);
+        return false;
+    }
+    for (unsigned long unit = first; unit <= last; unit++) {
+        if (table->units[unit]) {
+            snprintf(error, error_size, "单元 ID %lu 已挂有设备 #%u", unit, table->units[unit]->id);
+            return false;
+        }
+    }
+
+    for (unsigned long unit = first; unit <= last; unit++) {
+        Device *device = device_create(table, template);
+        if (!device) {
+            snprintf(error, error_size, "内存不足");
+            return false;
+        }
+        device->unit_id = (uint8_t)unit;
+        table->units[unit] = device;
+    }
+    return true;
+}
+
+/*
+ * 按单元 ID 查找设备，未挂接时返回 NULL
+ */
+Device *device_table_route(const DeviceTable *table, uint8_t unit_id) {
+    return table->units[unit_id];
+}
+
+/*
+ * 设备占用的私有内存（结构体和写时复制出的页）
+ */
+size_t device_private_bytes(const Device *device) {
+    return sizeof(*device) + register_bank_private_bytes(&device->holding) +
+           register_bank_private_bytes(&device->input);
+}
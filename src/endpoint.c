@@ -0,0 +1,274 @@
+/*
+ * 设备端点实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "endpoint.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/* 单条规格的最大长度 */
+#define ENDPOINT_SPEC_LENGTH 128
+
+/*
+ * 初始化空的端点集合
+ */
+void endpoint_set_init(EndpointSet *set) {
+    memset(set, 0, sizeof(*set));
+}
+
+/*
+ * 关闭全部端点的监听套接字并释放集合
+ */
+void endpoint_set_close(EndpointSet *set) {
+    for (size_t i = 0; i < set->count; i++) {
+        close(set->endpoints[i].fd);
+    }
+    free(set->endpoints);
+    free(set->by_fd);
+    memset(set, 0, sizeof(*set));
+}
+
+/*
+ * 解析端口号（1 到 65535）
+ *
+ * 返回：
+ *   成功返回 true，end 指向数字之后的字符
+ */
+static bool parse_port(const char *text, char **end, unsigned long *port) {
+    if (!isdigit((unsigned char)*text)) {
+        return false;
+    }
+    *port = strtoul(text, end, 10);
+    return *port >= 1 && *port <= 65535;
+}
+
+/*
+ * 解析 IPv4 地址（主机字节序）
+ */
+static bool parse_address(const char *text, size_t length, uint32_t *address) {
+    char buffer[INET_ADDRSTRLEN];
+    struct in_addr parsed;
+    if (length == 0 || length >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    if (inet_pton(AF_INET, buffer, &parsed) != 1) {
+        return false;
+    }
+    *address = ntohl(parsed.s_addr);
+    return true;
+}
+
+/*
+ * 绑定一个非阻塞的监听套接字
+ *
+ * 返回：
+ *   监听描述符，失败返回 -1
+ */
+static int bind_listener(const struct sockaddr_in *addr, char *error, size_t error_size) {
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, text, sizeof(text));
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        snprintf(error, error_size, "无法创建套接字（%s）", strerror(errno));
+        return -1;
+    }
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 ||
+        listen(fd, LISTEN_BACKLOG) < 0) {
+        snprintf(error, error_size, "无法监听 %s:%u（%s）", text, ntohs(addr->sin_port), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+/*
+ * 把新端点加入集合和描述符索引
+ *
+ * 返回：
+ *   成功返回 true，内存不足返回 false
+ */
+static bool append_endpoint(EndpointSet *set, int fd, const struct sockaddr_in *addr, Device *device) {
+    if (set->count == set->capacity) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 64;
+        Endpoint *endpoints = realloc(set->endpoints, capacity * sizeof(Endpoint));
+        if (!endpoints) {
+            return false;
+        }
+        set->endpoints = endpoints;
+        set->capacity = capacity;
+    }
+    if ((size_t)fd >= set->by_fd_size) {
+        size_t size = set->by_fd_size ? set->by_fd_size : 256;
+        while (size <= (size_t)fd) {
+            size *= 2;
+        }
+        uint32_t *by_fd = realloc(set->by_fd, size * sizeof(uint32_t));
+        if (!by_fd) {
+            return false;
+        }
+        memset(by_fd + set->by_fd_size, 0, (size - set->by_fd_size) * sizeof(uint32_t));
+        set->by_fd = by_fd;
+        set->by_fd_size = size;
+    }
+
+    Endpoint *endpoint = &set->endpoints[set->count];
+    endpoint->fd = fd;
+    endpoint->addr = *addr;
+    endpoint->device = device;
+    endpoint->connections = 0;
+    set->by_fd[fd] = (uint32_t)++set->count;
+    return true;
+}
+
+/*
+ * 解析 [<地址>[-<地址>]:]<端口>[-<端口>]=<模板名>，为每个地址和端口创建一台设备并绑定监听套接字
+ */
+bool endpoint_set_add(EndpointSet *set, DeviceTable *devices, const char *spec, char *error, size_t error_size) {
+    char text[ENDPOINT_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(text)) {
+        snprintf(error, error_size, "规格过长");
+        return false;
+    }
+    strcpy(text, spec);
+
+    char *equals = strchr(text, '=');
+    if (!equals) {
+        snprintf(error, error_size, "格式应为 [<地址>[-<地址>]:]<端口>[-<端口>]=<模板名>");
+        return false;
+    }
+    *equals = '\0';
+    DeviceTemplate *template = device_template_find(devices, equals + 1);
+    if (!template) {
+        snprintf(error, error_size, "模板 %s 不存在", equals + 1);
+        return false;
+    }
+
+    /* 地址部分（可省略）：单个地址或地址范围 */
+    uint32_t first_address = INADDR_ANY, last_address = INADDR_ANY;
+    const char *ports = text;
+    char *colon = strrchr(text, ':');
+    if (colon) {
+        char *dash = memchr(text, '-', (size_t)(colon - text));
+        size_t first_length = (size_t)((dash ? dash : colon) - text);
+        if (!parse_address(text, first_length, &first_address) ||
+            (dash && !parse_address(dash + 1, (size_t)(colon - dash - 1), &last_address))) {
+            snprintf(error, error_size, "无效的 IPv4 地址");
+            return false;
+        }
+        if (!dash) {
+            last_address = first_address;
+        }
+        ports = colon + 1;
+    }
+
+    /* 端口部分：单个端口或端口范围 */
+    char *end = NULL;
+    unsigned long first_port = 0, last_port = 0;
+    if (!parse_port(ports, &end, &first_port)) {
+        snprintf(error, error_size, "端口必须在 1 到 65535 之间");
+        return false;
+    }
+    last_port = first_port;
+    if (*end == '-' && !parse_port(end + 1, &end, &last_port)) {
+        snprintf(error, error_size, "端口必须在 1 到 65535 之间");
+        return false;
+    }
+    if (*end != '\0' || last_port < first_port || last_address < first_address) {
+        snprintf(error, error_size, "格式应为 [<地址>[-<地址>]:]<端口>[-<端口>]=<模板名>，范围须从小到大");
+        return false;
+    }
+    uint64_t total = ((uint64_t)last_address - first_address + 1) * (last_port - first_port + 1);
+    if (total > ENDPOINT_SPEC_MAX) {
+        snprintf(error, error_size, "一条规格最多展开 %d 个端点（本条为 %llu 个）",
+                 ENDPOINT_SPEC_MAX, (unsigned long long)total);
+        return false;
+    }
+
+    for (uint64_t address = first_address; address <= last_address; address++) {
+        for (unsigned long port = first_port; port <= last_port; port++) {
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl((uint32_t)address);
+            addr.sin_port = htons((uint16_t)port);
+
+            int fd = bind_listener(&addr, error, error_size);
+            if (fd < 0) {
+                return false;
+            }
+            Device *device = device_create(devices, template);
+            if (!device || !append_endpoint(set, fd, &addr, device)) {
+                snprintf(error, error_size, "内存不足");
+                close(fd);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * 从配置文件逐行添加端点规格（忽略空行和 # 注释），出错时报告行号
+ */
+bool endpoint_set_load(EndpointSet *set, DeviceTable *devices, const char *path, char *error, size_t error_size) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        snprintf(error, error_size, "无法打开 %s（%s）", path, strerror(errno));
+        return false;
+    }
+
+    char line[256];
+    char reason[192];
+    unsigned line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *begin = line;
+        while (isspace((unsigned char)*begin)) {
+            begin++;
+        }
+        char *finish = begin + strlen(begin);
+        while (finish > begin && isspace((unsigned char)finish[-1])) {
+            *--finish = '\0';
+        }
+        if (*begin == '\0') {
+            continue;
+        }
+        if (!endpoint_set_add(set, devices, begin, reason, sizeof(reason))) {
+            snprintf(error, error_size, "%s 第 %u 行：%s", path, line_number, reason);
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+/*
+ * 按监听描述符查找端点，不是端点时返回 NULL
+ */
+Endpoint *endpoint_set_find(const EndpointSet *set, int fd) {
+    if (fd < 0 || (size_t)fd >= set->by_fd_size || set->by_fd[fd] == 0) {
+        return NULL;
+    }
+    return &set->endpoints[set->by_fd[fd] - 1];
+}
@@ -0,0 +1,1169 @@
+/*
+ * Modbus TCP 网关实现
+ */
+
+#define _GNU_SOURCE
+
+#include "gateway.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/* 检查超时和重连的定时器周期（毫秒），决定超时判定的精度 */
+#define GATEWAY_TICK_MS 20
+
+/* 重连退避间隔的下限与上限（毫秒） */
+#define GATEWAY_RETRY_MIN_MS 200
+#define GATEWAY_RETRY_MAX_MS 5000
+
+/* 规格的最大长度 */
+#define GATEWAY_SPEC_LENGTH 96
+
+/*
+ * 读取单调时钟（纳秒）
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 上游连接状态名称
+ */
+const char *gateway_link_state_name(GatewayLinkState state) {
+    switch (state) {
+        case GATEWAY_LINK_CONNECTING:
+            return "连接中";
+        case GATEWAY_LINK_UP:
+            return "已连接";
+        default:
+            return "未连接";
+    }
+}
+
+/*
+ * 初始化网关（未配置上游时其余函数均为空操作）
+ */
+void gateway_init(Gateway *gateway) {
+    memset(gateway, 0, sizeof(*gateway));
+    gateway->epoll_fd = -1;
+    gateway->timer_fd = -1;
+    gateway->timeout_ms = GATEWAY_DEFAULT_TIMEOUT_MS;
+}
+
+/*
+ * 解析 1 到 max 之间的十进制数
+ *
+ * 返回：
+ *   成功返回 true，end 指向数字之后的字符
+ */
+static bool parse_number(const char *text, char **end, unsigned long max, unsigned long *value) {
+    if (!isdigit((unsigned char)*text)) {
+        return false;
+    }
+    *value = strtoul(text, end, 10);
+    return *value >= 1 && *value <= max;
+}
+
+/*
+ * 解析一条转发规格，添加上游并把单元 ID 路由到它
+ */
+bool gateway_add(Gateway *gateway, const char *spec, char *error, size_t error_size) {
+    static const char FORMAT[] = "格式应为 <单元ID>[-<单元ID>]=<地址>:<端口>[,<连接数>[,<流水线深度>]]";
+    char text[GATEWAY_SPEC_LENGTH];
+    if (gateway->upstream_count >= GATEWAY_MAX_UPSTREAMS) {
+        snprintf(error, error_size, "最多 %d 个上游", GATEWAY_MAX_UPSTREAMS);
+        return false;
+    }
+    if (strlen(spec) >= sizeof(text)) {
+        snprintf(error, error_size, "规格过长");
+        return false;
+    }
+    strcpy(text, spec);
+
+    /* 单元 ID 范围 */
+    char *end = NULL;
+    unsigned long first_unit = 0, last_unit = 0;
+    if (!parse_number(text, &end, 255, &first_unit)) {
+        snprintf(error, error_size, "单元 ID 必须在 1 到 255 之间；%s", FORMAT);
+        return false;
+    }
+    last_unit = first_unit;
+    if (*end == '-' && !parse_number(end + 1, &end, 255, &last_unit)) {
+        snprintf(error, error_size, "单元 ID 必须在 1 到 255 之间；%s", FORMAT);
+        return false;
+    }
+    if (*end != '=' || last_unit < first_unit) {
+        snprintf(error, error_size, "%s", FORMAT);
+        return false;
+    }
+
+    /* 上游地址和端口 */
+    char *host = end + 1;
+    char *colon = strchr(host, ':');
+    struct in_addr address;
+    if (!colon) {
+        snprintf(error, error_size, "%s", FORMAT);
+        return false;
+    }
+    *colon = '\0';
+    if (inet_pton(AF_INET, host, &address) != 1) {
+        snprintf(error, error_size, "无效的 IPv4 地址 %s", host);
+        return false;
+    }
+    unsigned long port = 0;
+    if (!parse_number(colon + 1, &end, 65535, &port)) {
+        snprintf(error, error_size, "端口必须在 1 到 65535 之间");
+        return false;
+    }
+
+    /* 可选的连接数和流水线深度 */
+    unsigned long connections = GATEWAY_DEFAULT_CONNECTIONS;
+    unsigned long depth = GATEWAY_DEFAULT_DEPTH;
+    if (*end == ',' && !parse_number(end + 1, &end, GATEWAY_MAX_CONNECTIONS, &connections)) {
+        snprintf(error, error_size, "连接数必须在 1 到 %d 之间", GATEWAY_MAX_CONNECTIONS);
+        return false;
+    }
+    if (*end == ',' && !parse_number(end + 1, &end, GATEWAY_MAX_INFLIGHT, &depth)) {
+        snprintf(error, error_size, "流水线深度必须在 1 到 %d 之间", GATEWAY_MAX_INFLIGHT);
+        return false;
+    }
+    if (*end != '\0') {
+        snprintf(error, error_size, "%s", FORMAT);
+        return false;
+    }
+
+    for (unsigned long unit = first_unit; unit <= last_unit; unit++) {
+        if (gateway->unit_upstream[unit] != 0) {
+            snprintf(error, error_size, "单元 %lu 已转发到 %s", unit,
+                     gateway->upstreams[gateway->unit_upstream[unit] - 1].name);
+            return false;
+        }
+    }
+
+    GatewayUpstream *upstream = &gateway->upstreams[gateway->upstream_count];
+    memset(upstream, 0, sizeof(*upstream));
+    upstream->links = calloc(connections, sizeof(GatewayLink));
+    upstream->backlog = calloc(GATEWAY_BACKLOG, sizeof(GatewayQueued));
+    upstream->waiters = calloc(GATEWAY_MAX_WAITERS, sizeof(GatewayWaiter));
+    if (!upstream->links || !upstream->backlog || !upstream->waiters) {
+        free(upstream->links);
+        free(upstream->backlog);
+        free(upstream->waiters);
+        snprintf(error, error_size, "内存不足");
+        return false;
+    }
+    upstream->addr.sin_family = AF_INET;
+    upstream->addr.sin_addr = address;
+    upstream->addr.sin_port = htons((uint16_t)port);
+    snprintf(upstream->name, sizeof(upstream->name), "%s:%lu", host, port);
+    upstream->first_unit = (uint8_t)first_unit;
+    upstream->last_unit = (uint8_t)last_unit;
+    upstream->depth = (uint32_t)depth;
+    upstream->link_count = (uint32_t)connections;
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        upstream->links[i].fd = -1;
+        upstream->links[i].retry_ms = GATEWAY_RETRY_MIN_MS;
+    }
+    for (int32_t i = 0; i < GATEWAY_MAX_WAITERS; i++) {
+        upstream->waiters[i].client_fd = -1;
+        upstream->waiters[i].next = i + 1 < GATEWAY_MAX_WAITERS ? i + 1 : -1;
+    }
+    upstream->free_waiter = 0;
+
+    gateway->upstream_count++;
+    for (unsigned long unit = first_unit; unit <= last_unit; unit++) {
+        gateway->unit_upstream[unit] = (uint8_t)gateway->upstream_count;
+    }
+    return true;
+}
+
+/*
+ * 单元 ID 是否转发给上游
+ */
+bool gateway_routes(const Gateway *gateway, uint8_t unit_id) {
+    return gateway->unit_upstream[unit_id] != 0;
+}
+
+/*
+ * 解析 0 到 65535 之间的寄存器地址
+ */
+static bool parse_register_address(const char *text, char **end, unsigned long *value) {
+    if (!isdigit((unsigned char)*text)) {
+        return false;
+    }
+    *value = strtoul(text, end, 10);
+    return *value <= 65535;
+}
+
+/*
+ * 解析一条读缓存规则
+ */
+bool gateway_add_cache_rule(Gateway *gateway, const char *spec, char *error, size_t error_size) {
+    static const char FORMAT[] = "格式应为 <单元ID>[-<单元ID>]:<holding|input>:<起始地址>[-<结束地址>]=<毫秒>";
+    if (gateway->cache_rule_count >= GATEWAY_MAX_CACHE_RULES) {
+        snprintf(error, error_size, "最多 %d 条缓存规则", GATEWAY_MAX_CACHE_RULES);
+        return false;
+    }
+
+    char *end = NULL;
+    unsigned long first_unit = 0, last_unit = 0;
+    if (!parse_number(spec, &end, 255, &first_unit)) {
+        snprintf(error, error_size, "单元 ID 必须在 1 到 255 之间；%s", FORMAT);
+        return false;
+    }
+    last_unit = first_unit;
+    if (*end == '-' && !parse_number(end + 1, &end, 255, &last_unit)) {
+        snprintf(error, error_size, "单元 ID 必须在 1 到 255 之间；%s", FORMAT);
+        return false;
+    }
+    if (*end != ':' || last_unit < first_unit) {
+        snprintf(error, error_size, "%s", FORMAT);
+        return false;
+    }
+
+    uint8_t function_code;
+    const char *bank = end + 1;
+    if (strncmp(bank, "holding:", 8) == 0) {
+        function_code = MODBUS_FC_READ_HOLDING_REGISTERS;
+        end = (char *)bank + 8;
+    } else if (strncmp(bank, "input:", 6) == 0) {
+        function_code = MODBUS_FC_READ_INPUT_REGISTERS;
+        end = (char *)bank + 6;
+    } else {
+        snprintf(error, error_size, "寄存器组必须是 holding 或 input");
+        return false;
+    }
+
+    unsigned long first_address = 0, last_address = 0, ttl_ms = 0;
+    if (!parse_register_address(end, &end, &first_address)) {
+        snprintf(error, error_size, "地址必须在 0 到 65535 之间");
+        return false;
+    }
+    last_address = first_address;
+    if (*end == '-' && !parse_register_address(end + 1, &end, &last_address)) {
+        snprintf(error, error_size, "地址必须在 0 到 65535 之间");
+        return false;
+    }
+    if (*end != '=' || last_address < first_address) {
+        snprintf(error, error_size, "%s", FORMAT);
+        return false;
+    }
+    if (!parse_number(end + 1, &end, 3600000, &ttl_ms) || *end != '\0') {
+        snprintf(error, error_size, "存活时间必须在 1 到 3600000 毫秒之间");
+        return false;
+    }
+    for (unsigned long unit = first_unit; unit <= last_unit; unit++) {
+        if (gateway->unit_upstream[unit] == 0) {
+            snprintf(error, error_size, "单元 %lu 没有转发给网关上游（先用 -U 指定）", unit);
+            return false;
+        }
+    }
+
+    GatewayCacheRule *rule = &gateway->cache_rules[gateway->cache_rule_count++];
+    rule->first_unit = (uint8_t)first_unit;
+    rule->last_unit = (uint8_t)last_unit;
+    rule->function_code = function_code;
+    rule->first_address = (uint16_t)first_address;
+    rule->last_address = (uint16_t)last_address;
+    rule->ttl_ms = (uint32_t)ttl_ms;
+    return true;
+}
+
+/*
+ * 查找覆盖整个读请求的缓存规则
+ *
+ * 返回：
+ *   第一条覆盖的规则，没有则返回 NULL
+ */
+static const GatewayCacheRule *find_cache_rule(const Gateway *gateway, uint8_t unit_id, uint8_t function_code,
+                                               uint16_t start, uint16_t quantity) {
+    uint32_t last = (uint32_t)start + quantity - 1;
+    for (size_t i = 0; i < gateway->cache_rule_count; i++) {
+        const GatewayCacheRule *rule = &gateway->cache_rules[i];
+        if (unit_id >= rule->first_unit && unit_id <= rule->last_unit && function_code == rule->function_code &&
+            start >= rule->first_address && last <= rule->last_address) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 读请求所在的缓存组（GATEWAY_CACHE_WAYS 项）
+ */
+static GatewayCacheEntry *cache_set(const Gateway *gateway, uint8_t unit_id, uint8_t function_code,
+                                    uint16_t start, uint16_t quantity) {
+    uint32_t key = ((uint32_t)unit_id << 24) ^ ((uint32_t)function_code << 16) ^ start;
+    uint32_t hash = (key * 2654435761u) ^ ((uint32_t)quantity * 40503u);
+    return &gateway->cache[((hash >> 16) % GATEWAY_CACHE_SETS) * GATEWAY_CACHE_WAYS];
+}
+
+/*
+ * 缓存项是否对应同一单元、功能码和地址范围（不检查存活期）
+ */
+static bool cache_entry_matches(const GatewayCacheEntry *entry, uint8_t unit_id, uint8_t function_code,
+                                uint16_t start, uint16_t quantity) {
+    return entry->valid && entry->unit_id == unit_id && entry->function_code == function_code &&
+           entry->start == start && entry->quantity == quantity;
+}
+
+/*
+ * 查找未过期的缓存项
+ */
+static const GatewayCacheEntry *cache_lookup(const Gateway *gateway, uint8_t unit_id, uint8_t function_code,
+                                             uint16_t start, uint16_t quantity, uint64_t now) {
+    const GatewayCacheEntry *set = cache_set(gateway, unit_id, function_code, start, quantity);
+    for (int i = 0; i < GATEWAY_CACHE_WAYS; i++) {
+        if (cache_entry_matches(&set[i], unit_id, function_code, start, quantity) && set[i].expires_ns > now) {
+            return &set[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 把读响应写入缓存：覆盖同键的项，否则占用组内最早过期的项（无效项视为最早过期）
+ */
+static void cache_store(Gateway *gateway, const GatewaySlot *slot, const uint8_t *pdu, size_t length) {
+    const GatewayCacheRule *rule = find_cache_rule(gateway, slot->unit_id, slot->function_code,
+                                                   slot->start, slot->quantity);
+    if (!rule || length > MODBUS_MAX_PDU_LENGTH) {
+        return;
+    }
+    GatewayCacheEntry *set = cache_set(gateway, slot->unit_id, slot->function_code, slot->start, slot->quantity);
+    GatewayCacheEntry *victim = &set[0];
+    for (int i = 0; i < GATEWAY_CACHE_WAYS; i++) {
+        if (cache_entry_matches(&set[i], slot->unit_id, slot->function_code, slot->start, slot->quantity)) {
+            victim = &set[i];
+            break;
+        }
+        if (!set[i].valid || (victim->valid && set[i].expires_ns < victim->expires_ns)) {
+            victim = &set[i];
+        }
+    }
+    victim->valid = true;
+    victim->unit_id = slot->unit_id;
+    victim->function_code = slot->function_code;
+    victim->start = slot->start;
+    victim->quantity = slot->quantity;
+    victim->length = (uint8_t)length;
+    victim->expires_ns = monotonic_ns() + (uint64_t)rule->ttl_ms * 1000000ULL;
+    memcpy(victim->pdu, pdu, length);
+    gateway->cache_fills++;
+}
+
+/*
+ * 未过期的缓存项数
+ */
+size_t gateway_cache_entries(const Gateway *gateway) {
+    size_t count = 0;
+    uint64_t now = monotonic_ns();
+    for (size_t i = 0; gateway->cache && i < GATEWAY_CACHE_SETS * GATEWAY_CACHE_WAYS; i++) {
+        count += gateway->cache[i].valid && gateway->cache[i].expires_ns > now ? 1 : 0;
+    }
+    return count;
+}
+
+/*
+ * 上游全部连接上的在途请求数
+ */
+uint32_t gateway_upstream_inflight(const GatewayUpstream *upstream) {
+    uint32_t inflight = 0;
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        inflight += upstream->links[i].inflight;
+    }
+    return inflight;
+}
+
+/*
+ * 从空闲链表取一个等待者
+ *
+ * 返回：
+ *   下标，已用完返回 -1
+ */
+static int32_t waiter_alloc(GatewayUpstream *upstream) {
+    int32_t index = upstream->free_waiter;
+    if (index >= 0) {
+        upstream->free_waiter = upstream->waiters[index].next;
+    }
+    return index;
+}
+
+/*
+ * 把合并等待者放回空闲链表
+ */
+static void waiter_free(GatewayUpstream *upstream, int32_t index) {
+    upstream->waiters[index].client_fd = -1;
+    upstream->waiters[index].next = upstream->free_waiter;
+    upstream->free_waiter = index;
+}
+
+/*
+ * 把一帧响应交给请求的主站和全部合并等待者（各自换回自己的事务标识符），并释放等待者
+ *
+ * 参数：
+ *   client_fd、client_txid、request_ns - 请求本身的主站，client_fd 为 -1 时跳过
+ *   waiters - 等待者链表头
+ *   frame - 响应帧（事务标识符会被就地改写）
+ */
+static void answer_request(Gateway *gateway, GatewayUpstream *upstream, int client_fd, uint16_t client_txid,
+                           uint64_t request_ns, int32_t waiters, uint8_t *frame, size_t length) {
+    if (client_fd >= 0) {
+        frame[0] = (uint8_t)(client_txid >> 8);
+        frame[1] = (uint8_t)(client_txid & 0xFF);
+        gateway->deliver(client_fd, frame, length, request_ns, gateway->context);
+    }
+    while (waiters >= 0) {
+        GatewayWaiter *waiter = &upstream->waiters[waiters];
+        int32_t next = waiter->next;
+        if (waiter->client_fd >= 0) {
+            frame[0] = (uint8_t)(waiter->client_txid >> 8);
+            frame[1] = (uint8_t)(waiter->client_txid & 0xFF);
+            gateway->deliver(waiter->client_fd, frame, length, waiter->request_ns, gateway->context);
+        }
+        waiter_free(upstream, waiters);
+        waiters = next;
+    }
+}
+
+/*
+ * 以异常响应答复请求的主站和全部合并等待者
+ */
+static void reply_exception(Gateway *gateway, GatewayUpstream *upstream, int client_fd, uint16_t client_txid,
+                            uint8_t unit_id, uint8_t function_code, uint8_t exception_code, uint64_t request_ns,
+                            int32_t waiters) {
+    uint8_t response[MODBUS_MBAP_HEADER_LENGTH + 2];
+    size_t length = modbus_build_error_response(client_txid, unit_id, function_code & 0x7F, exception_code,
+                                                response, sizeof(response));
+    if (length > 0) {
+        answer_request(gateway, upstream, client_fd, client_txid, request_ns, waiters, response, length);
+    }
+}
+
+/*
+ * 以异常响应答复一条在途请求
+ */
+static void reply_slot_exception(Gateway *gateway, GatewayUpstream *upstream, const GatewaySlot *slot,
+                                 uint8_t exception_code) {
+    reply_exception(gateway, upstream, slot->client_fd, slot->client_txid, slot->unit_id, slot->function_code,
+                    exception_code, slot->request_ns, slot->waiters);
+}
+
+/*
+ * 以异常响应答复一条排队的请求
+ */
+static void reply_queued_exception(Gateway *gateway, GatewayUpstream *upstream, const GatewayQueued *queued,
+                                   uint8_t exception_code) {
+    reply_exception(gateway, upstream, queued->client_fd, (uint16_t)((queued->frame[0] << 8) | queued->frame[1]),
+                    queued->frame[6], queued->frame[7], exception_code, queued->request_ns, queued->waiters);
+}
+
+/*
+ * 按是否有待写数据设置上游连接关注的 epoll 事件
+ */
+static void link_set_write_interest(Gateway *gateway, GatewayLink *link, bool want_write) {
+    if (link->want_write == want_write) {
+        return;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+    event.data.fd = link->fd;
+    epoll_ctl(gateway->epoll_fd, EPOLL_CTL_MOD, link->fd, &event);
+    link->want_write = want_write;
+}
+
+/*
+ * 上游是否有连接可用或正在建立
+ */
+static bool upstream_reachable(const GatewayUpstream *upstream) {
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        if (upstream->links[i].state != GATEWAY_LINK_DOWN) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 关闭出错的上游连接：在途请求回复异常 0B，安排退避重连；
+ * 上游已没有可用连接时，等待队列中的请求回复异常 0A
+ */
+static void link_fail(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link, const char *reason) {
+    uint64_t now = monotonic_ns();
+    if (link->fd >= 0) {
+        epoll_ctl(gateway->epoll_fd, EPOLL_CTL_DEL, link->fd, NULL);
+        close(link->fd);
+    }
+    printf("[网关] 上游 %s 的连接 %u %s：%s，%u 毫秒后重连（在途请求 %u 个）\n",
+           upstream->name, (unsigned)(link - upstream->links),
+           link->state == GATEWAY_LINK_UP ? "已断开" : "无法建立",
+           reason, link->retry_ms, link->inflight);
+
+    link->fd = -1;
+    link->state = GATEWAY_LINK_DOWN;
+    link->state_ns = now;
+    link->retry_ns = now + (uint64_t)link->retry_ms * 1000000ULL;
+    link->retry_ms = link->retry_ms * 2 > GATEWAY_RETRY_MAX_MS ? GATEWAY_RETRY_MAX_MS : link->retry_ms * 2;
+    link->want_write = false;
+    link->rx_length = 0;
+    link->tx_length = 0;
+    link->failures++;
+
+    for (uint32_t i = 0; i < upstream->depth && link->inflight > 0; i++) {
+        GatewaySlot *slot = &link->slots[i];
+        if (slot->active) {
+            slot->active = false;
+            link->inflight--;
+            upstream->timeouts++;
+            reply_slot_exception(gateway, upstream, slot, MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED);
+        }
+    }
+    link->inflight = 0;
+
+    if (!upstream_reachable(upstream)) {
+        while (upstream->backlog_count > 0) {
+            GatewayQueued *queued = &upstream->backlog[upstream->backlog_head];
+            upstream->backlog_head = (upstream->backlog_head + 1) % GATEWAY_BACKLOG;
+            upstream->backlog_count--;
+            if (queued->client_fd >= 0) {
+                upstream->unavailable++;
+                reply_queued_exception(gateway, upstream, queued, MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE);
+            }
+        }
+    }
+}
+
+/*
+ * 尽量写出上游连接上待写的请求，写不完时关注 EPOLLOUT
+ *
+ * 返回：
+ *   成功（包括暂时写不出）返回 true，连接出错返回 false
+ */
+static bool link_flush(Gateway *gateway, GatewayLink *link) {
+    size_t written = 0;
+    while (written < link->tx_length) {
+        ssize_t n = send(link->fd, link->tx + written, link->tx_length - written, MSG_NOSIGNAL);
+        if (n > 0) {
+            written += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (written > 0) {
+        memmove(link->tx, link->tx + written, link->tx_length - written);
+        link->tx_length -= written;
+    }
+    link_set_write_interest(gateway, link, link->tx_length > 0);
+    return true;
+}
+
+/*
+ * 选择在途数最少且未满的已连接连接
+ */
+static GatewayLink *pick_link(GatewayUpstream *upstream) {
+    GatewayLink *best = NULL;
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        GatewayLink *link = &upstream->links[i];
+        if (link->state == GATEWAY_LINK_UP && link->inflight < upstream->depth &&
+            (!best || link->inflight < best->inflight)) {
+            best = link;
+        }
+    }
+    return best;
+}
+
+/*
+ * 在连接上占用一个槽位，换上网关的事务标识符后发出请求
+ *
+ * 参数：
+ *   joinable - 之后相同的读请求能否合并到本请求上
+ *   waiters - 排队期间已合并的等待者
+ */
+static void link_send(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link, int client_fd,
+                      const uint8_t *frame, size_t length, uint64_t request_ns, bool joinable, int32_t waiters) {
+    /* 上游长时间不读时待写数据会堆积：放不下就断开重连，本请求与在途请求一样回复异常 0B */
+    if (link->tx_length + length > sizeof(link->tx)) {
+        link_fail(gateway, upstream, link, "待写的请求积压过多");
+        upstream->timeouts++;
+        reply_exception(gateway, upstream, client_fd, (uint16_t)((frame[0] << 8) | frame[1]), frame[6], frame[7],
+                        MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED, request_ns, waiters);
+        return;
+    }
+
+    uint32_t index = 0;
+    while (link->slots[index].active) {
+        index++;  /* 调用者保证 inflight < depth，必有空槽位 */
+    }
+    GatewaySlot *slot = &link->slots[index];
+    slot->active = true;
+    slot->client_fd = client_fd;
+    slot->client_txid = (uint16_t)((frame[0] << 8) | frame[1]);
+    slot->upstream_txid = (uint16_t)(((link->sequence++ & 0x3FF) << 6) | index);
+    slot->unit_id = frame[6];
+    slot->function_code = frame[7];
+    slot->start = length >= MODBUS_MBAP_HEADER_LENGTH + 5 ? (uint16_t)((frame[8] << 8) | frame[9]) : 0;
+    slot->quantity = length >= MODBUS_MBAP_HEADER_LENGTH + 5 ? (uint16_t)((frame[10] << 8) | frame[11]) : 0;
+    slot->joinable = joinable;
+    slot->waiters = waiters;
+    slot->request_ns = request_ns;
+    slot->sent_ns = monotonic_ns();
+    link->inflight++;
+
+    uint8_t *out = link->tx + link->tx_length;
+    memcpy(out, frame, length);
+    out[0] = (uint8_t)(slot->upstream_txid >> 8);
+    out[1] = (uint8_t)(slot->upstream_txid & 0xFF);
+    link->tx_length += length;
+
+    upstream->forwarded++;
+    uint32_t inflight = gateway_upstream_inflight(upstream);
+    if (inflight > upstream->peak_inflight) {
+        upstream->peak_inflight = inflight;
+    }
+    if (!link_flush(gateway, link)) {
+        link_fail(gateway, upstream, link, strerror(errno));
+    }
+}
+
+/*
+ * 按到达顺序把等待队列中的请求发往有空槽位的连接
+ */
+static void drain_backlog(Gateway *gateway, GatewayUpstream *upstream) {
+    while (upstream->backlog_count > 0) {
+        GatewayQueued *queued = &upstream->backlog[upstream->backlog_head];
+        if (queued->client_fd >= 0 && !pick_link(upstream)) {
+            return;
+        }
+        GatewayQueued request = *queued;
+        upstream->backlog_head = (upstream->backlog_head + 1) % GATEWAY_BACKLOG;
+        upstream->backlog_count--;
+        if (request.client_fd >= 0) {
+            link_send(gateway, upstream, pick_link(upstream), request.client_fd, request.frame, request.length,
+                      request.request_ns, request.joinable, request.waiters);
+        }
+    }
+}
+
+/*
+ * 请求是否为可合并、可缓存的读请求（FC03/FC04，PDU 恰为功能码加起始地址和数量）
+ */
+static bool is_plain_read(const uint8_t *frame, size_t length) {
+    return length == MODBUS_MBAP_HEADER_LENGTH + 5 &&
+           (frame[7] == MODBUS_FC_READ_HOLDING_REGISTERS || frame[7] == MODBUS_FC_READ_INPUT_REGISTERS);
+}
+
+/*
+ * 查找可以合并的相同读请求（在途或排队）
+ *
+ * 返回：
+ *   等待者链表头的地址，没有返回 NULL
+ */
+static int32_t *find_leader(GatewayUpstream *upstream, const uint8_t *frame) {
+    uint16_t start = (uint16_t)((frame[8] << 8) | frame[9]);
+    uint16_t quantity = (uint16_t)((frame[10] << 8) | frame[11]);
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        GatewayLink *link = &upstream->links[i];
+        for (uint32_t s = 0; s < upstream->depth && link->inflight > 0; s++) {
+            GatewaySlot *slot = &link->slots[s];
+            if (slot->active && slot->joinable && slot->client_fd >= 0 && slot->unit_id == frame[6] &&
+                slot->function_code == frame[7] && slot->start == start && slot->quantity == quantity) {
+                return &slot->waiters;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < upstream->backlog_count; i++) {
+        GatewayQueued *queued = &upstream->backlog[(upstream->backlog_head + i) % GATEWAY_BACKLOG];
+        if (queued->joinable && queued->client_fd >= 0 && queued->length == MODBUS_MBAP_HEADER_LENGTH + 5 &&
+            memcmp(&queued->frame[6], &frame[6], 6) == 0) {
+            return &queued->waiters;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 转发写请求之前：同一单元此前的读请求不再接纳等待者，重叠范围的缓存失效
+ *
+ * FC06/FC10 的写入范围可以从请求中得出，只使保持寄存器上重叠的缓存失效；
+ * 其他功能码（厂商扩展等）无法确定范围，使该单元的全部缓存失效。
+ */
+static void note_write(Gateway *gateway, GatewayUpstream *upstream, const uint8_t *frame, size_t length) {
+    uint8_t unit_id = frame[6];
+    for (uint32_t i = 0; i < upstream->link_count; i++) {
+        GatewayLink *link = &upstream->links[i];
+        for (uint32_t s = 0; s < upstream->depth; s++) {
+            if (link->slots[s].active && link->slots[s].unit_id == unit_id) {
+                link->slots[s].joinable = false;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < upstream->backlog_count; i++) {
+        GatewayQueued *queued = &upstream->backlog[(upstream->backlog_head + i) % GATEWAY_BACKLOG];
+        if (queued->frame[6] == unit_id) {
+            queued->joinable = false;
+        }
+    }
+    if (!gateway->cache) {
+        return;
+    }
+
+    bool ranged = length >= MODBUS_MBAP_HEADER_LENGTH + 5 &&
+                  (frame[7] == MODBUS_FC_WRITE_SINGLE_REGISTER || frame[7] == MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    uint32_t first = ranged ? (uint32_t)((frame[8] << 8) | frame[9]) : 0;
+    uint32_t last = first;
+    if (ranged && frame[7] == MODBUS_FC_WRITE_MULTIPLE_REGISTERS) {
+        uint32_t quantity = (uint32_t)((frame[10] << 8) | frame[11]);
+        last = first + (quantity > 0 ? quantity - 1 : 0);
+    }
+    for (size_t i = 0; i < GATEWAY_CACHE_SETS * GATEWAY_CACHE_WAYS; i++) {
+        GatewayCacheEntry *entry = &gateway->cache[i];
+        if (!entry->valid || entry->unit_id != unit_id) {
+            continue;
+        }
+        if (ranged && (entry->function_code != MODBUS_FC_READ_HOLDING_REGISTERS ||
+                       entry->start > last || (uint32_t)entry->start + entry->quantity - 1 < first)) {
+            continue;
+        }
+        entry->valid = false;
+        gateway->cache_invalidations++;
+    }
+}
+
+/*
+ * 转发一帧主站请求
+ *
+ * 读请求先查缓存，再尝试合并到相同的在途或排队请求上；写请求使重叠的缓存项失效。
+ * 有空槽位的连接直接发出，否则排队；上游不可达回复异常 0A，队列已满回复异常 06。
+ */
+void gateway_forward(Gateway *gateway, int client_fd, const uint8_t *frame, size_t length) {
+    if (length <= MODBUS_MBAP_HEADER_LENGTH || length > MODBUS_MAX_MESSAGE_LENGTH) {
+        return;
+    }
+    uint64_t request_ns = monotonic_ns();
+    GatewayUpstream *upstream = &gateway->upstreams[gateway->unit_upstream[frame[6]] - 1];
+    uint16_t client_txid = (uint16_t)((frame[0] << 8) | frame[1]);
+    bool plain_read = is_plain_read(frame, length);
+
+    if (plain_read) {
+        /* 读缓存：存活期内直接以缓存的 PDU 应答 */
+        uint16_t start = (uint16_t)((frame[8] << 8) | frame[9]);
+        uint16_t quantity = (uint16_t)((frame[10] << 8) | frame[11]);
+        if (gateway->cache && quantity > 0 && find_cache_rule(gateway, frame[6], frame[7], start, quantity)) {
+            const GatewayCacheEntry *entry = cache_lookup(gateway, frame[6], frame[7], start, quantity, request_ns);
+            if (entry) {
+                uint8_t response[MODBUS_MAX_MESSAGE_LENGTH];
+                memcpy(response, frame, MODBUS_MBAP_HEADER_LENGTH);
+                response[4] = (uint8_t)((entry->length + 1) >> 8);
+                response[5] = (uint8_t)((entry->length + 1) & 0xFF);
+                memcpy(&response[MODBUS_MBAP_HEADER_LENGTH], entry->pdu, entry->length);
+                upstream->cache_hits++;
+                gateway->deliver(client_fd, response, MODBUS_MBAP_HEADER_LENGTH + entry->length, request_ns,
+                                 gateway->context);
+                return;
+            }
+            gateway->cache_misses++;
+        }
+
+        /* 合并：相同的读请求已在途或排队时挂到它的等待者链表上 */
+        int32_t *waiters = find_leader(upstream, frame);
+        int32_t index = waiters ? waiter_alloc(upstream) : -1;
+        if (index >= 0) {
+            GatewayWaiter *waiter = &upstream->waiters[index];
+            waiter->client_fd = client_fd;
+            waiter->client_txid = client_txid;
+            waiter->request_ns = request_ns;
+            waiter->next = *waiters;
+            *waiters = index;
+            upstream->coalesced++;
+            return;
+        }
+    } else if (frame[7] != MODBUS_FC_READ_VECTOR && frame[7] != MODBUS_FC_SUBSCRIBE) {
+        note_write(gateway, upstream, frame, length);
+    }
+
+    /* 没有排队的请求时直接发往有空槽位的连接 */
+    GatewayLink *link = upstream->backlog_count == 0 ? pick_link(upstream) : NULL;
+    if (link) {
+        link_send(gateway, upstream, link, client_fd, frame, length, request_ns, plain_read, -1);
+        return;
+    }
+    if (!upstream_reachable(upstream)) {
+        upstream->unavailable++;
+        reply_exception(gateway, upstream, client_fd, client_txid, frame[6], frame[7],
+                        MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE, request_ns, -1);
+        return;
+    }
+    if (upstream->backlog_count == GATEWAY_BACKLOG) {
+        upstream->busy++;
+        reply_exception(gateway, upstream, client_fd, client_txid, frame[6], frame[7],
+                        MODBUS_EXCEPTION_SERVER_DEVICE_BUSY, request_ns, -1);
+        return;
+    }
+    GatewayQueued *queued = &upstream->backlog[(upstream->backlog_head + upstream->backlog_count) % GATEWAY_BACKLOG];
+    queued->client_fd = client_fd;
+    queued->request_ns = request_ns;
+    queued->joinable = plain_read;
+    queued->waiters = -1;
+    queued->length = (uint16_t)length;
+    memcpy(queued->frame, frame, length);
+    upstream->backlog_count++;
+    upstream->queued++;
+}
+
+/*
+ * 发起非阻塞连接
+ */
+static void link_connect(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        link_fail(gateway, upstream, link, strerror(errno));
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    link->fd = fd;
+    link->state = GATEWAY_LINK_CONNECTING;
+    link->state_ns = monotonic_ns();
+    link->want_write = true;
+
+    struct epoll_event event;
+    event.events = EPOLLOUT | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (epoll_ctl(gateway->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 ||
+        (connect(fd, (const struct sockaddr *)&upstream->addr, sizeof(upstream->addr)) < 0 &&
+         errno != EINPROGRESS)) {
+        link_fail(gateway, upstream, link, strerror(errno));
+    }
+    /* 本机连接也可能立即完成，统一等待 EPOLLOUT 再确认 */
+}
+
+/*
+ * 非阻塞连接完成：检查结果，成功后发出等待队列中的请求
+ */
+static void link_connected(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link) {
+    int error = 0;
+    socklen_t error_length = sizeof(error);
+    if (getsockopt(link->fd, SOL_SOCKET, SO_ERROR, &error, &error_length) < 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        link_fail(gateway, upstream, link, strerror(error));
+        return;
+    }
+    link->state = GATEWAY_LINK_UP;
+    link->state_ns = monotonic_ns();
+    link->retry_ms = GATEWAY_RETRY_MIN_MS;
+    link->connects++;
+    link_set_write_interest(gateway, link, false);
+    printf("[网关] 已连接上游 %s（连接 %u）\n", upstream->name, (unsigned)(link - upstream->links));
+    drain_backlog(gateway, upstream);
+}
+
+/*
+ * 一帧上游响应：按事务标识符的低 6 位找回槽位，恢复主站的事务标识符后投递给主站和合并等待者；
+ * 期间没有转发过同一单元写请求的正常读响应写入缓存
+ */
+static void complete_slot(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link, uint8_t *frame,
+                          size_t length) {
+    uint16_t txid = (uint16_t)((frame[0] << 8) | frame[1]);
+    GatewaySlot *slot = &link->slots[txid & (GATEWAY_MAX_INFLIGHT - 1)];
+    if (!slot->active || slot->upstream_txid != txid) {
+        upstream->stale++;
+        return;
+    }
+    slot->active = false;
+    link->inflight--;
+    if (slot->client_fd < 0) {
+        upstream->stale++;  /* 主站已断开且没有等待者 */
+        return;
+    }
+    upstream->responses++;
+    upstream->latency_total_us += (monotonic_ns() - slot->sent_ns) / 1000ULL;
+    if (gateway->cache && slot->joinable && length > MODBUS_MBAP_HEADER_LENGTH &&
+        frame[MODBUS_MBAP_HEADER_LENGTH] == slot->function_code) {
+        cache_store(gateway, slot, &frame[MODBUS_MBAP_HEADER_LENGTH], length - MODBUS_MBAP_HEADER_LENGTH);
+    }
+    answer_request(gateway, upstream, slot->client_fd, slot->client_txid, slot->request_ns, slot->waiters,
+                   frame, length);
+}
+
+/*
+ * 读取上游响应并按 MBAP 分帧；无法识别的字节（例如调试版服务器的欢迎消息）逐字节跳过以重新同步
+ *
+ * 返回：
+ *   连接正常返回 true，对端关闭或出错返回 false
+ */
+static bool link_receive(Gateway *gateway, GatewayUpstream *upstream, GatewayLink *link) {
+    while (1) {
+        ssize_t n = recv(link->fd, link->rx + link->rx_length, sizeof(link->rx) - link->rx_length, 0);
+        if (n == 0) {
+            errno = ECONNRESET;
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        link->rx_length += (size_t)n;
+
+        size_t offset = 0;
+        while (offset < link->rx_length) {
+            int frame_length = modbus_tcp_frame_length(link->rx + offset, link->rx_length - offset);
+            if (frame_length < 0) {
+                offset++;
+                continue;
+            }
+            if (frame_length == 0 || (size_t)frame_length > link->rx_length - offset) {
+                break;
+            }
+            complete_slot(gateway, upstream, link, link->rx + offset, (size_t)frame_length);
+            offset += (size_t)frame_length;
+        }
+        memmove(link->rx, link->rx + offset, link->rx_length - offset);
+        link->rx_length -= offset;
+    }
+}
+
+/*
+ * 定时检查：重连到期的连接，判定连接和请求超时
+ */
+static void handle_timer(Gateway *gateway) {
+    uint64_t expirations;
+    if (read(gateway->timer_fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    uint64_t now = monotonic_ns();
+    uint64_t timeout_ns = (uint64_t)gateway->timeout_ms * 1000000ULL;
+
+    for (size_t u = 0; u < gateway->upstream_count; u++) {
+        GatewayUpstream *upstream = &gateway->upstreams[u];
+        for (uint32_t i = 0; i < upstream->link_count; i++) {
+            GatewayLink *link = &upstream->links[i];
+            if (link->state == GATEWAY_LINK_DOWN && now >= link->retry_ns) {
+                link_connect(gateway, upstream, link);
+            } else if (link->state == GATEWAY_LINK_CONNECTING && now - link->state_ns > timeout_ns) {
+                link_fail(gateway, upstream, link, "连接超时");
+            } else if (link->state == GATEWAY_LINK_UP) {
+                /* 请求超时说明上游已不响应，未写出的请求还留在发送缓冲区中：断开重连，在途请求回复异常 0B */
+                for (uint32_t s = 0; s < upstream->depth && link->inflight > 0; s++) {
+                    GatewaySlot *slot = &link->slots[s];
+                    if (slot->active && now - slot->sent_ns > timeout_ns) {
+                        link_fail(gateway, upstream, link, "请求超时");
+                        break;
+                    }
+                }
+            }
+        }
+
+        /* 等待队列按到达顺序排列，从队头淘汰等待过久的请求 */
+        while (upstream->backlog_count > 0) {
+            GatewayQueued *queued = &upstream->backlog[upstream->backlog_head];
+            if (queued->client_fd >= 0 && now - queued->request_ns <= timeout_ns) {
+                break;
+            }
+            upstream->backlog_head = (upstream->backlog_head + 1) % GATEWAY_BACKLOG;
+            upstream->backlog_count--;
+            if (queued->client_fd >= 0) {
+                upstream->timeouts++;
+                reply_queued_exception(gateway, upstream, queued, MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED);
+            }
+        }
+        drain_backlog(gateway, upstream);
+    }
+}
+
+/*
+ * 创建上游连接和超时定时器并发起连接
+ */
+bool gateway_start(Gateway *gateway, int epoll_fd, uint32_t timeout_ms, GatewayDeliverFunc deliver, void *context) {
+    if (gateway->upstream_count == 0) {
+        return true;
+    }
+    gateway->epoll_fd = epoll_fd;
+    gateway->timeout_ms = timeout_ms;
+    gateway->deliver = deliver;
+    gateway->context = context;
+    if (gateway->cache_rule_count > 0) {
+        gateway->cache = calloc(GATEWAY_CACHE_SETS * GATEWAY_CACHE_WAYS, sizeof(GatewayCacheEntry));
+        if (!gateway->cache) {
+            fprintf(stderr, "错误: 网关读缓存内存分配失败。\n");
+            return false;
+        }
+    }
+
+    gateway->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (gateway->timer_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = GATEWAY_TICK_MS * 1000000L;
+    spec.it_value = spec.it_interval;
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = gateway->timer_fd;
+    if (timerfd_settime(gateway->timer_fd, 0, &spec, NULL) < 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gateway->timer_fd, &event) < 0) {
+        perror("gateway timer");
+        return false;
+    }
+
+    for (size_t u = 0; u < gateway->upstream_count; u++) {
+        GatewayUpstream *upstream = &gateway->upstreams[u];
+        for (uint32_t i = 0; i < upstream->link_count; i++) {
+            link_connect(gateway, upstream, &upstream->links[i]);
+        }
+    }
+    return true;
+}
+
+/*
+ * 按描述符查找上游连接
+ */
+static GatewayLink *find_link(const Gateway *gateway, int fd, GatewayUpstream **upstream) {
+    for (size_t u = 0; u < gateway->upstream_count; u++) {
+        GatewayUpstream *candidate = (GatewayUpstream *)&gateway->upstreams[u];
+        for (uint32_t i = 0; i < candidate->link_count; i++) {
+            if (candidate->links[i].fd == fd) {
+                *upstream = candidate;
+                return &candidate->links[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 描述符是否属于网关（上游连接或定时器）
+ */
+bool gateway_owns_fd(const Gateway *gateway, int fd) {
+    GatewayUpstream *upstream = NULL;
+    return gateway->upstream_count > 0 && (fd == gateway->timer_fd || find_link(gateway, fd, &upstream));
+}
+
+/*
+ * 处理定时器到期或上游连接上的事件
+ */
+void gateway_handle_event(Gateway *gateway, int fd, uint32_t events) {
+    if (fd == gateway->timer_fd) {
+        handle_timer(gateway);
+        return;
+    }
+    GatewayUpstream *upstream = NULL;
+    GatewayLink *link = find_link(gateway, fd, &upstream);
+    if (!link) {
+        return;
+    }
+
+    if (link->state == GATEWAY_LINK_CONNECTING) {
+        link_connected(gateway, upstream, link);
+        return;
+    }
+    if ((events & EPOLLIN) && !link_receive(gateway, upstream, link)) {
+        link_fail(gateway, upstream, link, errno == ECONNRESET ? "上游关闭连接" : strerror(errno));
+        return;
+    }
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        link_fail(gateway, upstream, link, "上游关闭连接");
+        return;
+    }
+    if ((events & EPOLLOUT) && !link_flush(gateway, link)) {
+        link_fail(gateway, upstream, link, strerror(errno));
+        return;
+    }
+    drain_backlog(gateway, upstream);
+}
+
+/*
+ * 请求的主站断开后由第一个仍连接的等待者接替（响应仍要发往上游、分发给等待者）
+ *
+ * 返回：
+ *   接替的主站描述符，没有等待者返回 -1
+ */
+static int promote_waiter(GatewayUpstream *upstream, uint16_t *client_txid, uint64_t *request_ns, int32_t *waiters) {
+    while (*waiters >= 0) {
+        int32_t index = *waiters;
+        GatewayWaiter *waiter = &upstream->waiters[index];
+        int client_fd = waiter->client_fd;
+        *client_txid = waiter->client_txid;
+        *request_ns = waiter->request_ns;
+        *waiters = waiter->next;
+        waiter_free(upstream, index);
+        if (client_fd >= 0) {
+            return client_fd;
+        }
+    }
+    return -1;
+}
+
+/*
+ * 主站断开：丢弃它的合并等待，由它发起的在途和排队请求交给第一个等待者接管
+ */
+void gateway_client_closed(Gateway *gateway, int client_fd) {
+    for (size_t u = 0; u < gateway->upstream_count; u++) {
+        GatewayUpstream *upstream = &gateway->upstreams[u];
+        for (int32_t i = 0; i < GATEWAY_MAX_WAITERS; i++) {
+            if (upstream->waiters[i].client_fd == client_fd) {
+                upstream->waiters[i].client_fd = -1;
+            }
+        }
+        for (uint32_t i = 0; i < upstream->link_count; i++) {
+            GatewayLink *link = &upstream->links[i];
+            for (uint32_t s = 0; s < upstream->depth && link->inflight > 0; s++) {
+                GatewaySlot *slot = &link->slots[s];
+                if (slot->active && slot->client_fd == client_fd) {
+                    slot->client_fd = promote_waiter(upstream, &slot->client_txid, &slot->request_ns, &slot->waiters);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < upstream->backlog_count; i++) {
+            GatewayQueued *queued = &upstream->backlog[(upstream->backlog_head + i) % GATEWAY_BACKLOG];
+            if (queued->client_fd == client_fd) {
+                uint16_t client_txid = 0;
+                queued->client_fd = promote_waiter(upstream, &client_txid, &queued->request_ns, &queued->waiters);
+                queued->frame[0] = (uint8_t)(client_txid >> 8);
+                queued->frame[1] = (uint8_t)(client_txid & 0xFF);
+            }
+        }
+    }
+}
+
+/*
+ * 关闭全部上游连接和定时器并释放内存
+ */
+void gateway_close(Gateway *gateway) {
+    for (size_t u = 0; u < gateway->upstream_count; u++) {
+        GatewayUpstream *upstream = &gateway->upstreams[u];
+        for (uint32_t i = 0; i < upstream->link_count; i++) {
+            if (upstream->links[i].fd >= 0) {
+                close(upstream->links[i].fd);
+            }
+        }
+        free(upstream->links);
+        free(upstream->backlog);
+        free(upstream->waiters);
+    }
+    free(gateway->cache);
+    if (gateway->timer_fd >= 0) {
+        close(gateway->timer_fd);
+    }
+    gateway_init(gateway);
+}
@@ -0,0 +1,490 @@
+/*
+ * 寄存器值生成器实现（读取时惰性计算）
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "generator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+/* 随机游走一次最多补算的步数：长时间无人读取后再读，只补算最近的这些步 */
+#define GENERATOR_WALK_MAX_CATCHUP 4096
+
+/* M_PI 不属于 C99/POSIX 标准，这里自行定义 */
+#define GENERATOR_TWO_PI 6.283185307179586
+
+/* 回放文件的最大样本数 */
+#define GENERATOR_REPLAY_MAX_SAMPLES 1000000
+
+/*
+ * 读取 CLOCK_MONOTONIC 纳秒值
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * SplitMix64：由 (种子, 寄存器序号, 步数) 直接得到随机数，无需保存随机数发生器状态
+ */
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * 把浮点值四舍五入并限制在 16 位寄存器范围内
+ */
+static uint16_t to_register(double value) {
+    if (value <= 0.0) {
+        return 0;
+    }
+    if (value >= 65535.0) {
+        return 65535;
+    }
+    return (uint16_t)(value + 0.5);
+}
+
+/* ============= 时钟 ============= */
+
+/*
+ * 初始化生成器集合（时钟从 0 开始，倍速为 1）
+ */
+void generator_set_init(GeneratorSet *set) {
+    memset(set, 0, sizeof(*set));
+    set->clock_speed = 1.0;
+    set->clock_real_base_ns = monotonic_ns();
+    set->clock_virtual_base_ms = 0.0;
+}
+
+/*
+ * 读取生成器时钟（毫秒，按倍速折算）
+ */
+uint64_t generator_clock_now_ms(GeneratorSet *set) {
+    double elapsed_ms = (double)(monotonic_ns() - set->clock_real_base_ns) / 1e6;
+    return (uint64_t)(set->clock_virtual_base_ms + elapsed_ms * set->clock_speed);
+}
+
+/*
+ * 修改时钟倍速
+ */
+void generator_clock_set_speed(GeneratorSet *set, double speed) {
+    /* 以当前时刻为新的基准，之后按新倍速前进，时钟不会跳变 */
+    set->clock_virtual_base_ms = (double)generator_clock_now_ms(set);
+    set->clock_real_base_ns = monotonic_ns();
+    set->clock_speed = speed;
+}
+
+/*
+ * 时钟快进指定毫秒数
+ */
+void generator_clock_advance(GeneratorSet *set, uint64_t milliseconds) {
+    set->clock_virtual_base_ms += (double)milliseconds;
+}
+
+/* ============= 规格解析 ============= */
+
+/*
+ * 从文件读取回放样本（每行一个整数，忽略空行和 # 开头的注释）
+ */
+static bool load_samples(Generator *gen, const char *path, char *error, size_t error_size) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        snprintf(error, error_size, "无法打开回放文件 %s（%s）", path, strerror(errno));
+        return false;
+    }
+
+    size_t capacity = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0' || *p == '\n' || *p == '#') {
+            continue;
+        }
+        char *end = NULL;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < 0 || value > 65535 || gen->sample_count >= GENERATOR_REPLAY_MAX_SAMPLES) {
+            snprintf(error, error_size, "回放文件 %s 第 %zu 个样本无效", path, gen->sample_count + 1);
+            fclose(file);
+            return false;
+        }
+        if (gen->sample_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            uint16_t *samples = realloc(gen->samples, capacity * sizeof(uint16_t));
+            if (!samples) {
+                snprintf(error, error_size, "内存不足");
+                fclose(file);
+                return false;
+            }
+            gen->samples = samples;
+        }
+        gen->samples[gen->sample_count++] = (uint16_t)value;
+    }
+    fclose(file);
+
+    if (gen->sample_count == 0) {
+        snprintf(error, error_size, "回放文件 %s 中没有样本", path);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 解析一个 key=value 参数
+ */
+static bool parse_param(Generator *gen, char *param, char *error, size_t error_size) {
+    char *equals = strchr(param, '=');
+    if (!equals) {
+        snprintf(error, error_size, "参数 %s 缺少 '='", param);
+        return false;
+    }
+    *equals = '\0';
+    const char *key = param;
+    const char *text = equals + 1;
+
+    if (strcmp(key, "file") == 0) {
+        return load_samples(gen, text, error, error_size);
+    }
+
+    char *end = NULL;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0') {
+        snprintf(error, error_size, "参数 %s 的值 %s 不是数字", key, text);
+        return false;
+    }
+
+    if (strcmp(key, "value") == 0 || strcmp(key, "base") == 0) {
+        gen->value = value;
+    } else if (strcmp(key, "min") == 0) {
+        gen->minimum = value;
+    } else if (strcmp(key, "max") == 0) {
+        gen->maximum = value;
+    } else if (strcmp(key, "amp") == 0) {
+        gen->amplitude = value;
+    } else if (strcmp(key, "step") == 0) {
+        gen->step = value;
+    } else if (strcmp(key, "period") == 0 || strcmp(key, "interval") == 0) {
+        gen->period_ms = value > 0 ? (uint64_t)value : 0;
+    } else if (strcmp(key, "phase") == 0) {
+        gen->phase_ms = value > 0 ? (uint64_t)value : 0;
+    } else if (strcmp(key, "seed") == 0) {
+        gen->seed = (uint64_t)value;
+    } else {
+        snprintf(error, error_size, "未知参数 %s", key);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 解析规格字符串：<bank>:<start>[-<end>]:<type>[:<params>]
+ */
+static bool parse_spec(Generator *gen, const char *spec, uint32_t register_count, char *error, size_t error_size) {
+    char buffer[GENERATOR_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(buffer)) {
+        snprintf(error, error_size, "规格过长");
+        return false;
+    }
+    strcpy(buffer, spec);
+    snprintf(gen->spec, sizeof(gen->spec), "%s", spec);
+
+    /* 前三个字段以 ':' 分隔，其余部分整体作为参数列表（文件路径中允许出现 ':'） */
+    char *fields[4] = { buffer, NULL, NULL, NULL };
+    for (int i = 1; i < 4; i++) {
+        char *colon = strchr(fields[i - 1], ':');
+        if (!colon) {
+            break;
+        }
+        *colon = '\0';
+        fields[i] = colon + 1;
+    }
+    if (!fields[1] || !fields[2]) {
+        snprintf(error, error_size, "格式应为 <holding|input>:<地址>[-<地址>]:<类型>[:<参数>]");
+        return false;
+    }
+
+    if (strcmp(fields[0], "holding") == 0) {
+        gen->bank = GENERATOR_BANK_HOLDING;
+    } else if (strcmp(fields[0], "input") == 0) {
+        gen->bank = GENERATOR_BANK_INPUT;
+    } else {
+        snprintf(error, error_size, "未知寄存器组 %s", fields[0]);
+        return false;
+    }
+
+    char *end = NULL;
+    unsigned long first = strtoul(fields[1], &end, 10);
+    unsigned long last = first;
+    if (end != fields[1] && *end == '-') {
+        char *range_end = end + 1;
+        last = strtoul(range_end, &end, 10);
+        if (end == range_end) {
+            end = range_end - 1;
+        }
+    }
+    if (end == fields[1] || *end != '\0' || last < first || last >= register_count) {
+        snprintf(error, error_size, "地址范围 %s 无效（有效范围 0-%u）", fields[1], register_count - 1);
+        return false;
+    }
+    gen->start = (uint32_t)first;
+    gen->count = (uint32_t)(last - first + 1);
+
+    static const struct {
+        const char *name;
+        GeneratorType type;
+    } types[] = {
+        { "const", GENERATOR_CONSTANT },
+        { "ramp", GENERATOR_RAMP },
+        { "sine", GENERATOR_SINE },
+        { "walk", GENERATOR_RANDOM_WALK },
+        { "replay", GENERATOR_REPLAY },
+    };
+    bool type_found = false;
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcmp(fields[2], types[i].name) == 0) {
+            gen->type = types[i].type;
+            type_found = true;
+        }
+    }
+    if (!type_found) {
+        snprintf(error, error_size, "未知生成器类型 %s（支持 const/ramp/sine/walk/replay）", fields[2]);
+        return false;
+    }
+
+    /* 默认参数 */
+    gen->minimum = 0.0;
+    gen->maximum = 65535.0;
+    gen->period_ms = 1000;
+    gen->step = 1.0;
+
+    if (fields[3]) {
+        char *saveptr = NULL;
+        for (char *param = strtok_r(fields[3], ",", &saveptr); param; param = strtok_r(NULL, ",", &saveptr)) {
+            if (!parse_param(gen, param, error, error_size)) {
+                return false;
+            }
+        }
+    }
+
+    if (gen->period_ms == 0) {
+        snprintf(error, error_size, "period/interval 必须大于 0");
+        return false;
+    }
+    if (gen->type == GENERATOR_REPLAY && gen->sample_count == 0) {
+        snprintf(error, error_size, "replay 生成器需要 file 参数");
+        return false;
+    }
+    if (gen->type == GENERATOR_RAMP && gen->maximum < gen->minimum) {
+        snprintf(error, error_size, "ramp 的 max 不能小于 min");
+        return false;
+    }
+
+    if (gen->type == GENERATOR_RANDOM_WALK) {
+        gen->walk_values = malloc(gen->count * sizeof(uint16_t));
+        gen->walk_steps = calloc(gen->count, sizeof(uint64_t));
+        if (!gen->walk_values || !gen->walk_steps) {
+            snprintf(error, error_size, "内存不足");
+            return false;
+        }
+        for (uint32_t i = 0; i < gen->count; i++) {
+            gen->walk_values[i] = to_register(gen->value);
+        }
+    }
+    return true;
+}
+
+/*
+ * 释放单个生成器持有的内存
+ */
+static void generator_free(Generator *gen) {
+    free(gen->samples);
+    free(gen->walk_values);
+    free(gen->walk_steps);
+}
+
+/*
+ * 找到第一个 (bank, 结束地址) 不小于给定值的生成器位置（集合有序且互不重叠）
+ */
+static size_t lower_bound(const GeneratorSet *set, GeneratorBank bank, uint32_t address) {
+    size_t low = 0;
+    size_t high = set->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const Generator *gen = &set->items[mid];
+        if (gen->bank < bank || (gen->bank == bank && gen->start + gen->count <= address)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * 解析规格并按 (寄存器类型, 起始地址) 有序插入生成器，拒绝地址范围重叠
+ */
+bool generator_set_add(GeneratorSet *set, const char *spec, uint32_t register_count,
+                       char *error, size_t error_size) {
+    Generator gen;
+    memset(&gen, 0, sizeof(gen));
+    if (!parse_spec(&gen, spec, register_count, error, error_size)) {
+        generator_free(&gen);
+        return false;
+    }
+
+    size_t position = lower_bound(set, gen.bank, gen.start);
+    if (position < set->count && set->items[position].bank == gen.bank &&
+        set->items[position].start < gen.start + gen.count) {
+        snprintf(error, error_size, "与已有生成器 %s 的地址范围重叠", set->items[position].spec);
+        generator_free(&gen);
+        return false;
+    }
+
+    if (set->count == set->capacity) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 16;
+        Generator *items = realloc(set->items, capacity * sizeof(Generator));
+        if (!items) {
+            snprintf(error, error_size, "内存不足");
+            generator_free(&gen);
+            return false;
+        }
+        set->items = items;
+        set->capacity = capacity;
+    }
+    memmove(&set->items[position + 1], &set->items[position], (set->count - position) * sizeof(Generator));
+    set->items[position] = gen;
+    set->count++;
+    return true;
+}
+
+/*
+ * 释放全部生成器，保留数组容量
+ */
+void generator_set_clear(GeneratorSet *set) {
+    for (size_t i = 0; i < set->count; i++) {
+        generator_free(&set->items[i]);
+    }
+    set->count = 0;
+}
+
+/*
+ * 交换两个集合中的生成器（时钟不变）
+ */
+void generator_set_swap_items(GeneratorSet *set, GeneratorSet *other) {
+    Generator *items = set->items;
+    size_t count = set->count;
+    size_t capacity = set->capacity;
+    set->items = other->items;
+    set->count = other->count;
+    set->capacity = other->capacity;
+    other->items = items;
+    other->count = count;
+    other->capacity = capacity;
+}
+
+/*
+ * 释放全部生成器和数组
+ */
+void generator_set_free(GeneratorSet *set) {
+    generator_set_clear(set);
+    free(set->items);
+    set->items = NULL;
+    set->capacity = 0;
+}
+
+/* ============= 惰性求值 ============= */
+
+/*
+ * 计算生成器中第 index 个寄存器在时刻 now_ms 的值
+ */
+static uint16_t evaluate(Generator *gen, uint32_t index, uint64_t now_ms) {
+    uint64_t t = now_ms + (uint64_t)index * gen->phase_ms;
+
+    switch (gen->type) {
+        case GENERATOR_CONSTANT:
+            return to_register(gen->value);
+
+        case GENERATOR_RAMP: {
+            double fraction = (double)(t % gen->period_ms) / (double)gen->period_ms;
+            return to_register(gen->minimum + (gen->maximum - gen->minimum) * fraction);
+        }
+
+        case GENERATOR_SINE: {
+            double angle = GENERATOR_TWO_PI * (double)(t % gen->period_ms) / (double)gen->period_ms;
+            return to_register(gen->value + gen->amplitude * sin(angle));
+        }
+
+        case GENERATOR_RANDOM_WALK: {
+            /* 只在被读取时补算自上次读取以来经过的步数 */
+            uint64_t target = t / gen->period_ms;
+            uint64_t step = gen->walk_steps[index];
+            if (target <= step) {
+                return gen->walk_values[index];
+            }
+            if (target - step > GENERATOR_WALK_MAX_CATCHUP) {
+                step = target - GENERATOR_WALK_MAX_CATCHUP;
+            }
+            double value = gen->walk_values[index];
+            for (; step < target; step++) {
+                uint64_t r = splitmix64(gen->seed ^ splitmix64(((uint64_t)index << 40) ^ step));
+                double delta = ((double)(r >> 11) / 9007199254740992.0 * 2.0 - 1.0) * gen->step;
+                value += delta;
+                if (value < gen->minimum) {
+                    value = gen->minimum;
+                } else if (value > gen->maximum) {
+                    value = gen->maximum;
+                }
+            }
+            gen->walk_values[index] = to_register(value);
+            gen->walk_steps[index] = target;
+            return gen->walk_values[index];
+        }
+
+        case GENERATOR_REPLAY:
+            return gen->samples[(t / gen->period_ms) % gen->sample_count];
+    }
+    return 0;
+}
+
+/*
+ * 用生成器在当前时刻的值覆盖读取结果中落在其范围内的寄存器
+ */
+void generator_set_apply(GeneratorSet *set, GeneratorBank bank, uint32_t start, uint32_t count, uint16_t *values) {
+    if (set->count == 0) {
+        return;
+    }
+
+    uint32_t end = start + count;
+    uint64_t now_ms = 0;
+    bool clock_read = false;
+
+    for (size_t i = lower_bound(set, bank, start); i < set->count; i++) {
+        Generator *gen = &set->items[i];
+        if (gen->bank != bank || gen->start >= end) {
+            break;
+        }
+        if (!clock_read) {
+            now_ms = generator_clock_now_ms(set);
+            clock_read = true;
+        }
+
+        uint32_t first = gen->start > start ? gen->start : start;
+        uint32_t last = gen->start + gen->count < end ? gen->start + gen->count : end;
+        for (uint32_t address = first; address < last; address++) {
+            values[address - start] = evaluate(gen, address - gen->start, now_ms);
+        }
+        set->evaluations += last - first;
+    }
+}
@@ -0,0 +1,226 @@
+/*
+ * 寄存器访问热度统计实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "heatmap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/* 热度图每行的寄存器数，与寄存器组的页大小一致，一行即一页 */
+#define HEATMAP_ROW_REGISTERS 64
+
+/* 热度字符，从无访问到最热 */
+static const char HEAT_LEVELS[] = " .:-=+*#%@";
+
+/*
+ * 读取指定时钟的纳秒值
+ */
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 初始化热度统计，为每类寄存器分配读、写计数器
+ */
+bool heatmap_init(AccessHeatmap *map, uint32_t register_count) {
+    memset(map, 0, sizeof(*map));
+    map->register_count = register_count;
+    for (int bank = 0; bank < HEATMAP_BANK_COUNT; bank++) {
+        map->reads[bank] = calloc(register_count ? register_count : 1, sizeof(uint64_t));
+        map->writes[bank] = calloc(register_count ? register_count : 1, sizeof(uint64_t));
+        if (!map->reads[bank] || !map->writes[bank]) {
+            heatmap_destroy(map);
+            return false;
+        }
+    }
+    map->started_ns = clock_ns(CLOCK_MONOTONIC);
+    return true;
+}
+
+/*
+ * 释放计数器
+ */
+void heatmap_destroy(AccessHeatmap *map) {
+    for (int bank = 0; bank < HEATMAP_BANK_COUNT; bank++) {
+        free(map->reads[bank]);
+        free(map->writes[bank]);
+        map->reads[bank] = NULL;
+        map->writes[bank] = NULL;
+    }
+}
+
+/*
+ * 清零全部计数并重新开始计时
+ */
+void heatmap_reset(AccessHeatmap *map) {
+    for (int bank = 0; bank < HEATMAP_BANK_COUNT; bank++) {
+        memset(map->reads[bank], 0, map->register_count * sizeof(uint64_t));
+        memset(map->writes[bank], 0, map->register_count * sizeof(uint64_t));
+    }
+    map->started_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+/*
+ * 累加一段寄存器的读取次数
+ */
+void heatmap_record_read(AccessHeatmap *map, HeatmapBank bank, uint32_t start, uint32_t count) {
+    uint64_t *counters = map->reads[bank] + start;
+    for (uint32_t i = 0; i < count; i++) {
+        counters[i]++;
+    }
+}
+
+/*
+ * 累加一段寄存器的写入次数
+ */
+void heatmap_record_write(AccessHeatmap *map, HeatmapBank bank, uint32_t start, uint32_t count) {
+    uint64_t *counters = map->writes[bank] + start;
+    for (uint32_t i = 0; i < count; i++) {
+        counters[i]++;
+    }
+}
+
+/*
+ * 把一个范围按访问次数插入有序的前 N 名列表
+ */
+static void insert_range(HeatRange *ranges, size_t *count, size_t max_ranges, const HeatRange *range) {
+    uint64_t total = range->reads + range->writes;
+    size_t position = *count;
+    while (position > 0 && ranges[position - 1].reads + ranges[position - 1].writes < total) {
+        position--;
+    }
+    if (position >= max_ranges) {
+        return;
+    }
+    size_t moved = (*count < max_ranges ? *count : max_ranges - 1) - position;
+    memmove(&ranges[position + 1], &ranges[position], moved * sizeof(HeatRange));
+    ranges[position] = *range;
+    if (*count < max_ranges) {
+        (*count)++;
+    }
+}
+
+/*
+ * 把相邻的被访问寄存器合并成范围，按访问次数取前 N 名
+ */
+size_t heatmap_top_ranges(const AccessHeatmap *map, HeatRange *ranges, size_t max_ranges) {
+    size_t count = 0;
+    if (max_ranges == 0) {
+        return 0;
+    }
+
+    /* 相邻且都被访问过的寄存器合并为一个范围 */
+    for (int bank = 0; bank < HEATMAP_BANK_COUNT; bank++) {
+        const uint64_t *reads = map->reads[bank];
+        const uint64_t *writes = map->writes[bank];
+        uint32_t address = 0;
+        while (address < map->register_count) {
+            if (reads[address] == 0 && writes[address] == 0) {
+                address++;
+                continue;
+            }
+            HeatRange range = { (HeatmapBank)bank, address, 0, 0, 0 };
+            while (address < map->register_count && (reads[address] != 0 || writes[address] != 0)) {
+                range.reads += reads[address];
+                range.writes += writes[address];
+                range.count++;
+                address++;
+            }
+            insert_range(ranges, &count, max_ranges, &range);
+        }
+    }
+    return count;
+}
+
+/*
+ * 数值的二进制位数（0 的位数为 0），用作对数刻度
+ */
+static unsigned int bit_length(uint64_t value) {
+    return value ? 64u - (unsigned int)__builtin_clzll(value) : 0u;
+}
+
+/*
+ * 以字符热度图打印一类寄存器（每行 64 个，对数刻度，跳过没有访问的行）
+ */
+void heatmap_print(const AccessHeatmap *map, HeatmapBank bank, FILE *out) {
+    const uint64_t *reads = map->reads[bank];
+    const uint64_t *writes = map->writes[bank];
+
+    uint64_t maximum = 0;
+    for (uint32_t i = 0; i < map->register_count; i++) {
+        if (reads[i] + writes[i] > maximum) {
+            maximum = reads[i] + writes[i];
+        }
+    }
+    unsigned int max_bits = bit_length(maximum);
+    unsigned int top_level = (unsigned int)(sizeof(HEAT_LEVELS) - 2);
+
+    fprintf(out, "%s（最高 %llu 次，刻度 \"%s\"）：\n",
+            bank == HEATMAP_BANK_INPUT ? "输入寄存器" : "保持寄存器",
+            (unsigned long long)maximum, HEAT_LEVELS);
+    if (maximum == 0) {
+        return;
+    }
+
+    for (uint32_t row = 0; row < map->register_count; row += HEATMAP_ROW_REGISTERS) {
+        uint32_t end = row + HEATMAP_ROW_REGISTERS < map->register_count ? row + HEATMAP_ROW_REGISTERS
+                                                                         : map->register_count;
+        char line[HEATMAP_ROW_REGISTERS + 1];
+        bool touched = false;
+        for (uint32_t address = row; address < end; address++) {
+            unsigned int bits = bit_length(reads[address] + writes[address]);
+            unsigned int level = bits ? 1 + (bits - 1) * (top_level - 1) / (max_bits > 1 ? max_bits - 1 : 1) : 0;
+            line[address - row] = HEAT_LEVELS[level];
+            touched = touched || bits;
+        }
+        line[end - row] = '\0';
+        if (touched) {
+            fprintf(out, "  %5u |%s|\n", row, line);
+        }
+    }
+}
+
+/*
+ * 把计数器导出到文件（临时文件 + rename）
+ */
+bool heatmap_dump(const AccessHeatmap *map, const char *path) {
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "[热度] 错误：无法创建 %s（%s）\n", temp_path, strerror(errno));
+        return false;
+    }
+
+    HeatmapFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = HEATMAP_MAGIC;
+    header.version = HEATMAP_VERSION;
+    header.byte_order_mark = HEATMAP_BYTE_ORDER_MARK;
+    header.register_count = map->register_count;
+    header.elapsed_ms = (clock_ns(CLOCK_MONOTONIC) - map->started_ns) / 1000000ULL;
+    header.timestamp_ns = clock_ns(CLOCK_REALTIME);
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int bank = 0; ok && bank < HEATMAP_BANK_COUNT; bank++) {
+        ok = fwrite(map->reads[bank], sizeof(uint64_t), map->register_count, file) == map->register_count &&
+             fwrite(map->writes[bank], sizeof(uint64_t), map->register_count, file) == map->register_count;
+    }
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temp_path, path) < 0) {
+        fprintf(stderr, "[热度] 错误：写入 %s 失败（%s）\n", path, strerror(errno));
+        unlink(temp_path);
+        return false;
+    }
+    return true;
+}
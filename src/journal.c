@@ -0,0 +1,281 @@
+/*
+ * 寄存器写入日志实现（预写日志 + 组提交）
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "journal.h"
+#include "modbus_rtu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* 记录中参与 CRC 计算的字节数（checksum 字段之前的部分） */
+#define JOURNAL_RECORD_CHECKED_BYTES offsetof(JournalRecord, checksum)
+
+/*
+ * 读取指定时钟的纳秒值
+ */
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 写入全部数据（处理部分写入和 EINTR）
+ */
+static bool write_all(int fd, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+/*
+ * 重放已有日志，返回有效数据的结束偏移；文件头无效时返回 0
+ */
+static size_t replay_records(const uint8_t *data, size_t size, const char *path, uint32_t register_count,
+                             uint64_t after_sequence, JournalApplyFunc apply, void *context,
+                             uint64_t *last_sequence, uint64_t *replayed) {
+    JournalHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION ||
+        header.byte_order_mark != JOURNAL_BYTE_ORDER_MARK) {
+        fprintf(stderr, "[日志] 错误：%s 不是当前版本的寄存器写入日志\n", path);
+        return 0;
+    }
+    if (header.register_count != register_count) {
+        fprintf(stderr, "[日志] 错误：%s 记录的是 %u 个寄存器，与当前配置的 %u 个不一致\n",
+                path, header.register_count, register_count);
+        return 0;
+    }
+
+    size_t offset = sizeof(JournalHeader);
+    while (offset + sizeof(JournalRecord) <= size) {
+        JournalRecord record;
+        memcpy(&record, data + offset, sizeof(record));
+        if (!journal_record_valid(&record) ||
+            (*last_sequence != 0 && record.sequence != *last_sequence + 1)) {
+            break;
+        }
+        if (record.sequence > after_sequence && record.address < register_count) {
+            apply(&record, context);
+            (*replayed)++;
+        }
+        *last_sequence = record.sequence;
+        offset += sizeof(JournalRecord);
+    }
+    return offset;
+}
+
+/*
+ * 打开日志并重放
+ */
+bool journal_open(Journal *journal, const char *path, uint32_t register_count, uint32_t group_window_ms,
+                  uint64_t after_sequence, JournalApplyFunc apply, void *context, uint64_t *replayed) {
+    journal->fd = -1;
+    journal->buffered = 0;
+    journal->group_window_ms = group_window_ms;
+    journal->records = 0;
+    journal->commits = 0;
+    journal->largest_group = 0;
+    journal->commit_usec_total = 0;
+    *replayed = 0;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[日志] 错误：无法打开 %s（%s）\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        close(fd);
+        return false;
+    }
+
+    uint64_t last_sequence = 0;
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        /* 新日志：写入文件头 */
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = JOURNAL_MAGIC;
+        header.version = JOURNAL_VERSION;
+        header.byte_order_mark = JOURNAL_BYTE_ORDER_MARK;
+        header.register_count = register_count;
+        if (!write_all(fd, &header, sizeof(header)) || fdatasync(fd) < 0) {
+            perror("write");
+            close(fd);
+            return false;
+        }
+    } else if (size < sizeof(JournalHeader)) {
+        fprintf(stderr, "[日志] 错误：%s 文件头不完整\n", path);
+        close(fd);
+        return false;
+    } else {
+        /* 已有日志：整个文件映射进来顺序扫描，没有逐条 read() 的系统调用开销 */
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return false;
+        }
+        posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+        size_t valid_end = replay_records(map, size, path, register_count, after_sequence,
+                                          apply, context, &last_sequence, replayed);
+        munmap(map, size);
+        if (valid_end == 0) {
+            close(fd);
+            return false;
+        }
+
+        /* 截断崩溃时写了一半（或校验失败）的尾部，之后的追加从有效位置继续 */
+        if (valid_end < size) {
+            fprintf(stderr, "[日志] 警告：%s 尾部 %zu 字节无效（可能是崩溃时未写完），已截断\n",
+                    path, size - valid_end);
+            if (ftruncate(fd, (off_t)valid_end) < 0) {
+                perror("ftruncate");
+                close(fd);
+                return false;
+            }
+        }
+    }
+
+    /* 快照可能比日志更新（例如日志被删除后重建），序列号始终保持递增 */
+    journal->next_sequence = (last_sequence > after_sequence ? last_sequence : after_sequence) + 1;
+    journal->fd = fd;
+    return true;
+}
+
+/*
+ * 填写一条写入记录
+ */
+void journal_fill_record(JournalRecord *record, uint64_t sequence, uint8_t bank, uint8_t unit_id,
+                         uint16_t address, uint16_t value) {
+    memset(record, 0, sizeof(*record));
+    record->sequence = sequence;
+    record->timestamp_ns = clock_ns(CLOCK_REALTIME);
+    record->address = address;
+    record->value = value;
+    record->unit_id = unit_id;
+    record->bank = bank;
+    record->checksum = modbus_rtu_crc16((const uint8_t *)record, JOURNAL_RECORD_CHECKED_BYTES);
+}
+
+/*
+ * 记录的 CRC16 是否正确
+ */
+bool journal_record_valid(const JournalRecord *record) {
+    return record->checksum == modbus_rtu_crc16((const uint8_t *)record, JOURNAL_RECORD_CHECKED_BYTES);
+}
+
+/*
+ * 追加一条写入记录
+ */
+void journal_append(Journal *journal, uint8_t unit_id, uint16_t address, uint16_t value) {
+    if (journal->fd < 0) {
+        return;
+    }
+    if (journal->buffered + sizeof(JournalRecord) > JOURNAL_BUFFER_SIZE) {
+        journal_commit(journal);
+    }
+
+    JournalRecord record;
+    journal_fill_record(&record, journal->next_sequence++, JOURNAL_BANK_HOLDING, unit_id, address, value);
+
+    if (journal->buffered == 0) {
+        journal->first_pending_ns = clock_ns(CLOCK_MONOTONIC);
+    }
+    memcpy(journal->buffer + journal->buffered, &record, sizeof(record));
+    journal->buffered += sizeof(record);
+    journal->records++;
+}
+
+/*
+ * 是否应当提交
+ */
+bool journal_commit_due(Journal *journal) {
+    if (journal->fd < 0 || journal->buffered == 0) {
+        return false;
+    }
+    if (journal->group_window_ms == 0 || journal->buffered >= JOURNAL_GROUP_COMMIT_BYTES) {
+        return true;
+    }
+    return clock_ns(CLOCK_MONOTONIC) - journal->first_pending_ns >= (uint64_t)journal->group_window_ms * 1000000ULL;
+}
+
+/*
+ * 距离下一次必须提交的毫秒数
+ */
+int journal_timeout_ms(Journal *journal) {
+    if (journal->fd < 0 || journal->buffered == 0) {
+        return -1;
+    }
+    uint64_t elapsed_ms = (clock_ns(CLOCK_MONOTONIC) - journal->first_pending_ns) / 1000000ULL;
+    if (elapsed_ms >= journal->group_window_ms) {
+        return 0;
+    }
+    return (int)(journal->group_window_ms - elapsed_ms);
+}
+
+/*
+ * 提交全部未提交记录
+ */
+bool journal_commit(Journal *journal) {
+    if (journal->fd < 0 || journal->buffered == 0) {
+        return true;
+    }
+
+    uint64_t begin_ns = clock_ns(CLOCK_MONOTONIC);
+    bool ok = write_all(journal->fd, journal->buffer, journal->buffered) && fdatasync(journal->fd) == 0;
+    if (!ok) {
+        fprintf(stderr, "[日志] 错误：提交失败（%s），%zu 条记录可能丢失\n",
+                strerror(errno), journal->buffered / sizeof(JournalRecord));
+    }
+
+    uint64_t group = journal->buffered / sizeof(JournalRecord);
+    if (group > journal->largest_group) {
+        journal->largest_group = group;
+    }
+    journal->commits++;
+    journal->commit_usec_total += (clock_ns(CLOCK_MONOTONIC) - begin_ns) / 1000;
+    journal->buffered = 0;
+    return ok;
+}
+
+/*
+ * 最后一条已追加记录的序列号
+ */
+uint64_t journal_last_sequence(const Journal *journal) {
+    return journal->fd < 0 ? 0 : journal->next_sequence - 1;
+}
+
+/*
+ * 提交剩余记录并关闭日志
+ */
+void journal_close(Journal *journal) {
+    if (journal->fd < 0) {
+        return;
+    }
+    journal_commit(journal);
+    close(journal->fd);
+    journal->fd = -1;
+}
@@ -0,0 +1,209 @@
+/*
+ * 运行指标实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+/* 线性区间的桶数（1..8 微秒）与每个 2 的幂区间的子桶数（2 位） */
+#define LINEAR_BUCKETS 8
+#define SUB_BUCKET_BITS 2
+
+/* HTTP 请求行缓冲区大小 */
+#define HTTP_REQUEST_SIZE 1024
+
+/*
+ * 读取单调时钟（纳秒）
+ */
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 清零全部指标并记录启动时刻
+ */
+void metrics_init(ServerMetrics *metrics) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->started_ns = metrics_now_ns();
+}
+
+/*
+ * 延迟（微秒，向上取整）所在的桶：上界不小于该值的第一个桶
+ */
+static size_t bucket_index(uint64_t micros) {
+    if (micros <= LINEAR_BUCKETS) {
+        return micros ? (size_t)(micros - 1) : 0;
+    }
+    uint64_t value = micros - 1;
+    unsigned int octave = 63u - (unsigned int)__builtin_clzll(value);
+    size_t sub = (size_t)(value >> (octave - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+    size_t index = LINEAR_BUCKETS + (size_t)(octave - 3) * (1u << SUB_BUCKET_BITS) + sub;
+    return index < METRICS_LATENCY_BUCKETS ? index : METRICS_LATENCY_BUCKETS;
+}
+
+/*
+ * 延迟桶的上界（微秒）
+ */
+uint64_t metrics_bucket_bound_us(size_t index) {
+    if (index < LINEAR_BUCKETS) {
+        return index + 1;
+    }
+    unsigned int octave = 3u + (unsigned int)((index - LINEAR_BUCKETS) >> SUB_BUCKET_BITS);
+    uint64_t sub = ((index - LINEAR_BUCKETS) & ((1u << SUB_BUCKET_BITS) - 1)) + 1;
+    return (1ULL << octave) + (sub << (octave - SUB_BUCKET_BITS));
+}
+
+/*
+ * 记录一次请求的功能码、异常码和处理延迟
+ */
+void metrics_record_request(ServerMetrics *metrics, uint8_t function_code, uint8_t exception_code,
+                            uint64_t latency_ns) {
+    FunctionMetrics *function = &metrics->functions[function_code & 0x7F];
+    function->requests++;
+    if (exception_code != 0) {
+        function->exceptions[exception_code < METRICS_EXCEPTION_CODES ? exception_code : 0]++;
+    }
+    function->latency_buckets[bucket_index((latency_ns + 999) / 1000)]++;
+    function->latency_sum_ns += latency_ns;
+}
+
+/*
+ * 以 Prometheus 文本格式输出全部指标
+ */
+void metrics_write_prometheus(const ServerMetrics *metrics, FILE *out, int active_connections) {
+    const size_t function_count = sizeof(metrics->functions) / sizeof(metrics->functions[0]);
+
+    fprintf(out, "# HELP modbus_requests_total 已应答的 Modbus 请求数\n");
+    fprintf(out, "# TYPE modbus_requests_total counter\n");
+    for (size_t fc = 0; fc < function_count; fc++) {
+        if (metrics->functions[fc].requests) {
+            fprintf(out, "modbus_requests_total{function=\"0x%02zX\"} %llu\n",
+                    fc, (unsigned long long)metrics->functions[fc].requests);
+        }
+    }
+
+    fprintf(out, "# HELP modbus_exceptions_total 按功能码和异常码分类的异常响应数\n");
+    fprintf(out, "# TYPE modbus_exceptions_total counter\n");
+    for (size_t fc = 0; fc < function_count; fc++) {
+        for (size_t code = 0; code < METRICS_EXCEPTION_CODES; code++) {
+            if (metrics->functions[fc].exceptions[code]) {
+                fprintf(out, "modbus_exceptions_total{function=\"0x%02zX\",code=\"%zu\"} %llu\n",
+                        fc, code, (unsigned long long)metrics->functions[fc].exceptions[code]);
+            }
+        }
+    }
+
+    fprintf(out, "# HELP modbus_request_duration_seconds 从帧到达到响应写出的耗时\n");
+    fprintf(out, "# TYPE modbus_request_duration_seconds histogram\n");
+    for (size_t fc = 0; fc < function_count; fc++) {
+        const FunctionMetrics *function = &metrics->functions[fc];
+        if (!function->requests) {
+            continue;
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+            cumulative += function->latency_buckets[i];
+            uint64_t bound = metrics_bucket_bound_us(i);
+            fprintf(out, "modbus_request_duration_seconds_bucket{function=\"0x%02zX\",le=\"%llu.%06llu\"} %llu\n",
+                    fc, (unsigned long long)(bound / 1000000), (unsigned long long)(bound % 1000000),
+                    (unsigned long long)cumulative);
+        }
+        cumulative += function->latency_buckets[METRICS_LATENCY_BUCKETS];
+        fprintf(out, "modbus_request_duration_seconds_bucket{function=\"0x%02zX\",le=\"+Inf\"} %llu\n",
+                fc, (unsigned long long)cumulative);
+        fprintf(out, "modbus_request_duration_seconds_sum{function=\"0x%02zX\"} %.9f\n",
+                fc, (double)function->latency_sum_ns / 1e9);
+        fprintf(out, "modbus_request_duration_seconds_count{function=\"0x%02zX\"} %llu\n",
+                fc, (unsigned long long)cumulative);
+    }
+
+    fprintf(out, "# HELP modbus_received_bytes_total 从客户端和串口线路读到的字节数\n");
+    fprintf(out, "# TYPE modbus_received_bytes_total counter\n");
+    fprintf(out, "modbus_received_bytes_total %llu\n", (unsigned long long)metrics->bytes_received);
+    fprintf(out, "# HELP modbus_sent_bytes_total 写给客户端和串口线路的字节数\n");
+    fprintf(out, "# TYPE modbus_sent_bytes_total counter\n");
+    fprintf(out, "modbus_sent_bytes_total %llu\n", (unsigned long long)metrics->bytes_sent);
+    fprintf(out, "# HELP modbus_connections_opened_total 接受的客户端连接数\n");
+    fprintf(out, "# TYPE modbus_connections_opened_total counter\n");
+    fprintf(out, "modbus_connections_opened_total %llu\n", (unsigned long long)metrics->connections_opened);
+    fprintf(out, "# HELP modbus_connections_closed_total 断开的客户端连接数\n");
+    fprintf(out, "# TYPE modbus_connections_closed_total counter\n");
+    fprintf(out, "modbus_connections_closed_total %llu\n", (unsigned long long)metrics->connections_closed);
+    fprintf(out, "# HELP modbus_connections 当前客户端连接数\n");
+    fprintf(out, "# TYPE modbus_connections gauge\n");
+    fprintf(out, "modbus_connections %d\n", active_connections);
+    fprintf(out, "# HELP modbus_uptime_seconds 服务器运行时长\n");
+    fprintf(out, "# TYPE modbus_uptime_seconds gauge\n");
+    fprintf(out, "modbus_uptime_seconds %.3f\n", (double)(metrics_now_ns() - metrics->started_ns) / 1e9);
+    fprintf(out, "# HELP modbus_metrics_scrapes_total 已写完的指标抓取响应数\n");
+    fprintf(out, "# TYPE modbus_metrics_scrapes_total counter\n");
+    fprintf(out, "modbus_metrics_scrapes_total %llu\n", (unsigned long long)metrics->scrapes);
+    fprintf(out, "# HELP modbus_metrics_scrape_timeouts_total 超过期限被关闭的抓取连接数\n");
+    fprintf(out, "# TYPE modbus_metrics_scrape_timeouts_total counter\n");
+    fprintf(out, "modbus_metrics_scrape_timeouts_total %llu\n", (unsigned long long)metrics->scrape_timeouts);
+}
+
+/*
+ * 读取指标抓取连接上的 HTTP 请求，请求头完整后生成响应（GET /metrics 返回指标，其余路径 404）
+ */
+MetricsHttpStatus metrics_read_http(const ServerMetrics *metrics, int fd, int active_connections,
+                                    char **response, size_t *response_length, bool *found) {
+    /* 先窥视数据，请求头完整（或缓冲区已满）后才取出，避免关闭连接时仍有未读数据而触发 RST */
+    char request[HTTP_REQUEST_SIZE];
+    ssize_t n_read = recv(fd, request, sizeof(request) - 1, MSG_PEEK);
+    if (n_read < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? METRICS_HTTP_PENDING : METRICS_HTTP_CLOSED;
+    }
+    if (n_read == 0) {
+        return METRICS_HTTP_CLOSED;
+    }
+    request[n_read] = '\0';
+    if (!strstr(request, "\r\n\r\n") && (size_t)n_read < sizeof(request) - 1) {
+        return METRICS_HTTP_PENDING;
+    }
+    if (read(fd, request, (size_t)n_read) != n_read) {
+        return METRICS_HTTP_CLOSED;
+    }
+
+    /* 只看请求行：GET /metrics（允许带查询参数） */
+    *found = strncmp(request, "GET /metrics", 12) == 0 &&
+             (request[12] == ' ' || request[12] == '?');
+
+    char *body = NULL;
+    size_t body_length = 0;
+    FILE *stream = open_memstream(&body, &body_length);
+    if (!stream) {
+        return METRICS_HTTP_CLOSED;
+    }
+    if (*found) {
+        metrics_write_prometheus(metrics, stream, active_connections);
+    } else {
+        fprintf(stream, "not found, try /metrics\n");
+    }
+    fclose(stream);
+
+    /* 响应头在前，与响应体拼成一个缓冲区 */
+    stream = open_memstream(response, response_length);
+    if (!stream) {
+        free(body);
+        return METRICS_HTTP_CLOSED;
+    }
+    fprintf(stream, "HTTP/1.1 %s\r\n"
+                    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                    "Content-Length: %zu\r\n"
+                    "Connection: close\r\n\r\n",
+            *found ? "200 OK" : "404 Not Found", body_length);
+    fwrite(body, 1, body_length, stream);
+    fclose(stream);
+    free(body);
+    return METRICS_HTTP_READY;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "modbus.h"
+#include "trace.h"
 #include <string.h>
 #include <arpa/inet.h>
 
@@ -65,6 +66,7 @@ static bool parse_mbap_header(const uint8_t *buffer, size_t length, ModbusMBAPHe
  */
 static void build_mbap_header(uint8_t *buffer, uint16_t transaction_id,
                              uint16_t length, uint8_t unit_id) {
+    TRACE_PROBE2(encode, transaction_id, length);
     write_uint16_be(&buffer[0], transaction_id);        /* 字节0-1：事务ID */
     write_uint16_be(&buffer[2], MODBUS_PROTOCOL_ID);    /* 字节2-3：协议ID（0x0000） */
     write_uint16_be(&buffer[4], length);                /* 字节4-5：后续长度 */
@@ -74,9 +76,9 @@ static void build_mbap_header(uint8_t *buffer, uint16_t transaction_id,
 /* ============= 请求解析函数 ============= */
 
 /*
- * 解析 Modbus TCP 请求消息
+ * 解析 MBAP 请求帧（modbus_parse_request 的实现，不含跟踪点）
  */
-bool modbus_parse_request(const uint8_t *buffer, size_t length, ModbusTCPMessage *message) {
+static bool parse_request_frame(const uint8_t *buffer, size_t length, ModbusTCPMessage *message) {
     if (!buffer || !message || length < MODBUS_MBAP_HEADER_LENGTH + 1) {
         return false;
     }
@@ -110,6 +112,34 @@ bool modbus_parse_request(const uint8_t *buffer, size_t length, ModbusTCPMessage
     return true;
 }
 
+/*
+ * 推算 MBAP 帧的完整长度
+ */
+int modbus_tcp_frame_length(const uint8_t *buffer, size_t length) {
+    if (length < MODBUS_MBAP_HEADER_LENGTH - 1) {
+        return 0;
+    }
+    uint16_t protocol_id = read_uint16_be(&buffer[2]);
+    uint16_t field_length = read_uint16_be(&buffer[4]);
+    /* 长度字段包含 Unit ID 和 PDU */
+    if (protocol_id != MODBUS_PROTOCOL_ID || field_length < 2 || field_length > MODBUS_MAX_PDU_LENGTH + 1) {
+        return -1;
+    }
+    return MODBUS_MBAP_HEADER_LENGTH - 1 + field_length;
+}
+
+/*
+ * 解析 Modbus TCP 请求消息
+ */
+bool modbus_parse_request(const uint8_t *buffer, size_t length, ModbusTCPMessage *message) {
+    if (!parse_request_frame(buffer, length, message)) {
+        TRACE_PROBE1(decode_error, length);
+        return false;
+    }
+    TRACE_PROBE3(decode, message->mbap.transaction_id, message->pdu.function_code, length);
+    return true;
+}
+
 /* ============= FC03 读保持寄存器 ============= */
 
 /*
@@ -123,6 +153,18 @@ bool modbus_parse_request(const uint8_t *buffer, size_t length, ModbusTCPMessage
 size_t modbus_build_fc03_response(uint16_t transaction_id, uint8_t unit_id,
                                   const uint16_t *registers, uint16_t quantity,
                                   uint8_t *buffer, size_t buffer_size) {
+    return modbus_build_read_registers_response(transaction_id, unit_id, MODBUS_FC_READ_HOLDING_REGISTERS,
+                                                registers, quantity, buffer, buffer_size);
+}
+
+/*
+ * 构建读寄存器响应（FC03/FC04 共用）
+ *
+ * 两者的响应格式相同，只有功能码不同。
+ */
+size_t modbus_build_read_registers_response(uint16_t transaction_id, uint8_t unit_id, uint8_t function_code,
+                                            const uint16_t *registers, uint16_t quantity,
+                                            uint8_t *buffer, size_t buffer_size) {
     if (!registers || !buffer || quantity == 0 || quantity > MODBUS_MAX_READ_REGISTERS) {
         return 0;
     }
@@ -141,8 +183,8 @@ size_t modbus_build_fc03_response(uint16_t transaction_id, uint8_t unit_id,
 
     /* 构建 PDU */
     size_t offset = MODBUS_MBAP_HEADER_LENGTH;
-    buffer[offset++] = MODBUS_FC_READ_HOLDING_REGISTERS;  /* 功能码 */
-    buffer[offset++] = byte_count;                        /* 字节计数 */
+    buffer[offset++] = function_code;  /* 功能码 */
+    buffer[offset++] = byte_count;     /* 字节计数 */
 
     /* 写入寄存器值（大端序） */
     for (uint16_t i = 0; i < quantity; i++) {
@@ -284,6 +326,212 @@ size_t modbus_build_fc06_request(uint16_t transaction_id, uint8_t unit_id,
                                      buffer, buffer_size);
 }
 
+/* ============= FC10 写多个寄存器 ============= */
+
+/*
+ * 构建 FC10 写多个寄存器响应
+ *
+ * // 事务标识符(2字节) | 协议标识符(2字节) | 长度(2字节) | 单元标识符(1字节) | 功能码(1字节) | 起始地址(2字节) | 寄存器数量(2字节)
+ * // 0x00 0x01        | 0x00 0x00        | 0x00 0x06   | 0x01           | 0x10        | 0x00 0x01      | 0x00 0x02
+ *
+ * 服务器回显起始地址和写入数量以确认操作成功。
+ */
+size_t modbus_build_fc10_response(uint16_t transaction_id, uint8_t unit_id,
+                                  uint16_t start_address, uint16_t quantity,
+                                  uint8_t *buffer, size_t buffer_size) {
+    if (!buffer) {
+        return 0;
+    }
+
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + 1 + 2 + 2;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    /* Length = Unit ID(1) + Function Code(1) + Address(2) + Quantity(2) = 6 */
+    build_mbap_header(buffer, transaction_id, 6, unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;  /* 功能码 */
+    write_uint16_be(&buffer[offset], start_address);        /* 起始地址 */
+    offset += 2;
+    write_uint16_be(&buffer[offset], quantity);             /* 寄存器数量 */
+    offset += 2;
+
+    return total_length;
+}
+
+/* ============= FC41 订阅寄存器变化 ============= */
+
+/*
+ * 构建 FC41 订阅请求
+ *
+ * // 事务标识符(2字节) | 协议标识符(2字节) | 长度(2字节) | 单元标识符(1字节) | 功能码(1字节) | 读功能码(1字节) | 起始地址(2字节) | 数量(2字节)
+ * // 0x00 0x01        | 0x00 0x00        | 0x00 0x07   | 0x01           | 0x41        | 0x03           | 0x00 0x64      | 0x00 0x0A
+ *
+ * 服务器成功登记订阅后原样回显。
+ */
+size_t modbus_build_subscribe_request(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                      uint16_t start_address, uint16_t quantity,
+                                      uint8_t *buffer, size_t buffer_size) {
+    if (!buffer) {
+        return 0;
+    }
+
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + 1 + 1 + 2 + 2;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    /* Length = Unit ID(1) + Function Code(1) + Read Function Code(1) + Address(2) + Quantity(2) = 7 */
+    build_mbap_header(buffer, transaction_id, 7, unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_SUBSCRIBE;              /* 功能码 */
+    buffer[offset++] = read_function_code;               /* 订阅的寄存器组 */
+    write_uint16_be(&buffer[offset], start_address);     /* 起始地址 */
+    offset += 2;
+    write_uint16_be(&buffer[offset], quantity);          /* 寄存器数量 */
+    offset += 2;
+
+    return total_length;
+}
+
+/* ============= FC43 分散读 / FC44 原子多点写 ============= */
+
+/*
+ * 构建 FC43 分散读请求
+ *
+ * // MBAP(7字节) | 功能码 0x43 | 读功能码(1字节) | 段数(1字节) | 起始地址(2字节) | 数量(2字节) | ...
+ */
+size_t modbus_build_read_vector_request(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                        const uint16_t *starts, const uint16_t *quantities, size_t range_count,
+                                        uint8_t *buffer, size_t buffer_size) {
+    if (!buffer || !starts || !quantities || range_count == 0 || range_count > MODBUS_MAX_VECTOR_RANGES) {
+        return 0;
+    }
+
+    size_t pdu_length = 1 + 1 + 1 + range_count * 4;
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + pdu_length;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    /* Length = Unit ID(1) + PDU */
+    build_mbap_header(buffer, transaction_id, (uint16_t)(1 + pdu_length), unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_READ_VECTOR;        /* 功能码 */
+    buffer[offset++] = read_function_code;           /* 寄存器组 */
+    buffer[offset++] = (uint8_t)range_count;         /* 段数 */
+    for (size_t i = 0; i < range_count; i++) {
+        write_uint16_be(&buffer[offset], starts[i]);
+        offset += 2;
+        write_uint16_be(&buffer[offset], quantities[i]);
+        offset += 2;
+    }
+
+    return total_length;
+}
+
+/*
+ * 构建 FC43 分散读响应
+ *
+ * // MBAP(7字节) | 功能码 0x43 | 读功能码(1字节) | 字节计数(1字节) | 寄存器值...
+ */
+size_t modbus_build_read_vector_response(uint16_t transaction_id, uint8_t unit_id, uint8_t read_function_code,
+                                         const uint16_t *registers, uint16_t quantity,
+                                         uint8_t *buffer, size_t buffer_size) {
+    if (!buffer || !registers || quantity > MODBUS_MAX_READ_REGISTERS) {
+        return 0;
+    }
+
+    size_t byte_count = (size_t)quantity * 2;
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + 1 + 1 + 1 + byte_count;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    /* Length = Unit ID(1) + Function Code(1) + Read Function Code(1) + Byte Count(1) + Data */
+    build_mbap_header(buffer, transaction_id, (uint16_t)(4 + byte_count), unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_READ_VECTOR;        /* 功能码 */
+    buffer[offset++] = read_function_code;           /* 寄存器组 */
+    buffer[offset++] = (uint8_t)byte_count;          /* 字节计数 */
+    for (uint16_t i = 0; i < quantity; i++) {
+        write_uint16_be(&buffer[offset], registers[i]);
+        offset += 2;
+    }
+
+    return total_length;
+}
+
+/*
+ * 构建 FC44 原子多点写请求
+ *
+ * // MBAP(7字节) | 功能码 0x44 | 点数(1字节) | 地址(2字节) | 值(2字节) | ...
+ */
+size_t modbus_build_write_vector_request(uint16_t transaction_id, uint8_t unit_id,
+                                         const uint16_t *addresses, const uint16_t *values, size_t count,
+                                         uint8_t *buffer, size_t buffer_size) {
+    if (!buffer || !addresses || !values || count == 0 || count > MODBUS_MAX_VECTOR_WRITES) {
+        return 0;
+    }
+
+    size_t pdu_length = 1 + 1 + count * 4;
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + pdu_length;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    build_mbap_header(buffer, transaction_id, (uint16_t)(1 + pdu_length), unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_WRITE_VECTOR;       /* 功能码 */
+    buffer[offset++] = (uint8_t)count;               /* 点数 */
+    for (size_t i = 0; i < count; i++) {
+        write_uint16_be(&buffer[offset], addresses[i]);
+        offset += 2;
+        write_uint16_be(&buffer[offset], values[i]);
+        offset += 2;
+    }
+
+    return total_length;
+}
+
+/*
+ * 构建 FC44 原子多点写响应
+ *
+ * // MBAP(7字节) | 功能码 0x44 | 点数(1字节)
+ */
+size_t modbus_build_write_vector_response(uint16_t transaction_id, uint8_t unit_id, uint8_t count,
+                                          uint8_t *buffer, size_t buffer_size) {
+    if (!buffer) {
+        return 0;
+    }
+
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH + 1 + 1;
+
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    /* Length = Unit ID(1) + Function Code(1) + Count(1) = 3 */
+    build_mbap_header(buffer, transaction_id, 3, unit_id);
+
+    size_t offset = MODBUS_MBAP_HEADER_LENGTH;
+    buffer[offset++] = MODBUS_FC_WRITE_VECTOR;       /* 功能码 */
+    buffer[offset++] = count;                        /* 点数 */
+
+    return total_length;
+}
+
 /* ============= 错误响应 ============= */
 
 /*
@@ -334,6 +582,12 @@ const char* modbus_get_exception_string(uint8_t exception_code) {
             return "非法数据值";
         case MODBUS_EXCEPTION_SERVER_DEVICE_FAILURE:
             return "服务器设备故障";
+        case MODBUS_EXCEPTION_SERVER_DEVICE_BUSY:
+            return "服务器设备忙";
+        case MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE:
+            return "网关路径不可用";
+        case MODBUS_EXCEPTION_GATEWAY_TARGET_FAILED:
+            return "网关目标设备未响应";
         default:
             return "未知异常";
     }
@@ -0,0 +1,239 @@
+/*
+ * Modbus RTU 帧格式实现
+ *
+ * 实现 RTU 帧的 CRC16 计算、流式分帧以及 RTU 与 MBAP 帧之间的转换
+ */
+
+#include "modbus_rtu.h"
+#include "modbus.h"
+#include <string.h>
+
+/* ============= CRC16 查找表 ============= */
+
+/*
+ * slice-by-8 查找表：crc_table[0] 为标准逐字节表，
+ * crc_table[k][i] 表示字节 i 之后再经过 k 个零字节时对 CRC 的贡献。
+ * 首次使用时生成（约 4KB），之后只读。
+ */
+static uint16_t crc_table[8][256];
+static bool crc_table_ready = false;
+
+/*
+ * 生成 CRC16 查找表（多项式 0xA001，即反射后的 0x8005）
+ */
+static void init_crc_table(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+        crc_table[0][i] = crc;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint16_t prev = crc_table[k - 1][i];
+            crc_table[k][i] = (uint16_t)((prev >> 8) ^ crc_table[0][prev & 0xFF]);
+        }
+    }
+
+    crc_table_ready = true;
+}
+
+/*
+ * 计算 Modbus CRC16
+ *
+ * 每轮把 CRC 与前 2 字节异或后，8 个字节分别查 8 张表再合并，
+ * 循环内没有逐位移位和数据依赖的长链，比逐字节查表快约 3-4 倍。
+ */
+uint16_t modbus_rtu_crc16(const uint8_t *data, size_t length) {
+    if (!crc_table_ready) {
+        init_crc_table();
+    }
+
+    uint16_t crc = 0xFFFF;
+
+    while (length >= 8) {
+        crc ^= (uint16_t)(data[0] | (data[1] << 8));
+        crc = crc_table[7][crc & 0xFF] ^
+              crc_table[6][crc >> 8] ^
+              crc_table[5][data[2]] ^
+              crc_table[4][data[3]] ^
+              crc_table[3][data[4]] ^
+              crc_table[2][data[5]] ^
+              crc_table[1][data[6]] ^
+              crc_table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+
+    while (length-- > 0) {
+        crc = (uint16_t)((crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xFF]);
+    }
+
+    return crc;
+}
+
+/*
+ * 校验 RTU 帧末尾的 CRC（低字节在前）
+ */
+bool modbus_rtu_check_crc(const uint8_t *frame, size_t length) {
+    if (!frame || length < MODBUS_RTU_MIN_ADU_LENGTH) {
+        return false;
+    }
+
+    uint16_t crc = modbus_rtu_crc16(frame, length - MODBUS_RTU_CRC_LENGTH);
+    return frame[length - 2] == (crc & 0xFF) && frame[length - 1] == (crc >> 8);
+}
+
+/* ============= 分帧 ============= */
+
+/*
+ * 推算 RTU 请求帧长度
+ *
+ * // 从站地址(1字节) | 功能码(1字节) | 数据... | CRC低字节 | CRC高字节
+ *
+ * FC03/FC04/FC06 请求固定 8 字节，FC41 固定 9 字节；FC10 请求在第 7 字节给出后续数据字节数，
+ * FC43 在第 4 字节给出段数（每段 4 字节），FC44 在第 3 字节给出点数（每点 4 字节）。
+ */
+int modbus_rtu_request_length(const uint8_t *buffer, size_t length) {
+    if (!buffer || length < 2) {
+        return 0;
+    }
+
+    switch (buffer[1]) {
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            return 8;
+
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            /* 地址1 + 功能码1 + 起始地址2 + 数量2 + 字节数1 + 数据N + CRC2 */
+            if (length < 7) {
+                return 0;
+            }
+            return 9 + buffer[6];
+
+        case MODBUS_FC_SUBSCRIBE:
+            /* 地址1 + 功能码1 + 读功能码1 + 起始地址2 + 数量2 + CRC2 */
+            return 9;
+
+        case MODBUS_FC_READ_VECTOR:
+            /* 地址1 + 功能码1 + 读功能码1 + 段数1 + 段数*4 + CRC2 */
+            if (length < 4) {
+                return 0;
+            }
+            return 6 + 4 * buffer[3];
+
+        case MODBUS_FC_WRITE_VECTOR:
+            /* 地址1 + 功能码1 + 点数1 + 点数*4 + CRC2 */
+            if (length < 3) {
+                return 0;
+            }
+            return 5 + 4 * buffer[2];
+
+        default:
+            return -1;
+    }
+}
+
+/*
+ * 在功能码未知的数据开头查找 CRC 正确的最短帧
+ *
+ * 从最小帧长开始逐个长度校验 CRC，用于给未知功能码的完整请求回复异常 01。
+ */
+size_t modbus_rtu_scan_frame(const uint8_t *buffer, size_t length) {
+    if (!buffer) {
+        return 0;
+    }
+    if (length > MODBUS_RTU_MAX_ADU_LENGTH) {
+        length = MODBUS_RTU_MAX_ADU_LENGTH;
+    }
+
+    for (size_t candidate = MODBUS_RTU_MIN_ADU_LENGTH; candidate <= length; candidate++) {
+        if (modbus_rtu_check_crc(buffer, candidate)) {
+            return candidate;
+        }
+    }
+    return 0;
+}
+
+/* ============= 帧格式转换 ============= */
+
+/*
+ * RTU 帧转换为 MBAP 帧
+ *
+ * // RTU:  从站地址 | 功能码 | 数据... | CRC(2)
+ * // MBAP: 事务ID(2) | 协议ID(2) | 长度(2) | 单元ID | 功能码 | 数据...
+ */
+size_t modbus_rtu_to_tcp(const uint8_t *rtu_frame, size_t rtu_length,
+                         uint16_t transaction_id,
+                         uint8_t *buffer, size_t buffer_size) {
+    if (!rtu_frame || !buffer ||
+        rtu_length < MODBUS_RTU_MIN_ADU_LENGTH || rtu_length > MODBUS_RTU_MAX_ADU_LENGTH) {
+        return 0;
+    }
+
+    if (!modbus_rtu_check_crc(rtu_frame, rtu_length)) {
+        return 0;
+    }
+
+    /* 去掉 CRC 后剩余 单元ID + PDU，正好是 MBAP 长度字段的含义 */
+    size_t unit_and_pdu = rtu_length - MODBUS_RTU_CRC_LENGTH;
+    size_t total_length = MODBUS_MBAP_HEADER_LENGTH - 1 + unit_and_pdu;
+    if (buffer_size < total_length) {
+        return 0;
+    }
+
+    buffer[0] = (transaction_id >> 8) & 0xFF;
+    buffer[1] = transaction_id & 0xFF;
+    buffer[2] = (MODBUS_PROTOCOL_ID >> 8) & 0xFF;
+    buffer[3] = MODBUS_PROTOCOL_ID & 0xFF;
+    buffer[4] = (unit_and_pdu >> 8) & 0xFF;
+    buffer[5] = unit_and_pdu & 0xFF;
+    memcpy(&buffer[6], rtu_frame, unit_and_pdu);
+
+    return total_length;
+}
+
+/*
+ * MBAP 帧转换为 RTU 帧
+ */
+size_t modbus_tcp_to_rtu(const uint8_t *tcp_frame, size_t tcp_length,
+                         uint8_t *buffer, size_t buffer_size) {
+    if (!tcp_frame || !buffer || tcp_length < MODBUS_MBAP_HEADER_LENGTH + 1) {
+        return 0;
+    }
+
+    /* 从 MBAP 长度字段取 单元ID + PDU 的长度，而不是信任 tcp_length */
+    size_t unit_and_pdu = (size_t)((tcp_frame[4] << 8) | tcp_frame[5]);
+    if (unit_and_pdu < 2 || MODBUS_MBAP_HEADER_LENGTH - 1 + unit_and_pdu > tcp_length) {
+        return 0;
+    }
+
+    size_t total_length = unit_and_pdu + MODBUS_RTU_CRC_LENGTH;
+    if (total_length > MODBUS_RTU_MAX_ADU_LENGTH || buffer_size < total_length) {
+        return 0;
+    }
+
+    memcpy(buffer, &tcp_frame[MODBUS_MBAP_HEADER_LENGTH - 1], unit_and_pdu);
+    uint16_t crc = modbus_rtu_crc16(buffer, unit_and_pdu);
+    buffer[unit_and_pdu] = crc & 0xFF;          /* CRC 低字节在前 */
+    buffer[unit_and_pdu + 1] = (crc >> 8) & 0xFF;
+
+    return total_length;
+}
+
+/* ============= 定时 ============= */
+
+/*
+ * 计算 t3.5 帧间隔（微秒）
+ */
+uint32_t modbus_rtu_t35_usec(uint32_t baud_rate) {
+    if (baud_rate == 0 || baud_rate > 19200) {
+        return MODBUS_RTU_FIXED_T35_USEC;
+    }
+
+    /* 3.5 个字符 * 11 位/字符 = 38.5 位时间，向上取整 */
+    return (uint32_t)((38500000ULL + baud_rate - 1) / baud_rate);
+}
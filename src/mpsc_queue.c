@@ -0,0 +1,61 @@
+/*
+ * 无锁多生产者单消费者队列实现
+ */
+
+#include "mpsc_queue.h"
+#include <stddef.h>
+
+/*
+ * 初始化为只含占位节点的空队列
+ */
+void mpsc_queue_init(MpscQueue *queue) {
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+/*
+ * 入队：原子交换队头后链接前驱节点
+ */
+void mpsc_queue_push(MpscQueue *queue, MpscNode *node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    /* 交换队尾后再链接前驱：release 保证消费者看到链接时节点内容已写好 */
+    MpscNode *previous = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&previous->next, node, __ATOMIC_RELEASE);
+}
+
+/*
+ * 出队：从队尾取出最早入队的节点，必要时借助占位节点取出最后一个节点
+ */
+MpscNode *mpsc_queue_pop(MpscQueue *queue) {
+    MpscNode *tail = queue->tail;
+    MpscNode *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    /* 跳过占位节点 */
+    if (tail == &queue->stub) {
+        if (!next) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    /* tail 不是最后入队的节点：有生产者已交换队尾但尚未链接 */
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    /* tail 是唯一剩下的节点：重新放入占位节点，使 tail 有后继后再取出 */
+    mpsc_queue_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
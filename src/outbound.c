@@ -0,0 +1,130 @@
+/*
+ * 连接发送队列与共享消息缓冲区实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "outbound.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/*
+ * 从缓冲池分配共享消息缓冲区并复制数据（初始引用计数为 1）
+ */
+OutboundBuffer *outbound_buffer_create(BufferPool *pool, const void *data, size_t length) {
+    OutboundBuffer *buffer = buffer_pool_alloc(pool, sizeof(OutboundBuffer) + length);
+    if (!buffer) {
+        return NULL;
+    }
+    memset(buffer, 0, sizeof(*buffer));
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    buffer->created_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    buffer->refs = 1;
+    buffer->pool = pool;
+    buffer->length = length;
+    memcpy(buffer->data, data, length);
+    return buffer;
+}
+
+/*
+ * 释放一个引用；最后一个引用释放时调用完成回调并归还缓冲池
+ */
+void outbound_buffer_release(OutboundBuffer *buffer) {
+    if (--buffer->refs > 0) {
+        return;
+    }
+    if (buffer->complete) {
+        buffer->complete(buffer, buffer->context);
+    }
+    buffer_pool_free(buffer->pool, buffer);
+}
+
+/*
+ * 初始化空的发送队列
+ */
+void outbound_queue_init(OutboundQueue *queue) {
+    memset(queue, 0, sizeof(*queue));
+}
+
+/*
+ * 把缓冲区排入队尾并增加引用；队列已满时计为丢弃
+ */
+bool outbound_queue_push(OutboundQueue *queue, OutboundBuffer *buffer) {
+    buffer->targets++;
+    if (queue->count >= OUTBOUND_QUEUE_CAPACITY) {
+        buffer->dropped++;
+        return false;
+    }
+    buffer->refs++;
+    queue->items[(queue->head + queue->count) % OUTBOUND_QUEUE_CAPACITY] = buffer;
+    queue->count++;
+    return true;
+}
+
+/*
+ * 移除队头缓冲区并释放其引用
+ */
+static void pop_head(OutboundQueue *queue) {
+    OutboundBuffer *buffer = queue->items[queue->head];
+    queue->items[queue->head] = NULL;
+    queue->head = (queue->head + 1) % OUTBOUND_QUEUE_CAPACITY;
+    queue->count--;
+    queue->offset = 0;
+    outbound_buffer_release(buffer);
+}
+
+/*
+ * 按顺序写出队列中的缓冲区，直到写空、阻塞或出错
+ */
+OutboundFlushResult outbound_queue_flush(OutboundQueue *queue, OutboundWriteFunc write_func, void *context) {
+    while (queue->count > 0) {
+        OutboundBuffer *buffer = queue->items[queue->head];
+        ssize_t written = write_func(context, buffer->data + queue->offset, buffer->length - queue->offset);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return OUTBOUND_FLUSH_BLOCKED;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return OUTBOUND_FLUSH_ERROR;
+        }
+        queue->offset += (size_t)written;
+        if (queue->offset < buffer->length) {
+            return OUTBOUND_FLUSH_BLOCKED;
+        }
+        buffer->delivered++;
+        pop_head(queue);
+    }
+    return OUTBOUND_FLUSH_DRAINED;
+}
+
+/*
+ * 丢弃队列中全部未写出的缓冲区（连接关闭时调用）
+ */
+void outbound_queue_clear(OutboundQueue *queue) {
+    while (queue->count > 0) {
+        queue->items[queue->head]->dropped++;
+        pop_head(queue);
+    }
+}
+
+/*
+ * 队列是否为空
+ */
+bool outbound_queue_empty(const OutboundQueue *queue) {
+    return queue->count == 0;
+}
+
+/*
+ * 队列中尚未写出的字节数
+ */
+size_t outbound_queue_bytes(const OutboundQueue *queue) {
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < queue->count; i++) {
+        bytes += queue->items[(queue->head + i) % OUTBOUND_QUEUE_CAPACITY]->length;
+    }
+    return bytes - queue->offset;
+}
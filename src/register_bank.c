@@ -0,0 +1,395 @@
+/*
+ * 分页寄存器组实现（每页一个 seqlock）
+ *
+ * 内存序约定（与 Boehm 的 seqlock 模型一致）：
+ *   写者：CAS 序列号为奇数 -> release 栅栏 -> relaxed 写数据 -> release 写回偶数序列号
+ *   读者：acquire 读序列号 -> relaxed 读数据 -> acquire 栅栏 -> relaxed 复查序列号
+ * 数据读写全部使用原子内建函数，读者与写者并发时不存在数据竞争。
+ *
+ * 写时复制：模板只读，私有副本在加锁前复制好并以 CAS 发布到页表，之后与普通页一样加锁写入。
+ * 读者在一次读取开始时确定各页读模板还是读副本：若读的是模板，而写者随后复制并写入了副本，
+ * 读到的仍是写入之前的一致数据。
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "register_bank.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 自旋等待时提示 CPU 降低功耗并让出流水线 */
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+/*
+ * 初始化寄存器组
+ */
+bool register_bank_init(RegisterBank *bank, uint32_t register_count, uint16_t *storage) {
+    memset(bank, 0, sizeof(*bank));
+    bank->register_count = register_count;
+    bank->page_count = (register_count + REGISTER_BANK_PAGE_REGISTERS - 1) >> REGISTER_BANK_PAGE_SHIFT;
+
+    if (storage) {
+        bank->storage = storage;
+    } else {
+        bank->storage = calloc(register_count ? register_count : 1, sizeof(uint16_t));
+        if (!bank->storage) {
+            return false;
+        }
+        bank->owns_storage = true;
+    }
+
+    void *pages = NULL;
+    if (posix_memalign(&pages, 64, (bank->page_count ? bank->page_count : 1) * sizeof(RegisterPage)) != 0) {
+        register_bank_destroy(bank);
+        return false;
+    }
+    bank->pages = pages;
+    for (uint32_t p = 0; p < bank->page_count; p++) {
+        bank->pages[p].sequence = 0;
+        bank->pages[p].data = bank->storage + ((size_t)p << REGISTER_BANK_PAGE_SHIFT);
+    }
+    return true;
+}
+
+/*
+ * 以模板初始化写时复制的寄存器组
+ */
+void register_bank_init_cow(RegisterBank *bank, const RegisterBank *base) {
+    memset(bank, 0, sizeof(*bank));
+    bank->register_count = base->register_count;
+    bank->page_count = base->page_count;
+    bank->base = base;
+}
+
+/*
+ * 写时复制的寄存器组占用的私有内存
+ */
+size_t register_bank_private_bytes(const RegisterBank *bank) {
+    if (!__atomic_load_n(&bank->overlay, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return (size_t)bank->page_count * sizeof(RegisterPage *) +
+           (size_t)__atomic_load_n(&bank->private_pages, __ATOMIC_RELAXED) *
+           (sizeof(RegisterPage) + REGISTER_BANK_PAGE_REGISTERS * sizeof(uint16_t));
+}
+
+/*
+ * 释放寄存器组
+ */
+void register_bank_destroy(RegisterBank *bank) {
+    if (bank->overlay) {
+        for (uint32_t p = 0; p < bank->page_count; p++) {
+            free(bank->overlay[p]);
+        }
+        free(bank->overlay);
+        bank->overlay = NULL;
+    }
+    free(bank->pages);
+    bank->pages = NULL;
+    if (bank->owns_storage) {
+        free(bank->storage);
+    }
+    bank->storage = NULL;
+    bank->owns_storage = false;
+}
+
+/*
+ * 检查地址范围
+ */
+static bool range_valid(const RegisterBank *bank, uint32_t start, uint32_t count) {
+    return count > 0 && start < bank->register_count && count <= bank->register_count - start;
+}
+
+/*
+ * 读者看到的页：写时复制的寄存器组中尚未复制的页读模板
+ */
+static RegisterPage *read_page(const RegisterBank *bank, uint32_t p) {
+    if (!bank->base) {
+        return &bank->pages[p];
+    }
+    RegisterPage **overlay = __atomic_load_n(&bank->overlay, __ATOMIC_ACQUIRE);
+    RegisterPage *page = overlay ? __atomic_load_n(&overlay[p], __ATOMIC_ACQUIRE) : NULL;
+    return page ? page : &bank->base->pages[p];
+}
+
+/*
+ * 写者使用的页：写时复制的寄存器组中第一次写入的页先复制模板
+ *
+ * 返回：
+ *   可写入的页，内存不足返回 NULL
+ */
+static RegisterPage *write_page(RegisterBank *bank, uint32_t p) {
+    if (!bank->base) {
+        return &bank->pages[p];
+    }
+
+    RegisterPage **overlay = __atomic_load_n(&bank->overlay, __ATOMIC_ACQUIRE);
+    if (!overlay) {
+        RegisterPage **fresh = calloc(bank->page_count, sizeof(RegisterPage *));
+        if (!fresh) {
+            return NULL;
+        }
+        overlay = NULL;
+        if (__atomic_compare_exchange_n(&bank->overlay, &overlay, fresh, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            overlay = fresh;
+        } else {
+            free(fresh);  /* 另一个写者已分配，overlay 已是它的页表 */
+        }
+    }
+
+    RegisterPage *page = __atomic_load_n(&overlay[p], __ATOMIC_ACQUIRE);
+    if (page) {
+        return page;
+    }
+
+    /* 页头与数据一起分配；模板只读，复制时无需加锁 */
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, sizeof(RegisterPage) + REGISTER_BANK_PAGE_REGISTERS * sizeof(uint16_t)) != 0) {
+        return NULL;
+    }
+    RegisterPage *copy = memory;
+    copy->sequence = 0;
+    copy->data = (uint16_t *)(copy + 1);
+    uint32_t first_register = p << REGISTER_BANK_PAGE_SHIFT;
+    uint32_t count = bank->register_count - first_register;
+    if (count > REGISTER_BANK_PAGE_REGISTERS) {
+        count = REGISTER_BANK_PAGE_REGISTERS;
+    }
+    memset(copy->data, 0, REGISTER_BANK_PAGE_REGISTERS * sizeof(uint16_t));
+    memcpy(copy->data, bank->base->pages[p].data, count * sizeof(uint16_t));
+
+    if (!__atomic_compare_exchange_n(&overlay[p], &page, copy, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(copy);  /* 另一个写者已复制，page 已是它的副本 */
+        return page;
+    }
+    __atomic_fetch_add(&bank->private_pages, 1, __ATOMIC_RELAXED);
+    return copy;
+}
+
+/*
+ * 对跨度不超过 REGISTER_BANK_READ_SPAN_PAGES 页的范围做一次一致性读取
+ */
+static void read_span(RegisterBank *bank, uint32_t start, uint32_t count, uint16_t *values) {
+    uint32_t first = start >> REGISTER_BANK_PAGE_SHIFT;
+    uint32_t last = (start + count - 1) >> REGISTER_BANK_PAGE_SHIFT;
+    uint32_t sequences[REGISTER_BANK_READ_SPAN_PAGES];
+    RegisterPage *pages[REGISTER_BANK_READ_SPAN_PAGES];
+
+    for (;;) {
+        bool busy = false;
+        for (uint32_t p = first; p <= last; p++) {
+            pages[p - first] = read_page(bank, p);
+            sequences[p - first] = __atomic_load_n(&pages[p - first]->sequence, __ATOMIC_ACQUIRE);
+            if (sequences[p - first] & 1) {
+                busy = true;
+                break;
+            }
+        }
+
+        if (!busy) {
+            uint32_t address = start;
+            for (uint32_t i = 0; i < count; i++, address++) {
+                const RegisterPage *page = pages[(address >> REGISTER_BANK_PAGE_SHIFT) - first];
+                values[i] = __atomic_load_n(&page->data[address & (REGISTER_BANK_PAGE_REGISTERS - 1)],
+                                            __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            bool changed = false;
+            for (uint32_t p = first; p <= last; p++) {
+                if (__atomic_load_n(&pages[p - first]->sequence, __ATOMIC_RELAXED) != sequences[p - first]) {
+                    changed = true;
+                    break;
+                }
+            }
+            if (!changed) {
+                return;
+            }
+        }
+
+        __atomic_fetch_add(&bank->read_retries, 1, __ATOMIC_RELAXED);
+        cpu_relax();
+    }
+}
+
+/*
+ * 无锁读取一段连续寄存器
+ */
+bool register_bank_read(RegisterBank *bank, uint32_t start, uint32_t count, uint16_t *values) {
+    if (!range_valid(bank, start, count)) {
+        return false;
+    }
+
+    /* 按页对齐分段：每段最多 REGISTER_BANK_READ_SPAN_PAGES 页 */
+    while (count > 0) {
+        uint32_t span_end = ((start >> REGISTER_BANK_PAGE_SHIFT) + REGISTER_BANK_READ_SPAN_PAGES)
+                            << REGISTER_BANK_PAGE_SHIFT;
+        uint32_t chunk = span_end - start;
+        if (chunk > count) {
+            chunk = count;
+        }
+        read_span(bank, start, chunk, values);
+        start += chunk;
+        values += chunk;
+        count -= chunk;
+    }
+    return true;
+}
+
+/*
+ * 获取页写锁：序列号由偶数 CAS 为奇数
+ */
+static void lock_page(RegisterPage *page) {
+    for (;;) {
+        uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+        if (!(sequence & 1) &&
+            __atomic_compare_exchange_n(&page->sequence, &sequence, sequence + 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        cpu_relax();
+    }
+    /* 保证读者看到奇数序列号先于看到任何新数据 */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ * 释放页写锁：序列号加一回到偶数，同时发布本次写入的数据
+ */
+static void unlock_page(RegisterPage *page) {
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * 写入一段连续寄存器
+ */
+bool register_bank_write(RegisterBank *bank, uint32_t start, uint32_t count, const uint16_t *values) {
+    if (!range_valid(bank, start, count)) {
+        return false;
+    }
+
+    uint32_t first = start >> REGISTER_BANK_PAGE_SHIFT;
+    uint32_t last = (start + count - 1) >> REGISTER_BANK_PAGE_SHIFT;
+
+    /* 写时复制的页先全部复制好，避免持锁时分配内存或中途失败 */
+    for (uint32_t p = first; p <= last; p++) {
+        if (!write_page(bank, p)) {
+            return false;
+        }
+    }
+
+    /* 按页号升序加锁，多个跨页写者之间不会形成环形等待 */
+    for (uint32_t p = first; p <= last; p++) {
+        lock_page(write_page(bank, p));
+    }
+
+    uint32_t address = start;
+    RegisterPage *page = NULL;
+    for (uint32_t i = 0; i < count; i++, address++) {
+        if (!page || (address & (REGISTER_BANK_PAGE_REGISTERS - 1)) == 0) {
+            page = write_page(bank, address >> REGISTER_BANK_PAGE_SHIFT);
+        }
+        __atomic_store_n(&page->data[address & (REGISTER_BANK_PAGE_REGISTERS - 1)], values[i],
+                         __ATOMIC_RELAXED);
+    }
+
+    for (uint32_t p = first; p <= last; p++) {
+        unlock_page(write_page(bank, p));
+    }
+
+    __atomic_fetch_add(&bank->writes, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+/*
+ * 原子写入一组离散寄存器
+ */
+bool register_bank_write_scattered(RegisterBank *bank, const uint32_t *addresses, const uint16_t *values,
+                                   uint32_t count) {
+    if (count == 0 || count > REGISTER_BANK_SCATTER_MAX) {
+        return false;
+    }
+
+    /* 先检查全部地址并收集涉及的页（插入排序去重，数量很小） */
+    uint32_t pages[REGISTER_BANK_SCATTER_MAX];
+    uint32_t page_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (addresses[i] >= bank->register_count) {
+            return false;
+        }
+        uint32_t page = addresses[i] >> REGISTER_BANK_PAGE_SHIFT;
+        uint32_t position = page_count;
+        while (position > 0 && pages[position - 1] > page) {
+            position--;
+        }
+        if (position > 0 && pages[position - 1] == page) {
+            continue;
+        }
+        memmove(&pages[position + 1], &pages[position], (page_count - position) * sizeof(uint32_t));
+        pages[position] = page;
+        page_count++;
+    }
+
+    for (uint32_t i = 0; i < page_count; i++) {
+        if (!write_page(bank, pages[i])) {
+            return false;
+        }
+    }
+
+    /* 与连续写入相同，按页号升序加锁 */
+    for (uint32_t i = 0; i < page_count; i++) {
+        lock_page(write_page(bank, pages[i]));
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        RegisterPage *page = write_page(bank, addresses[i] >> REGISTER_BANK_PAGE_SHIFT);
+        __atomic_store_n(&page->data[addresses[i] & (REGISTER_BANK_PAGE_REGISTERS - 1)], values[i],
+                         __ATOMIC_RELAXED);
+    }
+
+    for (uint32_t i = 0; i < page_count; i++) {
+        unlock_page(write_page(bank, pages[i]));
+    }
+
+    __atomic_fetch_add(&bank->writes, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+/*
+ * 读取单个寄存器
+ */
+uint16_t register_bank_get(RegisterBank *bank, uint32_t address) {
+    /* 单个 16 位寄存器的读取本身是原子的，无需序列号校验 */
+    const RegisterPage *page = read_page(bank, address >> REGISTER_BANK_PAGE_SHIFT);
+    return __atomic_load_n(&page->data[address & (REGISTER_BANK_PAGE_REGISTERS - 1)], __ATOMIC_RELAXED);
+}
+
+/*
+ * 写入单个寄存器
+ */
+void register_bank_set(RegisterBank *bank, uint32_t address, uint16_t value) {
+    register_bank_write(bank, address, 1, &value);
+}
+
+/*
+ * 获取寄存器在数据区中的地址
+ */
+uint16_t* register_bank_location(RegisterBank *bank, uint32_t address) {
+    return &read_page(bank, address >> REGISTER_BANK_PAGE_SHIFT)->data[address & (REGISTER_BANK_PAGE_REGISTERS - 1)];
+}
+
+/*
+ * 获取统计信息
+ */
+void register_bank_get_stats(RegisterBank *bank, RegisterBankStats *stats) {
+    stats->register_count = bank->register_count;
+    stats->page_count = bank->page_count;
+    stats->private_pages = __atomic_load_n(&bank->private_pages, __ATOMIC_RELAXED);
+    stats->read_retries = __atomic_load_n(&bank->read_retries, __ATOMIC_RELAXED);
+    stats->writes = __atomic_load_n(&bank->writes, __ATOMIC_RELAXED);
+}
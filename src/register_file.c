@@ -0,0 +1,227 @@
+/*
+ * 寄存器持久化文件实现（mmap）
+ *
+ * 启动开销仅为 open + mmap + 文件头检查，寄存器数据不经过任何解析或复制
+ */
+
+#define _GNU_SOURCE
+
+#include "register_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+/*
+ * 计算给定寄存器数量对应的文件大小
+ */
+static size_t register_file_size(uint32_t register_count) {
+    return REGISTER_FILE_HEADER_SIZE + (size_t)register_count * sizeof(uint16_t) * 2;
+}
+
+/*
+ * 检查已有文件的文件头
+ * 返回：
+ *   文件头有效返回 true；不兼容时打印原因并返回 false
+ */
+static bool check_header(const RegisterFileHeader *header, const char *path, uint32_t register_count) {
+    if (header->magic != REGISTER_FILE_MAGIC) {
+        fprintf(stderr, "[持久化] 错误：%s 不是寄存器持久化文件（魔数不匹配）\n", path);
+        return false;
+    }
+    if (header->byte_order_mark != REGISTER_FILE_BYTE_ORDER_MARK) {
+        fprintf(stderr, "[持久化] 错误：%s 由不同字节序的机器创建\n", path);
+        return false;
+    }
+    if (header->version != REGISTER_FILE_VERSION) {
+        fprintf(stderr, "[持久化] 错误：%s 的格式版本 %u 不受支持（当前版本 %u）\n",
+                path, header->version, REGISTER_FILE_VERSION);
+        return false;
+    }
+    if (header->register_count != register_count) {
+        fprintf(stderr, "[持久化] 错误：%s 包含 %u 个寄存器，与当前配置的 %u 个不一致\n",
+                path, header->register_count, register_count);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 打开（必要时创建）寄存器持久化文件
+ */
+bool register_file_open(RegisterFile *file, const char *path, uint32_t register_count, bool *created) {
+    memset(file, 0, sizeof(*file));
+    file->fd = -1;
+    file->timer_fd = -1;
+    *created = false;
+
+    size_t expected_size = register_file_size(register_count);
+
+    file->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file->fd < 0) {
+        fprintf(stderr, "[持久化] 错误：无法打开 %s（%s）\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(file->fd, &st) < 0) {
+        perror("fstat");
+        register_file_close(file);
+        return false;
+    }
+
+    bool is_new = (st.st_size == 0);
+    if (is_new) {
+        if (ftruncate(file->fd, (off_t)expected_size) < 0) {
+            perror("ftruncate");
+            register_file_close(file);
+            return false;
+        }
+    } else if ((size_t)st.st_size != expected_size) {
+        fprintf(stderr, "[持久化] 错误：%s 大小为 %lld 字节，期望 %zu 字节\n",
+                path, (long long)st.st_size, expected_size);
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+
+    file->map = mmap(NULL, expected_size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (file->map == MAP_FAILED) {
+        perror("mmap");
+        file->map = NULL;
+        register_file_close(file);
+        return false;
+    }
+    file->map_size = expected_size;
+    file->header = (RegisterFileHeader *)file->map;
+
+    if (is_new) {
+        file->header->magic = REGISTER_FILE_MAGIC;
+        file->header->version = REGISTER_FILE_VERSION;
+        file->header->byte_order_mark = REGISTER_FILE_BYTE_ORDER_MARK;
+        file->header->register_count = register_count;
+        file->header->initialized = 0;
+    } else if (!check_header(file->header, path, register_count)) {
+        munmap(file->map, file->map_size);
+        file->map = NULL;
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+
+    uint8_t *base = (uint8_t *)file->map + REGISTER_FILE_HEADER_SIZE;
+    file->holding_registers = (uint16_t *)base;
+    file->input_registers = (uint16_t *)(base + (size_t)register_count * sizeof(uint16_t));
+    file->header->open_count++;
+
+    /* 上次创建时未完成初始化（如初始化过程中崩溃）的文件按新文件处理 */
+    *created = (file->header->initialized == 0);
+    return true;
+}
+
+/*
+ * 标记初值已写入完成
+ */
+void register_file_mark_initialized(RegisterFile *file) {
+    /* 先把寄存器数据落盘，再写入初始化标记，保证标记为 1 时数据完整 */
+    msync(file->map, file->map_size, MS_SYNC);
+    file->header->initialized = 1;
+    msync(file->map, REGISTER_FILE_HEADER_SIZE, MS_SYNC);
+}
+
+/*
+ * 设置 msync 策略
+ */
+bool register_file_set_policy(RegisterFile *file, RegisterSyncPolicy policy, uint32_t period_ms) {
+    file->policy = policy;
+    if (policy != REGISTER_SYNC_PERIODIC) {
+        return true;
+    }
+
+    file->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (file->timer_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = period_ms / 1000;
+    spec.it_interval.tv_nsec = (long)(period_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(file->timer_fd, 0, &spec, NULL) < 0) {
+        perror("timerfd_settime");
+        close(file->timer_fd);
+        file->timer_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 通知寄存器写入
+ */
+void register_file_note_write(RegisterFile *file, const uint16_t *registers, size_t count) {
+    if (!file->map) {
+        return;
+    }
+    file->dirty = true;
+    if (file->policy != REGISTER_SYNC_EVERY_WRITE || count == 0) {
+        return;
+    }
+
+    /* msync 要求起始地址页对齐：把写入范围扩展到所在的完整页 */
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)registers & ~(uintptr_t)(page_size - 1);
+    uintptr_t end = (uintptr_t)(registers + count);
+    if (msync((void *)start, end - start, MS_SYNC) == 0) {
+        file->sync_count++;
+    } else {
+        perror("msync");
+    }
+}
+
+/*
+ * 处理周期定时器事件
+ */
+void register_file_handle_timer(RegisterFile *file) {
+    uint64_t expirations;
+    if (read(file->timer_fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    if (!file->dirty) {
+        return;
+    }
+    if (msync(file->map, file->map_size, MS_SYNC) == 0) {
+        file->dirty = false;
+        file->sync_count++;
+    } else {
+        perror("msync");
+    }
+}
+
+/*
+ * 同步并关闭文件
+ */
+void register_file_close(RegisterFile *file) {
+    if (file->timer_fd >= 0) {
+        close(file->timer_fd);
+        file->timer_fd = -1;
+    }
+    if (file->map) {
+        if (file->policy != REGISTER_SYNC_NEVER) {
+            msync(file->map, file->map_size, MS_SYNC);
+        }
+        munmap(file->map, file->map_size);
+        file->map = NULL;
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
@@ -0,0 +1,584 @@
+/*
+ * 寄存器映射文件实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "register_map.h"
+#include "device.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+/* ============= 解析 ============= */
+
+/*
+ * 跳过空白（不跨行）
+ */
+static const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * 是否已到行尾（或注释）
+ */
+static bool line_done(const char *p, const char *end) {
+    return p >= end || *p == '#';
+}
+
+/*
+ * 匹配一个关键字（其后必须是空白、行尾或注释）
+ *
+ * 返回：
+ *   匹配时返回关键字之后的位置，否则返回 NULL
+ */
+static const char *match_word(const char *p, const char *end, const char *word) {
+    size_t length = strlen(word);
+    if ((size_t)(end - p) < length || memcmp(p, word, length) != 0) {
+        return NULL;
+    }
+    p += length;
+    if (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '#') {
+        return NULL;
+    }
+    return p;
+}
+
+/*
+ * 解析一个不大于 limit 的非负整数（十进制或 0x 开头的十六进制）
+ *
+ * 返回：
+ *   成功返回数字之后的位置，否则返回 NULL
+ */
+static const char *parse_number(const char *p, const char *end, uint32_t limit, uint32_t *value) {
+    uint64_t result = 0;
+    const char *begin;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        begin = p;
+        for (; p < end; p++) {
+            int digit = (*p >= '0' && *p <= '9') ? *p - '0'
+                      : (*p >= 'a' && *p <= 'f') ? *p - 'a' + 10
+                      : (*p >= 'A' && *p <= 'F') ? *p - 'A' + 10 : -1;
+            if (digit < 0) {
+                break;
+            }
+            result = result * 16 + (uint64_t)digit;
+            if (result > limit) {
+                return NULL;
+            }
+        }
+    } else {
+        begin = p;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            result = result * 10 + (uint64_t)(*p - '0');
+            if (result > limit) {
+                return NULL;
+            }
+        }
+    }
+    if (p == begin) {
+        return NULL;
+    }
+    *value = (uint32_t)result;
+    return p;
+}
+
+/*
+ * 解析访问模式关键字
+ *
+ * 返回：
+ *   成功返回关键字之后的位置，否则返回 NULL
+ */
+static const char *parse_access(const char *p, const char *end, RegisterAccess *access) {
+    static const struct {
+        const char *word;
+        RegisterAccess access;
+    } modes[] = {
+        { "rw", REGISTER_ACCESS_RW },
+        { "ro", REGISTER_ACCESS_RO },
+        { "wo", REGISTER_ACCESS_WO },
+    };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        const char *next = match_word(p, end, modes[i].word);
+        if (next) {
+            *access = modes[i].access;
+            return next;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 为一段分配初值和访问模式数组
+ */
+static bool section_init(RegisterMapSection *section, uint32_t register_count, uint8_t first, uint8_t last) {
+    memset(section, 0, sizeof(*section));
+    section->first_unit = first;
+    section->last_unit = last;
+    for (int b = 0; b < REGISTER_MAP_BANKS; b++) {
+        section->values[b] = calloc(register_count, sizeof(uint16_t));
+        section->access[b] = calloc(register_count, sizeof(uint8_t));
+        if (!section->values[b] || !section->access[b]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * 解析 unit 行
+ */
+static bool parse_unit_line(RegisterMap *map, RegisterMapSection **current, const char *p, const char *end,
+                            char *error, size_t error_size) {
+    p = skip_spaces(p, end);
+    const char *next = match_word(p, end, "default");
+    if (next) {
+        if (!line_done(skip_spaces(next, end), end)) {
+            snprintf(error, error_size, "unit default 之后有多余内容");
+            return false;
+        }
+        *current = &map->sections[0];
+        return true;
+    }
+
+    uint32_t first = 0, last = 0;
+    p = parse_number(p, end, DEVICE_MAX_UNIT, &first);
+    if (p && p < end && *p == '-') {
+        p = parse_number(p + 1, end, DEVICE_MAX_UNIT, &last);
+    } else {
+        last = first;
+    }
+    if (!p || first < DEVICE_MIN_UNIT || last < first || !line_done(skip_spaces(p, end), end)) {
+        snprintf(error, error_size, "格式应为 unit <单元ID>[-<单元ID>] 或 unit default（单元 ID 为 %d 到 %d）",
+                 DEVICE_MIN_UNIT, DEVICE_MAX_UNIT);
+        return false;
+    }
+    for (uint32_t unit = first; unit <= last; unit++) {
+        if (map->unit_section[unit]) {
+            snprintf(error, error_size, "单元 %u 已在前面的 unit 段中", unit);
+            return false;
+        }
+    }
+    if (map->section_count > REGISTER_MAP_MAX_UNIT_SECTIONS) {
+        snprintf(error, error_size, "unit 段最多 %d 个", REGISTER_MAP_MAX_UNIT_SECTIONS);
+        return false;
+    }
+
+    RegisterMapSection *section = &map->sections[map->section_count];
+    map->section_count++;
+    if (!section_init(section, map->register_count, (uint8_t)first, (uint8_t)last)) {
+        snprintf(error, error_size, "内存不足");
+        return false;
+    }
+    for (uint32_t unit = first; unit <= last; unit++) {
+        map->unit_section[unit] = (uint8_t)(map->section_count - 1);
+    }
+    *current = section;
+    return true;
+}
+
+/*
+ * 解析 holding/input 行：<起始地址>[-<结束地址>] [= <值>...] [rw|ro|wo]
+ */
+static bool parse_bank_line(RegisterMap *map, RegisterMapSection *section, int bank, const char *p, const char *end,
+                            char *error, size_t error_size) {
+    uint32_t limit = map->register_count - 1;
+    uint32_t start = 0, last = 0;
+    p = parse_number(skip_spaces(p, end), end, limit, &start);
+    bool ranged = p && p < end && *p == '-';
+    if (ranged) {
+        p = parse_number(p + 1, end, limit, &last);
+    } else {
+        last = start;
+    }
+    if (!p || last < start) {
+        snprintf(error, error_size, "地址应为 <起始>[-<结束>]，且不超过 %u", limit);
+        return false;
+    }
+    uint32_t count = last - start + 1;
+
+    p = skip_spaces(p, end);
+    bool assigned = p < end && *p == '=';
+    if (assigned) {
+        uint16_t *values = section->values[bank];
+        uint32_t n = 0;
+        p = skip_spaces(p + 1, end);
+        while (!line_done(p, end) && *p >= '0' && *p <= '9') {
+            uint32_t value = 0;
+            const char *next = parse_number(p, end, 65535, &value);
+            if (!next || (skip_spaces(next, end) == next && !line_done(next, end))) {
+                snprintf(error, error_size, "寄存器值必须在 0 到 65535 之间");
+                return false;
+            }
+            if (start + n > limit) {
+                snprintf(error, error_size, "从 %u 起的 %u 个值超出寄存器范围", start, n + 1);
+                return false;
+            }
+            values[start + n++] = (uint16_t)value;
+            p = skip_spaces(next, end);
+        }
+        if (n == 0) {
+            snprintf(error, error_size, "= 之后缺少寄存器值");
+            return false;
+        }
+        if (n == 1) {
+            for (uint32_t i = 1; i < count; i++) {
+                values[start + i] = values[start];
+            }
+        } else if (ranged && n != count) {
+            snprintf(error, error_size, "地址范围有 %u 个寄存器，但给出了 %u 个值", count, n);
+            return false;
+        } else {
+            count = n;
+        }
+        section->points += count;
+        map->points += count;
+    }
+
+    RegisterAccess access = REGISTER_ACCESS_RW;
+    bool has_access = false;
+    if (!line_done(p, end)) {
+        p = parse_access(p, end, &access);
+        if (!p) {
+            snprintf(error, error_size, "无法识别的内容（访问模式应为 rw、ro 或 wo）");
+            return false;
+        }
+        has_access = true;
+        p = skip_spaces(p, end);
+    }
+    if (!line_done(p, end) || (!assigned && !has_access)) {
+        snprintf(error, error_size, "格式应为 %s <起始>[-<结束>] [= <值>...] [rw|ro|wo]",
+                 bank == GENERATOR_BANK_INPUT ? "input" : "holding");
+        return false;
+    }
+    if (has_access) {
+        memset(section->access[bank] + start, (int)access, count);
+        if (access != REGISTER_ACCESS_RW) {
+            section->restricted = true;
+        }
+    }
+    return true;
+}
+
+/*
+ * 解析 gen 行（只用于默认寄存器段）
+ */
+static bool parse_generator_line(RegisterMap *map, const RegisterMapSection *section, const char *p,
+                                 const char *end, char *error, size_t error_size) {
+    if (section != &map->sections[0]) {
+        snprintf(error, error_size, "生成器只能用于默认寄存器（请放在 unit default 之后）");
+        return false;
+    }
+    p = skip_spaces(p, end);
+    const char *finish = p;
+    while (finish < end && *finish != '#') {
+        finish++;
+    }
+    while (finish > p && (finish[-1] == ' ' || finish[-1] == '\t' || finish[-1] == '\r')) {
+        finish--;
+    }
+    char spec[GENERATOR_SPEC_LENGTH];
+    if (finish == p || (size_t)(finish - p) >= sizeof(spec)) {
+        snprintf(error, error_size, "生成器规格为空或过长");
+        return false;
+    }
+    memcpy(spec, p, (size_t)(finish - p));
+    spec[finish - p] = '\0';
+    return generator_set_add(&map->generators, spec, map->register_count, error, error_size);
+}
+
+/*
+ * 解析整个文件内容
+ */
+static bool parse_map(RegisterMap *map, const char *text, size_t length, char *error, size_t error_size) {
+    RegisterMapSection *current = &map->sections[0];
+    const char *p = text;
+    const char *text_end = text + length;
+    char reason[192];
+
+    while (p < text_end) {
+        const char *end = memchr(p, '\n', (size_t)(text_end - p));
+        if (!end) {
+            end = text_end;
+        }
+        map->lines++;
+
+        const char *q = skip_spaces(p, end);
+        const char *rest;
+        bool ok = true;
+        if (line_done(q, end)) {
+            ok = true;
+        } else if ((rest = match_word(q, end, "holding")) != NULL) {
+            ok = parse_bank_line(map, current, GENERATOR_BANK_HOLDING, rest, end, reason, sizeof(reason));
+        } else if ((rest = match_word(q, end, "input")) != NULL) {
+            ok = parse_bank_line(map, current, GENERATOR_BANK_INPUT, rest, end, reason, sizeof(reason));
+        } else if ((rest = match_word(q, end, "unit")) != NULL) {
+            ok = parse_unit_line(map, &current, rest, end, reason, sizeof(reason));
+        } else if ((rest = match_word(q, end, "gen")) != NULL) {
+            ok = parse_generator_line(map, current, rest, end, reason, sizeof(reason));
+        } else {
+            snprintf(reason, sizeof(reason), "未知的关键字（可用 holding、input、unit、gen）");
+            ok = false;
+        }
+        if (!ok) {
+            snprintf(error, error_size, "%s 第 %llu 行：%s", map->path, (unsigned long long)map->lines, reason);
+            return false;
+        }
+        p = end + 1;
+    }
+    return true;
+}
+
+/*
+ * 把文件整个读入内存
+ */
+static char *read_file(const char *path, size_t *length, char *error, size_t error_size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        snprintf(error, error_size, "无法打开 %s（%s）", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    char *text = malloc((size_t)st.st_size + 1);
+    if (!text) {
+        snprintf(error, error_size, "内存不足");
+        close(fd);
+        return NULL;
+    }
+    size_t done = 0;
+    while (done < (size_t)st.st_size) {
+        ssize_t n = read(fd, text + done, (size_t)st.st_size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    *length = done;
+    return text;
+}
+
+/*
+ * 读取并解析映射文件，构建各单元段的模板映像
+ */
+RegisterMap *register_map_load(const char *path, uint32_t register_count, char *error, size_t error_size) {
+    struct timespec begin, finish;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    RegisterMap *map = calloc(1, sizeof(*map));
+    if (!map) {
+        snprintf(error, error_size, "内存不足");
+        return NULL;
+    }
+    snprintf(map->path, sizeof(map->path), "%s", path);
+    map->register_count = register_count;
+    generator_set_init(&map->generators);
+    map->sections = calloc(REGISTER_MAP_MAX_UNIT_SECTIONS + 1, sizeof(RegisterMapSection));
+    map->section_count = 1;
+    if (!map->sections || !section_init(&map->sections[0], register_count, 0, 0)) {
+        snprintf(error, error_size, "内存不足");
+        register_map_free(map);
+        return NULL;
+    }
+
+    size_t length = 0;
+    char *text = read_file(path, &length, error, error_size);
+    if (!text) {
+        register_map_free(map);
+        return NULL;
+    }
+    bool parsed = parse_map(map, text, length, error, error_size);
+    free(text);
+    if (!parsed) {
+        register_map_free(map);
+        return NULL;
+    }
+
+    /* 单元段的模板映像也在这里构建，切换时只需交换指针 */
+    for (size_t s = 1; s < map->section_count; s++) {
+        RegisterMapSection *section = &map->sections[s];
+        for (int b = 0; b < REGISTER_MAP_BANKS; b++) {
+            if (!register_bank_init(&section->images[b], register_count, NULL)) {
+                snprintf(error, error_size, "内存不足");
+                register_map_free(map);
+                return NULL;
+            }
+            register_bank_write(&section->images[b], 0, register_count, section->values[b]);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    map->load_usec = (uint64_t)((finish.tv_sec - begin.tv_sec) * 1000000L +
+                                (finish.tv_nsec - begin.tv_nsec) / 1000L);
+    return map;
+}
+
+/*
+ * 释放映射（允许 NULL）
+ */
+void register_map_free(RegisterMap *map) {
+    if (!map) {
+        return;
+    }
+    for (size_t s = 0; map->sections && s < map->section_count; s++) {
+        for (int b = 0; b < REGISTER_MAP_BANKS; b++) {
+            free(map->sections[s].values[b]);
+            free(map->sections[s].access[b]);
+            register_bank_destroy(&map->sections[s].images[b]);
+        }
+    }
+    free(map->sections);
+    generator_set_free(&map->generators);
+    free(map);
+}
+
+/*
+ * 单元 ID 对应的段：0 为默认段，没有单元段时返回 NULL
+ */
+const RegisterMapSection *register_map_section(const RegisterMap *map, uint8_t unit) {
+    if (unit == 0) {
+        return &map->sections[0];
+    }
+    uint8_t index = map->unit_section[unit];
+    return index ? &map->sections[index] : NULL;
+}
+
+/*
+ * 检查一段寄存器是否允许读（或写）；没有访问限制的段全部允许
+ */
+bool register_map_allows(const RegisterMapSection *section, int bank, uint32_t start, uint32_t count, bool write) {
+    if (!section || !section->restricted) {
+        return true;
+    }
+    uint8_t denied = write ? REGISTER_ACCESS_RO : REGISTER_ACCESS_WO;
+    const uint8_t *access = section->access[bank];
+    for (uint32_t i = 0; i < count; i++) {
+        if (access[start + i] == denied) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * 两份映射的单元段划分是否相同（重新加载时不能改变单元段）
+ */
+bool register_map_same_units(const RegisterMap *a, const RegisterMap *b) {
+    if (a->section_count != b->section_count) {
+        return false;
+    }
+    for (size_t s = 1; s < a->section_count; s++) {
+        if (a->sections[s].first_unit != b->sections[s].first_unit ||
+            a->sections[s].last_unit != b->sections[s].last_unit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ============= 后台加载 ============= */
+
+/*
+ * 加载线程：解析完成后通知事件循环
+ */
+static void *loader_thread(void *arg) {
+    RegisterMapLoader *loader = arg;
+    loader->result = register_map_load(loader->path, loader->register_count, loader->error, sizeof(loader->error));
+    uint64_t one = 1;
+    if (write(loader->wake_fd, &one, sizeof(one)) < 0) {
+        perror("write");
+    }
+    return NULL;
+}
+
+/*
+ * 初始化后台加载器，创建通知事件循环的 eventfd
+ */
+bool register_map_loader_init(RegisterMapLoader *loader) {
+    memset(loader, 0, sizeof(*loader));
+    loader->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loader->wake_fd < 0) {
+        perror("eventfd");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 启动加载线程（已有加载在进行时返回 false）
+ */
+bool register_map_loader_start(RegisterMapLoader *loader, const char *path, uint32_t register_count) {
+    if (loader->running) {
+        return false;
+    }
+    snprintf(loader->path, sizeof(loader->path), "%s", path);
+    loader->register_count = register_count;
+    loader->result = NULL;
+    loader->error[0] = '\0';
+
+    /* 加载线程屏蔽全部信号，SIGINT 等进程信号只由事件循环线程处理 */
+    sigset_t all_signals, previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+    int error = pthread_create(&loader->thread, NULL, loader_thread, loader);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0) {
+        snprintf(loader->error, sizeof(loader->error), "无法创建加载线程（%s）", strerror(error));
+        return false;
+    }
+    loader->running = true;
+    return true;
+}
+
+/*
+ * wake_fd 可读后回收加载线程，返回解析结果或错误原因
+ */
+RegisterMap *register_map_loader_finish(RegisterMapLoader *loader, char *error, size_t error_size) {
+    uint64_t count;
+    if (read(loader->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("read");
+    }
+    if (!loader->running) {
+        snprintf(error, error_size, "没有正在进行的加载");
+        return NULL;
+    }
+    pthread_join(loader->thread, NULL);
+    loader->running = false;
+    if (!loader->result) {
+        snprintf(error, error_size, "%s", loader->error);
+    }
+    return loader->result;
+}
+
+/*
+ * 等待进行中的加载结束并关闭 eventfd
+ */
+void register_map_loader_close(RegisterMapLoader *loader) {
+    if (loader->running) {
+        pthread_join(loader->thread, NULL);
+        loader->running = false;
+        register_map_free(loader->result);
+        loader->result = NULL;
+    }
+    if (loader->wake_fd >= 0) {
+        close(loader->wake_fd);
+    }
+    loader->wake_fd = -1;
+}
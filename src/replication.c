@@ -0,0 +1,929 @@
+/*
+ * 主备复制实现
+ */
+
+#define _GNU_SOURCE
+
+#include "replication.h"
+#include "snapshot.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/* 备机检查重连的定时器周期（毫秒） */
+#define REPLICATION_TICK_MS 100
+
+/* 连接主机的超时（毫秒） */
+#define REPLICATION_CONNECT_TIMEOUT_MS 2000
+
+/* 重连退避间隔的下限与上限（毫秒） */
+#define REPLICATION_RETRY_MIN_MS 200
+#define REPLICATION_RETRY_MAX_MS 5000
+
+/* 规格的最大长度 */
+#define REPLICATION_SPEC_LENGTH 64
+
+/*
+ * 指定时钟的当前时刻（纳秒）
+ */
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 角色名称
+ */
+const char *replication_role_name(ReplicationRole role) {
+    switch (role) {
+        case REPLICATION_ROLE_PRIMARY:
+            return "主机";
+        case REPLICATION_ROLE_BACKUP:
+            return "备机";
+        default:
+            return "未启用";
+    }
+}
+
+/*
+ * 连接状态名称
+ */
+const char *replication_link_state_name(ReplicationLinkState state) {
+    switch (state) {
+        case REPLICATION_LINK_CONNECTING:
+            return "连接中";
+        case REPLICATION_LINK_SYNCING:
+            return "等待快照";
+        case REPLICATION_LINK_STREAMING:
+            return "复制中";
+        default:
+            return "未连接";
+    }
+}
+
+/*
+ * 初始化为未启用复制
+ */
+void replication_init(Replication *replication) {
+    memset(replication, 0, sizeof(*replication));
+    replication->epoll_fd = -1;
+    replication->listen_fd = -1;
+    replication->link_fd = -1;
+    replication->timer_fd = -1;
+    replication->retry_ms = REPLICATION_RETRY_MIN_MS;
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        replication->peers[i].fd = -1;
+    }
+}
+
+/*
+ * 解析 [<地址>:]<端口>
+ *
+ * 参数：
+ *   require_host - 是否必须给出地址（省略时取 127.0.0.1）
+ *   addr - 输出：套接字地址
+ *   name - 输出："地址:端口"
+ *
+ * 返回：
+ *   成功返回 true
+ */
+static bool parse_address(const char *spec, bool require_host, struct sockaddr_in *addr, char *name,
+                          size_t name_size, char *error, size_t error_size) {
+    char text[REPLICATION_SPEC_LENGTH];
+    if (strlen(spec) >= sizeof(text)) {
+        snprintf(error, error_size, "规格过长");
+        return false;
+    }
+    strcpy(text, spec);
+
+    const char *host = "127.0.0.1";
+    char *port_text = text;
+    char *colon = strrchr(text, ':');
+    if (colon) {
+        *colon = '\0';
+        host = text;
+        port_text = colon + 1;
+    } else if (require_host) {
+        snprintf(error, error_size, "格式应为 <地址>:<端口>");
+        return false;
+    }
+
+    struct in_addr address;
+    if (inet_pton(AF_INET, host, &address) != 1) {
+        snprintf(error, error_size, "无效的 IPv4 地址 %s", host);
+        return false;
+    }
+    char *end = NULL;
+    unsigned long port = isdigit((unsigned char)*port_text) ? strtoul(port_text, &end, 10) : 0;
+    if (port < 1 || port > 65535 || *end != '\0') {
+        snprintf(error, error_size, "端口必须在 1 到 65535 之间");
+        return false;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr = address;
+    addr->sin_port = htons((uint16_t)port);
+    snprintf(name, name_size, "%s:%lu", host, port);
+    return true;
+}
+
+/*
+ * 设置接受备机连接的地址（-P），省略地址时只监听 127.0.0.1
+ */
+bool replication_listen_on(Replication *replication, const char *spec, char *error, size_t error_size) {
+    if (!parse_address(spec, false, &replication->listen_addr, replication->listen_name,
+                       sizeof(replication->listen_name), error, error_size)) {
+        return false;
+    }
+    if (replication->role == REPLICATION_ROLE_NONE) {
+        replication->role = REPLICATION_ROLE_PRIMARY;
+    }
+    return true;
+}
+
+/*
+ * 设置为备机并解析主机地址（-F）
+ */
+bool replication_follow(Replication *replication, const char *spec, char *error, size_t error_size) {
+    if (!parse_address(spec, true, &replication->primary_addr, replication->primary_name,
+                       sizeof(replication->primary_name), error, error_size)) {
+        return false;
+    }
+    replication->role = REPLICATION_ROLE_BACKUP;
+    return true;
+}
+
+/*
+ * 按需增减对 EPOLLOUT 的关注
+ */
+static void set_write_interest(Replication *replication, int fd, bool *current, bool want_write) {
+    if (*current == want_write) {
+        return;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    epoll_ctl(replication->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    *current = want_write;
+}
+
+/*
+ * 断开一个备机（它重连后重新同步）
+ */
+static void peer_drop(Replication *replication, ReplicationPeer *peer, const char *reason) {
+    printf("[复制] 备机 %s 已断开：%s（已确认序列号 %llu，积压 %zu 字节）\n",
+           peer->name, reason, (unsigned long long)peer->acked_sequence, peer->tx_length);
+    epoll_ctl(replication->epoll_fd, EPOLL_CTL_DEL, peer->fd, NULL);
+    close(peer->fd);
+    free(peer->tx);
+    memset(peer, 0, sizeof(*peer));
+    peer->fd = -1;
+}
+
+/*
+ * 尽量写出备机的积压数据，写不完时关注 EPOLLOUT
+ *
+ * 返回：
+ *   连接出错返回 false
+ */
+static bool peer_flush(Replication *replication, ReplicationPeer *peer) {
+    size_t written = 0;
+    while (written < peer->tx_length) {
+        ssize_t n = send(peer->fd, peer->tx + written, peer->tx_length - written, MSG_NOSIGNAL);
+        if (n > 0) {
+            written += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (written > 0) {
+        memmove(peer->tx, peer->tx + written, peer->tx_length - written);
+        peer->tx_length -= written;
+        peer->sent_bytes += written;
+    }
+    set_write_interest(replication, peer->fd, &peer->want_write, peer->tx_length > 0);
+    return true;
+}
+
+/*
+ * 追加到备机的积压数据；积压超过上限或内存不足时断开备机
+ *
+ * 返回：
+ *   成功返回 true
+ */
+static bool peer_queue(Replication *replication, ReplicationPeer *peer, const void *data, size_t length) {
+    size_t needed = peer->tx_length + length;
+    if (needed > REPLICATION_MAX_PENDING) {
+        replication->dropped++;
+        peer_drop(replication, peer, "发送积压超过上限");
+        return false;
+    }
+    if (needed > peer->tx_capacity) {
+        size_t capacity = peer->tx_capacity ? peer->tx_capacity : REPLICATION_BATCH_SIZE;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint8_t *tx = realloc(peer->tx, capacity);
+        if (!tx) {
+            replication->dropped++;
+            peer_drop(replication, peer, "内存不足");
+            return false;
+        }
+        peer->tx = tx;
+        peer->tx_capacity = capacity;
+    }
+    memcpy(peer->tx + peer->tx_length, data, length);
+    peer->tx_length += length;
+    return true;
+}
+
+/*
+ * 排入一份完整快照：文件头与快照文件相同，journal_sequence 填当前复制序列号
+ */
+static bool peer_queue_snapshot(Replication *replication, ReplicationPeer *peer) {
+    uint32_t count = replication->register_count;
+    uint16_t *holding = replication->image;
+    uint16_t *input = replication->image + count;
+    register_bank_read(replication->holding, 0, count, holding);
+    register_bank_read(replication->input, 0, count, input);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order_mark = SNAPSHOT_BYTE_ORDER_MARK;
+    header.register_count = count;
+    header.journal_sequence = replication->sequence;
+    header.timestamp_ns = clock_ns(CLOCK_REALTIME);
+    header.checksum = snapshot_checksum(holding, input, count);
+
+    if (!peer_queue(replication, peer, &header, sizeof(header)) ||
+        !peer_queue(replication, peer, replication->image, (size_t)count * 2 * sizeof(uint16_t))) {
+        return false;
+    }
+    peer->snapshot_sequence = replication->sequence;
+    peer->acked_sequence = replication->sequence;
+    replication->snapshots_sent++;
+    return true;
+}
+
+/*
+ * 读取备机发来的握手和确认
+ *
+ * 返回：
+ *   备机已被断开返回 false
+ */
+static bool peer_receive(Replication *replication, ReplicationPeer *peer) {
+    while (1) {
+        ssize_t n = recv(peer->fd, peer->rx + peer->rx_length, sizeof(peer->rx) - peer->rx_length, 0);
+        if (n == 0) {
+            peer_drop(replication, peer, "备机关闭连接");
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            peer_drop(replication, peer, strerror(errno));
+            return false;
+        }
+        peer->rx_length += (size_t)n;
+
+        size_t offset = 0;
+        if (!peer->streaming) {
+            ReplicationHello hello;
+            if (peer->rx_length < sizeof(hello)) {
+                continue;
+            }
+            memcpy(&hello, peer->rx, sizeof(hello));
+            if (hello.magic != REPLICATION_MAGIC || hello.version != REPLICATION_VERSION ||
+                hello.byte_order_mark != JOURNAL_BYTE_ORDER_MARK) {
+                peer_drop(replication, peer, "握手无效");
+                return false;
+            }
+            if (hello.register_count != replication->register_count) {
+                peer_drop(replication, peer, "寄存器数量与主机不一致");
+                return false;
+            }
+            if (!peer_queue_snapshot(replication, peer)) {
+                return false;
+            }
+            peer->streaming = true;
+            offset = sizeof(hello);
+            printf("[复制] 备机 %s 已握手，发送快照（序列号 %llu）\n",
+                   peer->name, (unsigned long long)peer->snapshot_sequence);
+            if (!peer_flush(replication, peer)) {
+                peer_drop(replication, peer, strerror(errno));
+                return false;
+            }
+        }
+
+        /* 确认：备机已应用的最后一个序列号 */
+        while (peer->rx_length - offset >= sizeof(uint64_t)) {
+            memcpy(&peer->acked_sequence, peer->rx + offset, sizeof(uint64_t));
+            offset += sizeof(uint64_t);
+        }
+        memmove(peer->rx, peer->rx + offset, peer->rx_length - offset);
+        peer->rx_length -= offset;
+    }
+}
+
+/*
+ * 接受备机连接；尚未提升的备机或已满时拒绝
+ */
+static void accept_backups(Replication *replication) {
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addr_length = sizeof(addr);
+        int fd = accept4(replication->listen_fd, (struct sockaddr *)&addr, &addr_length,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept4");
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        char name[32];
+        char host[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+        snprintf(name, sizeof(name), "%s:%u", host, ntohs(addr.sin_port));
+
+        ReplicationPeer *peer = NULL;
+        for (int i = 0; i < REPLICATION_MAX_BACKUPS && !peer; i++) {
+            if (replication->peers[i].fd < 0) {
+                peer = &replication->peers[i];
+            }
+        }
+        if (replication->role != REPLICATION_ROLE_PRIMARY || !peer) {
+            printf("[复制] 拒绝备机 %s 的连接：%s\n", name,
+                   peer ? "本机是尚未提升的备机" : "备机数已达上限");
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (epoll_ctl(replication->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            continue;
+        }
+        memset(peer, 0, sizeof(*peer));
+        peer->fd = fd;
+        peer->connected_ns = clock_ns(CLOCK_MONOTONIC);
+        snprintf(peer->name, sizeof(peer->name), "%s", name);
+        printf("[复制] 备机 %s 已连接\n", peer->name);
+    }
+}
+
+/*
+ * 主机把一条写入记录追加到本轮批次，批次写满时先发出
+ */
+void replication_append(Replication *replication, uint8_t bank, uint8_t unit_id, uint16_t address,
+                        uint16_t value) {
+    if (replication->role != REPLICATION_ROLE_PRIMARY) {
+        return;
+    }
+    if (replication->batched + sizeof(JournalRecord) > REPLICATION_BATCH_SIZE) {
+        replication_flush(replication);
+    }
+    JournalRecord record;
+    journal_fill_record(&record, ++replication->sequence, bank, unit_id, address, value);
+    memcpy(replication->batch + replication->batched, &record, sizeof(record));
+    replication->batched += sizeof(record);
+    replication->records++;
+}
+
+/*
+ * 主机累计设备寄存器上不复制的写入个数
+ */
+void replication_note_unreplicated(Replication *replication, uint32_t count) {
+    if (replication->role == REPLICATION_ROLE_PRIMARY) {
+        replication->unreplicated += count;
+    }
+}
+
+/*
+ * 本轮是否有待发出的记录
+ */
+bool replication_pending(const Replication *replication) {
+    return replication->batched > 0;
+}
+
+/*
+ * 把本轮批次排入每个已同步备机的发送队列并尽量写出
+ */
+void replication_flush(Replication *replication) {
+    if (replication->batched == 0) {
+        return;
+    }
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        ReplicationPeer *peer = &replication->peers[i];
+        if (peer->fd < 0 || !peer->streaming) {
+            continue;
+        }
+        if (peer_queue(replication, peer, replication->batch, replication->batched) &&
+            !peer_flush(replication, peer)) {
+            replication->dropped++;
+            peer_drop(replication, peer, strerror(errno));
+        }
+    }
+    uint64_t group = replication->batched / sizeof(JournalRecord);
+    if (group > replication->largest_batch) {
+        replication->largest_batch = group;
+    }
+    replication->batches++;
+    replication->batched = 0;
+}
+
+/*
+ * 关闭到主机的连接，安排退避重连（重连后重新接收快照）
+ */
+static void link_fail(Replication *replication, const char *reason) {
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    if (replication->link_fd >= 0) {
+        epoll_ctl(replication->epoll_fd, EPOLL_CTL_DEL, replication->link_fd, NULL);
+        close(replication->link_fd);
+    }
+    printf("[复制] 与主机 %s 的连接%s：%s，%u 毫秒后重连（已应用序列号 %llu，读请求回复忙直到重新同步）\n",
+           replication->primary_name,
+           replication->link_state == REPLICATION_LINK_CONNECTING ? "无法建立" : "已断开",
+           reason, replication->retry_ms, (unsigned long long)replication->applied_sequence);
+
+    replication->link_fd = -1;
+    replication->link_state = REPLICATION_LINK_DOWN;
+    replication->state_ns = now;
+    replication->retry_ns = now + (uint64_t)replication->retry_ms * 1000000ULL;
+    replication->retry_ms = replication->retry_ms * 2 > REPLICATION_RETRY_MAX_MS
+                                ? REPLICATION_RETRY_MAX_MS : replication->retry_ms * 2;
+    replication->rx_length = 0;
+    replication->failures++;
+}
+
+/*
+ * 发起到主机的非阻塞连接
+ */
+static void link_connect(Replication *replication) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        link_fail(replication, strerror(errno));
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    replication->link_fd = fd;
+    replication->link_state = REPLICATION_LINK_CONNECTING;
+    replication->state_ns = clock_ns(CLOCK_MONOTONIC);
+
+    struct epoll_event event;
+    event.events = EPOLLOUT | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (epoll_ctl(replication->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 ||
+        (connect(fd, (const struct sockaddr *)&replication->primary_addr, sizeof(replication->primary_addr)) < 0 &&
+         errno != EINPROGRESS)) {
+        link_fail(replication, strerror(errno));
+    }
+}
+
+/*
+ * 连接完成：发送握手，等待快照
+ */
+static void link_connected(Replication *replication) {
+    int error = 0;
+    socklen_t error_length = sizeof(error);
+    if (getsockopt(replication->link_fd, SOL_SOCKET, SO_ERROR, &error, &error_length) < 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        link_fail(replication, strerror(error));
+        return;
+    }
+
+    ReplicationHello hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = REPLICATION_MAGIC;
+    hello.version = REPLICATION_VERSION;
+    hello.byte_order_mark = JOURNAL_BYTE_ORDER_MARK;
+    hello.register_count = replication->register_count;
+    if (send(replication->link_fd, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+        link_fail(replication, "发送握手失败");
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = replication->link_fd;
+    epoll_ctl(replication->epoll_fd, EPOLL_CTL_MOD, replication->link_fd, &event);
+    replication->link_state = REPLICATION_LINK_SYNCING;
+    replication->state_ns = clock_ns(CLOCK_MONOTONIC);
+    replication->retry_ms = REPLICATION_RETRY_MIN_MS;
+    replication->acked_sequence = 0;
+    replication->connects++;
+    printf("[复制] 已连接主机 %s，等待快照\n", replication->primary_name);
+}
+
+/*
+ * 处理收到的数据：先是一份完整快照，之后是按序列号连续的写入记录
+ *
+ * 返回：
+ *   成功返回 NULL，数据无效时返回原因
+ */
+static const char *link_process(Replication *replication) {
+    uint32_t count = replication->register_count;
+    size_t offset = 0;
+
+    if (replication->link_state == REPLICATION_LINK_SYNCING) {
+        size_t image_bytes = (size_t)count * 2 * sizeof(uint16_t);
+        if (replication->rx_length < sizeof(SnapshotHeader) + image_bytes) {
+            return NULL;
+        }
+        SnapshotHeader header;
+        memcpy(&header, replication->rx, sizeof(header));
+        if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+            header.byte_order_mark != SNAPSHOT_BYTE_ORDER_MARK) {
+            return "主机发来的快照格式无效";
+        }
+        if (header.register_count != count) {
+            return "主机的寄存器数量与本机不一致";
+        }
+        memcpy(replication->image, replication->rx + sizeof(header), image_bytes);
+        if (snapshot_checksum(replication->image, replication->image + count, count) != header.checksum) {
+            return "快照校验和不匹配";
+        }
+        replication->load(replication->image, replication->image + count, count, replication->context);
+        replication->applied_sequence = header.journal_sequence;
+        replication->snapshots_loaded++;
+        replication->link_state = REPLICATION_LINK_STREAMING;
+        replication->state_ns = clock_ns(CLOCK_MONOTONIC);
+        offset = sizeof(header) + image_bytes;
+        printf("[复制] 已应用主机 %s 的快照（序列号 %llu），开始复制写入\n",
+               replication->primary_name, (unsigned long long)header.journal_sequence);
+    }
+
+    while (replication->link_state == REPLICATION_LINK_STREAMING &&
+           replication->rx_length - offset >= sizeof(JournalRecord)) {
+        JournalRecord record;
+        memcpy(&record, replication->rx + offset, sizeof(record));
+        if (!journal_record_valid(&record)) {
+            return "写入记录校验失败";
+        }
+        offset += sizeof(record);
+        if (record.sequence <= replication->applied_sequence) {
+            continue;  /* 快照已包含 */
+        }
+        if (record.sequence != replication->applied_sequence + 1) {
+            return "写入记录序列号不连续";
+        }
+        if (record.address < count) {
+            replication->apply(&record, replication->context);
+        }
+        replication->applied_sequence = record.sequence;
+        replication->applied_records++;
+
+        uint64_t now = clock_ns(CLOCK_REALTIME);
+        uint64_t lag = now > record.timestamp_ns ? now - record.timestamp_ns : 0;
+        replication->last_lag_ns = lag;
+        replication->lag_total_ns += lag;
+        if (lag > replication->max_lag_ns) {
+            replication->max_lag_ns = lag;
+        }
+    }
+
+    memmove(replication->rx, replication->rx + offset, replication->rx_length - offset);
+    replication->rx_length -= offset;
+    return NULL;
+}
+
+/*
+ * 读取主机推送的数据并应用，之后回送已应用的序列号
+ *
+ * 返回：
+ *   成功返回 NULL，连接出错或数据无效时返回原因
+ */
+static const char *link_receive(Replication *replication) {
+    while (1) {
+        if (replication->rx_length == replication->rx_capacity) {
+            const char *reason = link_process(replication);
+            if (reason) {
+                return reason;
+            }
+        }
+        ssize_t n = recv(replication->link_fd, replication->rx + replication->rx_length,
+                         replication->rx_capacity - replication->rx_length, 0);
+        if (n > 0) {
+            replication->rx_length += (size_t)n;
+            replication->last_receive_ns = clock_ns(CLOCK_MONOTONIC);
+            continue;
+        }
+        if (n == 0) {
+            return "主机关闭连接";
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        return strerror(errno);
+    }
+
+    const char *reason = link_process(replication);
+    if (reason) {
+        return reason;
+    }
+
+    /* 每处理完一批回送一次；套接字暂时写不进时留到下一批 */
+    if (replication->link_state == REPLICATION_LINK_STREAMING &&
+        replication->applied_sequence != replication->acked_sequence) {
+        ssize_t n = send(replication->link_fd, &replication->applied_sequence, sizeof(uint64_t), MSG_NOSIGNAL);
+        if (n == (ssize_t)sizeof(uint64_t)) {
+            replication->acked_sequence = replication->applied_sequence;
+        } else if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return "回送确认失败";
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 备机定时器：到时重连，连接超时则放弃本次连接
+ */
+static void handle_timer(Replication *replication) {
+    uint64_t expirations;
+    if (read(replication->timer_fd, &expirations, sizeof(expirations)) < 0 ||
+        replication->role != REPLICATION_ROLE_BACKUP) {
+        return;
+    }
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    if (replication->link_state == REPLICATION_LINK_DOWN && now >= replication->retry_ns) {
+        link_connect(replication);
+    } else if (replication->link_state == REPLICATION_LINK_CONNECTING &&
+               now - replication->state_ns > (uint64_t)REPLICATION_CONNECT_TIMEOUT_MS * 1000000ULL) {
+        link_fail(replication, "连接超时");
+    }
+}
+
+/*
+ * 打开接受备机的监听套接字
+ */
+static bool open_listener(Replication *replication) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (const struct sockaddr *)&replication->listen_addr, sizeof(replication->listen_addr)) < 0 ||
+        listen(fd, REPLICATION_MAX_BACKUPS) < 0) {
+        fprintf(stderr, "错误: 无法在 %s 上接受备机连接（%s）。\n", replication->listen_name, strerror(errno));
+        close(fd);
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(replication->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl");
+        close(fd);
+        return false;
+    }
+    replication->listen_fd = fd;
+    return true;
+}
+
+/*
+ * 分配快照缓冲区并打开监听套接字；备机还启动重连定时器，发起到主机的连接
+ */
+bool replication_start(Replication *replication, int epoll_fd, RegisterBank *holding, RegisterBank *input,
+                       JournalApplyFunc apply, ReplicationLoadFunc load, void *context) {
+    if (replication->role == REPLICATION_ROLE_NONE) {
+        return true;
+    }
+    replication->epoll_fd = epoll_fd;
+    replication->holding = holding;
+    replication->input = input;
+    replication->register_count = holding->register_count;
+    replication->apply = apply;
+    replication->load = load;
+    replication->context = context;
+
+    size_t image_bytes = (size_t)replication->register_count * 2 * sizeof(uint16_t);
+    replication->image = malloc(image_bytes);
+    if (!replication->image) {
+        fprintf(stderr, "错误: 复制缓冲区内存分配失败。\n");
+        return false;
+    }
+    if (replication->listen_name[0] && !open_listener(replication)) {
+        return false;
+    }
+    if (replication->role != REPLICATION_ROLE_BACKUP) {
+        return true;
+    }
+
+    /* 备机：接收缓冲区至少能放下一份完整快照 */
+    replication->rx_capacity = sizeof(SnapshotHeader) + image_bytes;
+    if (replication->rx_capacity < REPLICATION_BATCH_SIZE) {
+        replication->rx_capacity = REPLICATION_BATCH_SIZE;
+    }
+    replication->rx = malloc(replication->rx_capacity);
+    if (!replication->rx) {
+        fprintf(stderr, "错误: 复制缓冲区内存分配失败。\n");
+        return false;
+    }
+
+    replication->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (replication->timer_fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = REPLICATION_TICK_MS * 1000000L;
+    spec.it_value = spec.it_interval;
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = replication->timer_fd;
+    if (timerfd_settime(replication->timer_fd, 0, &spec, NULL) < 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, replication->timer_fd, &event) < 0) {
+        perror("replication timer");
+        return false;
+    }
+    link_connect(replication);
+    return true;
+}
+
+/*
+ * 是否是尚未提升的备机
+ */
+bool replication_read_only(const Replication *replication) {
+    return replication->role == REPLICATION_ROLE_BACKUP;
+}
+
+/*
+ * 备机的连接是否不在复制中状态（未连上、等待快照或断线）
+ */
+bool replication_syncing(const Replication *replication) {
+    return replication->role == REPLICATION_ROLE_BACKUP && replication->link_state != REPLICATION_LINK_STREAMING;
+}
+
+/*
+ * 把备机提升为主机：关闭到原主机的连接和定时器，序列号从已应用处继续
+ *
+ * 从未应用过快照时只有 force 才提升
+ */
+bool replication_promote(Replication *replication, bool force) {
+    if (replication->role != REPLICATION_ROLE_BACKUP || (replication->snapshots_loaded == 0 && !force)) {
+        return false;
+    }
+    if (replication->link_fd >= 0) {
+        epoll_ctl(replication->epoll_fd, EPOLL_CTL_DEL, replication->link_fd, NULL);
+        close(replication->link_fd);
+        replication->link_fd = -1;
+    }
+    if (replication->timer_fd >= 0) {
+        epoll_ctl(replication->epoll_fd, EPOLL_CTL_DEL, replication->timer_fd, NULL);
+        close(replication->timer_fd);
+        replication->timer_fd = -1;
+    }
+    replication->link_state = REPLICATION_LINK_DOWN;
+    replication->rx_length = 0;
+    replication->role = REPLICATION_ROLE_PRIMARY;
+    replication->sequence = replication->applied_sequence;
+    replication->promoted_ns = clock_ns(CLOCK_MONOTONIC);
+    printf("[复制] 已提升为主机（%s序列号 %llu）%s\n",
+           replication->snapshots_loaded ? "已应用到" : "强制提升，未应用过快照，寄存器为初值，",
+           (unsigned long long)replication->applied_sequence,
+           replication->listen_fd >= 0 ? "，开始接受备机" : "");
+    return true;
+}
+
+/*
+ * 按描述符查找备机连接
+ */
+static ReplicationPeer *find_peer(const Replication *replication, int fd) {
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        if (replication->peers[i].fd == fd) {
+            return (ReplicationPeer *)&replication->peers[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 描述符是否属于复制
+ */
+bool replication_owns_fd(const Replication *replication, int fd) {
+    return replication->role != REPLICATION_ROLE_NONE && fd >= 0 &&
+           (fd == replication->listen_fd || fd == replication->link_fd || fd == replication->timer_fd ||
+            find_peer(replication, fd));
+}
+
+/*
+ * 按描述符分派复制事件：监听套接字、备机连接、主机连接或重连定时器
+ */
+void replication_handle_event(Replication *replication, int fd, uint32_t events) {
+    if (fd == replication->timer_fd) {
+        handle_timer(replication);
+        return;
+    }
+    if (fd == replication->listen_fd) {
+        accept_backups(replication);
+        return;
+    }
+    if (fd == replication->link_fd) {
+        if (replication->link_state == REPLICATION_LINK_CONNECTING) {
+            link_connected(replication);
+            return;
+        }
+        const char *reason = (events & EPOLLIN) ? link_receive(replication) : NULL;
+        if (!reason && (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))) {
+            reason = "主机关闭连接";
+        }
+        if (reason) {
+            link_fail(replication, reason);
+        }
+        return;
+    }
+
+    ReplicationPeer *peer = find_peer(replication, fd);
+    if (!peer) {
+        return;
+    }
+    if ((events & EPOLLIN) && !peer_receive(replication, peer)) {
+        return;
+    }
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        peer_drop(replication, peer, "备机关闭连接");
+        return;
+    }
+    if ((events & EPOLLOUT) && !peer_flush(replication, peer)) {
+        replication->dropped++;
+        peer_drop(replication, peer, strerror(errno));
+    }
+}
+
+/*
+ * 当前连接的备机数
+ */
+size_t replication_backup_count(const Replication *replication) {
+    size_t count = 0;
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        count += replication->peers[i].fd >= 0 ? 1 : 0;
+    }
+    return count;
+}
+
+/*
+ * 关闭全部连接和定时器并释放内存，主机先尽量写出剩余批次
+ */
+void replication_close(Replication *replication) {
+    replication_flush(replication);
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        ReplicationPeer *peer = &replication->peers[i];
+        if (peer->fd >= 0) {
+            close(peer->fd);
+            peer->fd = -1;
+        }
+        free(peer->tx);
+        peer->tx = NULL;
+    }
+    int fds[] = { replication->listen_fd, replication->link_fd, replication->timer_fd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    replication->listen_fd = -1;
+    replication->link_fd = -1;
+    replication->timer_fd = -1;
+    free(replication->rx);
+    free(replication->image);
+    replication->rx = NULL;
+    replication->image = NULL;
+}
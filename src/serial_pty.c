@@ -0,0 +1,190 @@
+/*
+ * 伪终端（PTY）串口从站实现
+ *
+ * 使用 posix_openpt 创建串口线路，使用 timerfd 精确检测 t3.5 帧间隔
+ */
+
+#define _GNU_SOURCE
+
+#include "serial_pty.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/timerfd.h>
+
+/*
+ * 将 t3.5 定时器设置为从现在起 t35_usec 后到期（一次性）
+ */
+static bool arm_frame_timer(SerialLine *line) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = line->t35_usec / 1000000;
+    spec.it_value.tv_nsec = (long)(line->t35_usec % 1000000) * 1000;
+    return timerfd_settime(line->timer_fd, 0, &spec, NULL) == 0;
+}
+
+/*
+ * 打开一条 PTY 串口线路
+ */
+bool serial_pty_open(SerialLine *line, uint32_t baud_rate) {
+    memset(line, 0, sizeof(*line));
+    line->master_fd = -1;
+    line->slave_fd = -1;
+    line->timer_fd = -1;
+
+    line->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (line->master_fd < 0) {
+        perror("posix_openpt");
+        return false;
+    }
+    if (grantpt(line->master_fd) < 0 || unlockpt(line->master_fd) < 0) {
+        perror("grantpt/unlockpt");
+        serial_pty_close(line);
+        return false;
+    }
+    if (ptsname_r(line->master_fd, line->slave_name, sizeof(line->slave_name)) != 0) {
+        perror("ptsname_r");
+        serial_pty_close(line);
+        return false;
+    }
+
+    /* 服务器自己持有一个从端描述符：没有外部主站打开时主端也不会持续报告 HUP */
+    line->slave_fd = open(line->slave_name, O_RDWR | O_NOCTTY);
+    if (line->slave_fd < 0) {
+        perror("open pty slave");
+        serial_pty_close(line);
+        return false;
+    }
+
+    /* 从端设为 raw 模式：不做换行转换，不回显，二进制帧原样透传 */
+    struct termios tio;
+    if (tcgetattr(line->slave_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(line->slave_fd, TCSANOW, &tio);
+    }
+
+    line->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (line->timer_fd < 0) {
+        perror("timerfd_create");
+        serial_pty_close(line);
+        return false;
+    }
+
+    line->baud_rate = baud_rate;
+    line->t35_usec = modbus_rtu_t35_usec(baud_rate);
+    line->active = true;
+    return true;
+}
+
+/*
+ * 关闭线路
+ */
+void serial_pty_close(SerialLine *line) {
+    if (line->timer_fd >= 0) {
+        close(line->timer_fd);
+    }
+    if (line->slave_fd >= 0) {
+        close(line->slave_fd);
+    }
+    if (line->master_fd >= 0) {
+        close(line->master_fd);
+    }
+    line->timer_fd = -1;
+    line->slave_fd = -1;
+    line->master_fd = -1;
+    line->active = false;
+}
+
+/*
+ * 处理主端可读事件
+ *
+ * 读到的字节追加到当前帧；帧超过 RTU 最大长度时标记溢出并继续读空，
+ * 等 t3.5 到期后整帧丢弃。每批字节都会把定时器推迟到 t3.5 之后。
+ */
+bool serial_pty_handle_input(SerialLine *line) {
+    bool got_data = false;
+
+    while (1) {
+        uint8_t chunk[MODBUS_RTU_MAX_ADU_LENGTH];
+        ssize_t n = read(line->master_fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read pty");
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        got_data = true;
+        if (line->overflow || line->frame_length + (size_t)n > sizeof(line->frame)) {
+            line->overflow = true;
+            continue;
+        }
+        memcpy(&line->frame[line->frame_length], chunk, (size_t)n);
+        line->frame_length += (size_t)n;
+    }
+
+    if (got_data && !arm_frame_timer(line)) {
+        perror("timerfd_settime");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 处理定时器到期事件
+ */
+bool serial_pty_take_frame(SerialLine *line, const uint8_t **frame, size_t *length) {
+    uint64_t expirations;
+    if (read(line->timer_fd, &expirations, sizeof(expirations)) < 0) {
+        /* 定时器在读取前已被重新设置（又有新字节到达），帧尚未结束 */
+        return false;
+    }
+
+    bool complete = !line->overflow && line->frame_length > 0;
+    if (complete) {
+        *frame = line->frame;
+        *length = line->frame_length;
+        line->frames_received++;
+    } else if (line->overflow) {
+        line->frames_dropped++;
+    }
+
+    /* 下一帧从头开始累积（调用者须在下次读取前用完本帧） */
+    line->frame_length = 0;
+    line->overflow = false;
+    return complete;
+}
+
+/*
+ * 向主端写入响应帧
+ */
+bool serial_pty_write(SerialLine *line, const uint8_t *data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(line->master_fd, data + written, length - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                /* 从端无人读取，输入队列已满：与真实串口一样直接丢弃 */
+                return false;
+            }
+            perror("write pty");
+            return false;
+        }
+        written += (size_t)n;
+    }
+    return true;
+}
@@ -3,11 +3,35 @@
  * 
  * 功能描述：
  * - 基于 epoll 的高性能多客户端并发服务器
- * - 支持最多 128 个客户端同时连接
+ * - 支持最多 MAX_CLIENTS（1024）个客户端同时连接
  * - 每个客户端使用 socket 文件描述符作为唯一标识
  * - 服务器可向指定客户端发送消息或广播消息
  * - 实现回显（Echo）协议，将客户端发来的消息前添加 "Echo: " 前缀后返回
  * - 支持 Modbus TCP 协议，作为 Modbus 服务器处理 FC03 和 FC06 请求
+ * - 可选的 Unix 域套接字监听（-u），供同机主站绕过 TCP/IP 协议栈访问
+ * - 可选的 Modbus RTU 帧格式：RTU-over-TCP 监听（-r）和 PTY 串口从站（-s/-b）
+ * - 可选的 Modbus/TCP Security 监听（-t），TLS 会话复用并在握手后启用内核 TLS
+ * - 可选的寄存器持久化文件（-p/-y），寄存器组按页以 seqlock 保护，读者无锁
+ * - 寄存器快照：控制台 snapshot 命令或 SIGUSR1 触发，fork 子进程在后台写文件
+ * - 可选的寄存器写入日志（-J/-g），组提交落盘，启动时从快照（-L）之后重放
+ * - 寄存器值生成器（-G/-V）：读取时按（可快进的）时钟惰性计算常量、斜坡、正弦、随机游走或回放值
+ * - 厂商扩展 FC41 订阅寄存器变化，每轮事件循环结束时以 FC42 帧合并推送被写过的寄存器
+ * - 厂商扩展 FC43 一次读取多段不相邻寄存器，FC44 原子写入多个不相邻的保持寄存器
+ * - 按地址统计读写次数，控制台查看热点范围和热度图，可导出为二进制文件（-H）
+ * - 运行指标（请求、字节、异常、连接数和按功能码的延迟直方图），本机 HTTP 端口（-M）以 Prometheus 格式输出
+ * - 请求各阶段的 USDT 静态探针（见 trace.h），可用 tools/modbus_stages.bt 统计阶段延迟
+ * - 可选的事件循环看门狗线程（-W），报告超时的一轮正在运行的处理函数、描述符和调用栈
+ * - 按连接统计请求数、字节数、异常和延迟，list 按负载排序显示，top 在屏幕顶部原地刷新
+ * - 连接协议（Modbus TCP、RTU-over-TCP、文本）按监听或首批数据只判定一次，之后按各自的分帧方式处理
+ * - 服务器主动发出的数据挂到连接发送队列，广播共享一个引用计数缓冲区，套接字可写时再写出
+ * - 半帧暂存区和待写数据按尺寸档位从连接缓冲池借用，空闲连接不占缓冲区，总内存有上限（-m）
+ * - 可选的管理 Unix 域套接字（-a）：控制线程接收命令，经无锁队列交给事件循环执行，纯数据流模式下同样可用
+ * - 模拟设备（-T/-D）：按单元 ID 路由到以模板为基础、写时复制的设备寄存器，未写过的页不占内存
+ * - 寄存器映射文件（-R）：声明初值、访问模式、生成器和 unit 段设备，SIGHUP 时后台解析、在两次事件之间切换
+ * - 设备端点（-E）：一个进程绑定成百上千个地址/端口，每个端点一台设备，监听套接字共用同一个 epoll 集合
+ * - 网关模式（-U/-O）：指定单元 ID 的 Modbus TCP 请求经少量持久、流水线化的上游连接转发，事务标识符重新映射
+ * - 网关读合并与缓存（-c）：相同的在途读请求只发一次、响应分发给所有主站，可选按地址范围缓存读响应，经网关的写入使其失效
+ * - 主备复制（-P/-F）：主机把每轮事件循环的保持寄存器写入成批推给备机，备机复制期间只读、可提升为主机
  * - 使用非阻塞套接字和事件驱动模型提高吞吐量
  * - 支持优雅关闭和信号处理
  * 
@@ -16,10 +40,39 @@
  * - DEBUG_MODE=0：纯数据流模式，仅 Modbus TCP 数据，无调试输出
  */
 
+#define _GNU_SOURCE
+
 #include "common.h"
 #include "history.h"
 #include "modbus.h"
+#include "modbus_rtu.h"
+#include "serial_pty.h"
+#include "tls_server.h"
+#include "register_file.h"
+#include "register_bank.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "generator.h"
+#include "subscription.h"
+#include "heatmap.h"
+#include "metrics.h"
+#include "trace.h"
+#include "watchdog.h"
+#include "admin.h"
+#include "buffer_pool.h"
+#include "device.h"
+#include "endpoint.h"
+#include "register_map.h"
+#include "gateway.h"
+#include "replication.h"
 #include <sys/epoll.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <getopt.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -37,17 +90,127 @@
 /* Modbus 寄存器数量（简化实现，使用1000个寄存器） */
 #define MODBUS_REGISTER_COUNT 1000
 
+/* 每轮事件循环末尾最多刷新的发送队列数，其余留到下一轮（期间不阻塞等待） */
+#define OUTBOUND_FLUSH_BUDGET 16
+
+/* 同时等待请求的指标抓取连接数 */
+#define MAX_METRICS_CONNECTIONS 8
+
+/* 最多可指定的设备端点规格数（-E，每条规格可展开为一批端点） */
+#define MAX_ENDPOINT_SPECS 64
+
 /* 全局变量：服务器套接字和 epoll 文件描述符 */
 static int server_fd = -1;
 static int epoll_fd = -1;
 
+/* 全局变量：Unix 域套接字监听描述符及其路径（未启用时为 -1 / 空串） */
+static int unix_server_fd = -1;
+static char unix_socket_path[UNIX_PATH_LENGTH] = {0};
+
+/* 全局变量：RTU-over-TCP 监听描述符（未启用时为 -1） */
+static int rtu_server_fd = -1;
+
+/* 全局变量：TLS（Modbus/TCP Security）监听描述符（未启用时为 -1） */
+static int tls_server_fd = -1;
+
+/* 全局变量：PTY 串口从站线路 */
+static SerialLine serial_lines[MAX_SERIAL_LINES];
+static int serial_line_count = 0;
+
 /* 全局变量：客户端信息数组和客户端计数器 */
 static ClientInfo clients[MAX_CLIENTS];
 static int client_count = 0;
 
-/* 全局变量：Modbus 寄存器数组 */
-static uint16_t holding_registers[MODBUS_REGISTER_COUNT];  /* 保持寄存器 */
-static uint16_t input_registers[MODBUS_REGISTER_COUNT];    /* 输入寄存器 */
+/* 全局变量：Modbus 寄存器组（数据默认位于进程内存，启用持久化时位于映射文件） */
+static RegisterBank holding_bank;  /* 保持寄存器 */
+static RegisterBank input_bank;    /* 输入寄存器 */
+
+/* 全局变量：寄存器持久化文件（未启用时 fd 为 -1） */
+static RegisterFile register_file = { .fd = -1, .timer_fd = -1 };
+
+/* 全局变量：SIGUSR1/SIGCHLD 的 signalfd，以及后台快照状态和默认文件名前缀 */
+static int signal_fd = -1;
+static SnapshotState snapshot_state;
+static char snapshot_prefix[SNAPSHOT_PATH_LENGTH - 64] = "registers";
+static unsigned int snapshot_sequence = 0;
+
+/* 全局变量：寄存器写入日志（未启用时 fd 为 -1） */
+static Journal journal = { .fd = -1 };
+
+/* 全局变量：主备复制（-P/-F），在 main 开头初始化，未启用时各操作均为空操作 */
+static Replication replication;
+
+/* 全局变量：寄存器值生成器及其时钟 */
+static GeneratorSet generators;
+
+/* 全局变量：寄存器变化订阅表及各寄存器组的脏位图 */
+static SubscriptionTable subscriptions;
+
+/* 全局变量：按地址的读写次数，以及退出时的导出路径（未指定时为 NULL） */
+static AccessHeatmap heatmap;
+static const char *heatmap_path = NULL;
+
+/* 运行指标与本机 HTTP 抓取端口 */
+static ServerMetrics metrics;
+static int metrics_server_fd = -1;
+static int metrics_timer_fd = -1;   /* 周期检查抓取连接的期限 */
+
+/* 指标抓取连接：响应经发送队列非阻塞写出 */
+typedef struct {
+    int fd;
+    uint64_t deadline_ns;           /* 超过此刻仍未写完响应时关闭 */
+    bool responding;                /* 响应已排入发送队列 */
+    bool found;                     /* 响应是 /metrics 的指标（写完后计入抓取次数） */
+    OutboundQueue outbound;
+} MetricsConnection;
+static MetricsConnection metrics_connections[MAX_METRICS_CONNECTIONS];
+static int metrics_connection_count = 0;
+
+/* 设备模板与模拟设备（-T/-D），按单元 ID 路由 */
+static DeviceTable devices;
+
+/* 设备端点（-E）：每个监听地址/端口挂一台设备 */
+static EndpointSet endpoints;
+
+/*
+ * 寄存器映射（-R）：当前生效的映射与后台加载线程。
+ * 映射只由事件循环线程读取，重新加载时在两次事件之间切换指针，旧映射随即释放。
+ */
+static RegisterMap *register_map = NULL;
+static RegisterMapLoader register_map_loader = { .wake_fd = -1 };
+static const char *register_map_path = NULL;
+
+/* Modbus TCP 网关（-U）：单元 ID 在上游的请求转发出去，其余在本地处理 */
+static Gateway gateway = { .epoll_fd = -1, .timer_fd = -1 };
+
+/* 连接缓冲池：半帧暂存区和发送队列中的缓冲区只在需要时借用 */
+static BufferPool buffer_pool;
+
+/* 待刷新发送队列的连接（广播只排队，在本轮末尾按预算写出）与广播编号 */
+static ClientInfo *flush_pending[MAX_CLIENTS];
+static int flush_pending_count = 0;
+static uint64_t broadcast_sequence = 0;
+
+/* 当前正在处理的请求帧的到达时刻，用于计算请求延迟 */
+static uint64_t request_arrival_ns = 0;
+
+/* 事件循环卡顿看门狗（-W 启用） */
+static LoopWatchdog watchdog;
+
+/* 管理控制面（-a 启用，未启用时描述符为 -1） */
+static AdminServer admin = { .listen_fd = -1, .wake_fd = -1, .stop_fd = -1 };
+
+/* 上次刷新 top 面板的时刻（未开启 top 时为 0） */
+static uint64_t top_refreshed_ns = 0;
+
+#if DEBUG_MODE
+/* top 面板：客户端行数，总行数（标题、表头、客户端行、分隔线） */
+#define TOP_PANE_ROWS 10
+#define TOP_PANE_LINES (TOP_PANE_ROWS + 3)
+
+/* top 刷新定时器（未开启时为 -1） */
+static int top_timer_fd = -1;
+#endif
 
 /* 命令历史记录 */
 static CommandHistory cmd_history;
@@ -71,14 +234,44 @@ static void init_clients() {
  * 为保持寄存器和输入寄存器设置初始值
  */
 static void init_modbus_registers() {
+    /* 已初始化的持久化文件直接沿用其中的寄存器值 */
+    if (register_file.map && register_file.header->initialized) {
+        printf("[服务器] Modbus 寄存器已从持久化文件恢复（保持寄存器: %d 个，输入寄存器: %d 个，第 %llu 次打开）\n",
+               MODBUS_REGISTER_COUNT, MODBUS_REGISTER_COUNT,
+               (unsigned long long)register_file.header->open_count);
+        return;
+    }
+
+    /* 使用寄存器映射时初值全部来自映射文件的默认寄存器段 */
+    if (register_map) {
+        const RegisterMapSection *section = register_map_section(register_map, 0);
+        register_bank_write(&holding_bank, 0, MODBUS_REGISTER_COUNT, section->values[GENERATOR_BANK_HOLDING]);
+        register_bank_write(&input_bank, 0, MODBUS_REGISTER_COUNT, section->values[GENERATOR_BANK_INPUT]);
+        if (register_file.map) {
+            register_file_mark_initialized(&register_file);
+        }
+        printf("[服务器] Modbus 寄存器已按映射文件 %s 初始化（%llu 行，%llu 个点，解析耗时 %llu 微秒）\n",
+               register_map->path, (unsigned long long)register_map->lines,
+               (unsigned long long)register_map->points, (unsigned long long)register_map->load_usec);
+        return;
+    }
+
+    uint16_t values[MODBUS_REGISTER_COUNT];
+
     /* 初始化保持寄存器（可读写）为递增值 */
     for (int i = 0; i < MODBUS_REGISTER_COUNT; i++) {
-        holding_registers[i] = i;
+        values[i] = i;
     }
+    register_bank_write(&holding_bank, 0, MODBUS_REGISTER_COUNT, values);
     
     /* 初始化输入寄存器（只读）为固定值 */
     for (int i = 0; i < MODBUS_REGISTER_COUNT; i++) {
-        input_registers[i] = 1000 + i;
+        values[i] = 1000 + i;
+    }
+    register_bank_write(&input_bank, 0, MODBUS_REGISTER_COUNT, values);
+
+    if (register_file.map) {
+        register_file_mark_initialized(&register_file);
     }
     
     printf("[服务器] Modbus 寄存器已初始化（保持寄存器: %d 个，输入寄存器: %d 个）\n",
@@ -86,420 +279,2891 @@ static void init_modbus_registers() {
 }
 
 /*
- * 检查数据是否为 Modbus TCP 消息
- * 通过检查 MBAP Header 的协议标识符判断
+ * 向客户端写入数据（TLS 连接经由 TLS 会话，其余直接写套接字）
+ * 参数：
+ *   client - 客户端信息
+ *   data - 数据
+ *   length - 数据长度
+ * 返回：
+ *   与 write() 相同
  */
-static bool is_modbus_message(const uint8_t *buffer, size_t length) {
-    if (length < MODBUS_MBAP_HEADER_LENGTH) {
-        return false;
+static ssize_t client_write(ClientInfo *client, const void *data, size_t length) {
+    ssize_t written = client->tls ? tls_session_write(client->tls, data, length)
+                                  : write(client->fd, data, length);
+    if (written > 0) {
+        metrics.bytes_sent += (uint64_t)written;
+        client->traffic.bytes_out += (uint64_t)written;
     }
-    
-    /* 检查协议标识符（字节2-3）是否为0x0000 */
-    uint16_t protocol_id = (uint16_t)(buffer[2] << 8) | buffer[3];
-    return (protocol_id == MODBUS_PROTOCOL_ID);
+    return written;
 }
 
 /*
- * 处理 Modbus TCP 请求
- * 
- * 参数：
- *   client - 客户端信息
- *   request_buffer - 请求数据缓冲区
- *   request_length - 请求数据长度
- * 
+ * 从客户端读取数据（TLS 连接经由 TLS 会话，其余直接读套接字）
  * 返回：
- *   成功返回 true，失败返回 false
+ *   与 read() 相同
  */
-static bool handle_modbus_request(ClientInfo *client, const uint8_t *request_buffer, size_t request_length) {
-    if (!client || !request_buffer) {
-        return false;
+static ssize_t client_read(ClientInfo *client, void *buffer, size_t length) {
+    if (client->tls) {
+        return tls_session_read(client->tls, buffer, length);
     }
-    
-    /* 解析 Modbus 请求 */
-    ModbusTCPMessage request;
-    if (!modbus_parse_request(request_buffer, request_length, &request)) {
-        printf("[服务器] [fd:%d] Modbus 请求解析失败\n", client->fd);
-        return false;
+    return read(client->fd, buffer, length);
+}
+
+/*
+ * 发送队列的写函数（outbound_queue_flush 的回调）
+ */
+static ssize_t write_to_client(void *context, const void *data, size_t length) {
+    return client_write(context, data, length);
+}
+
+/*
+ * 调整客户端在 epoll 中是否关注可写事件（状态未变时不发起系统调用）
+ */
+static void set_client_write_interest(ClientInfo *client, bool want_write) {
+    if (client->want_write == want_write) {
+        return;
     }
-    
-    printf("[服务器] [fd:%d] Modbus 请求：事务ID=%u, 功能码=0x%02X, 单元ID=%u\n",
-           client->fd, request.mbap.transaction_id, request.pdu.function_code, request.mbap.unit_id);
-    
-    uint8_t response_buffer[MODBUS_MAX_MESSAGE_LENGTH];
-    size_t response_length = 0;
-    
-    /* 根据功能码处理请求 */
-    switch (request.pdu.function_code) {
-        case MODBUS_FC_READ_HOLDING_REGISTERS: {
-            /* FC03：读保持寄存器 */
-            if (request.pdu.data_length < 4) {
-                printf("[服务器] [fd:%d] FC03 请求数据不足\n", client->fd);
-                response_length = modbus_build_error_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    MODBUS_FC_READ_HOLDING_REGISTERS,
-                    MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-                break;
-            }
-            
-            /* 解析起始地址和数量 */
-            uint16_t start_address = (uint16_t)(request.pdu.data[0] << 8) | request.pdu.data[1];
-            uint16_t quantity = (uint16_t)(request.pdu.data[2] << 8) | request.pdu.data[3];
-            
-            printf("[服务器] [fd:%d] FC03 读保持寄存器：起始地址=%u, 数量=%u\n",
-                   client->fd, start_address, quantity);
-            
-            /* 验证地址范围 */
-            if (quantity == 0 || quantity > MODBUS_MAX_READ_REGISTERS ||
-                start_address >= MODBUS_REGISTER_COUNT ||
-                (start_address + quantity) > MODBUS_REGISTER_COUNT) {
-                printf("[服务器] [fd:%d] FC03 地址越界\n", client->fd);
-                response_length = modbus_build_error_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    MODBUS_FC_READ_HOLDING_REGISTERS,
-                    MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-            } else {
-                /* 读取寄存器并构建响应 */
-                response_length = modbus_build_fc03_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    &holding_registers[start_address],
-                    quantity,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-                
-                /* 显示读取的寄存器值 */
-                printf("[服务器] [fd:%d] FC03 响应：", client->fd);
-                for (uint16_t i = 0; i < (quantity < 5 ? quantity : 5); i++) {
-                    printf("[%u]=%u ", start_address + i, holding_registers[start_address + i]);
-                }
-                if (quantity > 5) {
-                    printf("...(共%u个)", quantity);
-                }
-                printf("\n");
-            }
-            break;
-        }
-        
-        case MODBUS_FC_WRITE_SINGLE_REGISTER: {
-            /* FC06：写单个寄存器 */
-            if (request.pdu.data_length < 4) {
-                printf("[服务器] [fd:%d] FC06 请求数据不足\n", client->fd);
-                response_length = modbus_build_error_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    MODBUS_FC_WRITE_SINGLE_REGISTER,
-                    MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-                break;
-            }
-            
-            /* 解析寄存器地址和值 */
-            uint16_t register_address = (uint16_t)(request.pdu.data[0] << 8) | request.pdu.data[1];
-            uint16_t register_value = (uint16_t)(request.pdu.data[2] << 8) | request.pdu.data[3];
-            
-            printf("[服务器] [fd:%d] FC06 写单个寄存器：地址=%u, 旧值=%u, 新值=%u\n",
-                   client->fd, register_address,
-                   register_address < MODBUS_REGISTER_COUNT ? holding_registers[register_address] : 0,
-                   register_value);
-            
-            /* 验证地址范围 */
-            if (register_address >= MODBUS_REGISTER_COUNT) {
-                printf("[服务器] [fd:%d] FC06 地址越界\n", client->fd);
-                response_length = modbus_build_error_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    MODBUS_FC_WRITE_SINGLE_REGISTER,
-                    MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-            } else {
-                /* 写入寄存器 */
-                holding_registers[register_address] = register_value;
-                
-                /* 构建响应（回显请求） */
-                response_length = modbus_build_fc06_response(
-                    request.mbap.transaction_id,
-                    request.mbap.unit_id,
-                    register_address,
-                    register_value,
-                    response_buffer,
-                    sizeof(response_buffer)
-                );
-                
-                printf("[服务器] [fd:%d] FC06 写入成功：[%u]=%u\n",
-                       client->fd, register_address, register_value);
-            }
-            break;
-        }
-        
-        default:
-            /* 不支持的功能码 */
-            printf("[服务器] [fd:%d] 不支持的功能码：0x%02X\n", client->fd, request.pdu.function_code);
-            response_length = modbus_build_error_response(
-                request.mbap.transaction_id,
-                request.mbap.unit_id,
-                request.pdu.function_code,
-                MODBUS_EXCEPTION_ILLEGAL_FUNCTION,
-                response_buffer,
-                sizeof(response_buffer)
-            );
-            break;
+    struct epoll_event client_event;
+    client_event.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+    client_event.data.fd = client->fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &client_event) == 0) {
+        client->want_write = want_write;
     }
-    
-    /* 发送响应 */
-    if (response_length > 0) {
-        ssize_t n_write = write(client->fd, response_buffer, response_length);
-        if (n_write < 0) {
-            perror("write");
-            return false;
-        }
-        printf("[服务器] [fd:%d] Modbus 响应已发送（%zu 字节）\n", client->fd, response_length);
-        return true;
+}
+
+/*
+ * 把客户端加入本轮末尾的待刷新列表
+ */
+static void schedule_client_flush(ClientInfo *client) {
+    if (!client->flush_scheduled) {
+        client->flush_scheduled = true;
+        flush_pending[flush_pending_count++] = client;
     }
-    
-    return false;
 }
 
 /*
- * 根据文件描述符查找客户端信息
- * 参数：
- *   fd - 客户端文件描述符
+ * 向客户端发送数据，保持与发送队列中已有数据的先后顺序
+ *
+ * 发送队列为空时直接写；没写完的部分（或队列非空时的全部数据）复制到新缓冲区挂到队尾，
+ * 套接字可写时再写出。
+ *
  * 返回：
- *   指向客户端信息的指针，未找到返回NULL
+ *   已写出或已排队返回 true；写入出错，或发送队列已满、缓冲池已达上限（errno 为 ENOBUFS）返回 false
  */
-static ClientInfo* find_client_by_fd(int fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].active && clients[i].fd == fd) {
-            return &clients[i];
+static bool client_send(ClientInfo *client, const void *data, size_t length) {
+    bool was_empty = outbound_queue_empty(&client->outbound);
+    size_t written = 0;
+    if (was_empty) {
+        ssize_t n_write = client_write(client, data, length);
+        if (n_write < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        written = n_write > 0 ? (size_t)n_write : 0;
+        if (written == length) {
+            return true;
         }
     }
-    return NULL;
+
+    OutboundBuffer *buffer = outbound_buffer_create(&buffer_pool, (const uint8_t *)data + written, length - written);
+    if (!buffer) {
+        errno = ENOBUFS;
+        return false;
+    }
+    bool queued = outbound_queue_push(&client->outbound, buffer);
+    outbound_buffer_release(buffer);
+    if (!queued) {
+        errno = ENOBUFS;
+        return false;
+    }
+    /* 刚才的直接写已经写不动：等待可写事件；队列原本非空时已在等待或已排入待刷新列表 */
+    if (was_empty) {
+        set_client_write_interest(client, true);
+    }
+    return true;
 }
 
+/* 定义见下文 */
+static void disconnect_client(ClientInfo *client, const char *reason);
+
 /*
- * 添加新客户端到客户端数组
- * 参数：
- *   fd - 客户端文件描述符
- *   addr - 客户端地址信息
+ * client_send 失败后断开客户端
+ *
+ * 发送队列已满（ENOBUFS）说明客户端长期不读取响应，继续保持连接只会让之后的响应同样丢失、
+ * 主站只能等到超时，因此与写入出错一样断开，并在断开原因中区分两种情况。
+ */
+static void disconnect_after_send_failure(ClientInfo *client) {
+    disconnect_client(client, errno == ENOBUFS ? "发送队列已满（客户端未读取响应）" : "发送失败");
+}
+
+/*
+ * 写出客户端发送队列，按结果调整可写事件关注
+ *
  * 返回：
- *   指向新添加客户端信息的指针，失败返回NULL
+ *   连接仍然有效返回 true，写入出错并已断开返回 false
  */
-static ClientInfo* add_client(int fd, struct sockaddr_in addr) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (!clients[i].active) {
-            clients[i].fd = fd;
-            clients[i].addr = addr;
-            clients[i].active = true;
-            snprintf(clients[i].id, CLIENT_ID_LENGTH, "%d", fd);
-            client_count++;
-            return &clients[i];
-        }
+static bool flush_client_output(ClientInfo *client) {
+    switch (outbound_queue_flush(&client->outbound, write_to_client, client)) {
+        case OUTBOUND_FLUSH_DRAINED:
+            set_client_write_interest(client, false);
+            return true;
+        case OUTBOUND_FLUSH_BLOCKED:
+            set_client_write_interest(client, true);
+            return true;
+        default:
+            disconnect_client(client, "发送队列写出失败");
+            return false;
     }
-    return NULL;
 }
 
 /*
- * 将客户端标记为非活跃状态
- * 参数：
- *   client - 客户端信息指针
+ * 本轮事件循环末尾：刷新待刷新列表中前 OUTBOUND_FLUSH_BUDGET 个连接的发送队列
+ *
+ * 剩下的连接留到下一轮，期间 epoll_wait 不阻塞，Modbus 请求可以插在两批之间处理。
  */
-static void deactivate_client(ClientInfo *client) {
-    if (!client || !client->active) {
-        return;
-    }
-    client->active = false;
-    client->fd = -1;
-    memset(&client->addr, 0, sizeof(client->addr));
-    memset(client->id, 0, CLIENT_ID_LENGTH);
-    if (client_count > 0) {
-        client_count--;
+static void flush_pending_clients() {
+    int batch = flush_pending_count < OUTBOUND_FLUSH_BUDGET ? flush_pending_count : OUTBOUND_FLUSH_BUDGET;
+    ClientInfo *clients_to_flush[OUTBOUND_FLUSH_BUDGET];
+    memcpy(clients_to_flush, flush_pending, (size_t)batch * sizeof(ClientInfo *));
+    flush_pending_count -= batch;
+    memmove(flush_pending, &flush_pending[batch], (size_t)flush_pending_count * sizeof(ClientInfo *));
+
+    for (int i = 0; i < batch; i++) {
+        ClientInfo *client = clients_to_flush[i];
+        client->flush_scheduled = false;
+        if (client->active) {
+            flush_client_output(client);
+        }
     }
 }
 
 /*
- * 断开与客户端的连接并清理 epoll/套接字资源
+ * 广播缓冲区的完成回调：最后一个连接写完或丢弃后报告投递结果
+ */
+static void report_broadcast_delivery(const OutboundBuffer *buffer, void *context __attribute__((unused))) {
+    printf("[服务器] 广播 #%llu 投递完成：%u/%u 个客户端已写出，%u 个未送达（队列已满或已断开），耗时 %llu 微秒\n",
+           (unsigned long long)buffer->id, buffer->delivered, buffer->targets, buffer->dropped,
+           (unsigned long long)((metrics_now_ns() - buffer->created_ns) / 1000ULL));
+}
+
+/*
+ * 记录一次已应答请求的指标（延迟截止到响应写出）
+ *
  * 参数：
- *   client - 客户端信息指针
- *   reason - 断开原因描述
+ *   client - 请求来源连接，串口线路为 NULL（只计入全局指标）
+ *   response_pdu - 响应 PDU：功能码最高位表示异常响应，其后一字节为异常码
  */
-static void disconnect_client(ClientInfo *client, const char *reason) {
-    if (!client || !client->active) {
+static void record_response_metrics(ClientInfo *client, const uint8_t *response_pdu) {
+    uint8_t function_code = response_pdu[0] & 0x7F;
+    uint8_t exception_code = (response_pdu[0] & 0x80) ? response_pdu[1] : 0;
+    uint64_t latency_ns = metrics_now_ns() - request_arrival_ns;
+    metrics_record_request(&metrics, function_code, exception_code, latency_ns);
+    if (!client) {
         return;
     }
 
-    int fd = client->fd;
-    char addr_buf[INET_ADDRSTRLEN] = {0};
-    if (inet_ntop(AF_INET, &client->addr.sin_addr, addr_buf, sizeof(addr_buf)) == NULL) {
-        strncpy(addr_buf, "未知", sizeof(addr_buf) - 1);
-    }
-    int port = ntohs(client->addr.sin_port);
-
-    if (epoll_fd != -1) {
-        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    ClientTraffic *traffic = &client->traffic;
+    double latency_us = (double)latency_ns / 1000.0;
+    traffic->latency_ewma_us = traffic->requests == 0
+        ? latency_us
+        : traffic->latency_ewma_us + (latency_us - traffic->latency_ewma_us) / 8.0;
+    traffic->requests++;
+    traffic->function_requests[function_code]++;
+    if (exception_code != 0) {
+        traffic->exceptions++;
     }
-    close(client->fd);
-
-    deactivate_client(client);
-
-    printf("[服务器] [fd:%d] 已断开连接（地址 %s:%d，原因: %s）（当前客户端总数: %d）\n",
-           fd,
-           addr_buf,
-           port,
-           reason ? reason : "未知",
-           client_count);
 }
 
 /*
- * 列出所有连接的客户端（仅在调试模式下使用）
+ * 一次请求作用的寄存器：服务器默认的寄存器组，或按单元 ID 路由到的模拟设备
+ *
+ * 写入日志、变化订阅、访问热度、持久化文件和值生成器只作用于默认寄存器组。
  */
-#if DEBUG_MODE
-static void list_clients() {
-    printf("[服务器] 当前连接的客户端列表：\n");
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].active) {
-            printf("  - [fd:%d] (地址=%s:%d)\n",
-                   clients[i].fd,
-                   inet_ntoa(clients[i].addr.sin_addr),
-                   ntohs(clients[i].addr.sin_port));
-        }
-    }
-    printf("[服务器] 总计：%d 个客户端\n", client_count);
-}
-#endif /* DEBUG_MODE */
+typedef struct {
+    RegisterBank *holding;
+    RegisterBank *input;
+    Device *device;         /* 模拟设备，默认寄存器组为 NULL */
+    const RegisterMapSection *section;  /* 寄存器映射中的段（访问模式），NULL 表示不受约束 */
+} RegisterTarget;
 
 /*
- * 向指定客户端发送消息（仅在调试模式下使用）
+ * 处理 FC03/FC04 读寄存器请求
+ *
+ * 寄存器组的读取不加锁，返回的多个寄存器来自同一时刻（不会读到写了一半的 32 位值）。
+ *
  * 参数：
- *   target_fd - 客户端的 socket 文件描述符
- *   message - 要发送的消息
+ *   source_fd - 请求来源描述符（仅用于日志）
+ *   request - 已解析的请求
+ *   target - 请求作用的寄存器（按功能码读取其中的保持或输入寄存器组）
+ *   response_buffer - 输出：响应缓冲区
+ *   response_size - 响应缓冲区大小
+ *
  * 返回：
- *   成功返回true，失败返回false
+ *   响应长度
  */
-#if DEBUG_MODE
-static bool send_to_client(int target_fd, const char *message) {
-    ClientInfo *client = find_client_by_fd(target_fd);
-    if (!client) {
-        printf("[服务器] 错误：未找到文件描述符为 %d 的客户端\n", target_fd);
-        return false;
+static size_t process_read_registers(int source_fd, const ModbusTCPMessage *request, const RegisterTarget *target,
+                                     uint8_t *response_buffer, size_t response_size) {
+    uint8_t function_code = request->pdu.function_code;
+    bool is_input = (function_code == MODBUS_FC_READ_INPUT_REGISTERS);
+    RegisterBank *bank = is_input ? target->input : target->holding;
+    const char *name = is_input ? "读输入寄存器" : "读保持寄存器";
+
+    if (request->pdu.data_length < 4) {
+        printf("[服务器] [fd:%d] FC%02X 请求数据不足\n", source_fd, function_code);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           function_code, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                                           response_buffer, response_size);
     }
 
-    if (!client->active) {
-        printf("[服务器] 警告：文件描述符为 %d 的客户端已不在活跃状态\n", target_fd);
-        return false;
+    /* 解析起始地址和数量 */
+    uint16_t start_address = (uint16_t)(request->pdu.data[0] << 8) | request->pdu.data[1];
+    uint16_t quantity = (uint16_t)(request->pdu.data[2] << 8) | request->pdu.data[3];
+
+    printf("[服务器] [fd:%d] FC%02X %s：起始地址=%u, 数量=%u\n",
+           source_fd, function_code, name, start_address, quantity);
+
+    /* 验证数量和地址范围 */
+    uint16_t registers[MODBUS_MAX_READ_REGISTERS];
+    if (quantity == 0 || quantity > MODBUS_MAX_READ_REGISTERS ||
+        !register_bank_read(bank, start_address, quantity, registers)) {
+        printf("[服务器] [fd:%d] FC%02X 地址越界\n", source_fd, function_code);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           function_code, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
     }
 
-    ssize_t n_write = write(client->fd, message, strlen(message));
-    if (n_write < 0) {
-        perror("write");
-        disconnect_client(client, "服务器发送失败");
-        return false;
+    if (!register_map_allows(target->section, is_input ? GENERATOR_BANK_INPUT : GENERATOR_BANK_HOLDING,
+                             start_address, quantity, false)) {
+        printf("[服务器] [fd:%d] FC%02X 范围内有只写寄存器\n", source_fd, function_code);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           function_code, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
     }
-    return true;
+
+    /* 挂接了生成器的寄存器只在这里按当前时钟计算，不读就不计算 */
+    if (!target->device) {
+        generator_set_apply(&generators, is_input ? GENERATOR_BANK_INPUT : GENERATOR_BANK_HOLDING,
+                            start_address, quantity, registers);
+        heatmap_record_read(&heatmap, is_input ? HEATMAP_BANK_INPUT : HEATMAP_BANK_HOLDING,
+                            start_address, quantity);
+    }
+
+    size_t response_length = modbus_build_read_registers_response(
+        request->mbap.transaction_id,
+        request->mbap.unit_id,
+        function_code,
+        registers,
+        quantity,
+        response_buffer,
+        response_size
+    );
+
+    /* 显示读取的寄存器值 */
+    printf("[服务器] [fd:%d] FC%02X 响应：", source_fd, function_code);
+    for (uint16_t i = 0; i < (quantity < 5 ? quantity : 5); i++) {
+        printf("[%u]=%u ", start_address + i, registers[i]);
+    }
+    if (quantity > 5) {
+        printf("...(共%u个)", quantity);
+    }
+    printf("\n");
+    return response_length;
 }
-#endif /* DEBUG_MODE */
 
 /*
- * 向所有客户端广播消息（仅在调试模式下使用）
- * 参数：
- *   message - 要广播的消息
+ * 默认保持寄存器的一次写入：追加写入日志记录，并排入本轮的复制批次
  */
-#if DEBUG_MODE
-static void broadcast_message(const char *message) {
-    int sent_count = 0;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].active) {
-            ssize_t n_write = write(clients[i].fd, message, strlen(message));
-            if (n_write > 0) {
-                sent_count++;
-            }
-        }
-    }
-    printf("[服务器] 已广播消息给 %d 个客户端\n", sent_count);
+static void record_holding_write(uint8_t unit_id, uint16_t address, uint16_t value) {
+    journal_append(&journal, unit_id, address, value);
+    replication_append(&replication, JOURNAL_BANK_HOLDING, unit_id, address, value);
 }
-#endif /* DEBUG_MODE */
 
 /*
- * 将文件描述符设置为非阻塞模式
- * 参数：
- *   fd - 需要设置的文件描述符
+ * 默认输入寄存器的一次写入：不进写入日志，只排入本轮的复制批次
  */
-static void set_nonblocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+static void record_input_write(uint8_t unit_id, uint16_t address, uint16_t value) {
+    replication_append(&replication, JOURNAL_BANK_INPUT, unit_id, address, value);
 }
 
 /*
- * 去除字符串末尾的换行符
- * 参数：
- *   str - 要处理的字符串
+ * 处理 FC06 写单个寄存器请求
  */
-static void trim_newline(char *str) {
-    if (!str) {
-        return;
+static size_t process_write_single_register(int source_fd, const ModbusTCPMessage *request,
+                                            const RegisterTarget *target,
+                                            uint8_t *response_buffer, size_t response_size) {
+    if (request->pdu.data_length < 4) {
+        printf("[服务器] [fd:%d] FC06 请求数据不足\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                                           response_buffer, response_size);
+    }
+
+    /* 解析寄存器地址和值 */
+    uint16_t register_address = (uint16_t)(request->pdu.data[0] << 8) | request->pdu.data[1];
+    uint16_t register_value = (uint16_t)(request->pdu.data[2] << 8) | request->pdu.data[3];
+
+    printf("[服务器] [fd:%d] FC06 写单个寄存器：地址=%u, 旧值=%u, 新值=%u\n",
+           source_fd, register_address,
+           register_address < MODBUS_REGISTER_COUNT ? register_bank_get(target->holding, register_address) : 0,
+           register_value);
+
+    /* 验证地址范围 */
+    if (register_address >= MODBUS_REGISTER_COUNT) {
+        printf("[服务器] [fd:%d] FC06 地址越界\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
+    }
+    if (!register_map_allows(target->section, GENERATOR_BANK_HOLDING, register_address, 1, true)) {
+        printf("[服务器] [fd:%d] FC06 寄存器 %u 只读\n", source_fd, register_address);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
+    }
+
+    if (!register_bank_write(target->holding, register_address, 1, &register_value)) {
+        printf("[服务器] [fd:%d] FC06 写入失败（内存不足）\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_SINGLE_REGISTER, MODBUS_EXCEPTION_SERVER_DEVICE_FAILURE,
+                                           response_buffer, response_size);
     }
-    size_t len = strlen(str);
-    while (len > 0 && (str[len - 1] == '\n' || str[len - 1] == '\r')) {
-        str[len - 1] = '\0';
-        len--;
+
+    /* 默认寄存器组追加日志记录（在本轮事件循环结束时统一提交） */
+    if (!target->device) {
+        record_holding_write(request->mbap.unit_id, register_address, register_value);
+        subscription_mark_dirty(&subscriptions, SUBSCRIPTION_BANK_HOLDING, register_address, 1);
+        heatmap_record_write(&heatmap, HEATMAP_BANK_HOLDING, register_address, 1);
+        register_file_note_write(&register_file, register_bank_location(&holding_bank, register_address), 1);
+    } else {
+        replication_note_unreplicated(&replication, 1);
     }
+
+    printf("[服务器] [fd:%d] FC06 写入成功：[%u]=%u\n",
+           source_fd, register_address, register_value);
+
+    /* 构建响应（回显请求） */
+    return modbus_build_fc06_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                      register_address, register_value,
+                                      response_buffer, response_size);
 }
 
 /*
- * 处理服务器命令行输入
- * 支持的命令：
- *   list - 列出所有客户端
- *   send <fd> <message> - 向指定文件描述符的客户端发送消息
- *   broadcast <message> - 向所有客户端广播消息
- *   help - 显示帮助信息
+ * 处理 FC10 写多个寄存器请求
+ *
+ * 整段写入对读者原子可见：跨越两个寄存器的 32 位值不会被读到一半。
+ *
+ * // 起始地址(2字节) | 寄存器数量(2字节) | 字节计数(1字节) | 寄存器值(N*2字节)
  */
+static size_t process_write_multiple_registers(int source_fd, const ModbusTCPMessage *request,
+                                               const RegisterTarget *target,
+                                               uint8_t *response_buffer, size_t response_size) {
+    uint16_t start_address = 0;
+    uint16_t quantity = 0;
+    if (request->pdu.data_length >= 5) {
+        start_address = (uint16_t)(request->pdu.data[0] << 8) | request->pdu.data[1];
+        quantity = (uint16_t)(request->pdu.data[2] << 8) | request->pdu.data[3];
+    }
+
+    if (request->pdu.data_length < 5 || quantity == 0 || quantity > MODBUS_MAX_WRITE_REGISTERS ||
+        request->pdu.data[4] != quantity * 2 || request->pdu.data_length < 5 + (size_t)quantity * 2) {
+        printf("[服务器] [fd:%d] FC10 请求数据无效\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                                           response_buffer, response_size);
+    }
+
+    printf("[服务器] [fd:%d] FC10 写多个寄存器：起始地址=%u, 数量=%u\n",
+           source_fd, start_address, quantity);
+
+    uint16_t values[MODBUS_MAX_WRITE_REGISTERS];
+    for (uint16_t i = 0; i < quantity; i++) {
+        values[i] = (uint16_t)(request->pdu.data[5 + i * 2] << 8) | request->pdu.data[6 + i * 2];
+    }
+
+    if (start_address + quantity <= MODBUS_REGISTER_COUNT &&
+        !register_map_allows(target->section, GENERATOR_BANK_HOLDING, start_address, quantity, true)) {
+        printf("[服务器] [fd:%d] FC10 范围内有只读寄存器\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
+    }
+    if (!register_bank_write(target->holding, start_address, quantity, values)) {
+        printf("[服务器] [fd:%d] FC10 地址越界\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_MULTIPLE_REGISTERS, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
+    }
+    if (!target->device) {
+        register_file_note_write(&register_file, register_bank_location(&holding_bank, start_address), quantity);
+        subscription_mark_dirty(&subscriptions, SUBSCRIPTION_BANK_HOLDING, start_address, quantity);
+        heatmap_record_write(&heatmap, HEATMAP_BANK_HOLDING, start_address, quantity);
+        for (uint16_t i = 0; i < quantity; i++) {
+            record_holding_write(request->mbap.unit_id, start_address + i, values[i]);
+        }
+    } else {
+        replication_note_unreplicated(&replication, quantity);
+    }
+
+    printf("[服务器] [fd:%d] FC10 写入成功：[%u..%u]\n",
+           source_fd, start_address, start_address + quantity - 1);
+
+    return modbus_build_fc10_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                      start_address, quantity,
+                                      response_buffer, response_size);
+}
+
+/*
+ * 处理 FC43 分散读请求：按请求中的顺序读取多段寄存器，拼接在一个响应中返回
+ *
+ * 每段内部的读取是一致的（同一时刻的值），不同段之间不保证来自同一时刻。
+ *
+ * // 读功能码(1字节) | 段数(1字节) | {起始地址(2字节) 数量(2字节)}...
+ */
+static size_t process_read_vector(int source_fd, const ModbusTCPMessage *request, const RegisterTarget *target,
+                                  uint8_t *response_buffer, size_t response_size) {
+    const uint8_t *data = request->pdu.data;
+    uint8_t range_count = request->pdu.data_length >= 2 ? data[1] : 0;
+    uint8_t read_function_code = request->pdu.data_length >= 1 ? data[0] : 0;
+
+    /* 检查格式和寄存器总数 */
+    uint32_t total = 0;
+    bool valid = (read_function_code == MODBUS_FC_READ_HOLDING_REGISTERS ||
+                  read_function_code == MODBUS_FC_READ_INPUT_REGISTERS) &&
+                 range_count > 0 && range_count <= MODBUS_MAX_VECTOR_RANGES &&
+                 request->pdu.data_length >= 2 + (size_t)range_count * 4;
+    for (uint8_t r = 0; valid && r < range_count; r++) {
+        uint16_t quantity = (uint16_t)(data[4 + r * 4] << 8) | data[5 + r * 4];
+        total += quantity;
+        valid = quantity > 0 && total <= MODBUS_MAX_READ_REGISTERS;
+    }
+    if (!valid) {
+        printf("[服务器] [fd:%d] FC43 请求数据无效\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_READ_VECTOR, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                                           response_buffer, response_size);
+    }
+
+    bool is_input = (read_function_code == MODBUS_FC_READ_INPUT_REGISTERS);
+    RegisterBank *bank = is_input ? target->input : target->holding;
+    printf("[服务器] [fd:%d] FC43 分散读：FC%02X，%u 段，共 %u 个寄存器\n",
+           source_fd, read_function_code, range_count, total);
+
+    uint16_t registers[MODBUS_MAX_READ_REGISTERS];
+    uint32_t offset = 0;
+    for (uint8_t r = 0; r < range_count; r++) {
+        uint16_t start_address = (uint16_t)(data[2 + r * 4] << 8) | data[3 + r * 4];
+        uint16_t quantity = (uint16_t)(data[4 + r * 4] << 8) | data[5 + r * 4];
+        if (!register_bank_read(bank, start_address, quantity, &registers[offset]) ||
+            !register_map_allows(target->section, is_input ? GENERATOR_BANK_INPUT : GENERATOR_BANK_HOLDING,
+                                 start_address, quantity, false)) {
+            printf("[服务器] [fd:%d] FC43 第 %u 段地址越界或含只写寄存器\n", source_fd, r + 1);
+            return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                               MODBUS_FC_READ_VECTOR, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                               response_buffer, response_size);
+        }
+        if (!target->device) {
+            generator_set_apply(&generators, is_input ? GENERATOR_BANK_INPUT : GENERATOR_BANK_HOLDING,
+                                start_address, quantity, &registers[offset]);
+            heatmap_record_read(&heatmap, is_input ? HEATMAP_BANK_INPUT : HEATMAP_BANK_HOLDING,
+                                start_address, quantity);
+        }
+        offset += quantity;
+    }
+
+    return modbus_build_read_vector_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                             read_function_code, registers, (uint16_t)total,
+                                             response_buffer, response_size);
+}
+
+/*
+ * 处理 FC44 原子多点写请求：全部地址有效时一次性写入，读者不会看到只写了一部分的状态
+ *
+ * // 点数(1字节) | {地址(2字节) 值(2字节)}...
+ */
+static size_t process_write_vector(int source_fd, const ModbusTCPMessage *request, const RegisterTarget *target,
+                                   uint8_t *response_buffer, size_t response_size) {
+    const uint8_t *data = request->pdu.data;
+    uint8_t count = request->pdu.data_length >= 1 ? data[0] : 0;
+
+    if (count == 0 || count > MODBUS_MAX_VECTOR_WRITES || request->pdu.data_length < 1 + (size_t)count * 4) {
+        printf("[服务器] [fd:%d] FC44 请求数据无效\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_VECTOR, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE,
+                                           response_buffer, response_size);
+    }
+
+    uint32_t addresses[MODBUS_MAX_VECTOR_WRITES];
+    uint16_t values[MODBUS_MAX_VECTOR_WRITES];
+    for (uint8_t i = 0; i < count; i++) {
+        addresses[i] = (uint16_t)(data[1 + i * 4] << 8) | data[2 + i * 4];
+        values[i] = (uint16_t)(data[3 + i * 4] << 8) | data[4 + i * 4];
+    }
+
+    printf("[服务器] [fd:%d] FC44 原子多点写：%u 个寄存器\n", source_fd, count);
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (addresses[i] < MODBUS_REGISTER_COUNT &&
+            !register_map_allows(target->section, GENERATOR_BANK_HOLDING, addresses[i], 1, true)) {
+            printf("[服务器] [fd:%d] FC44 寄存器 %u 只读，未写入任何寄存器\n", source_fd, addresses[i]);
+            return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                               MODBUS_FC_WRITE_VECTOR, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                               response_buffer, response_size);
+        }
+    }
+
+    if (!register_bank_write_scattered(target->holding, addresses, values, count)) {
+        printf("[服务器] [fd:%d] FC44 地址越界，未写入任何寄存器\n", source_fd);
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_WRITE_VECTOR, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS,
+                                           response_buffer, response_size);
+    }
+    for (uint8_t i = 0; target->device == NULL && i < count; i++) {
+        register_file_note_write(&register_file, register_bank_location(&holding_bank, addresses[i]), 1);
+        subscription_mark_dirty(&subscriptions, SUBSCRIPTION_BANK_HOLDING, addresses[i], 1);
+        heatmap_record_write(&heatmap, HEATMAP_BANK_HOLDING, addresses[i], 1);
+        record_holding_write(request->mbap.unit_id, (uint16_t)addresses[i], values[i]);
+    }
+    if (target->device) {
+        replication_note_unreplicated(&replication, count);
+    }
+
+    return modbus_build_write_vector_response(request->mbap.transaction_id, request->mbap.unit_id, count,
+                                              response_buffer, response_size);
+}
+
+/* 订阅需要按描述符确认请求来自客户端连接（定义在后面的客户端管理部分） */
+static ClientInfo* find_client_by_fd(int fd);
+
+/*
+ * 处理 FC41 订阅寄存器变化请求
+ *
+ * 只有客户端连接可以订阅（串口线路上从站不能主动发送），且只能订阅默认寄存器组。
+ * 数量为 0 时取消本连接在该组上的全部订阅。
+ *
+ * // 读功能码(1字节) | 起始地址(2字节) | 数量(2字节)
+ */
+static size_t process_subscribe(int source_fd, const ModbusTCPMessage *request, const RegisterTarget *target,
+                                uint8_t *response_buffer, size_t response_size) {
+    uint8_t exception = 0;
+    uint8_t read_function_code = 0;
+    uint16_t start_address = 0;
+    uint16_t quantity = 0;
+
+    if (!find_client_by_fd(source_fd) || target->device) {
+        exception = MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+    } else if (request->pdu.data_length < 5 ||
+               (request->pdu.data[0] != MODBUS_FC_READ_HOLDING_REGISTERS &&
+                request->pdu.data[0] != MODBUS_FC_READ_INPUT_REGISTERS)) {
+        exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    } else {
+        read_function_code = request->pdu.data[0];
+        start_address = (uint16_t)(request->pdu.data[1] << 8) | request->pdu.data[2];
+        quantity = (uint16_t)(request->pdu.data[3] << 8) | request->pdu.data[4];
+        SubscriptionBank bank = (read_function_code == MODBUS_FC_READ_INPUT_REGISTERS)
+                                    ? SUBSCRIPTION_BANK_INPUT : SUBSCRIPTION_BANK_HOLDING;
+
+        if (quantity == 0) {
+            size_t removed = subscription_remove(&subscriptions, source_fd, bank);
+            printf("[服务器] [fd:%d] FC41 取消订阅：FC%02X 寄存器组，共 %zu 个订阅\n",
+                   source_fd, read_function_code, removed);
+        } else if (subscriptions.count >= SUBSCRIPTION_MAX) {
+            exception = MODBUS_EXCEPTION_SERVER_DEVICE_FAILURE;
+        } else if (!subscription_add(&subscriptions, source_fd, request->mbap.unit_id, bank,
+                                     start_address, quantity)) {
+            exception = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+        } else {
+            printf("[服务器] [fd:%d] FC41 订阅变化：FC%02X 起始地址=%u, 数量=%u\n",
+                   source_fd, read_function_code, start_address, quantity);
+        }
+    }
+
+    if (exception != 0) {
+        printf("[服务器] [fd:%d] FC41 订阅失败：%s\n", source_fd, modbus_get_exception_string(exception));
+        return modbus_build_error_response(request->mbap.transaction_id, request->mbap.unit_id,
+                                           MODBUS_FC_SUBSCRIBE, exception, response_buffer, response_size);
+    }
+    return modbus_build_subscribe_request(request->mbap.transaction_id, request->mbap.unit_id,
+                                          read_function_code, start_address, quantity,
+                                          response_buffer, response_size);
+}
+
+/*
+ * 处理一条 MBAP 格式的 Modbus 请求并构建响应（不负责发送）
+ *
+ * TCP、Unix 域、RTU-over-TCP 和串口线路共用此函数：RTU 帧先转换为 MBAP 帧再进入这里。
+ *
+ * 参数：
+ *   source_fd - 请求来源描述符（仅用于日志）
+ *   endpoint_device - 连接所属端点的设备，NULL 表示按单元 ID 路由
+ *   request_buffer - 请求数据缓冲区
+ *   request_length - 请求数据长度
+ *   response_buffer - 输出：响应缓冲区
+ *   response_size - 响应缓冲区大小
+ *
+ * 返回：
+ *   响应长度，请求无法解析时返回 0
+ */
+static size_t process_modbus_request(int source_fd, Device *endpoint_device,
+                                     const uint8_t *request_buffer, size_t request_length,
+                                     uint8_t *response_buffer, size_t response_size) {
+    if (!request_buffer || !response_buffer) {
+        return 0;
+    }
+    
+    /* 解析 Modbus 请求 */
+    ModbusTCPMessage request;
+    if (!modbus_parse_request(request_buffer, request_length, &request)) {
+        printf("[服务器] [fd:%d] Modbus 请求解析失败\n", source_fd);
+        return 0;
+    }
+    
+    printf("[服务器] [fd:%d] Modbus 请求：事务ID=%u, 功能码=0x%02X, 单元ID=%u\n",
+           source_fd, request.mbap.transaction_id, request.pdu.function_code, request.mbap.unit_id);
+    TRACE_PROBE3(dispatch, source_fd, request.pdu.function_code, request.mbap.transaction_id);
+    
+    /* 端点上的连接读写端点的设备；否则单元 ID 挂有模拟设备时读写该设备的寄存器 */
+    RegisterTarget target = { &holding_bank, &input_bank,
+                              endpoint_device ? endpoint_device : device_table_route(&devices, request.mbap.unit_id),
+                              NULL };
+    if (target.device) {
+        target.holding = &target.device->holding;
+        target.input = &target.device->input;
+    }
+
+    /* 复制中的备机只读：写请求回复异常 01，提升为主机后才接受 */
+    if (replication_read_only(&replication) &&
+        (request.pdu.function_code == MODBUS_FC_WRITE_SINGLE_REGISTER ||
+         request.pdu.function_code == MODBUS_FC_WRITE_MULTIPLE_REGISTERS ||
+         request.pdu.function_code == MODBUS_FC_WRITE_VECTOR)) {
+        printf("[服务器] [fd:%d] 本机是复制中的备机，拒绝写请求（功能码 0x%02X）\n",
+               source_fd, request.pdu.function_code);
+        return modbus_build_error_response(request.mbap.transaction_id, request.mbap.unit_id,
+                                           request.pdu.function_code, MODBUS_EXCEPTION_ILLEGAL_FUNCTION,
+                                           response_buffer, response_size);
+    }
+
+    /* 未同步的备机：默认寄存器还是初值或已过时，读请求回复异常 06（忙）；设备寄存器各进程独立，照常应答 */
+    if (!target.device && replication_syncing(&replication) &&
+        (request.pdu.function_code == MODBUS_FC_READ_HOLDING_REGISTERS ||
+         request.pdu.function_code == MODBUS_FC_READ_INPUT_REGISTERS ||
+         request.pdu.function_code == MODBUS_FC_READ_VECTOR)) {
+        printf("[服务器] [fd:%d] 本机是尚未与主机同步的备机（%s），读请求回复忙（功能码 0x%02X）\n",
+               source_fd, replication_link_state_name(replication.link_state), request.pdu.function_code);
+        return modbus_build_error_response(request.mbap.transaction_id, request.mbap.unit_id,
+                                           request.pdu.function_code, MODBUS_EXCEPTION_SERVER_DEVICE_BUSY,
+                                           response_buffer, response_size);
+    }
+
+    /* 访问模式：默认寄存器取映射的默认段，按单元 ID 挂接的设备取所在的单元段 */
+    if (register_map && (!target.device || target.device->unit_id != 0)) {
+        target.section = register_map_section(register_map, target.device ? target.device->unit_id : 0);
+    }
+
+    size_t response_length = 0;
+    
+    /* 根据功能码处理请求 */
+    switch (request.pdu.function_code) {
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+            /* FC03：读保持寄存器 */
+            response_length = process_read_registers(source_fd, &request, &target,
+                                                     response_buffer, response_size);
+            break;
+
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+            /* FC04：读输入寄存器 */
+            response_length = process_read_registers(source_fd, &request, &target,
+                                                     response_buffer, response_size);
+            break;
+        
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            /* FC06：写单个寄存器 */
+            response_length = process_write_single_register(source_fd, &request, &target,
+                                                            response_buffer, response_size);
+            break;
+
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            /* FC10：写多个寄存器 */
+            response_length = process_write_multiple_registers(source_fd, &request, &target,
+                                                               response_buffer, response_size);
+            break;
+
+        case MODBUS_FC_SUBSCRIBE:
+            /* FC41：订阅寄存器变化（厂商扩展） */
+            response_length = process_subscribe(source_fd, &request, &target, response_buffer, response_size);
+            break;
+
+        case MODBUS_FC_READ_VECTOR:
+            /* FC43：分散读（厂商扩展） */
+            response_length = process_read_vector(source_fd, &request, &target, response_buffer, response_size);
+            break;
+
+        case MODBUS_FC_WRITE_VECTOR:
+            /* FC44：原子多点写（厂商扩展） */
+            response_length = process_write_vector(source_fd, &request, &target, response_buffer, response_size);
+            break;
+        
+        default:
+            /* 不支持的功能码 */
+            printf("[服务器] [fd:%d] 不支持的功能码：0x%02X\n", source_fd, request.pdu.function_code);
+            response_length = modbus_build_error_response(
+                request.mbap.transaction_id,
+                request.mbap.unit_id,
+                request.pdu.function_code,
+                MODBUS_EXCEPTION_ILLEGAL_FUNCTION,
+                response_buffer,
+                response_size
+            );
+            break;
+    }
+
+    if (response_length > 0) {
+        TRACE_PROBE3(response_built, source_fd, response_buffer[MODBUS_MBAP_HEADER_LENGTH], response_length);
+    }
+    return response_length;
+}
+
+/*
+ * 处理 Modbus TCP 请求并发送响应
+ * 
+ * 参数：
+ *   client - 客户端信息
+ *   request_buffer - 请求数据缓冲区
+ *   request_length - 请求数据长度
+ * 
+ * 返回：
+ *   成功返回 true，失败返回 false；客户端在处理中被断开时（client->active 为 false）调用者应停止处理后续帧
+ */
+static bool handle_modbus_request(ClientInfo *client, const uint8_t *request_buffer, size_t request_length) {
+    if (!client || !request_buffer) {
+        return false;
+    }
+
+    TRACE_PROBE2(frame_complete, client->fd, request_length);
+
+    /* 网关：单元 ID 在上游的请求转发出去，响应（或网关异常）稍后经 deliver_gateway_response 写回 */
+    if (!client->device && request_length > MODBUS_MBAP_HEADER_LENGTH &&
+        gateway_routes(&gateway, request_buffer[6])) {
+        gateway_forward(&gateway, client->fd, request_buffer, request_length);
+        return client->active;  /* 缓存命中或网关异常同步应答，发送失败时已断开该客户端 */
+    }
+
+    uint8_t response_buffer[MODBUS_MAX_MESSAGE_LENGTH];
+    size_t response_length = process_modbus_request(client->fd, client->device, request_buffer, request_length,
+                                                    response_buffer, sizeof(response_buffer));
+    
+    /* 发送响应 */
+    if (response_length > 0) {
+        if (!client_send(client, response_buffer, response_length)) {
+            disconnect_after_send_failure(client);
+            return false;
+        }
+        TRACE_PROBE2(response_flush, client->fd, response_length);
+        record_response_metrics(client, &response_buffer[MODBUS_MBAP_HEADER_LENGTH]);
+        printf("[服务器] [fd:%d] Modbus 响应已发送（%zu 字节）\n", client->fd, response_length);
+        return true;
+    }
+    
+    return false;
+}
+
+/*
+ * 网关的响应投递函数：把上游响应（已恢复主站的事务标识符）或网关异常写回主站
+ *
+ * 参数：
+ *   client_fd - 主站连接的描述符
+ *   frame - MBAP 响应帧
+ *   length - 帧长度
+ *   request_ns - 请求到达网关的时刻，延迟按此统计
+ *   context - 未使用
+ */
+static void deliver_gateway_response(int client_fd, const uint8_t *frame, size_t length, uint64_t request_ns,
+                                     void *context __attribute__((unused))) {
+    ClientInfo *client = find_client_by_fd(client_fd);
+    if (!client) {
+        return;
+    }
+    /* RTU-over-TCP 主站的请求转发前已转换为 MBAP，响应转换回 RTU 帧 */
+    uint8_t rtu_frame[MODBUS_RTU_MAX_ADU_LENGTH];
+    const uint8_t *pdu = &frame[MODBUS_MBAP_HEADER_LENGTH];
+    if (client->protocol == CLIENT_PROTOCOL_MODBUS_RTU) {
+        length = modbus_tcp_to_rtu(frame, length, rtu_frame, sizeof(rtu_frame));
+        frame = rtu_frame;
+        pdu = &rtu_frame[1];
+    }
+    if (length == 0) {
+        disconnect_client(client, "网关响应无法转换为 RTU 帧");
+        return;
+    }
+    if (!client_send(client, frame, length)) {
+        disconnect_after_send_failure(client);
+        return;
+    }
+    request_arrival_ns = request_ns;  /* 延迟从请求到达网关时算起 */
+    record_response_metrics(client, pdu);
+    printf("[服务器] [fd:%d] 网关响应已转发（%zu 字节）\n", client->fd, length);
+}
+
+/*
+ * 处理一条 RTU 帧：校验 CRC，转换为 MBAP 后处理，再把响应转换回 RTU
+ *
+ * 单元 ID 由网关转发时：RTU-over-TCP 连接的请求交给网关，响应稍后经 deliver_gateway_response 写回；
+ * 串口线路按半双工逐帧应答，无法等待上游，回复异常 0A（网关路径不可用）。
+ *
+ * 参数：
+ *   client - RTU-over-TCP 连接，串口线路为 NULL
+ *   source_fd - 请求来源描述符（仅用于日志）
+ *   endpoint_device - 连接所属端点的设备，NULL 表示按单元 ID 路由
+ *   frame - RTU 请求帧（含 CRC）
+ *   length - 帧长度
+ *   response - 输出：RTU 响应帧
+ *   response_size - 响应缓冲区大小
+ *
+ * 返回：
+ *   RTU 响应长度；CRC 错误或广播请求（按规范不应答）返回 0
+ */
+static size_t process_rtu_frame(ClientInfo *client, int source_fd, Device *endpoint_device, const uint8_t *frame,
+                                size_t length, uint8_t *response, size_t response_size) {
+    uint8_t tcp_request[MODBUS_MAX_MESSAGE_LENGTH];
+    size_t tcp_length = modbus_rtu_to_tcp(frame, length, 0, tcp_request, sizeof(tcp_request));
+    if (tcp_length == 0) {
+        printf("[服务器] [fd:%d] RTU 帧 CRC 校验失败或长度非法（%zu 字节），已丢弃\n", source_fd, length);
+        return 0;
+    }
+
+    uint8_t tcp_response[MODBUS_MAX_MESSAGE_LENGTH];
+    size_t tcp_response_length = 0;
+    if (!endpoint_device && tcp_length > MODBUS_MBAP_HEADER_LENGTH && gateway_routes(&gateway, tcp_request[6])) {
+        if (client) {
+            gateway_forward(&gateway, client->fd, tcp_request, tcp_length);
+            return 0;
+        }
+        printf("[服务器] [fd:%d] 串口线路上的单元 %u 由网关转发，回复异常 0A\n", source_fd, tcp_request[6]);
+        tcp_response_length = modbus_build_error_response(0, tcp_request[6], tcp_request[7],
+                                                          MODBUS_EXCEPTION_GATEWAY_PATH_UNAVAILABLE,
+                                                          tcp_response, sizeof(tcp_response));
+    } else {
+        tcp_response_length = process_modbus_request(source_fd, endpoint_device, tcp_request, tcp_length,
+                                                     tcp_response, sizeof(tcp_response));
+    }
+    if (tcp_response_length == 0 || frame[0] == MODBUS_RTU_BROADCAST_ADDRESS) {
+        return 0;
+    }
+
+    return modbus_tcp_to_rtu(tcp_response, tcp_response_length, response, response_size);
+}
+
+/*
+ * 确保连接持有半帧暂存区（从缓冲池借用）
+ *
+ * 返回：
+ *   已持有或借用成功返回 true；缓冲池已达上限返回 false，调用者丢弃这段不完整的数据
+ */
+static bool borrow_pending(ClientInfo *client) {
+    if (client->pending) {
+        return true;
+    }
+    client->pending = buffer_pool_alloc(&buffer_pool, CLIENT_PENDING_SIZE);
+    if (!client->pending) {
+        printf("[服务器] [fd:%d] 缓冲池已达内存上限，丢弃不完整的帧\n", client->fd);
+        client->pending_length = 0;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 暂存区中没有半帧时把它还给缓冲池
+ */
+static void return_pending(ClientInfo *client) {
+    if (client->pending && client->pending_length == 0) {
+        buffer_pool_free(&buffer_pool, client->pending);
+        client->pending = NULL;
+    }
+}
+
+/*
+ * 缓冲数据中第一个字节之后是否已有 CRC 正确的帧（说明开头是杂散字节，而不是不完整的帧）
+ */
+static bool rtu_frame_follows(const uint8_t *buffer, size_t length) {
+    for (size_t skip = 1; skip + MODBUS_RTU_MIN_ADU_LENGTH <= length; skip++) {
+        if (modbus_rtu_scan_frame(&buffer[skip], length - skip) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 处理 RTU-over-TCP 连接上收到的数据
+ *
+ * TCP 流没有 t3.5 间隔可用，按功能码推算帧长度逐帧切分，
+ * 不足一帧的尾部字节暂存在连接上，与下次读到的数据拼接；
+ * 无法推算长度的功能码：开头有 CRC 正确的帧时按该帧处理（回复异常 01）；还没有时可能只是帧不完整，
+ * 等待更多数据，直到后面出现 CRC 正确的帧或已缓冲满一个最大帧，才丢弃一个字节重新同步，
+ * 分帧不依赖每次读到的数据边界。
+ */
+static void handle_rtu_stream(ClientInfo *client, const uint8_t *buffer, size_t length) {
+    while (length > 0) {
+        if (!borrow_pending(client)) {
+            return;
+        }
+        /* 把新数据追加到暂存区，一次最多凑满一个最大帧 */
+        size_t room = CLIENT_PENDING_SIZE - client->pending_length;
+        size_t take = length < room ? length : room;
+        memcpy(&client->pending[client->pending_length], buffer, take);
+        client->pending_length += take;
+        buffer += take;
+        length -= take;
+
+        size_t offset = 0;
+        while (offset < client->pending_length) {
+            size_t available = client->pending_length - offset;
+            int frame_length = modbus_rtu_request_length(&client->pending[offset], available);
+            if (frame_length < 0) {
+                frame_length = (int)modbus_rtu_scan_frame(&client->pending[offset], available);
+                if (frame_length == 0) {
+                    if (available < MODBUS_RTU_MAX_ADU_LENGTH &&
+                        !rtu_frame_follows(&client->pending[offset], available)) {
+                        break;  /* 可能是不完整的帧，等待更多数据 */
+                    }
+                    printf("[服务器] [fd:%d] RTU 功能码未知（0x%02X）且没有完整的帧，丢弃 1 字节重新同步\n",
+                           client->fd, client->pending[offset + 1]);
+                    offset++;
+                    continue;
+                }
+            } else if (frame_length > MODBUS_RTU_MAX_ADU_LENGTH) {
+                printf("[服务器] [fd:%d] RTU 帧长度非法（%d 字节），丢弃缓冲数据\n", client->fd, frame_length);
+                offset = client->pending_length;
+                break;
+            } else if (frame_length == 0 || (size_t)frame_length > available) {
+                break;  /* 等待更多数据 */
+            }
+
+            TRACE_PROBE2(frame_complete, client->fd, frame_length);
+            uint8_t response[MODBUS_RTU_MAX_ADU_LENGTH];
+            size_t response_length = process_rtu_frame(client, client->fd, client->device,
+                                                       &client->pending[offset], (size_t)frame_length,
+                                                       response, sizeof(response));
+            if (!client->active) {
+                return;  /* 网关同步应答时发送失败，连接已断开，暂存区已归还 */
+            }
+            if (response_length > 0) {
+                if (!client_send(client, response, response_length)) {
+                    disconnect_after_send_failure(client);
+                    return;  /* 暂存区已随连接归还 */
+                }
+                TRACE_PROBE2(response_flush, client->fd, response_length);
+                record_response_metrics(client, &response[1]);
+                printf("[服务器] [fd:%d] RTU 响应已发送（%zu 字节）\n", client->fd, response_length);
+            }
+            offset += (size_t)frame_length;
+        }
+
+        /* 将未处理的尾部移到暂存区开头 */
+        if (offset > 0) {
+            memmove(client->pending, &client->pending[offset], client->pending_length - offset);
+            client->pending_length -= offset;
+        }
+    }
+}
+
+/*
+ * 丢弃 MBAP 头非法的缓冲数据（流已无法重新同步）
+ */
+static void drop_invalid_mbap(ClientInfo *client, const uint8_t *header) {
+    printf("[服务器] [fd:%d] MBAP 头非法（协议标识符=0x%02X%02X，长度字段=0x%02X%02X），丢弃缓冲数据\n",
+           client->fd, header[2], header[3], header[4], header[5]);
+    client->pending_length = 0;
+}
+
+/*
+ * 处理 Modbus TCP 连接上收到的数据
+ *
+ * 按 MBAP 长度字段逐帧切分，一次读取可以包含多帧。完整的帧直接在读缓冲区上处理，不复制；
+ * 只有跨两次读取的帧才暂存在连接上，凑满后处理。
+ */
+static void handle_modbus_stream(ClientInfo *client, const uint8_t *buffer, size_t length) {
+    /* 先用新数据补齐上次暂存的半帧 */
+    while (client->pending_length > 0) {
+        int frame_length = modbus_tcp_frame_length(client->pending, client->pending_length);
+        if (frame_length < 0) {
+            drop_invalid_mbap(client, client->pending);
+            return;
+        }
+        size_t target = frame_length > 0 ? (size_t)frame_length : MODBUS_MBAP_HEADER_LENGTH - 1;
+        size_t take = target - client->pending_length;
+        if (take > length) {
+            take = length;
+        }
+        if (take == 0) {
+            return;  /* 等待更多数据 */
+        }
+        memcpy(&client->pending[client->pending_length], buffer, take);
+        client->pending_length += take;
+        buffer += take;
+        length -= take;
+        if (frame_length > 0 && client->pending_length == (size_t)frame_length) {
+            client->pending_length = 0;
+            if (!handle_modbus_request(client, client->pending, (size_t)frame_length) && !client->active) {
+                return;
+            }
+        }
+    }
+
+    while (length > 0) {
+        int frame_length = modbus_tcp_frame_length(buffer, length);
+        if (frame_length < 0) {
+            drop_invalid_mbap(client, buffer);
+            return;
+        }
+        if (frame_length == 0 || (size_t)frame_length > length) {
+            if (!borrow_pending(client)) {
+                return;
+            }
+            memcpy(client->pending, buffer, length);
+            client->pending_length = length;
+            return;
+        }
+        if (!handle_modbus_request(client, buffer, (size_t)frame_length) && !client->active) {
+            return;  /* 已断开：不再处理同一批中后续的帧 */
+        }
+        buffer += frame_length;
+        length -= (size_t)frame_length;
+    }
+}
+
+/*
+ * 处理文本连接上收到的数据（回显协议，仅在调试模式下应答）
+ *
+ * 每次读到的数据是一批消息，按换行拆分（客户端程序的每条消息以换行结尾），最后一段不要求以换行结尾。
+ * 各段直接从读缓冲区格式化到回显响应中，不另外复制。
+ */
+static void handle_text_stream(ClientInfo *client, const uint8_t *buffer, size_t length) {
+#if DEBUG_MODE
+    const char *text = (const char *)buffer;
+    const char *end = text + length;
+    while (text < end) {
+        const char *newline = memchr(text, '\n', (size_t)(end - text));
+        int line_length = (int)((newline ? newline : end) - text);
+        if (line_length > 0 && text[line_length - 1] == '\r') {
+            line_length--;
+        }
+
+        if (line_length > 0) {
+            printf("[服务器] [fd:%d] 消息：%.*s\n", client->fd, line_length, text);
+        } else {
+            printf("[服务器] [fd:%d] 消息：(空消息)\n", client->fd);
+        }
+
+        char response[BUFFER_SIZE + 64];
+        int resp_len = snprintf(response, sizeof(response), "[服务器回显][fd:%d] %.*s\n",
+                                client->fd, line_length, text);
+        if (resp_len < 0) {
+            return;
+        }
+        if ((size_t)resp_len >= sizeof(response)) {
+            resp_len = (int)sizeof(response) - 1;
+        }
+        if (!client_send(client, response, (size_t)resp_len)) {
+            disconnect_after_send_failure(client);
+            return;
+        }
+        text = newline ? newline + 1 : end;
+    }
+#else
+    (void)client;
+    (void)buffer;
+    (void)length;
+#endif
+}
+
+/*
+ * 根据连接上最先到达的字节判定协议
+ *
+ * MBAP 头的协议标识符（字节 2-3）固定为 0，长度字段（字节 4-5）在 2..254 之间，
+ * 文本消息不含 NUL 字节：已到达的字节中任一字节与 MBAP 头不符即判定为文本。
+ * 已到达的字节都相符但不足 6 字节时暂不判定。
+ */
+static ClientProtocol detect_client_protocol(const uint8_t *data, size_t length) {
+    int frame_length = modbus_tcp_frame_length(data, length);
+    if (frame_length != 0) {
+        return frame_length > 0 ? CLIENT_PROTOCOL_MODBUS_TCP : CLIENT_PROTOCOL_TEXT;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (data[i] != 0) {
+            return CLIENT_PROTOCOL_TEXT;
+        }
+    }
+    return CLIENT_PROTOCOL_UNKNOWN;
+}
+
+/*
+ * 协议名称（用于日志）
+ */
+static const char *client_protocol_name(ClientProtocol protocol) {
+    switch (protocol) {
+        case CLIENT_PROTOCOL_MODBUS_TCP: return "Modbus TCP";
+        case CLIENT_PROTOCOL_MODBUS_RTU: return "RTU-over-TCP";
+        case CLIENT_PROTOCOL_TEXT: return "文本";
+        default: return "未知";
+    }
+}
+
+/*
+ * 把连接上收到的数据交给其协议的处理函数
+ *
+ * 协议在连接上只判定一次：尚未判定时先判定，判定前暂存的开头几个字节留给对应的处理函数。
+ */
+static void dispatch_client_data(ClientInfo *client, const uint8_t *buffer, size_t length) {
+    if (client->protocol == CLIENT_PROTOCOL_UNKNOWN) {
+        uint8_t probe[MODBUS_MBAP_HEADER_LENGTH - 1];
+        size_t held = client->pending_length;
+        size_t take = length < sizeof(probe) - held ? length : sizeof(probe) - held;
+        if (held > 0) {
+            memcpy(probe, client->pending, held);
+        }
+        memcpy(&probe[held], buffer, take);
+        client->protocol = detect_client_protocol(probe, held + take);
+        if (client->protocol == CLIENT_PROTOCOL_UNKNOWN) {
+            if (borrow_pending(client)) {
+                memcpy(&client->pending[held], buffer, length);
+                client->pending_length += length;
+            }
+            return;
+        }
+        printf("[服务器] [fd:%d] 连接协议判定为 %s\n", client->fd, client_protocol_name(client->protocol));
+
+        /* 暂存的开头字节与本次数据拼成同一批文本（每个连接只发生一次） */
+        if (client->protocol == CLIENT_PROTOCOL_TEXT && held > 0) {
+            uint8_t joined[CLIENT_PENDING_SIZE + BUFFER_SIZE];
+            memcpy(joined, client->pending, held);
+            memcpy(&joined[held], buffer, length);
+            client->pending_length = 0;
+            return_pending(client);
+            handle_text_stream(client, joined, held + length);
+            return;
+        }
+    }
+
+    switch (client->protocol) {
+        case CLIENT_PROTOCOL_MODBUS_RTU:
+            handle_rtu_stream(client, buffer, length);
+            break;
+        case CLIENT_PROTOCOL_MODBUS_TCP:
+            handle_modbus_stream(client, buffer, length);
+            break;
+        default:
+            handle_text_stream(client, buffer, length);
+            break;
+    }
+    return_pending(client);
+}
+
+/*
+ * 根据描述符查找串口线路
+ * 参数：
+ *   fd - PTY 主端或定时器描述符
+ *   is_timer - 输出：fd 是否为该线路的定时器
+ * 返回：
+ *   指向线路的指针，未找到返回NULL
+ */
+static SerialLine* find_serial_line_by_fd(int fd, bool *is_timer) {
+    for (int i = 0; i < serial_line_count; i++) {
+        if (!serial_lines[i].active) {
+            continue;
+        }
+        if (serial_lines[i].master_fd == fd) {
+            *is_timer = false;
+            return &serial_lines[i];
+        }
+        if (serial_lines[i].timer_fd == fd) {
+            *is_timer = true;
+            return &serial_lines[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 处理串口线路事件：主端可读时累积字节，t3.5 定时器到期时处理完整帧
+ */
+static void handle_serial_event(SerialLine *line, bool is_timer) {
+    if (!is_timer) {
+        if (!serial_pty_handle_input(line)) {
+            printf("[服务器] [串口 %s] 读取失败\n", line->slave_name);
+        }
+        return;
+    }
+
+    const uint8_t *frame = NULL;
+    size_t frame_length = 0;
+    if (!serial_pty_take_frame(line, &frame, &frame_length)) {
+        return;
+    }
+    request_arrival_ns = metrics_now_ns();
+    metrics.bytes_received += frame_length;
+    TRACE_PROBE2(request_receive, line->master_fd, frame_length);
+    TRACE_PROBE2(frame_complete, line->master_fd, frame_length);
+
+    uint8_t response[MODBUS_RTU_MAX_ADU_LENGTH];
+    size_t response_length = process_rtu_frame(NULL, line->master_fd, NULL, frame, frame_length,
+                                               response, sizeof(response));
+    if (response_length == 0) {
+        line->frames_dropped++;
+        return;
+    }
+    if (!serial_pty_write(line, response, response_length)) {
+        printf("[服务器] [串口 %s] 响应发送失败，已丢弃\n", line->slave_name);
+        return;
+    }
+    metrics.bytes_sent += response_length;
+    TRACE_PROBE2(response_flush, line->master_fd, response_length);
+    record_response_metrics(NULL, &response[1]);
+}
+
+/*
+ * 根据文件描述符查找客户端信息
+ * 参数：
+ *   fd - 客户端文件描述符
+ * 返回：
+ *   指向客户端信息的指针，未找到返回NULL
+ */
+static ClientInfo* find_client_by_fd(int fd) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].active && clients[i].fd == fd) {
+            return &clients[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 添加新客户端到客户端数组
+ * 参数：
+ *   fd - 客户端文件描述符
+ *   addr - 客户端地址信息（Unix 域连接时为全零）
+ *   is_unix - 是否来自 Unix 域套接字监听
+ *   protocol - 监听决定的协议（RTU-over-TCP），其余为 CLIENT_PROTOCOL_UNKNOWN，由首批数据判定
+ * 返回：
+ *   指向新添加客户端信息的指针，失败返回NULL
+ */
+static ClientInfo* add_client(int fd, struct sockaddr_in addr, bool is_unix, ClientProtocol protocol) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].active) {
+            clients[i].fd = fd;
+            clients[i].addr = addr;
+            clients[i].active = true;
+            clients[i].is_unix = is_unix;
+            clients[i].protocol = protocol;
+            clients[i].device = NULL;
+            clients[i].pending_length = 0;
+            outbound_queue_init(&clients[i].outbound);
+            clients[i].want_write = false;
+            clients[i].flush_scheduled = false;
+            memset(&clients[i].traffic, 0, sizeof(clients[i].traffic));
+            clients[i].traffic.connected_ns = metrics_now_ns();
+            clients[i].traffic.last_activity_ns = clients[i].traffic.connected_ns;
+            snprintf(clients[i].id, CLIENT_ID_LENGTH, "%d", fd);
+            client_count++;
+            metrics.connections_opened++;
+            return &clients[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 将客户端标记为非活跃状态
+ * 参数：
+ *   client - 客户端信息指针
+ */
+static void deactivate_client(ClientInfo *client) {
+    if (!client || !client->active) {
+        return;
+    }
+    client->active = false;
+    client->is_unix = false;
+    client->protocol = CLIENT_PROTOCOL_UNKNOWN;
+    client->device = NULL;
+    buffer_pool_free(&buffer_pool, client->pending);
+    client->pending = NULL;
+    client->pending_length = 0;
+    client->tls = NULL;
+    client->tls_ready = false;
+    client->fd = -1;
+    memset(&client->addr, 0, sizeof(client->addr));
+    memset(client->id, 0, CLIENT_ID_LENGTH);
+    if (client_count > 0) {
+        client_count--;
+    }
+}
+
+/*
+ * 将客户端地址格式化为 "IP:端口" 或 "unix:路径"
+ * 参数：
+ *   client - 客户端信息指针
+ *   buf - 输出缓冲区
+ *   size - 缓冲区大小
+ */
+static void format_client_address(const ClientInfo *client, char *buf, size_t size) {
+    if (client->is_unix) {
+        snprintf(buf, size, "unix:%s", unix_socket_path);
+        return;
+    }
+    char addr_buf[INET_ADDRSTRLEN] = {0};
+    if (inet_ntop(AF_INET, &client->addr.sin_addr, addr_buf, sizeof(addr_buf)) == NULL) {
+        strncpy(addr_buf, "未知", sizeof(addr_buf) - 1);
+    }
+    snprintf(buf, size, "%s:%d", addr_buf, ntohs(client->addr.sin_port));
+}
+
+/*
+ * 断开与客户端的连接并清理 epoll/套接字资源
+ * 参数：
+ *   client - 客户端信息指针
+ *   reason - 断开原因描述
+ */
+static void disconnect_client(ClientInfo *client, const char *reason) {
+    if (!client || !client->active) {
+        return;
+    }
+
+    int fd = client->fd;
+    char addr_buf[UNIX_PATH_LENGTH + 8] = {0};
+    format_client_address(client, addr_buf, sizeof(addr_buf));
+
+    if (epoll_fd != -1) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    }
+    if (client->tls) {
+        tls_session_free(client->tls);
+    }
+    close(client->fd);
+    subscription_remove_client(&subscriptions, fd);
+    gateway_client_closed(&gateway, fd);
+
+    /* 未写出的消息计入各缓冲区的丢弃数；从待刷新列表中移除 */
+    outbound_queue_clear(&client->outbound);
+    client->want_write = false;
+    if (client->flush_scheduled) {
+        client->flush_scheduled = false;
+        for (int i = 0; i < flush_pending_count; i++) {
+            if (flush_pending[i] == client) {
+                flush_pending[i] = flush_pending[--flush_pending_count];
+                break;
+            }
+        }
+    }
+
+    deactivate_client(client);
+    metrics.connections_closed++;
+
+    printf("[服务器] [fd:%d] 已断开连接（地址 %s，原因: %s）（当前客户端总数: %d）\n",
+           fd,
+           addr_buf,
+           reason ? reason : "未知",
+           client_count);
+}
+
+/* 客户端负载排序项 */
+typedef struct {
+    ClientInfo *client;
+    double rate;        /* 请求/秒 */
+} ClientLoad;
+
+/* list/top 表头，与 format_client_row 的列宽对齐 */
+static const char CLIENT_TABLE_HEADER[] =
+    "   fd  地址                    请求/秒    请求数   异常  收字节  发字节  延迟us   空闲s  功能码:请求数";
+
+/*
+ * 按请求速率降序排序，速率相同按累计请求数
+ */
+static int compare_client_load(const void *a, const void *b) {
+    const ClientLoad *left = a;
+    const ClientLoad *right = b;
+    if (left->rate != right->rate) {
+        return left->rate < right->rate ? 1 : -1;
+    }
+    if (left->client->traffic.requests != right->client->traffic.requests) {
+        return left->client->traffic.requests < right->client->traffic.requests ? 1 : -1;
+    }
+    return left->client->fd - right->client->fd;
+}
+
+/*
+ * 收集活跃客户端并按负载排序
+ *
+ * 参数：
+ *   loads - 输出数组（容量 MAX_CLIENTS）
+ *   since_refresh - true 时速率按上次 top 刷新以来的请求数计算，否则按连接以来的平均值
+ *   now - 当前时刻（CLOCK_MONOTONIC 纳秒）
+ *
+ * 返回：
+ *   客户端数量
+ */
+static int collect_client_loads(ClientLoad *loads, bool since_refresh, uint64_t now) {
+    int count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].active) {
+            continue;
+        }
+        const ClientTraffic *traffic = &clients[i].traffic;
+        uint64_t since = since_refresh && top_refreshed_ns > traffic->connected_ns ? top_refreshed_ns
+                                                                                   : traffic->connected_ns;
+        uint64_t requests = since_refresh && top_refreshed_ns > traffic->connected_ns
+                                ? traffic->requests - traffic->top_requests
+                                : traffic->requests;
+        double seconds = (double)(now - since) / 1e9;
+        loads[count].client = &clients[i];
+        loads[count].rate = seconds > 0 ? (double)requests / seconds : 0.0;
+        count++;
+    }
+    qsort(loads, (size_t)count, sizeof(ClientLoad), compare_client_load);
+    return count;
+}
+
+/*
+ * 将字节数格式化为 B/K/M/G
+ */
+static void format_bytes(uint64_t bytes, char *buf, size_t size) {
+    static const char UNITS[] = "BKMG";
+    double value = (double)bytes;
+    int unit = 0;
+    while (value >= 1024.0 && unit < 3) {
+        value /= 1024.0;
+        unit++;
+    }
+    if (unit == 0) {
+        snprintf(buf, size, "%lluB", (unsigned long long)bytes);
+    } else {
+        snprintf(buf, size, "%.1f%c", value, UNITS[unit]);
+    }
+}
+
+/*
+ * 将一个客户端格式化为一行表格（纯 ASCII，按字节截断即按列截断）
+ *
+ * 功能码列列出请求最多的 3 个功能码。
+ */
+static void format_client_row(const ClientLoad *load, uint64_t now, char *buf, size_t size) {
+    const ClientInfo *client = load->client;
+    const ClientTraffic *traffic = &client->traffic;
+
+    char addr_buf[UNIX_PATH_LENGTH + 8] = {0};
+    format_client_address(client, addr_buf, sizeof(addr_buf));
+    char in_buf[16], out_buf[16];
+    format_bytes(traffic->bytes_in, in_buf, sizeof(in_buf));
+    format_bytes(traffic->bytes_out, out_buf, sizeof(out_buf));
+
+    int top_codes[3] = { -1, -1, -1 };
+    for (int fc = 0; fc < CLIENT_FUNCTION_CODES; fc++) {
+        uint32_t count = traffic->function_requests[fc];
+        for (int slot = 0; count > 0 && slot < 3; slot++) {
+            if (top_codes[slot] < 0 || count > traffic->function_requests[top_codes[slot]]) {
+                memmove(&top_codes[slot + 1], &top_codes[slot], (size_t)(2 - slot) * sizeof(int));
+                top_codes[slot] = fc;
+                break;
+            }
+        }
+    }
+    char codes_buf[64] = "-";
+    size_t used = 0;
+    for (int slot = 0; slot < 3 && top_codes[slot] >= 0; slot++) {
+        used += (size_t)snprintf(codes_buf + used, sizeof(codes_buf) - used, "%s%02X:%u",
+                                 slot ? " " : "", (unsigned int)top_codes[slot],
+                                 traffic->function_requests[top_codes[slot]]);
+    }
+
+    snprintf(buf, size, "%5d  %-22.22s %8.1f %9llu %6llu %7s %7s %7.0f %7.1f  %s",
+             client->fd, addr_buf, load->rate,
+             (unsigned long long)traffic->requests, (unsigned long long)traffic->exceptions,
+             in_buf, out_buf, traffic->latency_ewma_us,
+             (double)(now - traffic->last_activity_ns) / 1e9, codes_buf);
+}
+
+/*
+ * 列出所有连接的客户端及其流量统计，按连接以来的平均请求速率排序
+ * 参数：
+ *   out - 输出流（控制台为 stdout，管理连接为内存流）
+ */
+static void list_clients(FILE *out) {
+    ClientLoad loads[MAX_CLIENTS];
+    uint64_t now = metrics_now_ns();
+    int count = collect_client_loads(loads, false, now);
+
+    fprintf(out, "[服务器] 当前连接的客户端列表（按平均请求速率排序）：\n");
+    if (count > 0) {
+        fprintf(out, "%s\n", CLIENT_TABLE_HEADER);
+    }
+    for (int i = 0; i < count; i++) {
+        char row[256];
+        format_client_row(&loads[i], now, row, sizeof(row));
+        fprintf(out, "%s\n", row);
+    }
+    fprintf(out, "[服务器] 总计：%d 个客户端\n", client_count);
+}
+
 #if DEBUG_MODE
-static void handle_stdin_input() {
-    char input[BUFFER_SIZE];
-    int result = process_server_input_char(&server_input_state, "[服务器] ", &cmd_history, input, BUFFER_SIZE);
-    
-    if (result < 0) {
-        /* 错误或Ctrl+D */
+
+/*
+ * 输出 top 面板的一行：先清除该行，超出终端宽度的部分截断（非 ASCII 字符按 2 列计）
+ */
+static void print_pane_line(const char *text, int columns, bool last) {
+    int width = 0;
+    size_t length = 0;
+    while (text[length] != '\0') {
+        unsigned char c = (unsigned char)text[length];
+        size_t char_length = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+        int char_width = c < 0x80 ? 1 : 2;
+        if (width + char_width > columns - 1) {
+            break;
+        }
+        width += char_width;
+        length += char_length;
+    }
+    printf("\033[K%.*s%s", (int)length, text, last ? "" : "\r\n");
+}
+
+/*
+ * 重绘 top 面板
+ *
+ * 面板占据屏幕顶部 TOP_PANE_LINES 行，其余行设为滚动区域，日志和命令行在下方滚动。
+ * 绘制前后保存/恢复光标，行编辑器的光标位置和正在输入的内容不受影响。
+ */
+static void refresh_top_pane() {
+    int rows = 24, columns = 80;
+    struct winsize window;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 0) {
+        rows = window.ws_row;
+        columns = window.ws_col;
+    }
+    if (rows <= TOP_PANE_LINES + 2) {
+        return;
+    }
+
+    uint64_t now = metrics_now_ns();
+    double interval = (double)(now - top_refreshed_ns) / 1e9;
+    ClientLoad loads[MAX_CLIENTS];
+    int count = collect_client_loads(loads, true, now);
+
+    printf("\0337\033[%d;%dr\033[H", TOP_PANE_LINES + 1, rows);
+    char line[256];
+    snprintf(line, sizeof(line), "[服务器] top：%d 个客户端，按最近 %.1f 秒的请求速率排序（top off 关闭）",
+             client_count, interval);
+    print_pane_line(line, columns, false);
+    print_pane_line(CLIENT_TABLE_HEADER, columns, false);
+    for (int i = 0; i < TOP_PANE_ROWS; i++) {
+        line[0] = '\0';
+        if (i < count) {
+            format_client_row(&loads[i], now, line, sizeof(line));
+        }
+        print_pane_line(line, columns, false);
+    }
+    memset(line, '-', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    print_pane_line(line, columns, true);
+    printf("\0338");
+    fflush(stdout);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].traffic.top_requests = clients[i].traffic.requests;
+    }
+    top_refreshed_ns = now;
+}
+
+/* 定义见下文（epoll 集合创建之后才会调用） */
+static bool epoll_add_fd(int fd, uint32_t events);
+
+/*
+ * 开启 top 面板：清屏，按间隔刷新
+ */
+static void start_top(double interval_s) {
+    if (!isatty(STDOUT_FILENO)) {
+        printf("[服务器] 错误：top 需要在终端中运行\n");
+        return;
+    }
+    if (top_timer_fd < 0) {
+        top_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (top_timer_fd < 0 || !epoll_add_fd(top_timer_fd, EPOLLIN)) {
+            perror("timerfd_create");
+            if (top_timer_fd >= 0) {
+                close(top_timer_fd);
+                top_timer_fd = -1;
+            }
+            return;
+        }
+    }
+    struct itimerspec period;
+    memset(&period, 0, sizeof(period));
+    period.it_interval.tv_sec = (time_t)interval_s;
+    period.it_interval.tv_nsec = (long)((interval_s - (double)(time_t)interval_s) * 1e9);
+    period.it_value = period.it_interval;
+    timerfd_settime(top_timer_fd, 0, &period, NULL);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].traffic.top_requests = clients[i].traffic.requests;
+    }
+    top_refreshed_ns = metrics_now_ns();
+
+    /* 清屏并把光标放到最后一行，面板在首次刷新时绘制 */
+    int rows = 24;
+    struct winsize window;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) == 0 && window.ws_row > 0) {
+        rows = window.ws_row;
+    }
+    printf("\033[2J\033[%d;1H", rows);
+    refresh_top_pane();
+}
+
+/*
+ * 关闭 top 面板：恢复整屏滚动
+ */
+static void stop_top() {
+    if (top_timer_fd < 0) {
+        return;
+    }
+    close(top_timer_fd);
+    top_timer_fd = -1;
+    printf("\0337\033[r\0338");
+    fflush(stdout);
+}
+
+/*
+ * top 刷新定时器到期
+ */
+static void handle_top_timer() {
+    uint64_t expirations;
+    if (read(top_timer_fd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations)) {
+        refresh_top_pane();
+    }
+}
+#endif /* DEBUG_MODE */
+
+/*
+ * 向指定客户端发送消息
+ * 参数：
+ *   target_fd - 客户端的 socket 文件描述符
+ *   message - 要发送的消息
+ *   out - 错误信息的输出流
+ * 返回：
+ *   成功返回true，失败返回false
+ */
+static bool send_to_client(int target_fd, const char *message, FILE *out) {
+    ClientInfo *client = find_client_by_fd(target_fd);
+    if (!client) {
+        fprintf(out, "[服务器] 错误：未找到文件描述符为 %d 的客户端\n", target_fd);
+        return false;
+    }
+
+    if (!client->active) {
+        fprintf(out, "[服务器] 警告：文件描述符为 %d 的客户端已不在活跃状态\n", target_fd);
+        return false;
+    }
+
+    if (!client_send(client, message, strlen(message))) {
+        disconnect_after_send_failure(client);
+        fprintf(out, "[服务器] 错误：向 [fd:%d] 发送失败，已断开\n", target_fd);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 向所有客户端广播消息
+ *
+ * 消息只复制一次到共享缓冲区，每个连接的发送队列挂一个引用，不在这里写套接字；
+ * 本轮末尾起按预算分批写出，全部写完或丢弃后由 report_broadcast_delivery 报告投递结果。
+ * TLS 握手尚未完成的连接不参与广播。
+ *
+ * 参数：
+ *   message - 要广播的消息
+ *   out - 结果的输出流
+ */
+static void broadcast_message(const char *message, FILE *out) {
+    OutboundBuffer *buffer = outbound_buffer_create(&buffer_pool, message, strlen(message));
+    if (!buffer) {
+        fprintf(out, "[服务器] 错误：广播缓冲区分配失败（缓冲池已达内存上限）\n");
+        return;
+    }
+    buffer->id = ++broadcast_sequence;
+    buffer->complete = report_broadcast_delivery;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo *client = &clients[i];
+        if (!client->active || (client->tls && !client->tls_ready)) {
+            continue;
+        }
+        bool was_empty = outbound_queue_empty(&client->outbound);
+        if (outbound_queue_push(&client->outbound, buffer) && was_empty && !client->want_write) {
+            schedule_client_flush(client);
+        }
+    }
+    fprintf(out, "[服务器] 广播 #%llu 已排队给 %u 个客户端（%u 个发送队列已满），写出后报告投递结果\n",
+            (unsigned long long)buffer->id, buffer->targets - buffer->dropped, buffer->dropped);
+    outbound_buffer_release(buffer);
+}
+
+/*
+ * 将文件描述符设置为非阻塞模式
+ * 参数：
+ *   fd - 需要设置的文件描述符
+ */
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/*
+ * 接受监听套接字上所有待处理的连接并注册到 epoll
+ * 参数：
+ *   listen_fd - 就绪的监听套接字（TCP 或 Unix 域）
+ */
+static void accept_clients(int listen_fd) {
+    bool is_unix = (listen_fd == unix_server_fd);
+    bool is_rtu = (listen_fd == rtu_server_fd);
+    bool is_tls = (listen_fd == tls_server_fd);
+    Endpoint *endpoint = endpoint_set_find(&endpoints, listen_fd);
+
+    /* 循环接受所有待处理的连接（非阻塞模式可能积累多个连接） */
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        memset(&client_addr, 0, sizeof(client_addr));
+
+        /* 接受客户端连接（Unix 域连接的对端地址无意义，不获取） */
+        int client_fd = is_unix
+            ? accept(listen_fd, NULL, NULL)
+            : accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
+        if (client_fd < 0) {
+            /* 如果没有更多连接了，退出循环 */
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            perror("accept");
+            break;
+        }
+
+        /* 检查是否达到最大客户端数量限制 */
+        if (client_count >= MAX_CLIENTS) {
+            printf("[服务器] 已达到最大客户端数量 (%d)。拒绝新连接。\n", MAX_CLIENTS);
+            close(client_fd);
+            continue;
+        }
+
+        /* 将客户端套接字设置为非阻塞模式 */
+        set_nonblocking(client_fd);
+
+        /* 将客户端套接字添加到 epoll 监听列表 */
+        struct epoll_event client_event;
+        client_event.events = EPOLLIN | EPOLLRDHUP; /* 监听可读和对端关闭事件 */
+        client_event.data.fd = client_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event) < 0) {
+            perror("epoll_ctl");
+            close(client_fd);
+            continue;
+        }
+
+        /* 添加客户端到管理数组 */
+        ClientInfo *client = add_client(client_fd, client_addr, is_unix,
+                                        is_rtu ? CLIENT_PROTOCOL_MODBUS_RTU : CLIENT_PROTOCOL_UNKNOWN);
+        if (!client) {
+            printf("[服务器] 错误：无法添加客户端到管理列表\n");
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
+            close(client_fd);
+            continue;
+        }
+
+        /* 设备端点上的连接只访问该端点的设备 */
+        if (endpoint) {
+            client->device = endpoint->device;
+            endpoint->connections++;
+        }
+
+        /* TLS 连接：创建会话，握手随后在事件循环中非阻塞推进 */
+        if (is_tls) {
+            client->tls = tls_session_new(client_fd);
+            if (!client->tls) {
+                disconnect_client(client, "创建 TLS 会话失败");
+                continue;
+            }
+        }
+
+        /* 打印连接信息 */
+        char addr_buf[UNIX_PATH_LENGTH + 8] = {0};
+        format_client_address(client, addr_buf, sizeof(addr_buf));
+        printf("[服务器] [fd:%d] 客户端已连接，来自 %s（当前客户端总数: %d）\n",
+               client->fd,
+               addr_buf,
+               client_count);
+        if (endpoint) {
+            char endpoint_buf[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &endpoint->addr.sin_addr, endpoint_buf, sizeof(endpoint_buf));
+            printf("[服务器] [fd:%d] 连接到端点 %s:%u（设备 #%u）\n", client->fd,
+                   endpoint_buf, ntohs(endpoint->addr.sin_port), endpoint->device->id);
+        }
+
+        /* 发送欢迎消息（仅在调试模式下；RTU 和 TLS 连接是纯二进制帧，不发送） */
+#if DEBUG_MODE
+        if (is_rtu || is_tls) {
+            continue;
+        }
+        char welcome[BUFFER_SIZE];
+        snprintf(welcome, BUFFER_SIZE, "[服务器通知] 欢迎，您的文件描述符为 %d。\n", client->fd);
+        if (write(client_fd, welcome, strlen(welcome)) < 0) {
+            perror("write");
+            disconnect_client(client, "发送欢迎消息失败");
+        }
+#endif
+    }
+}
+
+/*
+ * 接受指标抓取连接，等待其 HTTP 请求到达
+ *
+ * 抓取连接不进入客户端数组，不计入连接数指标。
+ */
+static void accept_metrics_connections() {
+    while (1) {
+        int fd = accept(metrics_server_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            break;
+        }
+        if (metrics_connection_count >= MAX_METRICS_CONNECTIONS) {
+            close(fd);
+            continue;
+        }
+        set_nonblocking(fd);
+        /* 边沿触发：请求头未收完时只窥视不取出，水平触发会在等待期间反复就绪 */
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            continue;
+        }
+        MetricsConnection *connection = &metrics_connections[metrics_connection_count++];
+        connection->fd = fd;
+        connection->deadline_ns = metrics_now_ns() + (uint64_t)METRICS_HTTP_TIMEOUT_MS * 1000000ULL;
+        connection->responding = false;
+        connection->found = false;
+        outbound_queue_init(&connection->outbound);
+    }
+}
+
+/*
+ * 关闭第 index 个指标抓取连接，丢弃未写完的响应
+ */
+static void close_metrics_connection(int index) {
+    MetricsConnection *connection = &metrics_connections[index];
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    outbound_queue_clear(&connection->outbound);
+    metrics_connections[index] = metrics_connections[--metrics_connection_count];
+}
+
+/*
+ * 发送队列的写函数：写到指标抓取连接（context 指向描述符）
+ */
+static ssize_t metrics_connection_write(void *context, const void *data, size_t length) {
+    return send(*(const int *)context, data, length, MSG_NOSIGNAL);
+}
+
+/*
+ * 处理指标抓取连接上的事件：请求头完整后把响应排入发送队列，非阻塞写出，写完后关闭连接
+ *
+ * 返回：
+ *   fd 是指标抓取连接返回 true，否则返回 false
+ */
+static bool handle_metrics_connection(int fd) {
+    for (int i = 0; i < metrics_connection_count; i++) {
+        MetricsConnection *connection = &metrics_connections[i];
+        if (connection->fd != fd) {
+            continue;
+        }
+        /* 确认是指标抓取连接后才记入看门狗，串口等其他描述符不会被算到这里 */
+        watchdog_enter(&watchdog, WATCHDOG_HANDLER_METRICS, fd);
+        if (!connection->responding) {
+            char *response = NULL;
+            size_t response_length = 0;
+            MetricsHttpStatus status = metrics_read_http(&metrics, fd, client_count, &response, &response_length,
+                                                         &connection->found);
+            if (status == METRICS_HTTP_PENDING) {
+                return true;
+            }
+            OutboundBuffer *buffer = status == METRICS_HTTP_READY
+                                         ? outbound_buffer_create(&buffer_pool, response, response_length) : NULL;
+            free(response);
+            bool queued = buffer && outbound_queue_push(&connection->outbound, buffer);
+            if (buffer) {
+                outbound_buffer_release(buffer);
+            }
+            if (!queued) {
+                close_metrics_connection(i);
+                return true;
+            }
+            connection->responding = true;
+        }
+
+        OutboundFlushResult result = outbound_queue_flush(&connection->outbound, metrics_connection_write,
+                                                          &connection->fd);
+        if (result == OUTBOUND_FLUSH_BLOCKED) {
+            /* 发送缓冲区已满：等待可写后继续，期限到了仍未写完则由定时器关闭 */
+            struct epoll_event event;
+            event.events = EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+            return true;
+        }
+        if (result == OUTBOUND_FLUSH_DRAINED && connection->found) {
+            metrics.scrapes++;
+        }
+        close_metrics_connection(i);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * 周期检查：关闭超过期限仍未写完响应的指标抓取连接（只连不发请求，或长期不读响应的抓取方）
+ */
+static void expire_metrics_connections(void) {
+    uint64_t expirations;
+    if (read(metrics_timer_fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+    uint64_t now = metrics_now_ns();
+    for (int i = metrics_connection_count - 1; i >= 0; i--) {
+        if (now >= metrics_connections[i].deadline_ns) {
+            printf("[服务器] 指标抓取连接 [fd:%d] %d 毫秒内未完成，已关闭\n",
+                   metrics_connections[i].fd, METRICS_HTTP_TIMEOUT_MS);
+            metrics.scrape_timeouts++;
+            close_metrics_connection(i);
+        }
+    }
+}
+
+/*
+ * 创建 TCP 监听套接字（非阻塞）
+ * 参数：
+ *   port - 监听端口
+ *   loopback_only - 只绑定 127.0.0.1（本机管理端口），否则绑定所有网络接口
+ * 返回：
+ *   成功返回监听描述符，失败返回 -1
+ */
+static int create_tcp_listener(int port, bool loopback_only) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    /* 设置套接字选项：允许地址快速重用 */
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt");
+        close(fd);
+        return -1;
+    }
+
+    /* 配置服务器地址结构 */
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;              /* IPv4 协议 */
+    server_addr.sin_addr.s_addr = htonl(loopback_only ? INADDR_LOOPBACK : INADDR_ANY);
+    server_addr.sin_port = htons(port);            /* 设置端口号（主机字节序转网络字节序） */
+
+    /* 绑定服务器套接字到指定地址和端口 */
+    if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    /* 开始监听连接请求 */
+    if (listen(fd, LISTEN_BACKLOG) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    /* 将服务器套接字设置为非阻塞模式 */
+    set_nonblocking(fd);
+    return fd;
+}
+
+/*
+ * 创建 Unix 域流式监听套接字
+ *
+ * 同机主站通过该套接字访问时绕过 TCP/IP 协议栈（无校验和、无 Nagle），
+ * 请求仍由同一 epoll 循环和 Modbus 处理逻辑服务。
+ * 若路径上残留的是旧的套接字文件则先删除，其他类型文件不覆盖。
+ *
+ * 参数：
+ *   path - 套接字文件路径
+ * 返回：
+ *   成功返回监听描述符，失败返回 -1
+ */
+static int create_unix_listener(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "错误: Unix 套接字路径过长（最多 %zu 字节）。\n", sizeof(addr.sun_path) - 1);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "错误: %s 已存在且不是套接字文件。\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, LISTEN_BACKLOG) < 0) {
+        perror("listen");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+/*
+ * 推进 TLS 握手，并根据 OpenSSL 的需要调整 epoll 关注的事件
+ * 参数：
+ *   client - 握手尚未完成的 TLS 客户端
+ * 返回：
+ *   连接仍然有效返回 true，握手失败并已断开返回 false
+ */
+static bool advance_tls_handshake(ClientInfo *client) {
+    TlsHandshakeResult result = tls_session_handshake(client->tls);
+    struct epoll_event client_event;
+    client_event.data.fd = client->fd;
+
+    switch (result) {
+        case TLS_HANDSHAKE_DONE: {
+            client->tls_ready = true;
+            client_event.events = EPOLLIN | EPOLLRDHUP;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &client_event);
+            char desc[128];
+            tls_session_describe(client->tls, desc, sizeof(desc));
+            printf("[服务器] [fd:%d] TLS 握手完成（%s）\n", client->fd, desc);
+            return true;
+        }
+        case TLS_HANDSHAKE_WANT_READ:
+            client_event.events = EPOLLIN | EPOLLRDHUP;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &client_event);
+            return true;
+        case TLS_HANDSHAKE_WANT_WRITE:
+            client_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &client_event);
+            return true;
+        default:
+            disconnect_client(client, "TLS 握手失败");
+            return false;
+    }
+}
+
+/*
+ * 处理客户端连接上的 epoll 事件：读取数据并按协议分发
+ * 参数：
+ *   client - 客户端信息
+ *   events - epoll 返回的事件位
+ */
+static void handle_client_event(ClientInfo *client, uint32_t events) {
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        disconnect_client(client, "客户端异常断开");
         return;
     }
-    
-    if (result == 0) {
-        /* 继续输入中 */
+
+    /* TLS 连接在握手完成前只推进握手 */
+    if (client->tls && !client->tls_ready) {
+        if (!advance_tls_handshake(client) || !client->tls_ready) {
+            return;
+        }
+    }
+
+    /* 套接字可写：继续写出发送队列 */
+    if (events & EPOLLOUT) {
+        if (!flush_client_output(client) || !(events & (EPOLLIN | EPOLLRDHUP))) {
+            return;
+        }
+    }
+
+    /* TLS 记录可能一次解密出多段数据，OpenSSL 内部仍有缓存时继续读取 */
+    do {
+        uint8_t buffer[BUFFER_SIZE];
+        ssize_t n_read = client_read(client, buffer, sizeof(buffer));
+
+        if (n_read < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            perror("read");
+            disconnect_client(client, "读取失败");
+            return;
+        }
+
+        if (n_read == 0 || (events & EPOLLRDHUP)) {
+            disconnect_client(client, "客户端关闭连接");
+            return;
+        }
+        request_arrival_ns = metrics_now_ns();
+        metrics.bytes_received += (uint64_t)n_read;
+        client->traffic.bytes_in += (uint64_t)n_read;
+        client->traffic.last_activity_ns = request_arrival_ns;
+        TRACE_PROBE2(request_receive, client->fd, n_read);
+
+        dispatch_client_data(client, buffer, (size_t)n_read);
+    } while (client->active && client->tls && tls_session_pending(client->tls));
+}
+
+/*
+ * 向订阅者发送本轮的 FC42 变化推送（subscription_push_changes 的回调）
+ *
+ * RTU-over-TCP 连接逐帧转换为 RTU 格式后发送。写不完的部分挂到连接的发送队列上；
+ * 发送队列已满（订阅者长期不读）时丢弃本轮推送，订阅者可随时用 FC03/FC04 重新读取完整值。
+ */
+static void send_change_notification(int fd, const uint8_t *data, size_t length,
+                                     void *context __attribute__((unused))) {
+    ClientInfo *client = find_client_by_fd(fd);
+    if (!client || (client->tls && !client->tls_ready)) {
         return;
     }
-    
-    /* result == 1，完成一行输入 */
-    if (strlen(input) == 0) {
+
+    bool ok = true;
+    if (client->protocol == CLIENT_PROTOCOL_MODBUS_RTU) {
+        size_t offset = 0;
+        while (ok && offset + MODBUS_MBAP_HEADER_LENGTH <= length) {
+            size_t frame_length = MODBUS_MBAP_HEADER_LENGTH - 1 +
+                                  ((size_t)(data[offset + 4] << 8) | data[offset + 5]);
+            uint8_t rtu_frame[MODBUS_RTU_MAX_ADU_LENGTH];
+            size_t rtu_length = modbus_tcp_to_rtu(&data[offset], frame_length, rtu_frame, sizeof(rtu_frame));
+            ok = rtu_length > 0 && client_send(client, rtu_frame, rtu_length);
+            offset += frame_length;
+        }
+    } else {
+        ok = client_send(client, data, length);
+    }
+
+    if (!ok) {
+        printf("[服务器] [fd:%d] 变化推送发送失败，已丢弃本轮推送\n", fd);
+    }
+}
+
+/*
+ * 开始一次后台寄存器快照
+ * 参数：
+ *   path - 快照文件路径，为 NULL 时使用 "<前缀>-<日期>-<时间>-<序号>.snap"
+ *   out - 结果的输出流
+ */
+static void start_snapshot(const char *path, FILE *out) {
+    char default_path[SNAPSHOT_PATH_LENGTH];
+    if (!path) {
+        char stamp[32];
+        time_t now = time(NULL);
+        struct tm tm_now;
+        localtime_r(&now, &tm_now);
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_now);
+        snprintf(default_path, sizeof(default_path), "%s-%s-%u.snap",
+                 snapshot_prefix, stamp, ++snapshot_sequence);
+        path = default_path;
+    }
+
+    if (snapshot_state.child_pid > 0) {
+        fprintf(out, "[服务器] 快照 %s 仍在写入中，忽略本次请求\n", snapshot_state.path);
         return;
     }
-    
-    /* 添加到历史记录 */
-    add_to_history(&cmd_history, input);
+    if (!snapshot_begin(&snapshot_state, path, &holding_bank, &input_bank, register_file.map != NULL,
+                        journal_last_sequence(&journal))) {
+        fprintf(out, "[服务器] 快照启动失败\n");
+        return;
+    }
+    fprintf(out, "[服务器] 快照开始：%s（子进程 %d，事件循环停顿 %llu 微秒）\n",
+           path, (int)snapshot_state.child_pid, (unsigned long long)snapshot_state.fork_usec);
+}
+
+/*
+ * 日志重放回调：把一条记录写回保持寄存器
+ */
+static void apply_journal_record(const JournalRecord *record, void *context __attribute__((unused))) {
+    register_bank_set(&holding_bank, record->address, record->value);
+}
+
+/*
+ * 复制回调（备机）：应用主机推送的一条写入记录，标记订阅脏位、通知持久化文件；保持寄存器同时追加本机日志
+ */
+static void apply_replicated_record(const JournalRecord *record, void *context __attribute__((unused))) {
+    bool is_input = (record->bank == JOURNAL_BANK_INPUT);
+    RegisterBank *bank = is_input ? &input_bank : &holding_bank;
+    register_bank_set(bank, record->address, record->value);
+    if (!is_input) {
+        journal_append(&journal, record->unit_id, record->address, record->value);
+    }
+    subscription_mark_dirty(&subscriptions, is_input ? SUBSCRIPTION_BANK_INPUT : SUBSCRIPTION_BANK_HOLDING,
+                            record->address, 1);
+    register_file_note_write(&register_file, register_bank_location(bank, record->address), 1);
+}
+
+/*
+ * 复制回调（备机）：用主机发来的完整快照替换默认寄存器组
+ *
+ * 与映射重新加载相同：值有变化的保持寄存器追加日志，变化的寄存器标记订阅脏位，并通知持久化文件。
+ */
+static void load_replicated_snapshot(const uint16_t *holding, const uint16_t *input,
+                                     uint32_t register_count __attribute__((unused)),
+                                     void *context __attribute__((unused))) {
+    static uint16_t previous[MODBUS_REGISTER_COUNT];
+    const uint16_t *images[2] = { holding, input };
+    for (int b = 0; b < 2; b++) {
+        bool is_input = (b == 1);
+        RegisterBank *bank = is_input ? &input_bank : &holding_bank;
+        register_bank_read(bank, 0, MODBUS_REGISTER_COUNT, previous);
+        register_bank_write(bank, 0, MODBUS_REGISTER_COUNT, images[b]);
+        for (uint32_t i = 0; i < MODBUS_REGISTER_COUNT; i++) {
+            if (previous[i] == images[b][i]) {
+                continue;
+            }
+            if (!is_input) {
+                journal_append(&journal, 0, (uint16_t)i, images[b][i]);
+            }
+            subscription_mark_dirty(&subscriptions, is_input ? SUBSCRIPTION_BANK_INPUT : SUBSCRIPTION_BANK_HOLDING,
+                                    i, 1);
+        }
+        register_file_note_write(&register_file, register_bank_location(bank, 0), MODBUS_REGISTER_COUNT);
+    }
+}
+
+/*
+ * 寄存器映射单元段对应的设备模板名
+ */
+static void register_map_template_name(const RegisterMapSection *section, char *name, size_t size) {
+    snprintf(name, size, "map:%u-%u", section->first_unit, section->last_unit);
+}
+
+/*
+ * 开始在后台重新加载寄存器映射（SIGHUP 或 map reload 命令）
+ */
+static void start_register_map_reload(FILE *out) {
+    if (!register_map) {
+        fprintf(out, "[服务器] 未使用寄存器映射（使用 -R <文件> 启用）\n");
+    } else if (replication_read_only(&replication)) {
+        fprintf(out, "[服务器] 本机是复制中的备机，寄存器随主机变化，提升为主机后才能重新加载映射\n");
+    } else if (register_map_loader.running) {
+        fprintf(out, "[服务器] 寄存器映射正在重新加载，忽略本次请求\n");
+    } else if (!register_map_loader_start(&register_map_loader, register_map_path, MODBUS_REGISTER_COUNT)) {
+        fprintf(out, "[服务器] 错误：%s\n", register_map_loader.error);
+    } else {
+        fprintf(out, "[服务器] 开始在后台重新加载寄存器映射 %s\n", register_map_path);
+    }
+}
+
+/*
+ * 后台加载完成：在两次事件之间切换到新映射
+ *
+ * 默认寄存器写入新初值（与 reg set 相同：值有变化的保持寄存器追加日志，值有变化的寄存器推给备机，
+ * 并标记订阅脏位、通知持久化文件），单元段的设备模板换成新映像（设备的私有页清空），生成器整体替换，然后释放旧映射。
+ */
+static void finish_register_map_reload(void) {
+    static uint16_t previous[MODBUS_REGISTER_COUNT];
+    char error[256];
+    RegisterMap *map = register_map_loader_finish(&register_map_loader, error, sizeof(error));
+    if (!map) {
+        printf("[服务器] 寄存器映射重新加载失败，继续使用第 %llu 版：%s\n",
+               (unsigned long long)register_map->generation, error);
+        return;
+    }
+    if (!register_map_same_units(register_map, map)) {
+        printf("[服务器] 寄存器映射重新加载失败：unit 段的划分与当前映射不同（已挂接的设备需要重启才能改变）\n");
+        register_map_free(map);
+        return;
+    }
+
+    const RegisterMapSection *defaults = register_map_section(map, 0);
+    for (int b = 0; b < REGISTER_MAP_BANKS; b++) {
+        bool is_input = (b == GENERATOR_BANK_INPUT);
+        RegisterBank *bank = is_input ? &input_bank : &holding_bank;
+        register_bank_read(bank, 0, MODBUS_REGISTER_COUNT, previous);
+        register_bank_write(bank, 0, MODBUS_REGISTER_COUNT, defaults->values[b]);
+        for (uint32_t i = 0; i < MODBUS_REGISTER_COUNT; i++) {
+            if (previous[i] == defaults->values[b][i]) {
+                continue;
+            }
+            if (is_input) {
+                record_input_write(0, (uint16_t)i, defaults->values[b][i]);
+            } else {
+                record_holding_write(0, (uint16_t)i, defaults->values[b][i]);
+            }
+            subscription_mark_dirty(&subscriptions, is_input ? SUBSCRIPTION_BANK_INPUT : SUBSCRIPTION_BANK_HOLDING,
+                                    i, 1);
+        }
+        register_file_note_write(&register_file, register_bank_location(bank, 0), MODBUS_REGISTER_COUNT);
+    }
+
+    for (size_t s = 1; s < map->section_count; s++) {
+        RegisterMapSection *section = &map->sections[s];
+        char name[DEVICE_NAME_LENGTH];
+        register_map_template_name(section, name, sizeof(name));
+        DeviceTemplate *template = device_template_find(&devices, name);
+        device_template_reset(&devices, template, &section->images[GENERATOR_BANK_HOLDING],
+                              &section->images[GENERATOR_BANK_INPUT]);
+        register_bank_destroy(&section->images[GENERATOR_BANK_HOLDING]);
+        register_bank_destroy(&section->images[GENERATOR_BANK_INPUT]);
+    }
+
+    generator_set_swap_items(&generators, &map->generators);
+    generator_set_clear(&map->generators);
+
+    /* 事件循环是映射唯一的读者，此刻没有请求持有旧映射 */
+    map->generation = register_map->generation + 1;
+    RegisterMap *old = register_map;
+    register_map = map;
+    register_map_free(old);
+    printf("[服务器] 寄存器映射已重新加载：第 %llu 版，%llu 行，%llu 个点，%zu 个 unit 段，解析耗时 %llu 微秒\n",
+           (unsigned long long)map->generation, (unsigned long long)map->lines, (unsigned long long)map->points,
+           map->section_count - 1, (unsigned long long)map->load_usec);
+}
+
+/*
+ * 处理 signalfd 事件：SIGUSR1 触发快照，SIGCHLD 回收快照子进程，SIGHUP 重新加载寄存器映射
+ */
+static void handle_signal_event() {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+        if (info.ssi_signo == SIGUSR1) {
+            start_snapshot(NULL, stdout);
+        } else if (info.ssi_signo == SIGHUP) {
+            start_register_map_reload(stdout);
+        } else if (info.ssi_signo == SIGCHLD) {
+            bool success = false;
+            char path[SNAPSHOT_PATH_LENGTH];
+            snprintf(path, sizeof(path), "%s", snapshot_state.path);
+            if (snapshot_reap(&snapshot_state, &success)) {
+                if (success) {
+                    printf("[服务器] 快照完成：%s\n", path);
+                } else {
+                    printf("[服务器] 快照失败：%s（%s）\n", path, snapshot_state.failure);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * 打印一段寄存器值（每行 10 个，行首为起始地址）
+ */
+static void print_register_values(FILE *out, uint32_t start, uint32_t count, const uint16_t *values) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % 10 == 0) {
+            fprintf(out, "%s  %4u:", i ? "\n" : "", start + i);
+        }
+        fprintf(out, " %5u", values[i]);
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * 执行寄存器命令
+ *
+ * 格式：
+ *   reg get <holding|input> <地址> [数量]            - 读取（默认 1 个）
+ *   reg dump <holding|input> [起始地址 [数量]]       - 读取一段（默认整个寄存器组）
+ *   reg set <holding|input> <地址> <值> [值...]      - 从该地址起连续写入
+ *
+ * 读取与主站看到的值相同（挂接了生成器的寄存器按当前时钟计算）。写入与 Modbus 写请求走同一条路径：
+ * 保持寄存器追加写入日志，并标记订阅脏位、通知持久化文件；读写都不计入访问热度（热度只统计主站访问）。
+ * 数值可以是十进制或 0x 开头的十六进制。
+ *
+ * 参数：
+ *   args - "reg " 之后的部分（会被修改）
+ *   out - 输出流
+ */
+static void execute_register_command(char *args, FILE *out) {
+    static uint16_t values[MODBUS_REGISTER_COUNT];
+    char *saveptr = NULL;
+    char *action = strtok_r(args, " ", &saveptr);
+    char *bank_name = strtok_r(NULL, " ", &saveptr);
+    if (!action || !bank_name || (strcmp(bank_name, "holding") != 0 && strcmp(bank_name, "input") != 0)) {
+        fprintf(out, "[服务器] 错误：用法: reg get|dump|set <holding|input> ...\n");
+        return;
+    }
+    bool is_input = strcmp(bank_name, "input") == 0;
+    RegisterBank *bank = is_input ? &input_bank : &holding_bank;
+    const char *name = is_input ? "输入寄存器" : "保持寄存器";
+
+    /* 其余参数：地址、数量或寄存器值，均为 0..65535 */
+    long numbers[MODBUS_MAX_WRITE_REGISTERS + 1];
+    size_t argc = 0;
+    char *token;
+    while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
+        char *end = NULL;
+        errno = 0;
+        long number = strtol(token, &end, 0);
+        if (*end != '\0' || errno != 0 || number < 0 || number > 65535) {
+            fprintf(out, "[服务器] 错误：无效的数值 %s\n", token);
+            return;
+        }
+        if (argc >= sizeof(numbers) / sizeof(numbers[0])) {
+            fprintf(out, "[服务器] 错误：一次最多写入 %d 个寄存器\n", MODBUS_MAX_WRITE_REGISTERS);
+            return;
+        }
+        numbers[argc++] = number;
+    }
+
+    if (strcmp(action, "get") == 0 || strcmp(action, "dump") == 0) {
+        bool dump = action[0] == 'd';
+        if ((!dump && (argc < 1 || argc > 2)) || (dump && argc > 2)) {
+            fprintf(out, "[服务器] 错误：用法: reg %s\n",
+                    dump ? "dump <holding|input> [起始地址 [数量]]" : "get <holding|input> <地址> [数量]");
+            return;
+        }
+        uint32_t start = argc > 0 ? (uint32_t)numbers[0] : 0;
+        uint32_t count = argc > 1 ? (uint32_t)numbers[1]
+                                  : dump && start < MODBUS_REGISTER_COUNT ? MODBUS_REGISTER_COUNT - start : 1;
+        if (count == 0 || !register_bank_read(bank, start, count, values)) {
+            fprintf(out, "[服务器] 错误：地址越界（寄存器组共 %d 个寄存器）\n", MODBUS_REGISTER_COUNT);
+            return;
+        }
+        generator_set_apply(&generators, is_input ? GENERATOR_BANK_INPUT : GENERATOR_BANK_HOLDING,
+                            start, count, values);
+        fprintf(out, "[服务器] %s [%u..%u]：\n", name, start, start + count - 1);
+        print_register_values(out, start, count, values);
+    } else if (strcmp(action, "set") == 0) {
+        if (replication_read_only(&replication)) {
+            fprintf(out, "[服务器] 错误：本机是复制中的备机，只读（先 replica promote 提升为主机）\n");
+            return;
+        }
+        if (argc < 2) {
+            fprintf(out, "[服务器] 错误：用法: reg set <holding|input> <地址> <值> [值...]\n");
+            return;
+        }
+        uint32_t start = (uint32_t)numbers[0];
+        uint32_t count = (uint32_t)(argc - 1);
+        for (uint32_t i = 0; i < count; i++) {
+            values[i] = (uint16_t)numbers[i + 1];
+        }
+        if (!register_bank_write(bank, start, count, values)) {
+            fprintf(out, "[服务器] 错误：地址越界（寄存器组共 %d 个寄存器）\n", MODBUS_REGISTER_COUNT);
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (is_input) {
+                record_input_write(0, (uint16_t)(start + i), values[i]);
+            } else {
+                record_holding_write(0, (uint16_t)(start + i), values[i]);
+            }
+        }
+        subscription_mark_dirty(&subscriptions, is_input ? SUBSCRIPTION_BANK_INPUT : SUBSCRIPTION_BANK_HOLDING,
+                                start, count);
+        register_file_note_write(&register_file, register_bank_location(bank, start), count);
+        fprintf(out, "[服务器] 已写入%s [%u..%u]（%u 个）\n", name, start, start + count - 1, count);
+    } else {
+        fprintf(out, "[服务器] 错误：未知的寄存器命令 %s（可用 get、dump、set）\n", action);
+    }
+}
+
+/*
+ * 显示主备复制状态：主机显示每个备机确认到的序列号和落后的记录数，备机显示已应用的序列号和复制延迟
+ */
+static void print_replication_status(FILE *out) {
+    const Replication *r = &replication;
+    if (r->role == REPLICATION_ROLE_NONE) {
+        fprintf(out, "[服务器] 未启用主备复制（主机使用 -P [地址:]<端口>，备机使用 -F <地址>:<端口>）\n");
+        return;
+    }
+    uint64_t now_ns = metrics_now_ns();
+    if (r->role == REPLICATION_ROLE_BACKUP) {
+        fprintf(out, "[服务器] 复制：备机（只读），主机 %s，%s；已应用序列号 %llu（记录 %llu 条，快照 %llu 份），"
+                     "连接 %llu 次，断开 %llu 次\n",
+                     r->primary_name, replication_link_state_name(r->link_state),
+                     (unsigned long long)r->applied_sequence, (unsigned long long)r->applied_records,
+                     (unsigned long long)r->snapshots_loaded, (unsigned long long)r->connects,
+                     (unsigned long long)r->failures);
+        fprintf(out, "  复制延迟：最近 %llu 微秒，平均 %llu 微秒，最大 %llu 微秒；距上次收到数据 %llu 毫秒\n",
+                     (unsigned long long)(r->last_lag_ns / 1000ULL),
+                     (unsigned long long)(r->applied_records ? r->lag_total_ns / r->applied_records / 1000ULL : 0),
+                     (unsigned long long)(r->max_lag_ns / 1000ULL),
+                     (unsigned long long)(r->last_receive_ns ? (now_ns - r->last_receive_ns) / 1000000ULL : 0));
+        return;
+    }
+
+    char promoted[64] = "";
+    if (r->promoted_ns) {
+        snprintf(promoted, sizeof(promoted), "（%llu 秒前由备机提升）",
+                 (unsigned long long)((now_ns - r->promoted_ns) / 1000000000ULL));
+    }
+    fprintf(out, "[服务器] 复制：主机%s，%s%s；序列号 %llu，记录 %llu 条，批次 %llu 个（平均每批 %.1f 条，最大 %llu 条），"
+                 "已发送快照 %llu 份，断开落后备机 %llu 个\n",
+                 promoted, r->listen_fd >= 0 ? "在 " : "未监听备机端口", r->listen_fd >= 0 ? r->listen_name : "",
+                 (unsigned long long)r->sequence, (unsigned long long)r->records, (unsigned long long)r->batches,
+                 r->batches ? (double)r->records / (double)r->batches : 0.0, (unsigned long long)r->largest_batch,
+                 (unsigned long long)r->snapshots_sent, (unsigned long long)r->dropped);
+    fprintf(out, "  未复制的写入：设备寄存器 %llu 个（按单元 ID 或端点挂接的设备在各进程中各自运行，"
+                 "备机上的值与本机不同）\n", (unsigned long long)r->unreplicated);
+    for (int i = 0; i < REPLICATION_MAX_BACKUPS; i++) {
+        const ReplicationPeer *peer = &r->peers[i];
+        if (peer->fd < 0) {
+            continue;
+        }
+        fprintf(out, "  备机 %s：%s，已确认序列号 %llu，落后 %llu 条，待发送 %zu 字节，已发送 %llu 字节，连接 %llu 秒\n",
+                     peer->name, peer->streaming ? "复制中" : "等待握手",
+                     (unsigned long long)peer->acked_sequence,
+                     (unsigned long long)(r->sequence > peer->acked_sequence ? r->sequence - peer->acked_sequence : 0),
+                     peer->tx_length, (unsigned long long)peer->sent_bytes,
+                     (unsigned long long)((now_ns - peer->connected_ns) / 1000000000ULL));
+    }
+}
 
+/*
+ * 执行一条控制台命令（在事件循环线程上调用）
+ *
+ * 调试版本的标准输入和管理套接字共用这一组命令，输出写到 out：
+ * 控制台为 stdout，管理连接为内存流，由控制线程写回管理客户端。
+ *
+ * 支持的命令：
+ *   list - 列出所有客户端及其流量统计（按负载排序）
+ *   top [秒] | top off - 在屏幕顶部原地刷新客户端负载，或关闭（仅调试版本的控制台）
+ *   send <fd> <message> - 向指定文件描述符的客户端发送消息
+ *   broadcast <message> - 向所有客户端广播消息
+ *   reg get|dump|set <holding|input> ... - 读取或写入寄存器
+ *   tls - 显示 TLS 统计信息
+ *   bank - 显示寄存器组统计信息
+ *   snapshot [file] - 在后台写出寄存器快照
+ *   journal - 显示写入日志统计信息
+ *   gen add <spec> | gen list | gen clear - 管理寄存器值生成器
+ *   clock [speed <x> | advance <ms>] - 查看或调整生成器时钟
+ *   subs - 列出寄存器变化订阅与推送统计
+ *   heat [n] | heat dump [file] | heat reset - 热点范围与热度图、导出或清零访问计数
+ *   gateway - 显示网关上游统计
+ *   replica | replica promote [force] - 显示主备复制状态与延迟，或把备机提升为主机
+ *   metrics - 以 Prometheus 文本格式显示运行指标
+ *   watchdog - 显示事件循环卡顿统计
+ *   help - 显示帮助信息
+ *
+ * 参数：
+ *   input - 命令行（会被修改）
+ *   out - 输出流
+ *   context - 未使用（与 AdminExecuteFunc 签名一致）
+ */
+static void execute_command(char *input, FILE *out, void *context __attribute__((unused))) {
     if (strcmp(input, "list") == 0) {
-        list_clients();
+        list_clients(out);
+    } else if (strcmp(input, "top") == 0 || strncmp(input, "top ", 4) == 0) {
+#if DEBUG_MODE
+        /* top 直接在服务器终端上绘制，只能从该终端的控制台开启 */
+        if (out != stdout) {
+            fprintf(out, "[服务器] 错误：top 只能在服务器终端的控制台中使用\n");
+            return;
+        }
+        if (strcmp(input, "top off") == 0) {
+            stop_top();
+            printf("[服务器] top 已关闭\n");
+            return;
+        }
+        double interval_s = input[3] ? atof(input + 4) : 1.0;
+        if (interval_s < 0.1 || interval_s > 60) {
+            printf("[服务器] 错误：刷新间隔必须在 0.1 到 60 秒之间\n");
+            return;
+        }
+        start_top(interval_s);
+#else
+        fprintf(out, "[服务器] 错误：纯数据流模式不支持 top，请使用 list\n");
+#endif
+    } else if (strncmp(input, "reg ", 4) == 0) {
+        execute_register_command(input + 4, out);
+    } else if (strcmp(input, "tls") == 0) {
+        TlsStats stats;
+        tls_server_get_stats(&stats);
+        fprintf(out, "[服务器] TLS 统计：完整握手 %llu 次，会话复用 %llu 次，握手失败 %llu 次，"
+                     "kTLS 发送 %llu 个连接，kTLS 接收 %llu 个连接\n",
+                     (unsigned long long)stats.handshakes_full,
+                     (unsigned long long)stats.handshakes_resumed,
+                     (unsigned long long)stats.handshakes_failed,
+                     (unsigned long long)stats.ktls_send,
+                     (unsigned long long)stats.ktls_recv);
+    } else if (strcmp(input, "bank") == 0) {
+        RegisterBankStats holding_stats, input_stats;
+        register_bank_get_stats(&holding_bank, &holding_stats);
+        register_bank_get_stats(&input_bank, &input_stats);
+        fprintf(out, "[服务器] 寄存器组：保持寄存器 %u 个（%u 页），写入 %llu 次，读重试 %llu 次；"
+                     "输入寄存器 %u 个（%u 页），写入 %llu 次，读重试 %llu 次\n",
+                     holding_stats.register_count, holding_stats.page_count,
+                     (unsigned long long)holding_stats.writes, (unsigned long long)holding_stats.read_retries,
+                     input_stats.register_count, input_stats.page_count,
+                     (unsigned long long)input_stats.writes, (unsigned long long)input_stats.read_retries);
+    } else if (strcmp(input, "snapshot") == 0) {
+        start_snapshot(NULL, out);
+    } else if (strncmp(input, "snapshot ", 9) == 0) {
+        char *path = input + 9;
+        if (strlen(path) == 0 || strlen(path) >= SNAPSHOT_PATH_LENGTH) {
+            fprintf(out, "[服务器] 错误：用法: snapshot [file]\n");
+            return;
+        }
+        start_snapshot(path, out);
+    } else if (strcmp(input, "journal") == 0) {
+        if (journal.fd < 0) {
+            fprintf(out, "[服务器] 未启用写入日志（使用 -J <文件> 启用）\n");
+        } else {
+            fprintf(out, "[服务器] 写入日志：最后序列号 %llu，本次运行追加 %llu 条，提交 %llu 次"
+                         "（平均每次 %.1f 条，最多 %llu 条，平均耗时 %llu 微秒）\n",
+                         (unsigned long long)journal_last_sequence(&journal),
+                         (unsigned long long)journal.records,
+                         (unsigned long long)journal.commits,
+                         journal.commits ? (double)journal.records / (double)journal.commits : 0.0,
+                         (unsigned long long)journal.largest_group,
+                         (unsigned long long)(journal.commits ? journal.commit_usec_total / journal.commits : 0));
+        }
+    } else if (strncmp(input, "gen add ", 8) == 0) {
+        char error[256];
+        if (generator_set_add(&generators, input + 8, MODBUS_REGISTER_COUNT, error, sizeof(error))) {
+            fprintf(out, "[服务器] 已添加生成器：%s\n", input + 8);
+        } else {
+            fprintf(out, "[服务器] 错误：生成器 %s 无效：%s\n", input + 8, error);
+        }
+    } else if (strcmp(input, "gen list") == 0) {
+        fprintf(out, "[服务器] 生成器 %zu 个，累计惰性计算 %llu 个值：\n",
+                     generators.count, (unsigned long long)generators.evaluations);
+        for (size_t i = 0; i < generators.count; i++) {
+            fprintf(out, "  %s\n", generators.items[i].spec);
+        }
+    } else if (strcmp(input, "gen clear") == 0) {
+        generator_set_clear(&generators);
+        fprintf(out, "[服务器] 已移除全部生成器\n");
+    } else if (strcmp(input, "clock") == 0) {
+        fprintf(out, "[服务器] 生成器时钟：%llu 毫秒，倍速 %g\n",
+                     (unsigned long long)generator_clock_now_ms(&generators), generators.clock_speed);
+    } else if (strncmp(input, "clock speed ", 12) == 0) {
+        double speed = atof(input + 12);
+        if (speed <= 0) {
+            fprintf(out, "[服务器] 错误：倍速必须大于 0\n");
+            return;
+        }
+        generator_clock_set_speed(&generators, speed);
+        fprintf(out, "[服务器] 生成器时钟倍速已设为 %g\n", speed);
+    } else if (strncmp(input, "clock advance ", 14) == 0) {
+        long long milliseconds = atoll(input + 14);
+        if (milliseconds <= 0) {
+            fprintf(out, "[服务器] 错误：用法: clock advance <毫秒>\n");
+            return;
+        }
+        generator_clock_advance(&generators, (uint64_t)milliseconds);
+        fprintf(out, "[服务器] 生成器时钟快进 %lld 毫秒，当前 %llu 毫秒\n",
+                     milliseconds, (unsigned long long)generator_clock_now_ms(&generators));
+    } else if (strcmp(input, "subs") == 0) {
+        fprintf(out, "[服务器] 变化订阅 %zu 个，推送写出 %llu 次，FC42 帧 %llu 个，寄存器值 %llu 个：\n",
+                     subscriptions.count,
+                     (unsigned long long)subscriptions.notify_writes,
+                     (unsigned long long)subscriptions.notify_frames,
+                     (unsigned long long)subscriptions.notify_registers);
+        for (size_t i = 0; i < subscriptions.count; i++) {
+            const Subscription *sub = &subscriptions.items[i];
+            fprintf(out, "  [fd:%d] %s [%u..%u]\n", sub->fd,
+                         sub->bank == SUBSCRIPTION_BANK_INPUT ? "输入寄存器" : "保持寄存器",
+                         sub->start, sub->start + sub->count - 1);
+        }
+    } else if (strcmp(input, "heat") == 0 || (strncmp(input, "heat ", 5) == 0 && isdigit((unsigned char)input[5]))) {
+        HeatRange ranges[64];
+        size_t limit = input[4] ? (size_t)atoi(input + 5) : 10;
+        if (limit == 0 || limit > sizeof(ranges) / sizeof(ranges[0])) {
+            limit = sizeof(ranges) / sizeof(ranges[0]);
+        }
+        size_t count = heatmap_top_ranges(&heatmap, ranges, limit);
+        fprintf(out, "[服务器] 热点范围（前 %zu 个，按读写次数排序）：\n", count);
+        for (size_t i = 0; i < count; i++) {
+            fprintf(out, "  %s [%u..%u]：读 %llu 次，写 %llu 次\n",
+                         ranges[i].bank == HEATMAP_BANK_INPUT ? "输入寄存器" : "保持寄存器",
+                         ranges[i].start, ranges[i].start + ranges[i].count - 1,
+                         (unsigned long long)ranges[i].reads, (unsigned long long)ranges[i].writes);
+        }
+        heatmap_print(&heatmap, HEATMAP_BANK_HOLDING, out);
+        heatmap_print(&heatmap, HEATMAP_BANK_INPUT, out);
+    } else if (strcmp(input, "heat dump") == 0 || strncmp(input, "heat dump ", 10) == 0) {
+        const char *path = input[9] ? input + 10 : heatmap_path;
+        if (!path || strlen(path) == 0) {
+            fprintf(out, "[服务器] 错误：用法: heat dump <file>（或启动时用 -H 指定默认文件）\n");
+            return;
+        }
+        if (heatmap_dump(&heatmap, path)) {
+            fprintf(out, "[服务器] 访问计数已导出：%s\n", path);
+        }
+    } else if (strcmp(input, "heat reset") == 0) {
+        heatmap_reset(&heatmap);
+        fprintf(out, "[服务器] 访问计数已清零\n");
+    } else if (strcmp(input, "watchdog") == 0) {
+        if (!watchdog.running) {
+            fprintf(out, "[服务器] 未启用看门狗（使用 -W <毫秒> 启用）\n");
+        } else {
+            fprintf(out, "[服务器] 看门狗：阈值 %llu 毫秒，已运行 %llu 轮，卡顿 %llu 轮（看门狗报告 %llu 次），"
+                         "最长 %llu 毫秒（%s）\n",
+                         (unsigned long long)(watchdog.threshold_ns / 1000000ULL),
+                         (unsigned long long)watchdog.iteration,
+                         (unsigned long long)watchdog.stalls,
+                         (unsigned long long)__atomic_load_n(&watchdog.reports, __ATOMIC_RELAXED),
+                         (unsigned long long)(watchdog.longest_stall_ns / 1000000ULL),
+                         watchdog_handler_name(watchdog.longest_handler));
+        }
+    } else if (strcmp(input, "pool") == 0) {
+        fprintf(out, "[服务器] 连接缓冲池：在用 %zu 字节，空闲缓存 %zu 字节，峰值 %zu 字节，上限 %zu 字节；"
+                     "超大分配 %llu 次（在用 %u 个），超限拒绝 %llu 次\n",
+                     buffer_pool.bytes_in_use, buffer_pool.bytes_cached, buffer_pool.peak_bytes, buffer_pool.limit,
+                     (unsigned long long)buffer_pool.oversize, buffer_pool.oversize_in_use,
+                     (unsigned long long)buffer_pool.failures);
+        for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+            const BufferPoolClass *cls = &buffer_pool.classes[i];
+            fprintf(out, "  %6zu 字节档：在用 %u 个，缓存 %u 个，借出 %llu 次（复用 %llu 次）\n",
+                         cls->size, cls->in_use, cls->cached,
+                         (unsigned long long)cls->allocations, (unsigned long long)cls->reuses);
+        }
+    } else if (strcmp(input, "map") == 0) {
+        if (!register_map) {
+            fprintf(out, "[服务器] 未使用寄存器映射（使用 -R <文件> 启用）\n");
+        } else {
+            size_t restricted = 0;
+            for (size_t i = 0; i < register_map->section_count; i++) {
+                restricted += register_map->sections[i].restricted ? 1 : 0;
+            }
+            fprintf(out, "[服务器] 寄存器映射 %s：第 %llu 版，%llu 行，%llu 个点，%zu 个 unit 段"
+                         "（%zu 段含访问限制），生成器 %zu 个，解析耗时 %llu 微秒%s\n",
+                         register_map->path, (unsigned long long)register_map->generation,
+                         (unsigned long long)register_map->lines, (unsigned long long)register_map->points,
+                         register_map->section_count - 1, restricted, generators.count,
+                         (unsigned long long)register_map->load_usec,
+                         register_map_loader.running ? "（正在重新加载）" : "");
+            for (size_t i = 1; i < register_map->section_count; i++) {
+                const RegisterMapSection *section = &register_map->sections[i];
+                fprintf(out, "  unit %u-%u：%llu 个点%s\n", section->first_unit, section->last_unit,
+                             (unsigned long long)section->points, section->restricted ? "，含访问限制" : "");
+            }
+        }
+    } else if (strcmp(input, "map reload") == 0) {
+        start_register_map_reload(out);
+    } else if (strcmp(input, "devices") == 0) {
+        if (devices.template_count == 0) {
+            fprintf(out, "[服务器] 未挂接模拟设备（使用 -D <单元ID>[-<单元ID>]=<模板名> 挂接）\n");
+        } else {
+            size_t private_total = 0;
+            for (size_t i = 0; i < devices.device_count; i++) {
+                private_total += device_private_bytes(devices.devices[i]);
+            }
+            fprintf(out, "[服务器] 设备模板 %zu 个，模拟设备 %zu 台，私有内存共 %zu 字节\n",
+                         devices.template_count, devices.device_count, private_total);
+            for (size_t i = 0; i < devices.template_count; i++) {
+                fprintf(out, "  模板 %-16s 设备 %u 台\n", devices.templates[i].name, devices.templates[i].instances);
+            }
+            for (size_t i = 0; i < devices.device_count; i++) {
+                const Device *device = devices.devices[i];
+                fprintf(out, "  设备 #%-4u 单元 %-3u 模板 %-16s 私有页 %u/%u，私有内存 %zu 字节\n",
+                             device->id, device->unit_id, device->template->name,
+                             device->holding.private_pages, device->input.private_pages,
+                             device_private_bytes(device));
+            }
+            for (size_t i = 0; i < endpoints.count; i++) {
+                const Endpoint *endpoint = &endpoints.endpoints[i];
+                char endpoint_buf[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &endpoint->addr.sin_addr, endpoint_buf, sizeof(endpoint_buf));
+                fprintf(out, "  端点 %s:%u -> 设备 #%u，累计连接 %llu 次\n", endpoint_buf,
+                             ntohs(endpoint->addr.sin_port), endpoint->device->id,
+                             (unsigned long long)endpoint->connections);
+            }
+        }
+    } else if (strcmp(input, "gateway") == 0) {
+        if (gateway.upstream_count == 0) {
+            fprintf(out, "[服务器] 未启用网关（使用 -U <单元ID>[-<单元ID>]=<地址>:<端口> 转发）\n");
+        } else {
+            fprintf(out, "[服务器] 网关：%zu 个上游，上游响应超时 %u 毫秒\n", gateway.upstream_count, gateway.timeout_ms);
+            for (size_t i = 0; i < gateway.upstream_count; i++) {
+                const GatewayUpstream *upstream = &gateway.upstreams[i];
+                fprintf(out, "  单元 %u-%u -> %s：转发 %llu，响应 %llu，超时或断开 %llu，不可达 %llu，忙 %llu，"
+                             "过期响应 %llu；在途 %u（峰值 %u），排队 %u（累计 %llu），平均往返 %llu 微秒\n",
+                             upstream->first_unit, upstream->last_unit, upstream->name,
+                             (unsigned long long)upstream->forwarded, (unsigned long long)upstream->responses,
+                             (unsigned long long)upstream->timeouts, (unsigned long long)upstream->unavailable,
+                             (unsigned long long)upstream->busy, (unsigned long long)upstream->stale,
+                             gateway_upstream_inflight(upstream), upstream->peak_inflight,
+                             upstream->backlog_count, (unsigned long long)upstream->queued,
+                             (unsigned long long)(upstream->responses
+                                 ? upstream->latency_total_us / upstream->responses : 0));
+                fprintf(out, "    合并读请求 %llu，缓存命中 %llu\n",
+                             (unsigned long long)upstream->coalesced, (unsigned long long)upstream->cache_hits);
+                for (uint32_t l = 0; l < upstream->link_count; l++) {
+                    const GatewayLink *link = &upstream->links[l];
+                    fprintf(out, "    连接 %u：%s，在途 %u/%u，建立 %llu 次，失败 %llu 次\n",
+                                 l, gateway_link_state_name(link->state), link->inflight, upstream->depth,
+                                 (unsigned long long)link->connects, (unsigned long long)link->failures);
+                }
+            }
+            if (gateway.cache_rule_count > 0) {
+                fprintf(out, "  读缓存：%zu 条规则，有效 %zu 项，未命中 %llu，写入 %llu，失效 %llu\n",
+                             gateway.cache_rule_count, gateway_cache_entries(&gateway),
+                             (unsigned long long)gateway.cache_misses, (unsigned long long)gateway.cache_fills,
+                             (unsigned long long)gateway.cache_invalidations);
+            }
+        }
+    } else if (strcmp(input, "replica") == 0) {
+        print_replication_status(out);
+    } else if (strcmp(input, "replica promote") == 0 || strcmp(input, "replica promote force") == 0) {
+        if (!replication_read_only(&replication)) {
+            fprintf(out, "[服务器] 错误：本机不是复制中的备机（使用 -F <地址>:<端口> 以备机方式启动）\n");
+        } else if (!replication_promote(&replication, strcmp(input, "replica promote force") == 0)) {
+            fprintf(out, "[服务器] 错误：备机尚未应用过主机 %s 的快照（%s），寄存器仍是初值；"
+                         "确需以初值提升请用 replica promote force\n",
+                         replication.primary_name, replication_link_state_name(replication.link_state));
+        } else {
+            fprintf(out, "[服务器] 已提升为主机，寄存器保持复制到的值（序列号 %llu），开始接受写入\n",
+                         (unsigned long long)replication.applied_sequence);
+        }
+    } else if (strcmp(input, "metrics") == 0) {
+        metrics_write_prometheus(&metrics, out, client_count);
     } else if (strcmp(input, "help") == 0) {
-        printf("\n[服务器] 可用命令：\n");
-        printf("  list                        - 列出所有连接的客户端\n");
-        printf("  send <fd> <message>         - 向指定文件描述符的客户端发送消息\n");
-        printf("  broadcast <message>         - 向所有客户端广播消息\n");
-        printf("  help                        - 显示此帮助信息\n\n");
+        fprintf(out, "\n[服务器] 可用命令：\n");
+        fprintf(out, "  list                        - 列出所有连接的客户端及其流量统计（按负载排序）\n");
+        fprintf(out, "  top [秒] | top off          - 在服务器终端顶部按间隔刷新客户端负载（默认 1 秒），或关闭\n");
+        fprintf(out, "  send <fd> <message>         - 向指定文件描述符的客户端发送消息\n");
+        fprintf(out, "  broadcast <message>         - 向所有客户端广播消息\n");
+        fprintf(out, "  reg get <bank> <addr> [n]   - 读取寄存器，bank 为 holding 或 input\n");
+        fprintf(out, "  reg dump <bank> [addr [n]]  - 读取一段寄存器（默认整个寄存器组）\n");
+        fprintf(out, "  reg set <bank> <addr> <v>.. - 从 addr 起连续写入寄存器\n");
+        fprintf(out, "  tls                         - 显示 TLS 握手与会话复用统计\n");
+        fprintf(out, "  bank                        - 显示寄存器组分页与 seqlock 统计\n");
+        fprintf(out, "  snapshot [file]             - 在后台写出寄存器快照（也可发送 SIGUSR1 触发）\n");
+        fprintf(out, "  journal                     - 显示写入日志与组提交统计\n");
+        fprintf(out, "  gen add <spec>              - 添加寄存器值生成器（格式同 -G）\n");
+        fprintf(out, "  gen list | gen clear        - 列出或移除全部生成器\n");
+        fprintf(out, "  clock [speed <x>|advance <ms>] - 查看、调整倍速或快进生成器时钟\n");
+        fprintf(out, "  subs                        - 列出寄存器变化订阅与推送统计\n");
+        fprintf(out, "  heat [n]                    - 显示前 n 个热点范围（默认 10）和热度图\n");
+        fprintf(out, "  heat dump [file] | heat reset - 导出访问计数到二进制文件，或清零\n");
+        fprintf(out, "  pool                        - 显示连接缓冲池各档位的占用与复用统计\n");
+        fprintf(out, "  devices                     - 列出设备模板和模拟设备的写时复制私有页\n");
+        fprintf(out, "  map | map reload            - 显示寄存器映射，或在后台重新加载（也可发送 SIGHUP）\n");
+        fprintf(out, "  gateway                     - 显示网关上游的连接、在途请求与转发统计\n");
+        fprintf(out, "  replica | replica promote   - 显示主备复制状态与延迟，或把备机提升为主机\n");
+        fprintf(out, "  replica promote force       - 备机未应用过主机快照时也提升（寄存器为初值）\n");
+        fprintf(out, "  metrics                     - 以 Prometheus 文本格式显示运行指标\n");
+        fprintf(out, "  watchdog                    - 显示事件循环卡顿统计\n");
+        fprintf(out, "  help                        - 显示此帮助信息\n\n");
     } else if (strncmp(input, "send ", 5) == 0) {
         char *args = input + 5;
         char *space = strchr(args, ' ');
         if (space == NULL) {
-            printf("[服务器] 错误：用法: send <fd> <message>\n");
+            fprintf(out, "[服务器] 错误：用法: send <fd> <message>\n");
             return;
         }
         *space = '\0';
@@ -507,7 +3171,7 @@ static void handle_stdin_input() {
         char *message = space + 1;
 
         if (strlen(message) == 0) {
-            printf("[服务器] 错误：消息不能为空\n");
+            fprintf(out, "[服务器] 错误：消息不能为空\n");
             return;
         }
 
@@ -515,11 +3179,11 @@ static void handle_stdin_input() {
         errno = 0;
         long target_fd_long = strtol(fd_str, &endptr, 10);
         if (fd_str[0] == '\0' || endptr == NULL || *endptr != '\0' || errno != 0) {
-            printf("[服务器] 错误：无效的文件描述符 %s\n", fd_str);
+            fprintf(out, "[服务器] 错误：无效的文件描述符 %s\n", fd_str);
             return;
         }
         if (target_fd_long < 0 || target_fd_long > INT_MAX) {
-            printf("[服务器] 错误：文件描述符超出范围\n");
+            fprintf(out, "[服务器] 错误：文件描述符超出范围\n");
             return;
         }
         int target_fd = (int)target_fd_long;
@@ -533,13 +3197,13 @@ static void handle_stdin_input() {
         }
         snprintf(full_message, BUFFER_SIZE, "[服务器] %.*s\n", (int)actual_len, message);
 
-        if (send_to_client(target_fd, full_message)) {
-            printf("[服务器] 已向 [fd:%d] 发送消息: %.*s\n", target_fd, (int)actual_len, message);
+        if (send_to_client(target_fd, full_message, out)) {
+            fprintf(out, "[服务器] 已向 [fd:%d] 发送消息: %.*s\n", target_fd, (int)actual_len, message);
         }
     } else if (strncmp(input, "broadcast ", 10) == 0) {
         char *message = input + 10;
         if (strlen(message) == 0) {
-            printf("[服务器] 错误：消息不能为空\n");
+            fprintf(out, "[服务器] 错误：消息不能为空\n");
             return;
         }
 
@@ -551,10 +3215,39 @@ static void handle_stdin_input() {
             actual_len = max_copy;
         }
         snprintf(full_message, BUFFER_SIZE, "[服务器广播] %.*s\n", (int)actual_len, message);
-        broadcast_message(full_message);
+        broadcast_message(full_message, out);
     } else {
-        printf("[服务器] 未知命令: %s (输入 'help' 查看可用命令)\n", input);
+        fprintf(out, "[服务器] 未知命令: %s (输入 'help' 查看可用命令)\n", input);
+    }
+}
+
+/*
+ * 处理服务器命令行输入（仅在调试模式下），完成一行后执行命令
+ */
+#if DEBUG_MODE
+static void handle_stdin_input() {
+    char input[BUFFER_SIZE];
+    int result = process_server_input_char(&server_input_state, "[服务器] ", &cmd_history, input, BUFFER_SIZE);
+    
+    if (result < 0) {
+        /* 错误或Ctrl+D */
+        return;
+    }
+    
+    if (result == 0) {
+        /* 继续输入中 */
+        return;
+    }
+    
+    /* result == 1，完成一行输入 */
+    if (strlen(input) == 0) {
+        return;
     }
+    
+    /* 添加到历史记录 */
+    add_to_history(&cmd_history, input);
+
+    execute_command(input, stdout, NULL);
 }
 #endif /* DEBUG_MODE */
 
@@ -564,7 +3257,12 @@ static void handle_stdin_input() {
     *   signum - 信号编号（未使用但为了兼容信号处理器函数签名）
     */
 static void cleanup(int signum __attribute__((unused))) {
+#if DEBUG_MODE
+    stop_top();
+#endif
     printf("\n[服务器] 正在关闭...\n");
+    watchdog_stop(&watchdog);
+    admin_server_stop(&admin);
     
     /* 清理输入状态 */
     cleanup_server_input(&server_input_state);
@@ -575,39 +3273,555 @@ static void cleanup(int signum __attribute__((unused))) {
     if (server_fd != -1) {
         close(server_fd);
     }
+    if (unix_server_fd != -1) {
+        close(unix_server_fd);
+        unlink(unix_socket_path);
+    }
+    if (rtu_server_fd != -1) {
+        close(rtu_server_fd);
+    }
+    if (tls_server_fd != -1) {
+        close(tls_server_fd);
+    }
+    if (metrics_server_fd != -1) {
+        close(metrics_server_fd);
+    }
+    while (metrics_connection_count > 0) {
+        close_metrics_connection(metrics_connection_count - 1);
+    }
+    if (metrics_timer_fd != -1) {
+        close(metrics_timer_fd);
+    }
+    tls_server_cleanup();
+    for (int i = 0; i < serial_line_count; i++) {
+        serial_pty_close(&serial_lines[i]);
+    }
+    if (signal_fd != -1) {
+        close(signal_fd);
+    }
+    journal_close(&journal);
+    generator_set_free(&generators);
+    subscription_table_destroy(&subscriptions);
+    if (heatmap_path && heatmap_dump(&heatmap, heatmap_path)) {
+        printf("[服务器] 访问计数已导出：%s\n", heatmap_path);
+    }
+    heatmap_destroy(&heatmap);
+    buffer_pool_trim(&buffer_pool);
+    if (register_map) {
+        register_map_loader_close(&register_map_loader);
+        register_map_free(register_map);
+    }
+    replication_close(&replication);
+    gateway_close(&gateway);
+    endpoint_set_close(&endpoints);
+    device_table_destroy(&devices);
+    register_bank_destroy(&holding_bank);
+    register_bank_destroy(&input_bank);
+    register_file_close(&register_file);
     exit(0);
 }
 
+/*
+ * 打印命令行用法
+ */
+static void print_usage(const char *prog) {
+    fprintf(stderr, "用法: %s [选项] <端口号>\n", prog);
+    fprintf(stderr, "选项：\n");
+    fprintf(stderr, "  -u <路径>    同时在指定路径上监听 Unix 域套接字\n");
+    fprintf(stderr, "  -r <端口>    同时在指定端口上监听 RTU-over-TCP 连接\n");
+    fprintf(stderr, "  -s <数量>    创建指定数量的 PTY 串口从站线路（最多 %d 条）\n", MAX_SERIAL_LINES);
+    fprintf(stderr, "  -b <波特率>  串口线路的模拟波特率，决定 t3.5 帧间隔（默认 9600）\n");
+    fprintf(stderr, "  -t <端口>    同时在指定端口上监听 Modbus/TCP Security（TLS，标准端口 %d）\n",
+            MODBUS_TLS_DEFAULT_PORT);
+    fprintf(stderr, "  -C <文件>    TLS 证书链文件（PEM，与 -t 配合使用）\n");
+    fprintf(stderr, "  -K <文件>    TLS 私钥文件（PEM，与 -t 配合使用）\n");
+    fprintf(stderr, "  -A <文件>    校验客户端证书的 CA 文件（可选，指定后要求双向认证）\n");
+    fprintf(stderr, "  -p <文件>    将寄存器映射到持久化文件，重启后保留写入的值\n");
+    fprintf(stderr, "  -y <策略>    持久化文件的 msync 策略：never（默认）、write（每次写入）或周期毫秒数\n");
+    fprintf(stderr, "  -S <前缀>    SIGUSR1 或 snapshot 命令生成的快照文件名前缀（默认 registers）\n");
+    fprintf(stderr, "  -L <文件>    启动时从指定快照加载寄存器\n");
+    fprintf(stderr, "  -J <文件>    把寄存器写入追加到日志文件，启动时重放（在 -L 快照之后的部分）\n");
+    fprintf(stderr, "  -g <毫秒>    日志组提交窗口（默认 0：每轮事件循环提交一次）\n");
+    fprintf(stderr, "  -G <规格>    挂接寄存器值生成器，可重复指定，例如 input:0-99:sine:base=500,amp=100,period=60000\n");
+    fprintf(stderr, "  -V <倍速>    生成器时钟倍速（默认 1，测试时可设为较大值快进）\n");
+    fprintf(stderr, "  -H <文件>    退出时把按地址的读写次数导出到该文件（也是 heat dump 的默认文件）\n");
+    fprintf(stderr, "  -W <毫秒>    启动看门狗线程：一轮事件循环超过该时长时报告正在运行的处理函数和调用栈\n");
+    fprintf(stderr, "  -M <端口>    在 127.0.0.1 的指定端口上以 HTTP 提供 Prometheus 格式的运行指标（GET /metrics）\n");
+    fprintf(stderr, "  -a <路径>    在指定路径上提供管理 Unix 域套接字，执行与控制台相同的命令（纯数据流模式同样可用）\n");
+    fprintf(stderr, "  -m <KB>      连接缓冲池（半帧暂存区和待写数据）的内存上限（默认 %d KB）\n",
+            BUFFER_POOL_DEFAULT_LIMIT / 1024);
+    fprintf(stderr, "  -T <名称>[=<快照>] 定义设备模板，寄存器初值取自快照文件（省略时取默认寄存器的初值），可重复指定\n");
+    fprintf(stderr, "  -D <规格>    按单元 ID 挂接以模板创建的模拟设备，可重复指定，例如 1-100=meter"
+                    "（模板 default 总是可用）\n");
+    fprintf(stderr, "  -R <文件>    按寄存器映射文件设置初值、访问模式、生成器和 unit 段设备；SIGHUP 或 map reload 重新加载\n");
+    fprintf(stderr, "  -E <规格>    绑定设备端点，每个地址/端口挂一台模拟设备，可重复指定，"
+                    "例如 127.0.0.1:20001-20300=meter 或 127.0.0.2-127.0.0.9:1502=default；"
+                    "-E @<文件> 从配置文件逐行读取规格\n");
+    fprintf(stderr, "  -U <规格>    网关模式：把指定单元 ID 的请求转发给上游 Modbus TCP 服务器，可重复指定，"
+                    "格式 <单元ID>[-<单元ID>]=<地址>:<端口>[,<连接数>[,<流水线深度>]]"
+                    "（默认 %d 条连接、每条 %d 个在途请求），例如 10-20=192.168.1.5:502,2,4\n",
+            GATEWAY_DEFAULT_CONNECTIONS, GATEWAY_DEFAULT_DEPTH);
+    fprintf(stderr, "  -O <毫秒>    网关上游响应超时，超时回复异常 0B（默认 %d 毫秒）\n", GATEWAY_DEFAULT_TIMEOUT_MS);
+    fprintf(stderr, "  -P [地址:]<端口> 作为主机接受备机连接（默认只监听 127.0.0.1），把默认寄存器组的写入推给备机\n");
+    fprintf(stderr, "  -F <地址>:<端口> 作为备机跟随主机：先接收完整快照，再应用推送的写入；复制期间只读，"
+                    "同步前读请求回复忙，replica promote 提升为主机\n");
+    fprintf(stderr, "  -c <规则>    缓存转发单元的读响应，可重复指定，格式 <单元ID>[-<单元ID>]:<holding|input>:"
+                    "<起始地址>[-<结束地址>]=<存活毫秒>，例如 10-20:holding:0-99=500；经网关的写入使重叠的缓存失效\n");
+}
+
+/*
+ * 将描述符以指定事件加入 epoll 集合
+ * 返回：
+ *   成功返回 true，失败返回 false
+ */
+static bool epoll_add_fd(int fd, uint32_t events) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
 /*
  * 主函数：初始化并运行 TCP 服务器
  * 
  * 执行流程：
- * 1. 解析命令行参数获取端口号
+ * 1. 解析命令行选项和端口号
  * 2. 创建并配置服务器套接字
  * 3. 绑定端口并开始监听
  * 4. 创建 epoll 实例
  * 5. 进入事件循环处理连接和数据
  */
 int main(int argc, char *argv[]) {
-    /* 检查命令行参数 */
-    if (argc != 2) {
-        fprintf(stderr, "用法: %s <端口号>\n", argv[0]);
+    /* 解析命令行选项 */
+    int opt_char;
+    int rtu_port = 0;
+    int serial_count = 0;
+    long baud_rate = 9600;
+    int tls_port = 0;
+    int metrics_port = 0;
+    long watchdog_ms = 0;
+    long pool_limit_kb = 0;
+    const char *admin_socket_path = NULL;
+    const char *tls_cert_file = NULL;
+    const char *tls_key_file = NULL;
+    const char *tls_ca_file = NULL;
+    const char *register_file_path = NULL;
+    RegisterSyncPolicy sync_policy = REGISTER_SYNC_NEVER;
+    long sync_period_ms = 0;
+    const char *load_snapshot_path = NULL;
+    const char *journal_path = NULL;
+    long group_window_ms = 0;
+    const char *template_specs[DEVICE_MAX_TEMPLATES];
+    int template_spec_count = 0;
+    const char *device_specs[DEVICE_MAX_UNIT];
+    int device_spec_count = 0;
+    const char *endpoint_specs[MAX_ENDPOINT_SPECS];
+    int endpoint_spec_count = 0;
+    const char *gateway_specs[GATEWAY_MAX_UPSTREAMS];
+    int gateway_spec_count = 0;
+    long gateway_timeout_ms = GATEWAY_DEFAULT_TIMEOUT_MS;
+    const char *cache_specs[GATEWAY_MAX_CACHE_RULES];
+    int cache_spec_count = 0;
+    char generator_error[256];
+    char replication_error[160];
+    generator_set_init(&generators);
+    replication_init(&replication);
+    while ((opt_char = getopt(argc, argv, "u:r:s:b:t:C:K:A:p:y:S:L:J:g:G:V:H:M:W:a:m:T:D:E:R:U:O:c:P:F:")) != -1) {
+        switch (opt_char) {
+            case 'u':
+                strncpy(unix_socket_path, optarg, sizeof(unix_socket_path) - 1);
+                break;
+            case 'r':
+                rtu_port = atoi(optarg);
+                if (rtu_port <= 0 || rtu_port > 65535) {
+                    fprintf(stderr, "错误: 无效的 RTU 端口号。\n");
+                    exit(1);
+                }
+                break;
+            case 's':
+                serial_count = atoi(optarg);
+                if (serial_count <= 0 || serial_count > MAX_SERIAL_LINES) {
+                    fprintf(stderr, "错误: 串口线路数量必须在 1 到 %d 之间。\n", MAX_SERIAL_LINES);
+                    exit(1);
+                }
+                break;
+            case 'b':
+                baud_rate = atol(optarg);
+                if (baud_rate <= 0) {
+                    fprintf(stderr, "错误: 无效的波特率。\n");
+                    exit(1);
+                }
+                break;
+            case 't':
+                tls_port = atoi(optarg);
+                if (tls_port <= 0 || tls_port > 65535) {
+                    fprintf(stderr, "错误: 无效的 TLS 端口号。\n");
+                    exit(1);
+                }
+                break;
+            case 'C':
+                tls_cert_file = optarg;
+                break;
+            case 'K':
+                tls_key_file = optarg;
+                break;
+            case 'A':
+                tls_ca_file = optarg;
+                break;
+            case 'p':
+                register_file_path = optarg;
+                break;
+            case 'y':
+                if (strcmp(optarg, "never") == 0) {
+                    sync_policy = REGISTER_SYNC_NEVER;
+                } else if (strcmp(optarg, "write") == 0) {
+                    sync_policy = REGISTER_SYNC_EVERY_WRITE;
+                } else {
+                    sync_period_ms = atol(optarg);
+                    if (sync_period_ms <= 0) {
+                        fprintf(stderr, "错误: msync 策略必须是 never、write 或正整数毫秒。\n");
+                        exit(1);
+                    }
+                    sync_policy = REGISTER_SYNC_PERIODIC;
+                }
+                break;
+            case 'S':
+                if (strlen(optarg) >= sizeof(snapshot_prefix)) {
+                    fprintf(stderr, "错误: 快照文件名前缀过长。\n");
+                    exit(1);
+                }
+                strcpy(snapshot_prefix, optarg);
+                break;
+            case 'L':
+                load_snapshot_path = optarg;
+                break;
+            case 'J':
+                journal_path = optarg;
+                break;
+            case 'g':
+                group_window_ms = atol(optarg);
+                if (group_window_ms < 0 || group_window_ms > 60000) {
+                    fprintf(stderr, "错误: 组提交窗口必须在 0 到 60000 毫秒之间。\n");
+                    exit(1);
+                }
+                break;
+            case 'G':
+                if (!generator_set_add(&generators, optarg, MODBUS_REGISTER_COUNT,
+                                       generator_error, sizeof(generator_error))) {
+                    fprintf(stderr, "错误: 生成器 %s 无效：%s\n", optarg, generator_error);
+                    exit(1);
+                }
+                break;
+            case 'H':
+                heatmap_path = optarg;
+                break;
+            case 'W':
+                watchdog_ms = atol(optarg);
+                if (watchdog_ms <= 0 || watchdog_ms > 60000) {
+                    fprintf(stderr, "错误: 看门狗阈值必须在 1 到 60000 毫秒之间。\n");
+                    exit(1);
+                }
+                break;
+            case 'a':
+                admin_socket_path = optarg;
+                break;
+            case 'm':
+                pool_limit_kb = atol(optarg);
+                if (pool_limit_kb < 64 || pool_limit_kb > 16L * 1024 * 1024) {
+                    fprintf(stderr, "错误: 缓冲池内存上限必须在 64 KB 到 16 GB 之间。\n");
+                    exit(1);
+                }
+                break;
+            case 'T':
+                if (template_spec_count >= DEVICE_MAX_TEMPLATES - 1) {
+                    fprintf(stderr, "错误: 最多定义 %d 个设备模板。\n", DEVICE_MAX_TEMPLATES - 1);
+                    exit(1);
+                }
+                template_specs[template_spec_count++] = optarg;
+                break;
+            case 'D':
+                if (device_spec_count >= DEVICE_MAX_UNIT) {
+                    fprintf(stderr, "错误: 设备规格过多。\n");
+                    exit(1);
+                }
+                device_specs[device_spec_count++] = optarg;
+                break;
+            case 'R':
+                register_map_path = optarg;
+                break;
+            case 'E':
+                if (endpoint_spec_count >= MAX_ENDPOINT_SPECS) {
+                    fprintf(stderr, "错误: 最多指定 %d 条设备端点规格（可改用 -E @<配置文件>）。\n",
+                            MAX_ENDPOINT_SPECS);
+                    exit(1);
+                }
+                endpoint_specs[endpoint_spec_count++] = optarg;
+                break;
+            case 'U':
+                if (gateway_spec_count >= GATEWAY_MAX_UPSTREAMS) {
+                    fprintf(stderr, "错误: 最多指定 %d 个网关上游。\n", GATEWAY_MAX_UPSTREAMS);
+                    exit(1);
+                }
+                gateway_specs[gateway_spec_count++] = optarg;
+                break;
+            case 'O':
+                gateway_timeout_ms = atol(optarg);
+                if (gateway_timeout_ms <= 0 || gateway_timeout_ms > 600000) {
+                    fprintf(stderr, "错误: 网关上游超时必须在 1 到 600000 毫秒之间。\n");
+                    exit(1);
+                }
+                break;
+            case 'c':
+                if (cache_spec_count >= GATEWAY_MAX_CACHE_RULES) {
+                    fprintf(stderr, "错误: 最多指定 %d 条网关缓存规则。\n", GATEWAY_MAX_CACHE_RULES);
+                    exit(1);
+                }
+                cache_specs[cache_spec_count++] = optarg;
+                break;
+            case 'P':
+                if (!replication_listen_on(&replication, optarg, replication_error, sizeof(replication_error))) {
+                    fprintf(stderr, "错误: 复制监听地址 %s：%s。\n", optarg, replication_error);
+                    exit(1);
+                }
+                break;
+            case 'F':
+                if (!replication_follow(&replication, optarg, replication_error, sizeof(replication_error))) {
+                    fprintf(stderr, "错误: 复制主机地址 %s：%s。\n", optarg, replication_error);
+                    exit(1);
+                }
+                break;
+            case 'M':
+                metrics_port = atoi(optarg);
+                if (metrics_port <= 0 || metrics_port > 65535) {
+                    fprintf(stderr, "错误: 无效的指标端口号。\n");
+                    exit(1);
+                }
+                break;
+            case 'V': {
+                double speed = atof(optarg);
+                if (speed <= 0) {
+                    fprintf(stderr, "错误: 时钟倍速必须大于 0。\n");
+                    exit(1);
+                }
+                generator_clock_set_speed(&generators, speed);
+                break;
+            }
+            default:
+                print_usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    /* 检查位置参数：端口号 */
+    if (argc - optind != 1) {
+        print_usage(argv[0]);
         exit(1);
     }
 
     /* 解析端口号并验证 */
-    int port = atoi(argv[1]);
+    int port = atoi(argv[optind]);
     if (port <= 0 || port > 65535) {
         fprintf(stderr, "错误: 无效的端口号。端口必须在 1 到 65535 之间。\n");
         exit(1);
     }
 
+    /* TLS 监听需要证书和私钥 */
+    if (tls_port > 0 && (!tls_cert_file || !tls_key_file)) {
+        fprintf(stderr, "错误: 启用 TLS 监听（-t）时必须同时指定证书（-C）和私钥（-K）。\n");
+        exit(1);
+    }
+
     /* 初始化客户端信息数组 */
     init_clients();
+    metrics_init(&metrics);
+    buffer_pool_init(&buffer_pool, (size_t)pool_limit_kb * 1024);
+
+    /* 打开可选的寄存器持久化文件，寄存器数组改为直接指向映射内存 */
+    if (register_file_path) {
+        bool created = false;
+        if (!register_file_open(&register_file, register_file_path, MODBUS_REGISTER_COUNT, &created)) {
+            exit(1);
+        }
+        if (!register_file_set_policy(&register_file, sync_policy, (uint32_t)sync_period_ms)) {
+            register_file_close(&register_file);
+            exit(1);
+        }
+        printf("[服务器] 寄存器持久化文件：%s（%s）\n",
+               register_file_path, created ? "新建" : "已存在");
+    }
+
+    /* 创建寄存器组：启用持久化时直接使用映射内存作为数据区 */
+    if (!register_bank_init(&holding_bank, MODBUS_REGISTER_COUNT, register_file.holding_registers) ||
+        !register_bank_init(&input_bank, MODBUS_REGISTER_COUNT, register_file.input_registers)) {
+        fprintf(stderr, "错误: 寄存器组内存分配失败。\n");
+        exit(1);
+    }
+    if (!subscription_table_init(&subscriptions, MODBUS_REGISTER_COUNT)) {
+        fprintf(stderr, "错误: 订阅表内存分配失败。\n");
+        exit(1);
+    }
+    if (!heatmap_init(&heatmap, MODBUS_REGISTER_COUNT)) {
+        fprintf(stderr, "错误: 访问计数内存分配失败。\n");
+        exit(1);
+    }
+
+    /* 读取寄存器映射（启动时同步加载，之后的重新加载在后台线程中进行） */
+    if (register_map_path) {
+        char map_error[256];
+        if (generators.count > 0) {
+            fprintf(stderr, "错误: 使用寄存器映射（-R）时请在映射文件中用 gen 行定义生成器，而不是 -G。\n");
+            exit(1);
+        }
+        register_map = register_map_load(register_map_path, MODBUS_REGISTER_COUNT, map_error, sizeof(map_error));
+        if (!register_map || !register_map_loader_init(&register_map_loader)) {
+            fprintf(stderr, "错误: 寄存器映射：%s。\n", register_map ? "无法创建 eventfd" : map_error);
+            exit(1);
+        }
+        register_map->generation = 1;
+        generator_set_swap_items(&generators, &register_map->generators);
+    }
 
     /* 初始化 Modbus 寄存器 */
     init_modbus_registers();
+
+    /* 从快照加载寄存器 */
+    uint64_t snapshot_journal_sequence = 0;
+    if (load_snapshot_path) {
+        static uint16_t holding_values[MODBUS_REGISTER_COUNT];
+        static uint16_t input_values[MODBUS_REGISTER_COUNT];
+        SnapshotHeader snapshot_header;
+        if (!snapshot_read_file(load_snapshot_path, holding_values, input_values, MODBUS_REGISTER_COUNT,
+                                &snapshot_header)) {
+            exit(1);
+        }
+        register_bank_write(&holding_bank, 0, MODBUS_REGISTER_COUNT, holding_values);
+        register_bank_write(&input_bank, 0, MODBUS_REGISTER_COUNT, input_values);
+        snapshot_journal_sequence = snapshot_header.journal_sequence;
+        printf("[服务器] 已从快照 %s 加载寄存器（日志序列号 %llu）\n",
+               load_snapshot_path, (unsigned long long)snapshot_journal_sequence);
+    }
+
+    /* 打开写入日志并重放快照之后的记录 */
+    if (journal_path) {
+        uint64_t replayed = 0;
+        struct timespec replay_begin, replay_end;
+        clock_gettime(CLOCK_MONOTONIC, &replay_begin);
+        if (!journal_open(&journal, journal_path, MODBUS_REGISTER_COUNT, (uint32_t)group_window_ms,
+                          snapshot_journal_sequence, apply_journal_record, NULL, &replayed)) {
+            exit(1);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &replay_end);
+        long replay_usec = (replay_end.tv_sec - replay_begin.tv_sec) * 1000000L +
+                           (replay_end.tv_nsec - replay_begin.tv_nsec) / 1000L;
+        printf("[服务器] 写入日志：%s，重放 %llu 条记录（耗时 %ld 微秒），下一序列号 %llu\n",
+               journal_path, (unsigned long long)replayed, replay_usec,
+               (unsigned long long)journal.next_sequence);
+    }
     
+    /* 加载设备模板，挂接模拟设备并绑定设备端点（模板 default 取默认寄存器此刻的值） */
+    device_table_init(&devices);
+    endpoint_set_init(&endpoints);
+    if (device_spec_count > 0 || template_spec_count > 0 || endpoint_spec_count > 0 ||
+        (register_map && register_map->section_count > 1)) {
+        static uint16_t holding_values[MODBUS_REGISTER_COUNT];
+        static uint16_t input_values[MODBUS_REGISTER_COUNT];
+        char device_error[128];
+        register_bank_read(&holding_bank, 0, MODBUS_REGISTER_COUNT, holding_values);
+        register_bank_read(&input_bank, 0, MODBUS_REGISTER_COUNT, input_values);
+        if (!device_template_add(&devices, "default", holding_values, input_values, MODBUS_REGISTER_COUNT,
+                                 device_error, sizeof(device_error))) {
+            fprintf(stderr, "错误: 设备模板 default：%s。\n", device_error);
+            exit(1);
+        }
+        for (int i = 0; i < template_spec_count; i++) {
+            char name[DEVICE_NAME_LENGTH];
+            const char *equals = strchr(template_specs[i], '=');
+            size_t name_length = equals ? (size_t)(equals - template_specs[i]) : strlen(template_specs[i]);
+            if (name_length == 0 || name_length >= sizeof(name)) {
+                fprintf(stderr, "错误: 无效的设备模板：%s。\n", template_specs[i]);
+                exit(1);
+            }
+            memcpy(name, template_specs[i], name_length);
+            name[name_length] = '\0';
+            if (equals) {
+                SnapshotHeader template_header;
+                if (!snapshot_read_file(equals + 1, holding_values, input_values, MODBUS_REGISTER_COUNT,
+                                        &template_header)) {
+                    exit(1);
+                }
+            } else {
+                register_bank_read(&holding_bank, 0, MODBUS_REGISTER_COUNT, holding_values);
+                register_bank_read(&input_bank, 0, MODBUS_REGISTER_COUNT, input_values);
+            }
+            if (!device_template_add(&devices, name, holding_values, input_values, MODBUS_REGISTER_COUNT,
+                                     device_error, sizeof(device_error))) {
+                fprintf(stderr, "错误: 设备模板 %s：%s。\n", name, device_error);
+                exit(1);
+            }
+        }
+        for (int i = 0; i < device_spec_count; i++) {
+            if (!device_table_add_units(&devices, device_specs[i], device_error, sizeof(device_error))) {
+                fprintf(stderr, "错误: 设备规格 %s：%s。\n", device_specs[i], device_error);
+                exit(1);
+            }
+        }
+        /* 寄存器映射的每个 unit 段是一个模板，段内的单元 ID 各挂一台设备 */
+        for (size_t s = 1; register_map && s < register_map->section_count; s++) {
+            RegisterMapSection *section = &register_map->sections[s];
+            char name[DEVICE_NAME_LENGTH];
+            char spec[DEVICE_NAME_LENGTH + 16];
+            register_map_template_name(section, name, sizeof(name));
+            snprintf(spec, sizeof(spec), "%u-%u=%s", section->first_unit, section->last_unit, name);
+            if (!device_template_add(&devices, name, section->values[GENERATOR_BANK_HOLDING],
+                                     section->values[GENERATOR_BANK_INPUT], MODBUS_REGISTER_COUNT,
+                                     device_error, sizeof(device_error)) ||
+                !device_table_add_units(&devices, spec, device_error, sizeof(device_error))) {
+                fprintf(stderr, "错误: 寄存器映射 unit %u-%u：%s。\n",
+                        section->first_unit, section->last_unit, device_error);
+                exit(1);
+            }
+            register_bank_destroy(&section->images[GENERATOR_BANK_HOLDING]);
+            register_bank_destroy(&section->images[GENERATOR_BANK_INPUT]);
+        }
+        for (int i = 0; i < endpoint_spec_count; i++) {
+            bool added = endpoint_specs[i][0] == '@'
+                ? endpoint_set_load(&endpoints, &devices, endpoint_specs[i] + 1, device_error, sizeof(device_error))
+                : endpoint_set_add(&endpoints, &devices, endpoint_specs[i], device_error, sizeof(device_error));
+            if (!added) {
+                fprintf(stderr, "错误: 设备端点 %s：%s。\n", endpoint_specs[i], device_error);
+                exit(1);
+            }
+        }
+        printf("[服务器] 已加载 %zu 个设备模板，挂接 %zu 台模拟设备（其中 %zu 台在独立端点上）\n",
+               devices.template_count, devices.device_count, endpoints.count);
+    }
+
+    /* 网关上游：转发的单元 ID 不能同时挂接本地模拟设备 */
+    for (int i = 0; i < gateway_spec_count; i++) {
+        char gateway_error[160];
+        if (!gateway_add(&gateway, gateway_specs[i], gateway_error, sizeof(gateway_error))) {
+            fprintf(stderr, "错误: 网关上游 %s：%s。\n", gateway_specs[i], gateway_error);
+            exit(1);
+        }
+    }
+    for (int unit = 0; unit < 256 && gateway.upstream_count > 0; unit++) {
+        if (gateway_routes(&gateway, (uint8_t)unit) && device_table_route(&devices, (uint8_t)unit)) {
+            fprintf(stderr, "错误: 单元 %d 既转发到网关上游又挂接了模拟设备。\n", unit);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < cache_spec_count; i++) {
+        char cache_error[160];
+        if (!gateway_add_cache_rule(&gateway, cache_specs[i], cache_error, sizeof(cache_error))) {
+            fprintf(stderr, "错误: 网关缓存规则 %s：%s。\n", cache_specs[i], cache_error);
+            exit(1);
+        }
+    }
+
     /* 初始化命令历史记录 */
     init_history(&cmd_history);
 
@@ -615,45 +3829,12 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, cleanup);
     signal(SIGTERM, cleanup);
 
-    /* 创建服务器套接字 */
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    /* 创建服务器套接字（绑定所有网络接口并开始监听） */
+    server_fd = create_tcp_listener(port, false);
     if (server_fd < 0) {
-        perror("socket");
-        exit(1);
-    }
-
-    /* 设置套接字选项：允许地址快速重用 */
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        perror("setsockopt");
-        close(server_fd);
-        exit(1);
-    }
-
-    /* 配置服务器地址结构 */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;              /* IPv4 协议 */
-    server_addr.sin_addr.s_addr = htonl(INADDR_ANY); /* 监听所有网络接口 */
-    server_addr.sin_port = htons(port);            /* 设置端口号（主机字节序转网络字节序） */
-
-    /* 绑定服务器套接字到指定地址和端口 */
-    if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind");
-        close(server_fd);
-        exit(1);
-    }
-
-    /* 开始监听连接请求 */
-    if (listen(server_fd, LISTEN_BACKLOG) < 0) {
-        perror("listen");
-        close(server_fd);
         exit(1);
     }
 
-    /* 将服务器套接字设置为非阻塞模式 */
-    set_nonblocking(server_fd);
-
     /* 创建 epoll 实例 */
     epoll_fd = epoll_create1(0);
     if (epoll_fd < 0) {
@@ -673,6 +3854,138 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
+    /* 创建可选的 Unix 域套接字监听，并加入同一个 epoll 集合 */
+    if (unix_socket_path[0] != '\0') {
+        unix_server_fd = create_unix_listener(unix_socket_path);
+        if (unix_server_fd < 0) {
+            close(epoll_fd);
+            close(server_fd);
+            exit(1);
+        }
+        if (!epoll_add_fd(unix_server_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        printf("[服务器] 正在监听 Unix 域套接字 %s\n", unix_socket_path);
+    }
+
+    /* 创建可选的 RTU-over-TCP 监听 */
+    if (rtu_port > 0) {
+        rtu_server_fd = create_tcp_listener(rtu_port, false);
+        if (rtu_server_fd < 0 || !epoll_add_fd(rtu_server_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        printf("[服务器] 正在监听 RTU-over-TCP 端口 %d\n", rtu_port);
+    }
+
+    /* 创建可选的 TLS 监听：先加载证书，失败时不启动 */
+    if (tls_port > 0) {
+        if (!tls_server_init(tls_cert_file, tls_key_file, tls_ca_file)) {
+            cleanup(0);
+        }
+        tls_server_fd = create_tcp_listener(tls_port, false);
+        if (tls_server_fd < 0 || !epoll_add_fd(tls_server_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        printf("[服务器] 正在监听 Modbus/TCP Security（TLS）端口 %d%s\n",
+               tls_port, tls_ca_file ? "（要求客户端证书）" : "");
+    }
+
+    /* 创建可选的指标抓取端口：只监听本机回环地址 */
+    if (metrics_port > 0) {
+        metrics_server_fd = create_tcp_listener(metrics_port, true);
+        if (metrics_server_fd < 0 || !epoll_add_fd(metrics_server_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        /* 抓取连接的期限检查：每个期限内检查 4 次 */
+        struct itimerspec period;
+        memset(&period, 0, sizeof(period));
+        period.it_interval.tv_nsec = (long)METRICS_HTTP_TIMEOUT_MS / 4 * 1000000L;
+        period.it_value = period.it_interval;
+        metrics_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (metrics_timer_fd < 0 || timerfd_settime(metrics_timer_fd, 0, &period, NULL) < 0 ||
+            !epoll_add_fd(metrics_timer_fd, EPOLLIN)) {
+            perror("timerfd_create");
+            cleanup(0);
+        }
+        printf("[服务器] 正在监听指标端口 127.0.0.1:%d（GET /metrics）\n", metrics_port);
+    }
+
+    /* 创建 PTY 串口从站线路：主端和 t3.5 定时器都加入 epoll 集合 */
+    for (int i = 0; i < serial_count; i++) {
+        SerialLine *line = &serial_lines[serial_line_count];
+        if (!serial_pty_open(line, (uint32_t)baud_rate)) {
+            cleanup(0);
+        }
+        serial_line_count++;
+        if (!epoll_add_fd(line->master_fd, EPOLLIN) || !epoll_add_fd(line->timer_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        printf("[服务器] 串口线路 %d：%s（%ld 波特，t3.5=%u 微秒）\n",
+               i, line->slave_name, baud_rate, line->t35_usec);
+    }
+
+    /* SIGUSR1（触发快照）、SIGCHLD（快照子进程结束）和 SIGHUP（重新加载寄存器映射）改由 signalfd 在事件循环中处理 */
+    sigset_t signal_mask;
+    sigemptyset(&signal_mask);
+    sigaddset(&signal_mask, SIGUSR1);
+    sigaddset(&signal_mask, SIGCHLD);
+    sigaddset(&signal_mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signal_mask, NULL);
+    signal_fd = signalfd(-1, &signal_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0 || !epoll_add_fd(signal_fd, EPOLLIN)) {
+        perror("signalfd");
+        cleanup(0);
+    }
+
+    /* 设备端点的监听套接字与主端口共用同一个 epoll 集合 */
+    for (size_t i = 0; i < endpoints.count; i++) {
+        if (!epoll_add_fd(endpoints.endpoints[i].fd, EPOLLIN)) {
+            cleanup(0);
+        }
+    }
+
+    /* 寄存器映射后台加载完成的通知 */
+    if (register_map && !epoll_add_fd(register_map_loader.wake_fd, EPOLLIN)) {
+        cleanup(0);
+    }
+
+    /* 网关的上游连接和定时器加入同一个 epoll 集合（上游暂时连不上时之后自动重连） */
+    if (gateway.upstream_count > 0) {
+        if (!gateway_start(&gateway, epoll_fd, (uint32_t)gateway_timeout_ms, deliver_gateway_response, NULL)) {
+            cleanup(0);
+        }
+        for (size_t i = 0; i < gateway.upstream_count; i++) {
+            const GatewayUpstream *upstream = &gateway.upstreams[i];
+            printf("[服务器] 网关：单元 %u-%u -> %s（%u 条连接，每条 %u 个在途请求，超时 %ld 毫秒）\n",
+                   upstream->first_unit, upstream->last_unit, upstream->name,
+                   upstream->link_count, upstream->depth, gateway_timeout_ms);
+        }
+        for (size_t i = 0; i < gateway.cache_rule_count; i++) {
+            const GatewayCacheRule *rule = &gateway.cache_rules[i];
+            printf("[服务器] 网关读缓存：单元 %u-%u 的%s寄存器 %u-%u，存活 %u 毫秒\n",
+                   rule->first_unit, rule->last_unit,
+                   rule->function_code == MODBUS_FC_READ_HOLDING_REGISTERS ? "保持" : "输入",
+                   rule->first_address, rule->last_address, rule->ttl_ms);
+        }
+    }
+
+    /* 主备复制：主机打开接受备机的端口，备机发起到主机的连接（连不上时之后自动重连） */
+    if (!replication_start(&replication, epoll_fd, &holding_bank, &input_bank,
+                           apply_replicated_record, load_replicated_snapshot, NULL)) {
+        cleanup(0);
+    }
+    if (replication.role == REPLICATION_ROLE_BACKUP) {
+        printf("[服务器] 复制：备机，跟随主机 %s，复制期间只读%s%s\n", replication.primary_name,
+               replication.listen_name[0] ? "；提升后在 " : "", replication.listen_name);
+    } else if (replication.role == REPLICATION_ROLE_PRIMARY) {
+        printf("[服务器] 复制：主机，在 %s 上接受备机\n", replication.listen_name);
+    }
+
+    /* 周期 msync 定时器 */
+    if (register_file.timer_fd >= 0 && !epoll_add_fd(register_file.timer_fd, EPOLLIN)) {
+        cleanup(0);
+    }
+
     /* 将标准输入添加到 epoll 监听列表（用于服务器命令输入，仅在调试模式下） */
 #if DEBUG_MODE
     bool stdin_registered = false;
@@ -698,13 +4011,30 @@ int main(int argc, char *argv[]) {
     printf("[服务器] 纯数据流模式运行中...\n\n");
 #endif
 
+    /* 启动看门狗线程（在事件循环线程中调用，记录该线程用于采样调用栈） */
+    if (watchdog_ms > 0) {
+        if (!watchdog_start(&watchdog, (uint32_t)watchdog_ms)) {
+            cleanup(0);
+        }
+        printf("[服务器] 看门狗已启动：一轮事件循环超过 %ld 毫秒时报告\n", watchdog_ms);
+    }
+
+    /* 启动管理控制面：控制线程接受管理连接，命令经队列交给事件循环，eventfd 唤醒 */
+    if (admin_socket_path) {
+        if (!admin_server_start(&admin, admin_socket_path) || !epoll_add_fd(admin.wake_fd, EPOLLIN)) {
+            cleanup(0);
+        }
+        printf("[服务器] 管理套接字：%s\n", admin_socket_path);
+    }
+
     /* 事件数组 */
     struct epoll_event events[MAX_EVENTS];
 
     /* 主事件循环 */
     while (1) {
         /* 等待事件发生（阻塞直到有事件或出错） */
-        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS,
+                           flush_pending_count > 0 ? 0 : journal_timeout_ms(&journal));
         if (n < 0) {
             /* 如果被信号中断，继续循环 */
             if (errno == EINTR) {
@@ -713,12 +4043,14 @@ int main(int argc, char *argv[]) {
             perror("epoll_wait");
             break;
         }
+        watchdog_begin_iteration(&watchdog);
 
         /* 处理所有就绪的事件 */
         for (int i = 0; i < n; i++) {
             /* 情况一：标准输入有数据，处理服务器命令（仅在调试模式下） */
 #if DEBUG_MODE
             if (events[i].data.fd == STDIN_FILENO) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_STDIN, STDIN_FILENO);
                 handle_stdin_input();
             }
 #else
@@ -726,142 +4058,116 @@ int main(int argc, char *argv[]) {
                 continue;  /* 纯数据流模式下忽略标准输入 */
             }
 #endif
-            /* 情况二：服务器套接字有可读事件，表示有新连接到来 */
-            else if (events[i].data.fd == server_fd) {
-                /* 循环接受所有待处理的连接（非阻塞模式可能积累多个连接） */
-                while (1) {
-                    struct sockaddr_in client_addr;
-                    socklen_t client_len = sizeof(client_addr);
-
-                    /* 接受客户端连接 */
-                    int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
-                    if (client_fd < 0) {
-                        /* 如果没有更多连接了，退出循环 */
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break;
-                        }
-                        perror("accept");
-                        break;
-                    }
-
-                    /* 检查是否达到最大客户端数量限制 */
-                    if (client_count >= MAX_CLIENTS) {
-                        printf("[服务器] 已达到最大客户端数量 (%d)。拒绝新连接。\n", MAX_CLIENTS);
-                        close(client_fd);
-                        continue;
-                    }
-
-                    /* 将客户端套接字设置为非阻塞模式 */
-                    set_nonblocking(client_fd);
-
-                    /* 将客户端套接字添加到 epoll 监听列表 */
-                    struct epoll_event client_event;
-                    client_event.events = EPOLLIN | EPOLLRDHUP; /* 监听可读和对端关闭事件 */
-                    client_event.data.fd = client_fd;
-                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event) < 0) {
-                        perror("epoll_ctl");
-                        close(client_fd);
-                        continue;
-                    }
-
-                    /* 添加客户端到管理数组 */
-                    ClientInfo *client = add_client(client_fd, client_addr);
-                    if (!client) {
-                        printf("[服务器] 错误：无法添加客户端到管理列表\n");
-                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-                        close(client_fd);
-                        continue;
-                    }
-
-                    /* 打印连接信息 */
-                    char addr_buf[INET_ADDRSTRLEN] = {0};
-                    if (inet_ntop(AF_INET, &client_addr.sin_addr, addr_buf, sizeof(addr_buf)) == NULL) {
-                        strncpy(addr_buf, "未知", sizeof(addr_buf) - 1);
-                    }
-                    printf("[服务器] [fd:%d] 客户端已连接，来自 %s:%d（当前客户端总数: %d）\n",
-                           client->fd,
-                           addr_buf,
-                           ntohs(client_addr.sin_port),
-                           client_count);
-
-                    /* 发送欢迎消息（仅在调试模式下） */
+            /* 情况二：监听套接字（TCP 或 Unix 域）有可读事件，表示有新连接到来 */
+            else if (events[i].data.fd == server_fd || events[i].data.fd == unix_server_fd ||
+                     events[i].data.fd == rtu_server_fd || events[i].data.fd == tls_server_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_ACCEPT, events[i].data.fd);
+                accept_clients(events[i].data.fd);
+            }
+            /* 设备端点有新连接 */
+            else if (endpoint_set_find(&endpoints, events[i].data.fd)) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_ACCEPT, events[i].data.fd);
+                accept_clients(events[i].data.fd);
+            }
 #if DEBUG_MODE
-                    char welcome[BUFFER_SIZE];
-                    snprintf(welcome, BUFFER_SIZE, "[服务器通知] 欢迎，您的文件描述符为 %d。\n", client->fd);
-                    if (write(client_fd, welcome, strlen(welcome)) < 0) {
-                        perror("write");
-                        disconnect_client(client, "发送欢迎消息失败");
-                    }
+            /* top 面板刷新定时器 */
+            else if (events[i].data.fd == top_timer_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_TOP, top_timer_fd);
+                handle_top_timer();
+            }
 #endif
-                }
+            /* 指标抓取端口有新连接 */
+            else if (events[i].data.fd == metrics_server_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_METRICS, metrics_server_fd);
+                accept_metrics_connections();
+            }
+            /* 指标抓取连接的期限检查 */
+            else if (events[i].data.fd == metrics_timer_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_METRICS, metrics_timer_fd);
+                expire_metrics_connections();
+            }
+            /* 情况三：寄存器持久化文件的周期 msync 定时器 */
+            else if (events[i].data.fd == register_file.timer_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_REGISTER_TIMER, register_file.timer_fd);
+                register_file_handle_timer(&register_file);
+            }
+            /* 管理连接提交的命令 */
+            else if (events[i].data.fd == admin.wake_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_ADMIN, admin.wake_fd);
+                admin_server_drain(&admin, execute_command, NULL);
+            }
+            /* 寄存器映射后台加载完成 */
+            else if (events[i].data.fd == register_map_loader.wake_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_REGISTER_MAP, register_map_loader.wake_fd);
+                finish_register_map_reload();
             }
-            /* 情况三：客户端套接字有数据或者发生断开 */
-            else if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            /* 主备复制的监听套接字、备机连接、主机连接或定时器 */
+            else if (replication_owns_fd(&replication, events[i].data.fd)) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_REPLICATION, events[i].data.fd);
+                replication_handle_event(&replication, events[i].data.fd, events[i].events);
+            }
+            /* 网关的上游连接或定时器 */
+            else if (gateway_owns_fd(&gateway, events[i].data.fd)) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_GATEWAY, events[i].data.fd);
+                gateway_handle_event(&gateway, events[i].data.fd, events[i].events);
+            }
+            /* 情况四：SIGUSR1/SIGCHLD/SIGHUP */
+            else if (events[i].data.fd == signal_fd) {
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_SIGNAL, signal_fd);
+                handle_signal_event();
+            }
+            /* 情况五：客户端套接字或串口线路有数据或者发生断开 */
+            else if (events[i].events & (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
                 int client_fd = events[i].data.fd;
                 ClientInfo *client = find_client_by_fd(client_fd);
-                if (!client) {
-                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-                    close(client_fd);
-                    continue;
-                }
-
-                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
-                    disconnect_client(client, "客户端异常断开");
+                if (!client && handle_metrics_connection(client_fd)) {
                     continue;
                 }
-
-                uint8_t buffer[BUFFER_SIZE];
-                ssize_t n_read = read(client_fd, buffer, BUFFER_SIZE - 1);
-
-                if (n_read < 0) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!client) {
+                    bool is_timer = false;
+                    SerialLine *line = find_serial_line_by_fd(client_fd, &is_timer);
+                    if (line) {
+                        watchdog_enter(&watchdog, is_timer ? WATCHDOG_HANDLER_SERIAL_TIMER : WATCHDOG_HANDLER_SERIAL,
+                                       client_fd);
+                        handle_serial_event(line, is_timer);
                         continue;
                     }
-                    perror("read");
-                    disconnect_client(client, "读取失败");
-                    continue;
-                }
-
-                if (n_read == 0 || (events[i].events & EPOLLRDHUP)) {
-                    disconnect_client(client, "客户端关闭连接");
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
+                    close(client_fd);
                     continue;
                 }
 
-                /* 检查是否为 Modbus TCP 消息 */
-                if (is_modbus_message(buffer, n_read)) {
-                    /* 处理 Modbus 请求 */
-                    handle_modbus_request(client, buffer, n_read);
-                } else {
-                    /* 处理普通文本消息（回显协议，仅在调试模式下） */
-                    buffer[n_read] = '\0';
+                watchdog_enter(&watchdog, WATCHDOG_HANDLER_CLIENT, client_fd);
+                handle_client_event(client, events[i].events);
+            }
+        }
 
-                    char message[BUFFER_SIZE];
-                    strncpy(message, (char*)buffer, BUFFER_SIZE - 1);
-                    message[BUFFER_SIZE - 1] = '\0';
-                    trim_newline(message);
+        /* 组提交：本轮事件产生的全部日志记录一次写入并同步 */
+        if (journal_commit_due(&journal)) {
+            watchdog_enter(&watchdog, WATCHDOG_HANDLER_JOURNAL_COMMIT, journal.fd);
+            journal_commit(&journal);
+        }
 
-#if DEBUG_MODE
-                    const char *log_message = strlen(message) > 0 ? message : "(空消息)";
-                    printf("[服务器] [fd:%d] 消息：%s\n", client->fd, log_message);
+        /* 复制：本轮的写入记录成批推给备机，每个备机一次写出 */
+        if (replication_pending(&replication)) {
+            watchdog_enter(&watchdog, WATCHDOG_HANDLER_REPLICATION_SHIP, -1);
+            replication_flush(&replication);
+        }
 
-                    char response[BUFFER_SIZE];
-                    int resp_len = snprintf(response, BUFFER_SIZE, "[服务器回显][fd:%d] %s\n", client->fd, message);
-                    if (resp_len < 0) {
-                        continue;
-                    }
-                    if (resp_len >= BUFFER_SIZE) {
-                        response[BUFFER_SIZE - 1] = '\0';
-                    }
+        /* 变化推送：本轮被写过的寄存器按订阅者合并，每个订阅者一次写出 */
+        if (subscription_has_changes(&subscriptions)) {
+            RegisterBank *banks[SUBSCRIPTION_BANK_COUNT] = { &holding_bank, &input_bank };
+            watchdog_enter(&watchdog, WATCHDOG_HANDLER_SUBSCRIPTION_PUSH, -1);
+            subscription_push_changes(&subscriptions, banks, send_change_notification, NULL);
+        }
 
-                    ssize_t n_write = write(client_fd, response, strlen(response));
-                    if (n_write < 0) {
-                        perror("write");
-                        disconnect_client(client, "发送失败");
-                    }
-#endif
-                }
-            }
+        /* 发送队列：广播等排队的消息按预算分批写出 */
+        if (flush_pending_count > 0) {
+            watchdog_enter(&watchdog, WATCHDOG_HANDLER_OUTBOUND_FLUSH, -1);
+            flush_pending_clients();
         }
+
+        watchdog_end_iteration(&watchdog);
     }
 
     /* 清理资源并退出 */
@@ -0,0 +1,308 @@
+/*
+ * 寄存器快照实现（fork 写时复制 + 后台写文件）
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+
+/* FNV-1a 64 位参数 */
+#define FNV64_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
+
+/*
+ * 读取指定时钟的纳秒值
+ */
+static uint64_t clock_ns(clockid_t clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 对一段数据累加 FNV-1a 校验和
+ */
+static uint64_t fnv1a_update(uint64_t hash, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * 计算寄存器数据的校验和
+ */
+uint64_t snapshot_checksum(const uint16_t *holding, const uint16_t *input, uint32_t register_count) {
+    size_t bank_bytes = (size_t)register_count * sizeof(uint16_t);
+    return fnv1a_update(fnv1a_update(FNV64_OFFSET_BASIS, holding, bank_bytes), input, bank_bytes);
+}
+
+/*
+ * 写入全部数据（处理部分写入和 EINTR）
+ */
+static bool write_all(int fd, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+/* 写文件失败的步骤（后台子进程以此作为退出状态） */
+enum {
+    WRITE_STEP_OK = 0,
+    WRITE_STEP_CREATE,          /* 创建临时文件 */
+    WRITE_STEP_WRITE,           /* 写入或 fsync */
+    WRITE_STEP_RENAME           /* rename 到目标路径 */
+};
+
+/*
+ * 生成快照文件头
+ */
+static void fill_header(SnapshotHeader *header, const uint16_t *holding, const uint16_t *input,
+                        uint32_t register_count, uint64_t journal_sequence) {
+    memset(header, 0, sizeof(*header));
+    header->magic = SNAPSHOT_MAGIC;
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order_mark = SNAPSHOT_BYTE_ORDER_MARK;
+    header->register_count = register_count;
+    header->journal_sequence = journal_sequence;
+    header->timestamp_ns = clock_ns(CLOCK_REALTIME);
+    header->checksum = snapshot_checksum(holding, input, register_count);
+}
+
+/*
+ * 写入临时文件、fsync 后 rename 到目标路径
+ *
+ * fork 出的子进程也调用这里，因此只使用 open/write/fsync/close/rename/unlink，
+ * 不碰 stdio 和 locale（fork 时其他线程可能正持有它们的锁）。
+ *
+ * 返回：
+ *   成功返回 WRITE_STEP_OK，否则返回失败的步骤（errno 保持为该步骤的错误）
+ */
+static int write_image(const char *path, const char *temp_path, const SnapshotHeader *header,
+                       const uint16_t *holding, const uint16_t *input, size_t bank_bytes) {
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return WRITE_STEP_CREATE;
+    }
+
+    bool ok = write_all(fd, header, sizeof(*header)) &&
+              write_all(fd, holding, bank_bytes) &&
+              write_all(fd, input, bank_bytes) &&
+              fsync(fd) == 0;
+    int saved_errno = errno;
+    if (close(fd) < 0 && ok) {
+        ok = false;
+        saved_errno = errno;
+    }
+    if (!ok) {
+        unlink(temp_path);
+        errno = saved_errno;
+        return WRITE_STEP_WRITE;
+    }
+    if (rename(temp_path, path) < 0) {
+        saved_errno = errno;
+        unlink(temp_path);
+        errno = saved_errno;
+        return WRITE_STEP_RENAME;
+    }
+    return WRITE_STEP_OK;
+}
+
+/*
+ * 失败步骤的说明
+ */
+static const char *write_step_name(int step) {
+    switch (step) {
+        case WRITE_STEP_CREATE: return "无法创建临时文件";
+        case WRITE_STEP_WRITE:  return "写入或 fsync 失败";
+        case WRITE_STEP_RENAME: return "无法重命名到目标路径";
+        default:                return "子进程异常退出";
+    }
+}
+
+/*
+ * 把寄存器写入快照文件
+ */
+bool snapshot_write_file(const char *path, const uint16_t *holding, const uint16_t *input, uint32_t register_count,
+                         uint64_t journal_sequence) {
+    char temp_path[SNAPSHOT_PATH_LENGTH + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    SnapshotHeader header;
+    fill_header(&header, holding, input, register_count, journal_sequence);
+
+    int step = write_image(path, temp_path, &header, holding, input, (size_t)register_count * sizeof(uint16_t));
+    if (step != WRITE_STEP_OK) {
+        fprintf(stderr, "[快照] 错误：写入 %s 失败：%s（%s）\n", path, write_step_name(step), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 读取全部数据（处理部分读取和 EINTR）
+ */
+static bool read_all(int fd, void *data, size_t length) {
+    uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t n = read(fd, bytes, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+/*
+ * 读取快照文件
+ */
+bool snapshot_read_file(const char *path, uint16_t *holding, uint16_t *input, uint32_t register_count,
+                        SnapshotHeader *header) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[快照] 错误：无法打开 %s（%s）\n", path, strerror(errno));
+        return false;
+    }
+
+    size_t bank_bytes = (size_t)register_count * sizeof(uint16_t);
+    const char *error = NULL;
+    if (!read_all(fd, header, sizeof(*header))) {
+        error = "文件头不完整";
+    } else if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+               header->byte_order_mark != SNAPSHOT_BYTE_ORDER_MARK) {
+        error = "不是当前版本的快照文件";
+    } else if (header->register_count != register_count) {
+        error = "寄存器数量与当前配置不一致";
+    } else if (!read_all(fd, holding, bank_bytes) || !read_all(fd, input, bank_bytes)) {
+        error = "寄存器数据不完整";
+    }
+    close(fd);
+    if (error) {
+        fprintf(stderr, "[快照] 错误：%s %s\n", path, error);
+        return false;
+    }
+
+    if (snapshot_checksum(holding, input, register_count) != header->checksum) {
+        fprintf(stderr, "[快照] 错误：%s 校验和不匹配\n", path);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 在后台开始一次快照
+ */
+bool snapshot_begin(SnapshotState *state, const char *path, RegisterBank *holding, RegisterBank *input,
+                    bool shared_storage, uint64_t journal_sequence) {
+    if (state->child_pid > 0) {
+        return false;
+    }
+
+    uint64_t begin_ns = clock_ns(CLOCK_MONOTONIC);
+    uint32_t register_count = holding->register_count;
+    uint16_t *holding_copy = malloc((size_t)register_count * sizeof(uint16_t));
+    uint16_t *input_copy = malloc((size_t)register_count * sizeof(uint16_t));
+    if (!holding_copy || !input_copy) {
+        free(holding_copy);
+        free(input_copy);
+        return false;
+    }
+
+    /* 共享映射不享有写时复制：在父进程中先取得一致的副本 */
+    if (shared_storage) {
+        register_bank_read(holding, 0, register_count, holding_copy);
+        register_bank_read(input, 0, register_count, input_copy);
+    }
+
+    /* 临时文件路径在 fork 前生成，子进程中不再调用 snprintf */
+    char temp_path[SNAPSHOT_PATH_LENGTH + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    /* 避免子进程继承并重复输出父进程 stdio 缓冲区中的内容 */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        free(holding_copy);
+        free(input_copy);
+        return false;
+    }
+
+    if (pid == 0) {
+        /*
+         * 子进程：此刻的私有内存就是 fork 时刻的寄存器镜像。
+         * 父进程有多个线程，fork 时它们可能持有 stdio、locale 或 malloc 的锁，
+         * 这里只做内存读取和系统调用，失败步骤通过退出状态交给父进程输出。
+         */
+        if (!shared_storage) {
+            register_bank_read(holding, 0, register_count, holding_copy);
+            register_bank_read(input, 0, register_count, input_copy);
+        }
+        SnapshotHeader header;
+        fill_header(&header, holding_copy, input_copy, register_count, journal_sequence);
+        _exit(write_image(path, temp_path, &header, holding_copy, input_copy,
+                          (size_t)register_count * sizeof(uint16_t)));
+    }
+
+    free(holding_copy);
+    free(input_copy);
+
+    state->child_pid = pid;
+    snprintf(state->path, sizeof(state->path), "%s", path);
+    state->started_ns = begin_ns;
+    state->fork_usec = (clock_ns(CLOCK_MONOTONIC) - begin_ns) / 1000;
+    return true;
+}
+
+/*
+ * 回收已结束的快照子进程
+ */
+bool snapshot_reap(SnapshotState *state, bool *success) {
+    if (state->child_pid <= 0) {
+        return false;
+    }
+
+    int status = 0;
+    pid_t pid = waitpid(state->child_pid, &status, WNOHANG);
+    if (pid <= 0) {
+        return false;
+    }
+
+    *success = WIFEXITED(status) && WEXITSTATUS(status) == WRITE_STEP_OK;
+    if (*success) {
+        state->completed++;
+        state->failure = NULL;
+    } else {
+        state->failed++;
+        state->failure = write_step_name(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    }
+    state->child_pid = 0;
+    return true;
+}
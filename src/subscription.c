@@ -0,0 +1,332 @@
+/*
+ * 寄存器变化订阅实现（脏位图 + 每轮事件循环合并推送）
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "subscription.h"
+#include "modbus.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 每个订阅者每轮推送使用的缓冲区大小，写满时先发出一批 */
+#define SUBSCRIPTION_PUSH_BUFFER_SIZE 4096
+
+/* FC42 帧中段头（起始地址 2 字节 + 数量 1 字节）的长度 */
+#define SUBSCRIPTION_RUN_HEADER_LENGTH 3
+
+/* FC42 帧中一段最多包含的寄存器数（数量字段为 1 字节） */
+#define SUBSCRIPTION_RUN_MAX 255
+
+/*
+ * 在 [from, end) 中查找下一个位值为 set 的地址，找不到时返回 end
+ */
+static uint32_t find_bit(const uint64_t *words, uint32_t from, uint32_t end, bool set) {
+    while (from < end) {
+        uint32_t word = from >> 6;
+        uint64_t bits = set ? words[word] : ~words[word];
+        bits &= ~0ULL << (from & 63);
+        if (bits) {
+            uint32_t found = (word << 6) + (uint32_t)__builtin_ctzll(bits);
+            return found < end ? found : end;
+        }
+        from = (word + 1) << 6;
+    }
+    return end;
+}
+
+/*
+ * 将位图标记为没有脏位
+ */
+static void bitmap_reset_range(DirtyBitmap *bitmap) {
+    bitmap->first_dirty_word = bitmap->word_count;
+    bitmap->last_dirty_word = 0;
+}
+
+/*
+ * 初始化订阅表并为每类寄存器分配脏位图
+ */
+bool subscription_table_init(SubscriptionTable *table, uint32_t register_count) {
+    memset(table, 0, sizeof(*table));
+    table->register_count = register_count;
+    for (int bank = 0; bank < SUBSCRIPTION_BANK_COUNT; bank++) {
+        DirtyBitmap *bitmap = &table->dirty[bank];
+        bitmap->word_count = (register_count + 63) / 64;
+        bitmap->words = calloc(bitmap->word_count, sizeof(uint64_t));
+        if (!bitmap->words) {
+            subscription_table_destroy(table);
+            return false;
+        }
+        bitmap_reset_range(bitmap);
+    }
+    return true;
+}
+
+/*
+ * 释放脏位图并清空订阅
+ */
+void subscription_table_destroy(SubscriptionTable *table) {
+    for (int bank = 0; bank < SUBSCRIPTION_BANK_COUNT; bank++) {
+        free(table->dirty[bank].words);
+        table->dirty[bank].words = NULL;
+    }
+    table->count = 0;
+}
+
+/*
+ * 添加一条订阅（同一连接的订阅相邻存放，同类寄存器的范围不得重叠）
+ */
+bool subscription_add(SubscriptionTable *table, int fd, uint8_t unit_id, SubscriptionBank bank,
+                      uint32_t start, uint32_t count) {
+    if (count == 0 || start >= table->register_count || count > table->register_count - start ||
+        table->count >= SUBSCRIPTION_MAX) {
+        return false;
+    }
+
+    /* 同一连接的订阅相邻存放；新订阅插在该连接最后一个订阅之后 */
+    size_t position = table->count;
+    for (size_t i = 0; i < table->count; i++) {
+        const Subscription *sub = &table->items[i];
+        if (sub->fd != fd) {
+            continue;
+        }
+        if (sub->bank == bank && start < sub->start + sub->count && sub->start < start + count) {
+            return false;
+        }
+        position = i + 1;
+    }
+
+    memmove(&table->items[position + 1], &table->items[position],
+            (table->count - position) * sizeof(Subscription));
+    table->items[position].fd = fd;
+    table->items[position].unit_id = unit_id;
+    table->items[position].bank = bank;
+    table->items[position].start = start;
+    table->items[position].count = count;
+    table->count++;
+    return true;
+}
+
+/*
+ * 移除一个连接在指定寄存器类型上的全部订阅
+ */
+size_t subscription_remove(SubscriptionTable *table, int fd, SubscriptionBank bank) {
+    size_t kept = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        if (table->items[i].fd == fd && table->items[i].bank == bank) {
+            continue;
+        }
+        table->items[kept++] = table->items[i];
+    }
+    size_t removed = table->count - kept;
+    table->count = kept;
+    return removed;
+}
+
+/*
+ * 移除一个连接的全部订阅（连接断开时调用）
+ */
+void subscription_remove_client(SubscriptionTable *table, int fd) {
+    for (int bank = 0; bank < SUBSCRIPTION_BANK_COUNT; bank++) {
+        subscription_remove(table, fd, (SubscriptionBank)bank);
+    }
+}
+
+/*
+ * 标记一段寄存器被写过（没有订阅时直接返回）
+ */
+void subscription_mark_dirty(SubscriptionTable *table, SubscriptionBank bank, uint32_t start, uint32_t count) {
+    if (table->count == 0 || start >= table->register_count) {
+        return;
+    }
+    if (count > table->register_count - start) {
+        count = table->register_count - start;
+    }
+
+    DirtyBitmap *bitmap = &table->dirty[bank];
+    for (uint32_t address = start; address < start + count; address++) {
+        bitmap->words[address >> 6] |= 1ULL << (address & 63);
+    }
+    uint32_t first_word = start >> 6;
+    uint32_t last_word = (start + count - 1) >> 6;
+    if (first_word < bitmap->first_dirty_word) {
+        bitmap->first_dirty_word = first_word;
+    }
+    if (last_word > bitmap->last_dirty_word) {
+        bitmap->last_dirty_word = last_word;
+    }
+}
+
+/*
+ * 本轮是否有被写过的寄存器待推送
+ */
+bool subscription_has_changes(const SubscriptionTable *table) {
+    for (int bank = 0; bank < SUBSCRIPTION_BANK_COUNT; bank++) {
+        if (table->dirty[bank].first_dirty_word <= table->dirty[bank].last_dirty_word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 为一个订阅者拼装推送数据的状态 */
+typedef struct {
+    uint8_t buffer[SUBSCRIPTION_PUSH_BUFFER_SIZE];
+    size_t used;                 /* 已写入的字节数 */
+    size_t frame_offset;         /* 当前帧在缓冲区中的起点 */
+    bool frame_open;             /* 是否有未封口的帧 */
+    uint8_t unit_id;             /* 当前帧的单元标识符 */
+    SubscriptionBank bank;       /* 当前帧的寄存器组 */
+    uint8_t run_count;           /* 当前帧的段数 */
+} PushBuilder;
+
+/*
+ * 封口当前帧：回填 MBAP 长度字段和段数
+ */
+static void close_frame(SubscriptionTable *table, PushBuilder *builder) {
+    if (!builder->frame_open) {
+        return;
+    }
+    uint8_t *frame = &builder->buffer[builder->frame_offset];
+    size_t length = builder->used - builder->frame_offset - 6;    /* 单元标识符 + PDU */
+    frame[4] = (uint8_t)(length >> 8);
+    frame[5] = (uint8_t)(length & 0xFF);
+    frame[MODBUS_MBAP_HEADER_LENGTH + 2] = builder->run_count;
+    builder->frame_open = false;
+    table->notify_frames++;
+}
+
+/*
+ * 发出缓冲区中已封口的全部帧
+ */
+static void flush_builder(SubscriptionTable *table, PushBuilder *builder, int fd,
+                          SubscriptionSendFunc send, void *context) {
+    close_frame(table, builder);
+    if (builder->used > 0) {
+        send(fd, builder->buffer, builder->used, context);
+        table->notify_writes++;
+        builder->used = 0;
+    }
+}
+
+/*
+ * 开始一个新帧；缓冲区剩余空间放不下一个最大帧时先发出已有数据
+ *
+ * // 事务标识符(0) | 协议标识符(0) | 长度(封口时回填) | 单元标识符 | 0x42 | 读功能码 | 段数(封口时回填)
+ */
+static void open_frame(SubscriptionTable *table, PushBuilder *builder, int fd, uint8_t unit_id,
+                       SubscriptionBank bank, SubscriptionSendFunc send, void *context) {
+    close_frame(table, builder);
+    if (sizeof(builder->buffer) - builder->used < MODBUS_MAX_MESSAGE_LENGTH) {
+        flush_builder(table, builder, fd, send, context);
+    }
+
+    uint8_t *frame = &builder->buffer[builder->used];
+    memset(frame, 0, MODBUS_MBAP_HEADER_LENGTH);
+    frame[6] = unit_id;
+    frame[MODBUS_MBAP_HEADER_LENGTH] = MODBUS_FC_CHANGE_NOTIFY;
+    frame[MODBUS_MBAP_HEADER_LENGTH + 1] = (bank == SUBSCRIPTION_BANK_INPUT)
+                                               ? MODBUS_FC_READ_INPUT_REGISTERS
+                                               : MODBUS_FC_READ_HOLDING_REGISTERS;
+    frame[MODBUS_MBAP_HEADER_LENGTH + 2] = 0;
+
+    builder->frame_offset = builder->used;
+    builder->used += MODBUS_MBAP_HEADER_LENGTH + 3;
+    builder->frame_open = true;
+    builder->unit_id = unit_id;
+    builder->bank = bank;
+    builder->run_count = 0;
+}
+
+/*
+ * 把一个订阅范围内的脏寄存器追加到推送数据中
+ */
+static void append_subscription(SubscriptionTable *table, PushBuilder *builder, const Subscription *sub,
+                                RegisterBank *bank, SubscriptionSendFunc send, void *context) {
+    const uint64_t *words = table->dirty[sub->bank].words;
+    uint32_t end = sub->start + sub->count;
+    uint32_t address = find_bit(words, sub->start, end, true);
+
+    while (address < end) {
+        uint32_t run_end = find_bit(words, address, end, false);
+
+        /* 一段连续的脏寄存器可能要拆到多个帧中 */
+        while (address < run_end) {
+            if (!builder->frame_open || builder->unit_id != sub->unit_id || builder->bank != sub->bank ||
+                builder->run_count == UINT8_MAX) {
+                open_frame(table, builder, sub->fd, sub->unit_id, sub->bank, send, context);
+            }
+            size_t pdu_length = builder->used - builder->frame_offset - MODBUS_MBAP_HEADER_LENGTH;
+            size_t room = MODBUS_MAX_PDU_LENGTH - pdu_length;
+            if (room < SUBSCRIPTION_RUN_HEADER_LENGTH + 2) {
+                open_frame(table, builder, sub->fd, sub->unit_id, sub->bank, send, context);
+                continue;
+            }
+
+            uint32_t quantity = run_end - address;
+            uint32_t fits = (uint32_t)(room - SUBSCRIPTION_RUN_HEADER_LENGTH) / 2;
+            if (quantity > fits) {
+                quantity = fits;
+            }
+            if (quantity > SUBSCRIPTION_RUN_MAX) {
+                quantity = SUBSCRIPTION_RUN_MAX;
+            }
+
+            uint16_t values[SUBSCRIPTION_RUN_MAX];
+            register_bank_read(bank, address, quantity, values);
+
+            uint8_t *run = &builder->buffer[builder->used];
+            run[0] = (uint8_t)(address >> 8);
+            run[1] = (uint8_t)(address & 0xFF);
+            run[2] = (uint8_t)quantity;
+            for (uint32_t i = 0; i < quantity; i++) {
+                run[3 + i * 2] = (uint8_t)(values[i] >> 8);
+                run[4 + i * 2] = (uint8_t)(values[i] & 0xFF);
+            }
+            builder->used += SUBSCRIPTION_RUN_HEADER_LENGTH + (size_t)quantity * 2;
+            builder->run_count++;
+            table->notify_registers += quantity;
+            address += quantity;
+        }
+
+        address = find_bit(words, run_end, end, true);
+    }
+}
+
+/*
+ * 把被写过的寄存器按订阅者合并成 FC42 推送帧发出，然后清空脏位图
+ */
+void subscription_push_changes(SubscriptionTable *table, RegisterBank *banks[SUBSCRIPTION_BANK_COUNT],
+                               SubscriptionSendFunc send, void *context) {
+    if (!subscription_has_changes(table)) {
+        return;
+    }
+
+    PushBuilder builder;
+    builder.used = 0;
+    builder.frame_open = false;
+
+    /* 同一连接的订阅相邻，按连接分组拼装，每组一次写出 */
+    for (size_t i = 0; i < table->count; i++) {
+        const Subscription *sub = &table->items[i];
+        const DirtyBitmap *bitmap = &table->dirty[sub->bank];
+        if (bitmap->first_dirty_word <= bitmap->last_dirty_word &&
+            sub->start >> 6 <= bitmap->last_dirty_word &&
+            (sub->start + sub->count - 1) >> 6 >= bitmap->first_dirty_word) {
+            append_subscription(table, &builder, sub, banks[sub->bank], send, context);
+        }
+        if (i + 1 == table->count || table->items[i + 1].fd != sub->fd) {
+            flush_builder(table, &builder, sub->fd, send, context);
+        }
+    }
+
+    /* 只清除被置过位的字范围 */
+    for (int bank = 0; bank < SUBSCRIPTION_BANK_COUNT; bank++) {
+        DirtyBitmap *bitmap = &table->dirty[bank];
+        if (bitmap->first_dirty_word <= bitmap->last_dirty_word) {
+            memset(&bitmap->words[bitmap->first_dirty_word], 0,
+                   (bitmap->last_dirty_word - bitmap->first_dirty_word + 1) * sizeof(uint64_t));
+        }
+        bitmap_reset_range(bitmap);
+    }
+}
@@ -0,0 +1,338 @@
+/*
+ * Modbus/TCP Security（TLS）服务端实现
+ *
+ * 使用 OpenSSL 完成握手与会话复用，握手后尽量把记录层交给内核 TLS
+ */
+
+#include "tls_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if WITH_TLS
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+/* 会话缓存参数：缓存条目上限与会话（含票据）有效期 */
+#define TLS_SESSION_CACHE_SIZE 4096
+#define TLS_SESSION_TIMEOUT_SEC 7200
+
+/* 服务端会话 ID 上下文，会话复用时用于区分不同服务 */
+static const unsigned char tls_session_id_context[] = "modbus-simulator";
+
+/* 单个 TLS 连接 */
+struct TlsSession {
+    SSL *ssl;                 /* OpenSSL 连接对象 */
+    int fd;                   /* 底层套接字 */
+    bool handshake_done;      /* 握手是否已完成 */
+    bool ktls_send;           /* 发送方向是否已下沉到内核 */
+    bool ktls_recv;           /* 接收方向是否已下沉到内核 */
+};
+
+/* 全局 TLS 上下文与统计 */
+static SSL_CTX *tls_ctx = NULL;
+static TlsStats tls_stats;
+
+/*
+ * 打印 OpenSSL 错误队列
+ */
+static void print_openssl_errors(const char *what) {
+    unsigned long err;
+    fprintf(stderr, "[TLS] %s 失败\n", what);
+    while ((err = ERR_get_error()) != 0) {
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        fprintf(stderr, "[TLS]   %s\n", buf);
+    }
+}
+
+/*
+ * 初始化全局 TLS 上下文
+ */
+bool tls_server_init(const char *cert_file, const char *key_file, const char *ca_file) {
+    tls_ctx = SSL_CTX_new(TLS_server_method());
+    if (!tls_ctx) {
+        print_openssl_errors("SSL_CTX_new");
+        return false;
+    }
+
+    /* Modbus/TCP Security 要求 TLS 1.2 及以上 */
+    SSL_CTX_set_min_proto_version(tls_ctx, TLS1_2_VERSION);
+
+    /*
+     * 会话复用：TLS 1.3 使用无状态票据，TLS 1.2 同时支持票据和服务端会话缓存。
+     * 票据密钥由 OpenSSL 在上下文创建时随机生成，进程内所有连接共享。
+     */
+    SSL_CTX_set_session_cache_mode(tls_ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_session_id_context(tls_ctx, tls_session_id_context, sizeof(tls_session_id_context) - 1);
+    SSL_CTX_sess_set_cache_size(tls_ctx, TLS_SESSION_CACHE_SIZE);
+    SSL_CTX_set_timeout(tls_ctx, TLS_SESSION_TIMEOUT_SEC);
+
+    /* 握手后允许 OpenSSL 通过 setsockopt(TCP_ULP, "tls") 启用内核 TLS；
+     * 主站不发 close_notify 直接断开时按正常关闭处理，而不是记为读取错误 */
+    SSL_CTX_set_options(tls_ctx, SSL_OP_ENABLE_KTLS | SSL_OP_IGNORE_UNEXPECTED_EOF);
+
+    /* 允许部分写入并在重试时更换缓冲区地址，与非阻塞事件循环配合 */
+    SSL_CTX_set_mode(tls_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    if (SSL_CTX_use_certificate_chain_file(tls_ctx, cert_file) != 1) {
+        print_openssl_errors("加载证书");
+        tls_server_cleanup();
+        return false;
+    }
+    if (SSL_CTX_use_PrivateKey_file(tls_ctx, key_file, SSL_FILETYPE_PEM) != 1) {
+        print_openssl_errors("加载私钥");
+        tls_server_cleanup();
+        return false;
+    }
+    if (SSL_CTX_check_private_key(tls_ctx) != 1) {
+        print_openssl_errors("校验私钥");
+        tls_server_cleanup();
+        return false;
+    }
+
+    /* 指定 CA 时要求双向认证（Modbus/TCP Security 的标准部署方式） */
+    if (ca_file) {
+        if (SSL_CTX_load_verify_locations(tls_ctx, ca_file, NULL) != 1) {
+            print_openssl_errors("加载 CA");
+            tls_server_cleanup();
+            return false;
+        }
+        SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    }
+
+    memset(&tls_stats, 0, sizeof(tls_stats));
+    return true;
+}
+
+/*
+ * 释放全局 TLS 上下文
+ */
+void tls_server_cleanup(void) {
+    if (tls_ctx) {
+        SSL_CTX_free(tls_ctx);
+        tls_ctx = NULL;
+    }
+}
+
+/*
+ * 创建 TLS 会话
+ */
+TlsSession* tls_session_new(int fd) {
+    if (!tls_ctx) {
+        return NULL;
+    }
+
+    TlsSession *session = calloc(1, sizeof(TlsSession));
+    if (!session) {
+        return NULL;
+    }
+
+    session->ssl = SSL_new(tls_ctx);
+    if (!session->ssl || SSL_set_fd(session->ssl, fd) != 1) {
+        print_openssl_errors("SSL_new");
+        if (session->ssl) {
+            SSL_free(session->ssl);
+        }
+        free(session);
+        return NULL;
+    }
+    session->fd = fd;
+    SSL_set_accept_state(session->ssl);
+    return session;
+}
+
+/*
+ * 推进非阻塞握手
+ */
+TlsHandshakeResult tls_session_handshake(TlsSession *session) {
+    if (session->handshake_done) {
+        return TLS_HANDSHAKE_DONE;
+    }
+
+    int ret = SSL_do_handshake(session->ssl);
+    if (ret == 1) {
+        session->handshake_done = true;
+        session->ktls_send = BIO_get_ktls_send(SSL_get_wbio(session->ssl)) != 0;
+        session->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(session->ssl)) != 0;
+
+        if (SSL_session_reused(session->ssl)) {
+            tls_stats.handshakes_resumed++;
+        } else {
+            tls_stats.handshakes_full++;
+        }
+        if (session->ktls_send) {
+            tls_stats.ktls_send++;
+        }
+        if (session->ktls_recv) {
+            tls_stats.ktls_recv++;
+        }
+        return TLS_HANDSHAKE_DONE;
+    }
+
+    switch (SSL_get_error(session->ssl, ret)) {
+        case SSL_ERROR_WANT_READ:
+            return TLS_HANDSHAKE_WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return TLS_HANDSHAKE_WANT_WRITE;
+        default:
+            tls_stats.handshakes_failed++;
+            ERR_clear_error();
+            return TLS_HANDSHAKE_FAILED;
+    }
+}
+
+/*
+ * 读取应用数据
+ */
+ssize_t tls_session_read(TlsSession *session, void *buffer, size_t length) {
+    if (session->ktls_recv) {
+        ssize_t n = read(session->fd, buffer, length);
+        /* kTLS 收到非应用数据记录（如 close_notify 告警）时返回 EIO，按对端关闭处理 */
+        if (n < 0 && errno == EIO) {
+            return 0;
+        }
+        return n;
+    }
+
+    int n = SSL_read(session->ssl, buffer, (int)length);
+    if (n > 0) {
+        return n;
+    }
+    switch (SSL_get_error(session->ssl, n)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        default:
+            ERR_clear_error();
+            errno = EIO;
+            return -1;
+    }
+}
+
+/*
+ * 写入应用数据
+ */
+ssize_t tls_session_write(TlsSession *session, const void *buffer, size_t length) {
+    if (session->ktls_send) {
+        return write(session->fd, buffer, length);
+    }
+
+    int n = SSL_write(session->ssl, buffer, (int)length);
+    if (n > 0) {
+        return n;
+    }
+    switch (SSL_get_error(session->ssl, n)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+        default:
+            ERR_clear_error();
+            errno = EIO;
+            return -1;
+    }
+}
+
+/*
+ * OpenSSL 是否缓存有未读取的应用数据
+ */
+bool tls_session_pending(TlsSession *session) {
+    return !session->ktls_recv && SSL_pending(session->ssl) > 0;
+}
+
+/*
+ * 描述会话状态
+ */
+void tls_session_describe(TlsSession *session, char *buffer, size_t size) {
+    snprintf(buffer, size, "%s %s，%s，kTLS 发送:%s 接收:%s",
+             SSL_get_version(session->ssl),
+             SSL_get_cipher_name(session->ssl),
+             SSL_session_reused(session->ssl) ? "会话复用" : "完整握手",
+             session->ktls_send ? "是" : "否",
+             session->ktls_recv ? "是" : "否");
+}
+
+/*
+ * 释放会话
+ */
+void tls_session_free(TlsSession *session) {
+    if (!session) {
+        return;
+    }
+    if (session->handshake_done) {
+        SSL_shutdown(session->ssl);
+    }
+    SSL_free(session->ssl);
+    free(session);
+}
+
+/*
+ * 获取统计信息
+ */
+void tls_server_get_stats(TlsStats *stats) {
+    *stats = tls_stats;
+}
+
+#else /* !WITH_TLS */
+
+/* 未启用 TLS 时的空实现 */
+
+struct TlsSession {
+    int fd;
+};
+
+bool tls_server_init(const char *cert_file __attribute__((unused)),
+                     const char *key_file __attribute__((unused)),
+                     const char *ca_file __attribute__((unused))) {
+    fprintf(stderr, "[TLS] 编译时未启用 TLS（WITH_TLS=0），无法创建 TLS 监听\n");
+    return false;
+}
+
+void tls_server_cleanup(void) {
+}
+
+TlsSession* tls_session_new(int fd __attribute__((unused))) {
+    return NULL;
+}
+
+TlsHandshakeResult tls_session_handshake(TlsSession *session __attribute__((unused))) {
+    return TLS_HANDSHAKE_FAILED;
+}
+
+ssize_t tls_session_read(TlsSession *session __attribute__((unused)),
+                         void *buffer __attribute__((unused)),
+                         size_t length __attribute__((unused))) {
+    errno = EIO;
+    return -1;
+}
+
+ssize_t tls_session_write(TlsSession *session __attribute__((unused)),
+                          const void *buffer __attribute__((unused)),
+                          size_t length __attribute__((unused))) {
+    errno = EIO;
+    return -1;
+}
+
+bool tls_session_pending(TlsSession *session __attribute__((unused))) {
+    return false;
+}
+
+void tls_session_describe(TlsSession *session __attribute__((unused)), char *buffer, size_t size) {
+    snprintf(buffer, size, "TLS 未启用");
+}
+
+void tls_session_free(TlsSession *session __attribute__((unused))) {
+}
+
+void tls_server_get_stats(TlsStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* WITH_TLS */
@@ -0,0 +1,206 @@
+/*
+ * 事件循环卡顿看门狗实现
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "watchdog.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <execinfo.h>
+
+/* 请求事件循环线程写出调用栈的信号 */
+#define WATCHDOG_STACK_SIGNAL SIGRTMIN
+
+/* 调用栈最大深度 */
+#define WATCHDOG_STACK_DEPTH 32
+
+static const char *HANDLER_NAMES[WATCHDOG_HANDLER_COUNT] = {
+    "epoll_wait 返回后",
+    "handle_stdin_input",
+    "accept_clients",
+    "指标抓取连接",
+    "register_file_handle_timer",
+    "handle_signal_event",
+    "handle_serial_event",
+    "handle_client_event",
+    "journal_commit",
+    "subscription_push_changes",
+    "handle_top_timer",
+    "admin_server_drain",
+    "flush_pending_clients",
+    "finish_register_map_reload",
+    "gateway_handle_event",
+    "replication_handle_event",
+    "replication_flush",
+    "handle_serial_event(t3.5)",
+};
+
+/*
+ * 读取单调时钟（纳秒）
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * 处理函数编号对应的名称
+ */
+const char *watchdog_handler_name(WatchdogHandler handler) {
+    return handler < WATCHDOG_HANDLER_COUNT ? HANDLER_NAMES[handler] : "未知";
+}
+
+/*
+ * 在事件循环线程上执行：把当前调用栈写到标准错误
+ *
+ * backtrace_symbols_fd 不分配内存，直接写描述符。
+ */
+static void write_stack_sample(int signum __attribute__((unused))) {
+    void *frames[WATCHDOG_STACK_DEPTH];
+    int depth = backtrace(frames, WATCHDOG_STACK_DEPTH);
+    backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+}
+
+/*
+ * 看门狗线程：周期检查当前一轮事件循环是否超时
+ */
+static void *watchdog_thread(void *arg) {
+    LoopWatchdog *watchdog = arg;
+    uint64_t interval_ns = watchdog->threshold_ns / 4;
+    struct timespec interval = { (time_t)(interval_ns / 1000000000ULL), (long)(interval_ns % 1000000000ULL) };
+
+    while (__atomic_load_n(&watchdog->running, __ATOMIC_ACQUIRE)) {
+        nanosleep(&interval, NULL);
+
+        uint64_t busy_since = __atomic_load_n(&watchdog->busy_since_ns, __ATOMIC_ACQUIRE);
+        if (busy_since == 0) {
+            continue;
+        }
+        uint64_t iteration = __atomic_load_n(&watchdog->iteration, __ATOMIC_RELAXED);
+        uint64_t now = monotonic_ns();
+        if (iteration == watchdog->reported_iteration || now - busy_since < watchdog->threshold_ns) {
+            continue;
+        }
+        WatchdogHandler handler = (WatchdogHandler)__atomic_load_n(&watchdog->handler, __ATOMIC_ACQUIRE);
+        int fd = __atomic_load_n(&watchdog->fd, __ATOMIC_RELAXED);
+        watchdog->reported_iteration = iteration;
+        watchdog->reports++;
+
+        /* 不经过 stdio：事件循环可能正持有 stdout 的锁卡在终端写入上 */
+        char line[256];
+        int length = snprintf(line, sizeof(line),
+                              "[看门狗] 事件循环第 %llu 轮已运行 %llu 毫秒（阈值 %llu 毫秒），"
+                              "当前处理函数 %s（fd:%d），调用栈：\n",
+                              (unsigned long long)iteration,
+                              (unsigned long long)((now - busy_since) / 1000000ULL),
+                              (unsigned long long)(watchdog->threshold_ns / 1000000ULL),
+                              watchdog_handler_name(handler), fd);
+        if (write(STDERR_FILENO, line, (size_t)length) < 0) {
+            continue;
+        }
+        pthread_kill(watchdog->loop_thread, WATCHDOG_STACK_SIGNAL);
+    }
+    return NULL;
+}
+
+/*
+ * 安装调用栈采样信号处理函数并启动看门狗线程（在事件循环线程上调用）
+ */
+bool watchdog_start(LoopWatchdog *watchdog, uint32_t threshold_ms) {
+    memset(watchdog, 0, sizeof(*watchdog));
+    watchdog->fd = -1;
+    watchdog->threshold_ns = (uint64_t)threshold_ms * 1000000ULL;
+    watchdog->loop_thread = pthread_self();
+
+    /* 预先调用一次，让 backtrace 在信号处理函数之外完成 libgcc 的加载 */
+    void *frames[1];
+    backtrace(frames, 1);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = write_stack_sample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(WATCHDOG_STACK_SIGNAL, &action, NULL) < 0) {
+        perror("sigaction");
+        return false;
+    }
+
+    /* 看门狗线程屏蔽全部信号，SIGINT 等进程信号只由事件循环线程处理 */
+    sigset_t all_signals, previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+    watchdog->running = true;
+    int error = pthread_create(&watchdog->thread, NULL, watchdog_thread, watchdog);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (error != 0) {
+        fprintf(stderr, "[看门狗] 错误：无法创建线程（%s）\n", strerror(error));
+        watchdog->running = false;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 停止看门狗线程
+ */
+void watchdog_stop(LoopWatchdog *watchdog) {
+    if (!watchdog->running) {
+        return;
+    }
+    __atomic_store_n(&watchdog->running, false, __ATOMIC_RELEASE);
+    pthread_join(watchdog->thread, NULL);
+}
+
+/*
+ * epoll_wait 返回后开始一轮计时
+ */
+void watchdog_begin_iteration(LoopWatchdog *watchdog) {
+    if (!watchdog->running) {
+        return;
+    }
+    __atomic_store_n(&watchdog->iteration, watchdog->iteration + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&watchdog->busy_since_ns, monotonic_ns(), __ATOMIC_RELEASE);
+}
+
+/*
+ * 记录正在运行的处理函数和描述符
+ */
+void watchdog_enter(LoopWatchdog *watchdog, WatchdogHandler handler, int fd) {
+    if (!watchdog->running) {
+        return;
+    }
+    __atomic_store_n(&watchdog->fd, fd, __ATOMIC_RELAXED);
+    __atomic_store_n(&watchdog->handler, (uint32_t)handler, __ATOMIC_RELEASE);
+}
+
+/*
+ * 结束一轮计时；超过阈值的一轮计入统计并输出总耗时
+ */
+void watchdog_end_iteration(LoopWatchdog *watchdog) {
+    if (!watchdog->running) {
+        return;
+    }
+    uint64_t elapsed = monotonic_ns() - watchdog->busy_since_ns;
+    WatchdogHandler handler = (WatchdogHandler)watchdog->handler;
+    __atomic_store_n(&watchdog->busy_since_ns, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&watchdog->handler, (uint32_t)WATCHDOG_HANDLER_NONE, __ATOMIC_RELAXED);
+    __atomic_store_n(&watchdog->fd, -1, __ATOMIC_RELAXED);
+
+    if (elapsed < watchdog->threshold_ns) {
+        return;
+    }
+    watchdog->stalls++;
+    if (elapsed > watchdog->longest_stall_ns) {
+        watchdog->longest_stall_ns = elapsed;
+        watchdog->longest_handler = handler;
+    }
+    fprintf(stderr, "[看门狗] 事件循环第 %llu 轮结束，共耗时 %llu 毫秒（最后的处理函数 %s）\n",
+            (unsigned long long)watchdog->iteration, (unsigned long long)(elapsed / 1000000ULL),
+            watchdog_handler_name(handler));
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# 测试脚本共用的辅助函数（在仓库根目录运行，由 test_*.sh 通过 source 引入）
+#
+# 使用前由测试脚本设置：
+#   PORT       - 服务器的 Modbus TCP 端口（modbus_tcp 使用）
+#   ADMIN_SOCK - 服务器的管理套接字（admin 使用）
+
+# 通过指定的管理套接字依次执行若干条命令，输出去掉终端清行控制序列
+# 用法：admin_at 套接字 命令...
+admin_at() {
+    local sock=$1
+    shift
+    (for command in "$@"; do sleep 0.3; echo "$command"; done; sleep 0.3; echo "quit") \
+        | timeout 5 ./build/client -u "$sock" 2>&1 | sed 's/\x1b\[K//g'
+}
+
+# 通过 $ADMIN_SOCK 依次执行若干条命令
+# 用法：admin 命令...
+admin() {
+    admin_at "$ADMIN_SOCK" "$@"
+}
+
+# 新建一条 TCP 连接发送一帧请求（printf 格式），以十六进制输出等待期间收到的全部数据
+# 用法：request_at 地址 端口 帧 [等待秒数，默认 0.5]
+request_at() {
+    local fd
+    exec {fd}<>/dev/tcp/$1/$2
+    printf "$3" >&$fd
+    timeout ${4:-0.5} cat <&$fd | od -An -tx1 | tr -d ' \n'
+    exec {fd}<&-
+}
+
+# 向本机指定端口发送一帧请求
+# 用法：request 端口 帧 [等待秒数]
+request() {
+    request_at 127.0.0.1 "$@"
+}
+
+# 向本机 $PORT 发送一帧 MBAP 请求（包括连接时的欢迎消息在内一并输出）
+# 用法：modbus_tcp 帧 [等待秒数]
+modbus_tcp() {
+    request_at 127.0.0.1 "$PORT" "$@"
+}
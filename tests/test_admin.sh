@@ -0,0 +1,92 @@
+#!/bin/bash
+
+# 测试管理套接字：命令由控制线程接收，经无锁队列交给事件循环执行，输出写回管理连接
+# 标准输入不是终端时控制台不可用，全部命令只经管理套接字下发
+
+PORT=15590
+ADMIN_SOCK=/tmp/test_admin_$$.sock
+SERVER_LOG=test_admin_server.log
+
+echo "启动服务器（端口 $PORT，管理套接字 $ADMIN_SOCK）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+if [ "$(stat -c %a $ADMIN_SOCK 2>/dev/null)" = "600" ]; then
+    echo "✓ 管理套接字只允许所属用户访问"
+else
+    echo "✗ 管理套接字权限错误：$(stat -c %a $ADMIN_SOCK 2>&1)"
+fi
+
+# reg set 走与 FC06/FC10 相同的写入路径，主站用 FC03 读到新值
+OUTPUT=$(admin "reg set holding 11 1 2 0x10")
+RESP=$(modbus_tcp '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x0b\x00\x03')
+if echo "$OUTPUT" | grep -q "已写入保持寄存器 \[11..13\]（3 个）" && [[ "$RESP" == *"000100000009010306000100020010" ]]; then
+    echo "✓ reg set 写入的值对 Modbus 主站可见"
+else
+    echo "✗ reg set 失败：$OUTPUT / $RESP"
+fi
+
+# 主站 FC06 写入后 reg get 读回；reg dump 读输入寄存器尾部（初值 1000+i）
+modbus_tcp '\x00\x02\x00\x00\x00\x06\x01\x06\x00\x14\x12\x34' > /dev/null
+OUTPUT=$(admin "reg get holding 20" "reg dump input 997" "reg set input 999 1 2")
+if echo "$OUTPUT" | grep -q "20:  4660" && echo "$OUTPUT" | grep -q "997:  1997  1998  1999"; then
+    echo "✓ reg get / reg dump 读取寄存器"
+else
+    echo "✗ reg get / reg dump 输出错误：$OUTPUT"
+fi
+if echo "$OUTPUT" | grep -q "错误：地址越界"; then
+    echo "✓ 越界写入被拒绝"
+else
+    echo "✗ 越界写入未报错：$OUTPUT"
+fi
+
+# list 和 broadcast 作用于正在连接的客户端
+exec 4<>/dev/tcp/127.0.0.1/$PORT
+sleep 0.2
+OUTPUT=$(admin "list" "broadcast maintenance at noon")
+RECEIVED=$(timeout 0.5 cat <&4)
+exec 4<&-
+if echo "$OUTPUT" | grep -q "总计：1 个客户端" && echo "$OUTPUT" | grep -q "已排队给 1 个客户端" && \
+   echo "$RECEIVED" | grep -q "\[服务器广播\] maintenance at noon"; then
+    echo "✓ list / broadcast 经管理套接字执行"
+else
+    echo "✗ list / broadcast 失败：$OUTPUT / $RECEIVED"
+fi
+
+# 连续管道输入的多条命令（中间不等待）可能在一次读取中到达，也可能跨越读取边界，均按行逐条执行
+OUTPUT=$( (sleep 0.3; printf 'reg get holding 11\nreg get holding 12\nreg get holding 13\n'; sleep 0.5; echo "quit") | \
+    timeout 5 ./build/client -u $ADMIN_SOCK 2>&1 | sed 's/\x1b\[K//g')
+if echo "$OUTPUT" | grep -q "11: *1$" && echo "$OUTPUT" | grep -q "12: *2$" && echo "$OUTPUT" | grep -q "13: *16$"; then
+    echo "✓ 连续到达的命令按行切分逐条执行"
+else
+    echo "✗ 连续命令切分错误：$OUTPUT"
+fi
+
+# top 直接绘制服务器终端，管理连接上拒绝
+OUTPUT=$(admin "top")
+if echo "$OUTPUT" | grep -q "错误：.*top"; then
+    echo "✓ top 不能经管理套接字开启"
+else
+    echo "✗ top 未被拒绝：$OUTPUT"
+fi
+
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+if [ ! -e $ADMIN_SOCK ]; then
+    echo "✓ 退出时删除管理套接字"
+else
+    echo "✗ 退出后管理套接字仍存在"
+fi
+
+# 清理
+rm -f $SERVER_LOG $ADMIN_SOCK
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# 测试按连接的流量统计：list 命令按负载排序显示每个连接的请求数、异常、字节数和功能码分布
+# 需要 script 命令为服务器提供伪终端，使控制台可用
+
+PORT=15588
+SERVER_LOG=test_client_stats_server.log
+
+echo "启动服务器（端口 $PORT）..."
+( (sleep 2.5; echo "list"; sleep 0.5) | timeout 5 script -qfc "./build/server $PORT" /dev/null > $SERVER_LOG 2>&1 ) &
+RUNNER_PID=$!
+sleep 1
+
+echo "连接 A：FC03 三次、越界 FC06 一次；连接 B：FC04 一次..."
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+for i in 1 2 3; do
+    printf '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x05' >&3
+    sleep 0.1
+done
+printf '\x00\x02\x00\x00\x00\x06\x01\x06\x03\xe8\x00\x01' >&3
+exec 4<>/dev/tcp/127.0.0.1/$PORT
+printf '\x00\x03\x00\x00\x00\x06\x01\x04\x00\x00\x00\x05' >&4
+
+wait $RUNNER_PID 2>/dev/null
+exec 3<&- 4<&-
+pkill -x server 2>/dev/null
+
+TABLE=$(tr -d '\r' < $SERVER_LOG | sed 's/\x1b\[K//g' | grep -A4 "客户端列表")
+ROW_A=$(echo "$TABLE" | grep "03:3 06:1")
+ROW_B=$(echo "$TABLE" | grep "04:1")
+
+echo ""
+echo "=== 验证 ==="
+
+if [ -n "$ROW_A" ] && [ "$(echo "$ROW_A" | awk '{print $4, $5}')" = "4 1" ]; then
+    echo "✓ 连接 A 的请求数、异常数和功能码分布正确"
+else
+    echo "✗ 连接 A 统计错误：$ROW_A"
+fi
+
+# 欢迎消息不经过统计；A 收到 3 个 FC03 响应（各 19 字节）和 1 个异常响应（9 字节）
+if [ "$(echo "$ROW_A" | awk '{print $6, $7}')" = "48B 66B" ]; then
+    echo "✓ 连接 A 的收发字节数正确"
+else
+    echo "✗ 连接 A 字节数错误：$ROW_A"
+fi
+
+# 按请求速率排序：A 排在 B 前面
+if [ -n "$ROW_B" ] && [ "$(echo "$TABLE" | grep -n "03:3" | cut -d: -f1)" -lt "$(echo "$TABLE" | grep -n "04:1" | cut -d: -f1)" ]; then
+    echo "✓ 按负载排序"
+else
+    echo "✗ 排序错误：$TABLE"
+fi
+
+# 清理
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
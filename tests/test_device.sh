@@ -0,0 +1,77 @@
+#!/bin/bash
+
+# 测试模拟设备：按单元 ID 路由到以模板为基础的写时复制寄存器，
+# 写入只影响目标设备，其余设备和默认寄存器仍读模板的值，只有写过的页占私有内存
+
+PORT=15598
+ADMIN_SOCK=/tmp/test_device_admin_$$.sock
+SERVER_LOG=test_device_server.log
+
+echo "启动服务器（端口 $PORT，单元 1-3 挂接 default 模板的设备）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK -D 1-3=default $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 向指定单元 ID 读取保持寄存器 0，输出响应的十六进制
+read_unit() {
+    modbus_tcp "\\x00\\x01\\x00\\x00\\x00\\x06\\x$1\\x03\\x00\\x00\\x00\\x01"
+}
+
+echo ""
+echo "=== 验证 ==="
+
+if grep -q "挂接 3 台模拟设备" $SERVER_LOG; then
+    echo "✓ 启动时挂接 3 台设备"
+else
+    echo "✗ 设备挂接失败：$(cat $SERVER_LOG)"
+fi
+
+# 设备的初值与默认寄存器相同（模板取自默认寄存器）
+BEFORE=$(read_unit 01)
+DEFAULT=$(read_unit ff)
+if [[ "$BEFORE" == *"000100000005010302"* ]] && [[ "$DEFAULT" == *"000100000005ff0302"* ]] && \
+   [[ "${BEFORE: -4}" == "${DEFAULT: -4}" ]]; then
+    echo "✓ 设备初值与模板一致"
+else
+    echo "✗ 设备初值错误：$BEFORE / $DEFAULT"
+fi
+
+# 向单元 2 写入保持寄存器 0（FC06，值 0x1234）
+exec 6<>/dev/tcp/127.0.0.1/$PORT
+printf '\x00\x02\x00\x00\x00\x06\x02\x06\x00\x00\x12\x34' >&6
+WRITE=$(timeout 0.5 cat <&6 | od -An -tx1 | tr -d ' \n')
+exec 6<&-
+UNIT1=$(read_unit 01)
+UNIT2=$(read_unit 02)
+UNIT3=$(read_unit 03)
+DEFAULT_AFTER=$(read_unit ff)
+if [[ "$WRITE" == *"000200000006020600001234"* ]] && [[ "$UNIT2" == *"0001000000050203021234" ]]; then
+    echo "✓ 写入的设备读回新值"
+else
+    echo "✗ 设备写入错误：$WRITE / $UNIT2"
+fi
+if [[ "${UNIT1: -4}" == "${BEFORE: -4}" ]] && [[ "${UNIT3: -4}" == "${BEFORE: -4}" ]] && \
+   [[ "${DEFAULT_AFTER: -4}" == "${DEFAULT: -4}" ]]; then
+    echo "✓ 其他设备和默认寄存器不受影响"
+else
+    echo "✗ 写入影响了其他设备：$UNIT1 / $UNIT3 / $DEFAULT_AFTER"
+fi
+
+# 只有单元 2 的设备有私有页
+DEVICES=$(admin "devices")
+if echo "$DEVICES" | grep -q "单元 1 .*私有页 0/0" && echo "$DEVICES" | grep -q "单元 2 .*私有页 1/0" && \
+   echo "$DEVICES" | grep -q "单元 3 .*私有页 0/0"; then
+    echo "✓ 只有写过的页占用私有内存"
+else
+    echo "✗ 私有页统计错误：$DEVICES"
+fi
+
+# 清理
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG $ADMIN_SOCK
+
+echo ""
+echo "测试完成！"
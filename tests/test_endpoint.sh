@@ -0,0 +1,79 @@
+#!/bin/bash
+
+# 测试设备端点：一个进程绑定多个端口和回环别名地址，每个端点一台设备，
+# 写入某个端点只影响该端点的设备；端点也可以从配置文件读取
+
+PORT=15600
+ADMIN_SOCK=/tmp/test_endpoint_admin_$$.sock
+CONFIG=/tmp/test_endpoint_$$.conf
+SERVER_LOG=test_endpoint_server.log
+
+cat > $CONFIG <<EOF
+# 两个回环别名地址上的同一端口
+127.0.0.2-127.0.0.3:15610=default   # 每个地址一台设备
+EOF
+
+echo "启动服务器（端口 $PORT，端点 127.0.0.1:15601-15603 和配置文件中的回环别名）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK -E 127.0.0.1:15601-15603=default -E @$CONFIG $PORT \
+    < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+READ='\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01'
+
+echo ""
+echo "=== 验证 ==="
+
+if grep -q "挂接 5 台模拟设备（其中 5 台在独立端点上）" $SERVER_LOG; then
+    echo "✓ 一个进程绑定 5 个端点"
+else
+    echo "✗ 端点绑定失败：$(cat $SERVER_LOG)"
+fi
+
+BEFORE=$(request_at 127.0.0.1 15601 "$READ")
+
+# 写入端点 15602 的设备（FC06，保持寄存器 0 = 0x1234）
+WRITE=$(request_at 127.0.0.1 15602 '\x00\x02\x00\x00\x00\x06\x01\x06\x00\x00\x12\x34')
+EP1=$(request_at 127.0.0.1 15601 "$READ")
+EP2=$(request_at 127.0.0.1 15602 "$READ")
+EP3=$(request_at 127.0.0.1 15603 "$READ")
+MAIN=$(request_at 127.0.0.1 $PORT "$READ")
+if [[ "$WRITE" == *"000200000006010600001234"* ]] && [[ "$EP2" == *"0001000000050103021234" ]]; then
+    echo "✓ 写入的端点读回新值"
+else
+    echo "✗ 端点写入错误：$WRITE / $EP2"
+fi
+if [[ "$BEFORE" == *"000100000005010302"* ]] && [[ "${EP1: -4}" == "${BEFORE: -4}" ]] && \
+   [[ "${EP3: -4}" == "${BEFORE: -4}" ]] && [[ "${MAIN: -4}" == "${BEFORE: -4}" ]]; then
+    echo "✓ 其他端点和主端口不受影响"
+else
+    echo "✗ 写入影响了其他端点：$EP1 / $EP3 / $MAIN"
+fi
+
+# 回环别名地址：同一端口上的两台设备互相独立
+request_at 127.0.0.3 15610 '\x00\x03\x00\x00\x00\x06\x01\x06\x00\x00\x56\x78' > /dev/null
+ALIAS2=$(request_at 127.0.0.2 15610 "$READ")
+ALIAS3=$(request_at 127.0.0.3 15610 "$READ")
+if [[ "$ALIAS3" == *"0001000000050103025678" ]] && [[ "${ALIAS2: -4}" == "${BEFORE: -4}" ]]; then
+    echo "✓ 配置文件中的回环别名地址各自挂一台设备"
+else
+    echo "✗ 回环别名端点错误：$ALIAS2 / $ALIAS3"
+fi
+
+DEVICES=$(admin "devices")
+if echo "$DEVICES" | grep -q "端点 127.0.0.1:15602 -> 设备 #2，累计连接 2 次" && \
+   echo "$DEVICES" | grep -q "端点 127.0.0.3:15610 -> 设备 #5"; then
+    echo "✓ devices 命令列出端点与连接次数"
+else
+    echo "✗ 端点列表错误：$DEVICES"
+fi
+
+# 清理
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG $ADMIN_SOCK $CONFIG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,134 @@
+#!/bin/bash
+
+# 测试网关模式：指定单元 ID 的请求经持久连接转发给上游服务器，事务标识符对主站透明；
+# 多个主站与流水线请求共用一条上游连接；RTU-over-TCP 主站同样转发，串口线路回复异常 0A；其余单元在本地处理；上游不可达或超时时回复网关异常
+
+PORT=15640
+UPSTREAM_PORT=15641
+DEAD_PORT=15642
+RTU_PORT=15643
+ADMIN_SOCK=/tmp/test_gateway_admin_$$.sock
+UPSTREAM_MAP=/tmp/test_gateway_upstream_$$.map
+SERVER_LOG=test_gateway_server.log
+UPSTREAM_LOG=test_gateway_upstream.log
+RESULT_DIR=/tmp/test_gateway_$$
+mkdir -p $RESULT_DIR
+
+# 上游服务器的保持寄存器初值与网关本地不同，便于区分响应来自哪里
+cat > $UPSTREAM_MAP <<EOF
+holding 0-9 = 0x1111
+EOF
+
+echo "启动上游服务器（端口 $UPSTREAM_PORT）..."
+stdbuf -oL ./build/server -R $UPSTREAM_MAP $UPSTREAM_PORT < /dev/null > $UPSTREAM_LOG 2>&1 &
+UPSTREAM_PID=$!
+sleep 0.5
+
+echo "启动网关（端口 $PORT，单元 9 -> $UPSTREAM_PORT，单元 20 -> 无人监听的 $DEAD_PORT）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK -O 300 -r $RTU_PORT -s 1 -U 9=127.0.0.1:$UPSTREAM_PORT,1,4 \
+    -U 20=127.0.0.1:$DEAD_PORT $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+FORWARDED=$(request $PORT '\xab\xcd\x00\x00\x00\x06\x09\x03\x00\x00\x00\x01')
+LOCAL=$(request $PORT '\x00\x02\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01')
+if [[ "$FORWARDED" == *"abcd000000050903021111" ]] && [[ "$LOCAL" == *"000200000005010302"* ]] && \
+   [[ "$LOCAL" != *"1111" ]]; then
+    echo "✓ 单元 9 转发到上游并恢复主站的事务标识符，单元 1 在本地处理"
+else
+    echo "✗ 转发错误：$FORWARDED / $LOCAL"
+fi
+
+# RTU 帧：09 03 00 00 00 01 + CRC 经 RTU-over-TCP 转发，响应转换回 RTU；串口线路无法等待上游，回复异常 0A
+RTU_FORWARDED=$(request $RTU_PORT '\x09\x03\x00\x00\x00\x01\x85\x42')
+PTS=$(grep -o '/dev/pts/[0-9]\+' $SERVER_LOG | head -1)
+SERIAL=""
+if [ -n "$PTS" ]; then
+    exec 4<>$PTS
+    stty -F $PTS raw -echo 2>/dev/null
+    printf '\x09\x03\x00\x00\x00\x01\x85\x42' >&4
+    SERIAL=$(timeout 0.5 cat <&4 | od -An -tx1 | tr -d ' \n')
+    exec 4<&-
+fi
+if [ "$RTU_FORWARDED" = "090302111195d9" ] && [ "$SERIAL" = "09830a40f5" ]; then
+    echo "✓ RTU-over-TCP 请求经网关转发，串口线路上的网关单元回复异常 0A"
+else
+    echo "✗ RTU 网关路由错误：$RTU_FORWARDED / $SERIAL"
+fi
+
+# 一次写出 8 帧：流水线深度 4，其余在等待队列中按顺序发出
+BATCH=""
+for i in 1 2 3 4 5 6 7 8; do
+    BATCH="$BATCH\\x00\\x1$i\\x00\\x00\\x00\\x06\\x09\\x03\\x00\\x0$i\\x00\\x01"
+done
+PIPELINED=$(request $PORT "$BATCH")
+MATCHED=0
+for i in 1 2 3 4 5 6 7 8; do
+    [[ "$PIPELINED" == *"001${i}000000050903021111"* ]] && MATCHED=$((MATCHED + 1))
+done
+if [ "$MATCHED" -eq 8 ]; then
+    echo "✓ 同一连接上的 8 个流水线请求全部按原事务标识符应答"
+else
+    echo "✗ 流水线请求只匹配 $MATCHED 个：$PIPELINED"
+fi
+
+# 50 个主站同时请求，上游只看到网关的一条连接
+for i in $(seq 1 50); do
+    request $PORT '\x00\x33\x00\x00\x00\x06\x09\x03\x00\x05\x00\x01' 1 > $RESULT_DIR/$i &
+done
+wait $(jobs -p | grep -v -e "^$SERVER_PID$" -e "^$UPSTREAM_PID$") 2>/dev/null
+ANSWERED=$(grep -l "0033000000050903021111$" $RESULT_DIR/* 2>/dev/null | wc -l)
+UPSTREAM_CONNECTIONS=$(grep -c "客户端已连接" $UPSTREAM_LOG)
+if [ "$ANSWERED" -eq 50 ] && [ "$UPSTREAM_CONNECTIONS" -eq 1 ]; then
+    echo "✓ 50 个主站全部得到应答，上游只有 1 条连接"
+else
+    echo "✗ 多主站复用错误：应答 $ANSWERED 个，上游连接 $UPSTREAM_CONNECTIONS 条"
+fi
+
+# 经网关写入，直连上游读回
+WRITE=$(request $PORT '\x00\x04\x00\x00\x00\x06\x09\x06\x00\x03\x56\x78')
+DIRECT=$(request $UPSTREAM_PORT '\x00\x05\x00\x00\x00\x06\x09\x03\x00\x03\x00\x01')
+if [[ "$WRITE" == *"000400000006090600035678" ]] && [[ "$DIRECT" == *"0005000000050903025678" ]]; then
+    echo "✓ 经网关的写入到达上游"
+else
+    echo "✗ 写入转发错误：$WRITE / $DIRECT"
+fi
+
+# 上游不可达：异常 0A；上游暂停响应：超时后异常 0B，恢复后继续转发
+DEAD=$(request $PORT '\x00\x06\x00\x00\x00\x06\x14\x03\x00\x00\x00\x01')
+kill -STOP $UPSTREAM_PID
+STALLED=$(request $PORT '\x00\x07\x00\x00\x00\x06\x09\x03\x00\x00\x00\x01' 1)
+kill -CONT $UPSTREAM_PID
+sleep 0.2
+RESUMED=$(request $PORT '\x00\x08\x00\x00\x00\x06\x09\x03\x00\x00\x00\x01')
+if [[ "$DEAD" == *"00060000000314830a" ]] && [[ "$STALLED" == *"00070000000309830b" ]] && \
+   [[ "$RESUMED" == *"0008000000050903021111" ]]; then
+    echo "✓ 上游不可达回复异常 0A，超时回复异常 0B，恢复后照常转发"
+else
+    echo "✗ 网关异常错误：$DEAD / $STALLED / $RESUMED"
+fi
+
+# 63 个单元 9 的请求（含 1 个 RTU 请求）中相同的并发读请求会被合并，转发数与合并数之和不变
+STATS=$(admin "gateway")
+FORWARDED_COUNT=$(echo "$STATS" | grep -o "127.0.0.1:$UPSTREAM_PORT：转发 [0-9]*" | grep -o "[0-9]*$")
+COALESCED_COUNT=$(echo "$STATS" | grep -o "合并读请求 [0-9]*" | head -1 | grep -o "[0-9]*$")
+if [ $((FORWARDED_COUNT + COALESCED_COUNT)) -eq 63 ] && \
+   echo "$STATS" | grep -q "转发 $FORWARDED_COUNT，响应 $((FORWARDED_COUNT - 1))，超时或断开 1" && \
+   echo "$STATS" | grep -q "单元 20-20 -> 127.0.0.1:$DEAD_PORT：转发 0，响应 0，超时或断开 0，不可达 1"; then
+    echo "✓ gateway 命令显示转发、超时和不可达统计"
+else
+    echo "✗ 网关统计错误：$STATS"
+fi
+
+# 清理
+kill -INT $SERVER_PID $UPSTREAM_PID 2>/dev/null
+wait $SERVER_PID $UPSTREAM_PID 2>/dev/null
+rm -rf $SERVER_LOG $UPSTREAM_LOG $ADMIN_SOCK $UPSTREAM_MAP $RESULT_DIR
+
+echo ""
+echo "测试完成！"
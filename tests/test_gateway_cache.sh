@@ -0,0 +1,99 @@
+#!/bin/bash
+
+# 测试网关读合并与读缓存：上游暂停期间多个主站的相同读请求只转发一次，响应分发给所有主站；
+# 缓存规则覆盖的读请求在存活期内由网关直接应答，经网关的写入只使重叠的缓存失效
+
+PORT=15650
+UPSTREAM_PORT=15651
+ADMIN_SOCK=/tmp/test_gateway_cache_admin_$$.sock
+UPSTREAM_MAP=/tmp/test_gateway_cache_upstream_$$.map
+SERVER_LOG=test_gateway_cache_server.log
+UPSTREAM_LOG=test_gateway_cache_upstream.log
+RESULT_DIR=/tmp/test_gateway_cache_$$
+mkdir -p $RESULT_DIR
+
+cat > $UPSTREAM_MAP <<EOF
+holding 0-19 = 0x1111
+EOF
+
+echo "启动上游服务器（端口 $UPSTREAM_PORT）..."
+stdbuf -oL ./build/server -R $UPSTREAM_MAP $UPSTREAM_PORT < /dev/null > $UPSTREAM_LOG 2>&1 &
+UPSTREAM_PID=$!
+sleep 0.5
+
+echo "启动网关（端口 $PORT，单元 9 -> $UPSTREAM_PORT，缓存保持寄存器 10-19 四秒）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK -O 3000 -U 9=127.0.0.1:$UPSTREAM_PORT,1,4 \
+    -c 9:holding:10-19=4000 $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 上游已转发的请求数
+forwarded() {
+    admin "gateway" | grep -o "转发 [0-9]*" | head -1 | grep -o "[0-9]*"
+}
+
+echo ""
+echo "=== 验证 ==="
+
+# 上游暂停时 20 个主站发出相同的读请求（各自的事务标识符），恢复后全部得到应答
+BEFORE=$(forwarded)
+kill -STOP $UPSTREAM_PID
+for i in $(seq 10 29); do
+    request $PORT "\\x00\\x$i\\x00\\x00\\x00\\x06\\x09\\x03\\x00\\x00\\x00\\x02" 2 > $RESULT_DIR/$i &
+done
+sleep 0.5
+kill -CONT $UPSTREAM_PID
+wait $(jobs -p | grep -v -e "^$SERVER_PID$" -e "^$UPSTREAM_PID$") 2>/dev/null
+ANSWERED=0
+for i in $(seq 10 29); do
+    grep -q "00${i}0000000709030411111111$" $RESULT_DIR/$i && ANSWERED=$((ANSWERED + 1))
+done
+AFTER=$(forwarded)
+if [ "$ANSWERED" -eq 20 ] && [ $((AFTER - BEFORE)) -eq 1 ] && admin "gateway" | grep -q "合并读请求 19，"; then
+    echo "✓ 20 个相同读请求只转发 1 次，响应按各自的事务标识符分发"
+else
+    echo "✗ 读合并错误：应答 $ANSWERED 个，转发 $BEFORE -> $AFTER"
+fi
+
+# 缓存：第一次读取写入缓存，绕过网关直接改上游的值后，存活期内仍返回缓存值
+FIRST=$(request $PORT '\x00\x01\x00\x00\x00\x06\x09\x03\x00\x0a\x00\x01')
+request $UPSTREAM_PORT '\x00\x02\x00\x00\x00\x06\x09\x06\x00\x0a\x22\x22' > /dev/null
+CACHED=$(request $PORT '\x00\x03\x00\x00\x00\x06\x09\x03\x00\x0a\x00\x01')
+if [[ "$FIRST" == *"0001000000050903021111" ]] && [[ "$CACHED" == *"0003000000050903021111" ]] && \
+   admin "gateway" | grep -q "缓存命中 1"; then
+    echo "✓ 存活期内的读请求由缓存应答"
+else
+    echo "✗ 读缓存错误：$FIRST / $CACHED"
+fi
+
+# 经网关写入地址 10：该项缓存失效，下一次读到新值；地址 12 的缓存项不受影响
+request $PORT '\x00\x04\x00\x00\x00\x06\x09\x03\x00\x0c\x00\x01' > /dev/null
+request $PORT '\x00\x05\x00\x00\x00\x06\x09\x06\x00\x0a\x33\x33' > /dev/null
+request $UPSTREAM_PORT '\x00\x06\x00\x00\x00\x06\x09\x06\x00\x0c\x55\x55' > /dev/null
+FRESH=$(request $PORT '\x00\x07\x00\x00\x00\x06\x09\x03\x00\x0a\x00\x01')
+KEPT=$(request $PORT '\x00\x08\x00\x00\x00\x06\x09\x03\x00\x0c\x00\x01')
+if [[ "$FRESH" == *"0007000000050903023333" ]] && [[ "$KEPT" == *"0008000000050903021111" ]]; then
+    echo "✓ 经网关的写入只使重叠的缓存项失效"
+else
+    echo "✗ 缓存失效错误：$FRESH / $KEPT"
+fi
+
+# 存活期过后重新向上游读取
+sleep 4
+EXPIRED=$(request $PORT '\x00\x09\x00\x00\x00\x06\x09\x03\x00\x0c\x00\x01')
+STATS=$(admin "gateway")
+if [[ "$EXPIRED" == *"0009000000050903025555" ]] && echo "$STATS" | grep -q "读缓存：1 条规则.*失效 1"; then
+    echo "✓ 缓存项过期后重新转发，gateway 命令显示缓存统计"
+else
+    echo "✗ 缓存过期错误：$EXPIRED / $STATS"
+fi
+
+# 清理
+kill -INT $SERVER_PID $UPSTREAM_PID 2>/dev/null
+wait $SERVER_PID $UPSTREAM_PID 2>/dev/null
+rm -rf $SERVER_LOG $UPSTREAM_LOG $ADMIN_SOCK $UPSTREAM_MAP $RESULT_DIR
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# 测试寄存器值生成器：常量、斜坡、正弦（段内相位偏移）、文件回放，读取时惰性计算，虚拟时钟快进
+
+PORT=15574
+SAMPLES=/tmp/modbus_generator_$$.txt
+SERVER_LOG=test_generator_server.log
+
+printf '# 回放样本\n4321\n17\n99\n' > $SAMPLES
+
+# 时钟 1000 倍速：周期 1 秒的斜坡每真实毫秒走完一个周期；正弦和回放使用很长的周期，在测试期间近似不变
+echo "启动服务器（端口 $PORT，时钟 1000 倍速）..."
+stdbuf -oL ./build/server -V 1000 \
+    -G input:20:const:value=1234 \
+    -G holding:100-103:ramp:min=0,max=60000,period=1000 \
+    -G holding:200-203:sine:base=30000,amp=20000,period=1000000000,phase=250000000 \
+    -G input:30:replay:file=$SAMPLES,interval=1000000000 \
+    $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 从响应末尾取出第 n 个（从 0 开始，共 total 个）寄存器值
+register_value() {
+    local hex=$1 n=$2 total=$3
+    local offset=$(( ${#hex} - (total - n) * 4 ))
+    echo $(( 16#${hex:$offset:4} ))
+}
+
+echo ""
+echo "=== 验证 ==="
+
+# FC04 读输入寄存器 19-21：只有 20 挂接了常量生成器，19 和 21 保持存储值 1019/1021
+RESP=$(modbus_tcp '\x00\x01\x00\x00\x00\x06\x01\x04\x00\x13\x00\x03')
+if [[ "$RESP" == *"00010000000901040603fb04d203fd" ]]; then
+    echo "✓ 常量生成器只接管指定寄存器"
+else
+    echo "✗ 常量生成器响应错误：$RESP"
+fi
+
+# 斜坡：两次读取之间虚拟时钟前进了数百秒，值应当变化
+RESP1=$(modbus_tcp '\x00\x02\x00\x00\x00\x06\x01\x03\x00\x64\x00\x01')
+sleep 0.3
+RESP2=$(modbus_tcp '\x00\x03\x00\x00\x00\x06\x01\x03\x00\x64\x00\x01')
+RAMP1=$(register_value "$RESP1" 0 1)
+RAMP2=$(register_value "$RESP2" 0 1)
+if [ "$RAMP1" != "$RAMP2" ] && [ "$RAMP1" -le 60000 ] && [ "$RAMP2" -le 60000 ]; then
+    echo "✓ 斜坡生成器的值随时钟变化（$RAMP1 -> $RAMP2）"
+else
+    echo "✗ 斜坡生成器的值未变化或越界：$RAMP1 $RAMP2"
+fi
+
+# 正弦：相位偏移 1/4 周期，四个点依次约为 base、base+amp、base、base-amp
+RESP=$(modbus_tcp '\x00\x04\x00\x00\x00\x06\x01\x03\x00\xc8\x00\x04')
+SINE0=$(register_value "$RESP" 0 4)
+SINE1=$(register_value "$RESP" 1 4)
+SINE3=$(register_value "$RESP" 3 4)
+if [ $((SINE0 > 29000 && SINE0 < 31000)) = 1 ] && [ $((SINE1 > 49000)) = 1 ] && [ $((SINE3 < 11000)) = 1 ]; then
+    echo "✓ 正弦生成器段内各点按相位偏移（$SINE0 $SINE1 ... $SINE3）"
+else
+    echo "✗ 正弦生成器结果错误：$SINE0 $SINE1 $SINE3"
+fi
+
+# 回放：间隔很长，始终停留在第一个样本
+RESP=$(modbus_tcp '\x00\x05\x00\x00\x00\x06\x01\x04\x00\x1e\x00\x01')
+if [[ "$RESP" == *"000500000005010402""10e1" ]]; then
+    echo "✓ 回放生成器返回文件中的样本"
+else
+    echo "✗ 回放生成器响应错误：$RESP"
+fi
+
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+
+# 地址范围重叠的生成器在启动时被拒绝
+./build/server -G input:0-9:const:value=1 -G input:5:const:value=2 $PORT > $SERVER_LOG 2>&1
+if [ $? -ne 0 ] && grep -q "重叠" $SERVER_LOG; then
+    echo "✓ 地址重叠的生成器被拒绝"
+else
+    echo "✗ 地址重叠的生成器未被拒绝"
+fi
+
+# 清理
+rm -f $SAMPLES $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# 测试按地址的读写计数：退出时导出的二进制文件中记录了各寄存器被读写的次数
+
+PORT=15580
+HEATMAP=/tmp/modbus_heatmap_$$.bin
+SERVER_LOG=test_heatmap_server.log
+
+rm -f $HEATMAP
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server -H $HEATMAP $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 读取导出文件中指定偏移处的 64 位计数
+counter_at() {
+    od -An -tu8 -j $1 -N8 $HEATMAP | tr -d ' '
+}
+
+echo "FC03 读 100-104 三次，FC06 写 100 一次，FC04 读 11 一次..."
+for i in 1 2 3; do
+    modbus_tcp '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x64\x00\x05' > /dev/null
+done
+modbus_tcp '\x00\x02\x00\x00\x00\x06\x01\x06\x00\x64\x00\x01' > /dev/null
+modbus_tcp '\x00\x03\x00\x00\x00\x06\x01\x04\x00\x0b\x00\x01' > /dev/null
+
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+
+echo ""
+echo "=== 验证 ==="
+
+# 文件头 32 字节 + 4 个数组 * 1000 个寄存器 * 8 字节
+if [ -f $HEATMAP ] && [ "$(stat -c %s $HEATMAP)" = "32032" ] && grep -q "访问计数已导出" $SERVER_LOG; then
+    echo "✓ 退出时导出了访问计数文件"
+else
+    echo "✗ 访问计数文件缺失或大小错误"
+fi
+
+# 保持寄存器读计数从偏移 32 开始，写计数从 32+8000 开始，输入寄存器读计数从 32+16000 开始
+if [ "$(counter_at 832)" = "3" ] && [ "$(counter_at 864)" = "3" ] && [ "$(counter_at 872)" = "0" ]; then
+    echo "✓ 保持寄存器读计数正确（100-104 各 3 次，105 为 0）"
+else
+    echo "✗ 保持寄存器读计数错误：$(counter_at 832) $(counter_at 864) $(counter_at 872)"
+fi
+
+if [ "$(counter_at 8832)" = "1" ] && [ "$(counter_at 16120)" = "1" ]; then
+    echo "✓ 写计数和输入寄存器读计数正确"
+else
+    echo "✗ 写计数或输入寄存器读计数错误：$(counter_at 8832) $(counter_at 16120)"
+fi
+
+# 清理
+rm -f $HEATMAP $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# 测试寄存器写入日志：组提交落盘、崩溃后重放、快照之后的增量重放、截断不完整的尾部
+
+PORT=15572
+JOURNAL=/tmp/modbus_journal_$$.wal
+SNAP_PREFIX=/tmp/modbus_journal_snap_$$
+SERVER_LOG=test_journal_server.log
+
+rm -f $JOURNAL $SNAP_PREFIX-*.snap
+
+start_server() {
+    stdbuf -oL ./build/server -J $JOURNAL -S $SNAP_PREFIX "$@" $PORT >> $SERVER_LOG 2>&1 &
+    SERVER_PID=$!
+    sleep 1
+}
+
+# 依次执行若干条客户端命令
+client_commands() {
+    (sleep 0.5; for cmd in "$@"; do echo "$cmd"; sleep 0.2; done; echo "quit") | \
+        timeout 5 ./build/client 127.0.0.1 $PORT 2>&1
+}
+
+echo "第一次启动：写入三个寄存器后强制杀死服务器..."
+start_server
+client_commands "modbus write 500 11" "modbus write 501 22" "modbus write 502 33" > /dev/null
+kill -SIGKILL $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+JOURNAL_SIZE_1=$(stat -c %s $JOURNAL)
+
+echo "第二次启动：重放日志，触发快照后再写入一个寄存器..."
+start_server
+READ_BACK=$(client_commands "modbus read 500 3")
+kill -USR1 $SERVER_PID
+sleep 0.5
+client_commands "modbus write 503 44" > /dev/null
+kill -SIGKILL $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+SNAP=$(ls $SNAP_PREFIX-*.snap 2>/dev/null | head -1)
+
+echo "第三次启动：先加载快照，再只重放快照之后的日志..."
+stdbuf -oL ./build/server -J $JOURNAL -L $SNAP $PORT > $SERVER_LOG.3 2>&1 &
+SERVER_PID=$!
+sleep 1
+READ_BACK_3=$(client_commands "modbus read 500 4")
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+
+echo "第四次启动：日志尾部追加不完整的记录..."
+printf '\x01\x02\x03\x04\x05\x06\x07\x08\x09\x10' >> $JOURNAL
+stdbuf -oL ./build/server -J $JOURNAL $PORT > $SERVER_LOG.4 2>&1 &
+SERVER_PID=$!
+sleep 1
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+
+echo ""
+echo "=== 验证 ==="
+
+# 文件头 16 字节 + 每条记录 24 字节
+if [ "$JOURNAL_SIZE_1" = "88" ]; then
+    echo "✓ 强制杀死前三条记录均已提交到日志"
+else
+    echo "✗ 日志大小错误：$JOURNAL_SIZE_1"
+fi
+
+if grep -q "重放 3 条记录" $SERVER_LOG && \
+   echo "$READ_BACK" | grep -q "寄存器\[0\] = 11" && \
+   echo "$READ_BACK" | grep -q "寄存器\[2\] = 33"; then
+    echo "✓ 崩溃后重启通过日志恢复了写入的值"
+else
+    echo "✗ 崩溃后重启未恢复写入的值"
+fi
+
+if [ -n "$SNAP" ] && grep -q "日志序列号 3" $SERVER_LOG.3 && grep -q "重放 1 条记录" $SERVER_LOG.3 && \
+   echo "$READ_BACK_3" | grep -q "寄存器\[3\] = 44"; then
+    echo "✓ 加载快照后只重放了快照之后的记录"
+else
+    echo "✗ 快照加日志增量重放失败"
+fi
+
+if grep -q "尾部 10 字节无效" $SERVER_LOG.4 && grep -q "重放 4 条记录" $SERVER_LOG.4 && \
+   [ "$(stat -c %s $JOURNAL)" = "112" ]; then
+    echo "✓ 不完整的尾部被截断，有效记录全部重放"
+else
+    echo "✗ 不完整尾部处理错误"
+fi
+
+# 清理
+rm -f $JOURNAL $SNAP_PREFIX-*.snap $SERVER_LOG $SERVER_LOG.3 $SERVER_LOG.4
+
+echo ""
+echo "测试完成！"
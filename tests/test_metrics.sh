@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# 测试运行指标：本机 HTTP 端口以 Prometheus 文本格式输出请求数、异常数、延迟直方图和连接数；
+# 不发请求的抓取连接在期限后被关闭，不会一直占用连接名额
+
+PORT=15584
+METRICS_PORT=15585
+SERVER_LOG=test_metrics_server.log
+
+echo "启动服务器（端口 $PORT，指标端口 $METRICS_PORT）..."
+stdbuf -oL ./build/server -M $METRICS_PORT $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 抓取指定路径，输出完整 HTTP 响应
+http_get() {
+    exec 4<>/dev/tcp/127.0.0.1/$METRICS_PORT
+    printf "GET $1 HTTP/1.1\r\nHost: localhost\r\n\r\n" >&4
+    timeout 1 cat <&4
+    exec 4<&-
+}
+
+echo "FC03 读两次，FC06 越界写一次，FC07 不支持一次..."
+modbus_tcp '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x05' > /dev/null
+modbus_tcp '\x00\x02\x00\x00\x00\x06\x01\x03\x00\x64\x00\x02' > /dev/null
+modbus_tcp '\x00\x03\x00\x00\x00\x06\x01\x06\x03\xe8\x00\x01' > /dev/null
+modbus_tcp '\x00\x04\x00\x00\x00\x02\x01\x07' > /dev/null
+
+METRICS=$(http_get /metrics)
+NOT_FOUND=$(http_get /)
+
+echo "打开 8 个不发请求的抓取连接，占满连接名额..."
+for fd in 10 11 12 13 14 15 16 17; do
+    eval "exec $fd<>/dev/tcp/127.0.0.1/$METRICS_PORT"
+done
+sleep 0.3
+WHILE_FULL=$(http_get /metrics)
+MODBUS_WHILE_IDLE=$(exec 3<>/dev/tcp/127.0.0.1/$PORT; printf '\x00\x09\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01' >&3; \
+                    timeout 0.3 cat <&3 | od -An -tx1 | tr -d ' \n')
+sleep 3.5
+AFTER_EXPIRY=$(http_get /metrics)
+for fd in 10 11 12 13 14 15 16 17; do
+    eval "exec $fd<&-"
+done
+
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+
+echo ""
+echo "=== 验证 ==="
+
+if echo "$METRICS" | head -1 | grep -q "200 OK" && echo "$METRICS" | grep -q "^Content-Type: text/plain; version=0.0.4"; then
+    echo "✓ GET /metrics 返回 Prometheus 文本格式"
+else
+    echo "✗ GET /metrics 响应错误：$(echo "$METRICS" | head -3)"
+fi
+
+if echo "$METRICS" | grep -q '^modbus_requests_total{function="0x03"} 2' && \
+   echo "$METRICS" | grep -q '^modbus_requests_total{function="0x06"} 1'; then
+    echo "✓ 按功能码统计请求数"
+else
+    echo "✗ 请求数错误：$(echo "$METRICS" | grep modbus_requests_total)"
+fi
+
+if echo "$METRICS" | grep -q '^modbus_exceptions_total{function="0x06",code="2"} 1' && \
+   echo "$METRICS" | grep -q '^modbus_exceptions_total{function="0x07",code="1"} 1'; then
+    echo "✓ 按功能码和异常码统计异常响应"
+else
+    echo "✗ 异常数错误：$(echo "$METRICS" | grep modbus_exceptions_total)"
+fi
+
+# 直方图：+Inf 桶和 _count 等于请求数，累积计数单调不减
+BUCKETS=$(echo "$METRICS" | grep '^modbus_request_duration_seconds_bucket{function="0x03"' | awk '{print $2}')
+if echo "$METRICS" | grep -q '^modbus_request_duration_seconds_bucket{function="0x03",le="+Inf"} 2' && \
+   echo "$METRICS" | grep -q '^modbus_request_duration_seconds_count{function="0x03"} 2' && \
+   [ "$(echo "$BUCKETS" | sort -n | tr '\n' ' ')" = "$(echo "$BUCKETS" | tr '\n' ' ')" ]; then
+    echo "✓ 延迟直方图为累积计数，总数与请求数一致"
+else
+    echo "✗ 延迟直方图错误"
+fi
+
+if echo "$METRICS" | grep -q '^modbus_connections_opened_total 4' && \
+   echo "$METRICS" | grep -q '^modbus_connections_closed_total 4' && \
+   echo "$METRICS" | grep -q '^modbus_connections 0'; then
+    echo "✓ 连接建立/关闭计数正确"
+else
+    echo "✗ 连接计数错误：$(echo "$METRICS" | grep modbus_connections)"
+fi
+
+if echo "$NOT_FOUND" | head -1 | grep -q "404"; then
+    echo "✓ 其他路径返回 404"
+else
+    echo "✗ 其他路径响应错误：$(echo "$NOT_FOUND" | head -1)"
+fi
+
+if [ -z "$WHILE_FULL" ] && [[ "$MODBUS_WHILE_IDLE" == *"00090000000501030200"* ]] && \
+   echo "$AFTER_EXPIRY" | head -1 | grep -q "200 OK" && \
+   echo "$AFTER_EXPIRY" | grep -q '^modbus_metrics_scrape_timeouts_total 8' && \
+   echo "$AFTER_EXPIRY" | grep -q '^modbus_metrics_scrapes_total 1'; then
+    echo "✓ 不发请求的抓取连接超过期限后被关闭，名额释放后照常抓取"
+else
+    echo "✗ 抓取连接期限错误：${WHILE_FULL:0:40} / $MODBUS_WHILE_IDLE / $(echo "$AFTER_EXPIRY" | grep scrape)"
+fi
+
+# 清理
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,97 @@
+#!/bin/bash
+
+# 测试 Modbus RTU 帧格式：RTU-over-TCP 与 PTY 串口从站
+# 请求帧中的 CRC 为预先计算好的值（低字节在前）
+
+PORT=15562
+RTU_PORT=15563
+SERVER_LOG=test_rtu_server.log
+
+echo "启动服务器（RTU-over-TCP 端口 $RTU_PORT，1 条串口线路）..."
+stdbuf -oL ./build/server -r $RTU_PORT -s 1 -b 9600 $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+# 发送一帧并以十六进制输出响应
+rtu_over_tcp() {
+    exec 3<>/dev/tcp/127.0.0.1/$RTU_PORT
+    printf "$1" >&3
+    timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n'
+    exec 3<&-
+}
+
+echo ""
+echo "=== 验证 ==="
+
+# 01 06 00 0A 12 34 + CRC：写寄存器10 = 0x1234，响应原样回显
+RESP=$(rtu_over_tcp '\x01\x06\x00\x0a\x12\x34\xa4\xbf')
+if [ "$RESP" = "0106000a1234a4bf" ]; then
+    echo "✓ RTU-over-TCP FC06 响应正确"
+else
+    echo "✗ RTU-over-TCP FC06 响应错误：$RESP"
+fi
+
+# 01 03 00 0A 00 01 + CRC：读寄存器10
+RESP=$(rtu_over_tcp '\x01\x03\x00\x0a\x00\x01\xa4\x08')
+if [ "$RESP" = "0103021234b533" ]; then
+    echo "✓ RTU-over-TCP FC03 响应正确（含 CRC）"
+else
+    echo "✗ RTU-over-TCP FC03 响应错误：$RESP"
+fi
+
+# 一次写入：1 个杂散字节 + 未知功能码 FC01 的完整帧 + FC03 读请求
+# 杂散字节被丢弃后重新同步，FC01 回复异常 01，FC03 正常应答
+RESP=$(rtu_over_tcp '\xff\x01\x01\x00\x00\x00\x01\xfd\xca\x01\x03\x00\x0a\x00\x01\xa4\x08')
+if [ "$RESP" = "01810181900103021234b533" ]; then
+    echo "✓ 未知功能码按 CRC 分帧并回复异常 01，杂散字节丢弃后重新同步"
+else
+    echo "✗ 未知功能码分帧错误：$RESP"
+fi
+
+# 未知功能码 FC01 的帧分两次到达：不完整时不丢弃字节，凑齐后回复异常 01
+exec 3<>/dev/tcp/127.0.0.1/$RTU_PORT
+printf '\x01\x01\x00\x00' >&3
+sleep 0.2
+printf '\x00\x01\xfd\xca' >&3
+RESP=$(timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+exec 3<&-
+if [ "$RESP" = "0181018190" ]; then
+    echo "✓ 分两次到达的未知功能码帧凑齐后回复异常 01"
+else
+    echo "✗ 分段的未知功能码帧处理错误：$RESP"
+fi
+
+# CRC 错误的帧应被静默丢弃
+RESP=$(rtu_over_tcp '\x01\x03\x00\x0a\x00\x01\x00\x00')
+if [ -z "$RESP" ]; then
+    echo "✓ CRC 错误帧未应答"
+else
+    echo "✗ CRC 错误帧被应答：$RESP"
+fi
+
+# 串口线路：通过 PTY 从端发送同一读请求，分两次写入，依靠 t3.5 组帧
+PTS=$(grep -o '/dev/pts/[0-9]\+' $SERVER_LOG | head -1)
+if [ -n "$PTS" ]; then
+    exec 4<>$PTS
+    stty -F $PTS raw -echo 2>/dev/null
+    printf '\x01\x03\x00' >&4
+    printf '\x0a\x00\x01\xa4\x08' >&4
+    RESP=$(timeout 0.5 cat <&4 | od -An -tx1 | tr -d ' \n')
+    exec 4<&-
+    if [ "$RESP" = "0103021234b533" ]; then
+        echo "✓ PTY 串口从站响应正确（$PTS）"
+    else
+        echo "✗ PTY 串口从站响应错误：$RESP"
+    fi
+else
+    echo "✗ 未找到串口线路"
+fi
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+# 清理
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
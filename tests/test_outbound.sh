@@ -0,0 +1,101 @@
+#!/bin/bash
+
+# 测试广播的发送队列：广播只把共享缓冲区挂到各连接的队列上，可写时再写出，投递结果异步报告
+# 一个暂停（SIGSTOP）的 Unix 域客户端不读数据，它的套接字和发送队列被写满后只丢弃它的那一份，
+# 其他连接照常收到全部广播，Modbus 请求照常应答；恢复后队列中剩余的消息继续写出；
+# 流水线发出大量请求却从不读取响应的 Modbus 主站在发送队列写满后被断开
+
+PORT=15592
+SOCK_PATH=/tmp/test_outbound_$$.sock
+ADMIN_SOCK=/tmp/test_outbound_admin_$$.sock
+SERVER_LOG=test_outbound_server.log
+READER_LOG=test_outbound_reader.log
+COUNT=400
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server -u $SOCK_PATH -a $ADMIN_SOCK $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+# 不读数据的客户端：连接后暂停进程
+sleep 30 2>/dev/null | ./build/client -u $SOCK_PATH > /dev/null 2>&1 &
+STALLED_PID=$!
+sleep 0.5
+kill -STOP $STALLED_PID
+
+# 正常读取的客户端
+exec 4<>/dev/tcp/127.0.0.1/$PORT
+timeout 20 cat <&4 > $READER_LOG 2>/dev/null &
+READER_PID=$!
+
+echo "经管理套接字广播 $COUNT 条 1000 字节的消息..."
+MESSAGE=$(head -c 1000 /dev/zero | tr '\0' 'x')
+ADMIN_OUTPUT=$( (sleep 0.3; for i in $(seq 1 $COUNT); do echo "broadcast $i $MESSAGE"; done; sleep 1; echo "quit") | \
+    timeout 20 ./build/client -u $ADMIN_SOCK 2>&1)
+
+RESP=$(exec 3<>/dev/tcp/127.0.0.1/$PORT; printf '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01' >&3; \
+       timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+REPORTS_STALLED=$(grep -c "投递完成" $SERVER_LOG)
+# 客户端程序在输入很快时可能合并或丢掉个别行，以服务器实际排队的广播数为准
+QUEUED=$(grep -c "已排队给" <<< "$ADMIN_OUTPUT")
+
+kill -CONT $STALLED_PID
+sleep 1
+REPORTS_RESUMED=$(grep -c "投递完成" $SERVER_LOG)
+
+echo ""
+echo "=== 验证 ==="
+
+if [ "$QUEUED" -gt $((COUNT / 2)) ]; then
+    echo "✓ 广播立即返回排队结果（$QUEUED 条）"
+else
+    echo "✗ 广播排队结果数量错误：$QUEUED"
+fi
+
+if grep -q "1 个发送队列已满" <<< "$ADMIN_OUTPUT" && grep -q "1/2 个客户端已写出，1 个未送达" $SERVER_LOG; then
+    echo "✓ 不读数据的连接发送队列写满后只丢弃它的那一份"
+else
+    echo "✗ 未观察到队列写满后的丢弃"
+fi
+
+if [ "$(grep -c "\[服务器广播\] [0-9]* x" $READER_LOG)" -eq $QUEUED ]; then
+    echo "✓ 正常读取的连接收到全部 $QUEUED 条广播"
+else
+    echo "✗ 正常连接只收到 $(grep -c "\[服务器广播\]" $READER_LOG) 条广播"
+fi
+
+if [[ "$RESP" == *"000100000005010302"* ]]; then
+    echo "✓ 广播期间 Modbus 请求照常应答"
+else
+    echo "✗ Modbus 响应错误：$RESP"
+fi
+
+# 暂停期间仍有缓冲区挂在队列上未报告，恢复读取后写完并全部报告
+if [ "$REPORTS_STALLED" -lt $QUEUED ] && [ "$REPORTS_RESUMED" -eq $QUEUED ]; then
+    echo "✓ 恢复读取后队列中剩余的消息写出，投递结果异步报告（$REPORTS_STALLED → $REPORTS_RESUMED）"
+else
+    echo "✗ 投递报告数量错误：$REPORTS_STALLED → $REPORTS_RESUMED"
+fi
+
+# 65536 个 FC03（125 个寄存器）请求一次写出且不读响应：套接字缓冲区和发送队列写满后断开该主站
+FLOOD=/tmp/test_outbound_flood_$$.bin
+printf '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x7d' > $FLOOD
+for i in $(seq 1 16); do
+    cat $FLOOD $FLOOD > $FLOOD.tmp && mv $FLOOD.tmp $FLOOD
+done
+(exec 6<>/dev/tcp/127.0.0.1/$PORT; timeout 5 cat $FLOOD >&6 2>/dev/null; sleep 1) 2>/dev/null
+if grep -q "原因: 发送队列已满（客户端未读取响应）" $SERVER_LOG; then
+    echo "✓ 不读取响应的 Modbus 主站在发送队列写满后被断开"
+else
+    echo "✗ 发送队列写满后未断开不读取响应的主站"
+fi
+rm -f $FLOOD
+
+# 清理
+exec 4<&-
+kill $READER_PID $STALLED_PID 2>/dev/null
+pkill -x server 2>/dev/null
+rm -f $SERVER_LOG $READER_LOG $SOCK_PATH $ADMIN_SOCK
+
+echo ""
+echo "测试完成！"
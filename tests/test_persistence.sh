@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# 测试寄存器持久化文件：写入的值在服务器重启（包括被强制杀死）后依然保留
+
+PORT=15566
+REG_FILE=/tmp/modbus_registers_$$.bin
+SERVER_LOG=test_persistence_server.log
+
+rm -f $REG_FILE
+
+echo "第一次启动服务器（新建持久化文件 $REG_FILE）..."
+./build/server -p $REG_FILE -y write $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+echo "写入寄存器 300 = 2468..."
+(sleep 0.5; echo "modbus write 300 2468"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /tmp/persist_client1.log 2>&1
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+echo "第二次启动服务器（复用持久化文件）..."
+./build/server -p $REG_FILE $PORT >> $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+echo "读取寄存器 299-301，并写入寄存器 301 = 1357..."
+(sleep 0.5; echo "modbus read 299 3"; sleep 0.3; echo "modbus write 301 1357"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /tmp/persist_client2.log 2>&1
+
+echo "强制杀死服务器（不执行清理）..."
+kill -SIGKILL $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+echo "第三次启动服务器..."
+./build/server -p $REG_FILE $PORT >> $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+(sleep 0.5; echo "modbus read 301 1"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /tmp/persist_client3.log 2>&1
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+echo "用损坏的文件头启动服务器..."
+printf 'XXXX' | dd of=$REG_FILE bs=1 count=4 conv=notrunc 2>/dev/null
+timeout 3 ./build/server -p $REG_FILE $PORT > /tmp/persist_server_bad.log 2>&1
+BAD_EXIT=$?
+
+echo ""
+echo "=== 验证 ==="
+
+if grep -q "寄存器持久化文件：$REG_FILE（新建）" $SERVER_LOG; then
+    echo "✓ 首次启动新建了持久化文件"
+else
+    echo "✗ 未找到新建持久化文件的记录"
+fi
+
+if grep -q "寄存器已从持久化文件恢复" $SERVER_LOG; then
+    echo "✓ 重启后直接沿用文件中的寄存器值"
+else
+    echo "✗ 重启后没有从持久化文件恢复"
+fi
+
+if grep -q "寄存器\[0\] = 299" /tmp/persist_client2.log && \
+   grep -q "寄存器\[1\] = 2468" /tmp/persist_client2.log && \
+   grep -q "寄存器\[2\] = 301" /tmp/persist_client2.log; then
+    echo "✓ 正常重启后写入的值和未写入的初值都保留"
+else
+    echo "✗ 正常重启后寄存器值不正确"
+fi
+
+if grep -q "寄存器\[0\] = 1357" /tmp/persist_client3.log; then
+    echo "✓ 进程被强制杀死后写入的值依然保留"
+else
+    echo "✗ 进程被强制杀死后写入的值丢失"
+fi
+
+if [ $BAD_EXIT -ne 0 ] && grep -q "不是寄存器持久化文件" /tmp/persist_server_bad.log; then
+    echo "✓ 文件头不匹配时拒绝启动"
+else
+    echo "✗ 文件头不匹配时没有拒绝启动"
+fi
+
+# 清理
+rm -f $REG_FILE $SERVER_LOG /tmp/persist_client1.log /tmp/persist_client2.log \
+      /tmp/persist_client3.log /tmp/persist_server_bad.log
+
+echo ""
+echo "测试完成！"
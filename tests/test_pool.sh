@@ -0,0 +1,85 @@
+#!/bin/bash
+
+# 测试连接缓冲池：空闲连接不占缓冲区，半帧和待写数据期间才借用，处理完归还并复用；
+# 超出内存上限（-m）时分配失败，服务器照常运行，缓冲区写出后释放
+
+PORT=15596
+SOCK_PATH=/tmp/test_pool_$$.sock
+ADMIN_SOCK=/tmp/test_pool_admin_$$.sock
+SERVER_LOG=test_pool_server.log
+
+echo "启动服务器（端口 $PORT，缓冲池上限 64 KB）..."
+stdbuf -oL ./build/server -u $SOCK_PATH -a $ADMIN_SOCK -m 64 $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+# 几个空闲的 Modbus 连接（各完成一次请求后保持连接）
+for fd in 5 6 7; do
+    eval "exec $fd<>/dev/tcp/127.0.0.1/$PORT"
+    printf '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01' >&$fd
+done
+sleep 0.3
+OUTPUT=$(admin "pool")
+if echo "$OUTPUT" | grep -q "在用 0 字节"; then
+    echo "✓ 空闲连接不占用缓冲区"
+else
+    echo "✗ 空闲连接占用了缓冲区：$OUTPUT"
+fi
+
+# 半帧期间借用 512 字节档，帧凑满处理后归还
+exec 8<>/dev/tcp/127.0.0.1/$PORT
+printf '\x00\x02\x00\x00\x00\x06\x01' >&8
+sleep 0.3
+HALF=$(admin "pool")
+printf '\x03\x00\x00\x00\x01' >&8
+sleep 0.3
+DONE=$(admin "pool")
+RESP=$(timeout 0.5 cat <&8 | od -An -tx1 | tr -d ' \n')
+if echo "$HALF" | grep -q "512 字节档：在用 1 个" && echo "$DONE" | grep -q "512 字节档：在用 0 个，缓存 1 个" && \
+   [[ "$RESP" == *"000200000005010302"* ]]; then
+    echo "✓ 半帧期间借用暂存区，处理完归还到空闲缓存"
+else
+    echo "✗ 半帧暂存区借还错误：$HALF / $DONE / $RESP"
+fi
+
+# 暂停读取的客户端让广播缓冲区滞留在发送队列上，直到超出 64 KB 上限
+sleep 30 2>/dev/null | ./build/client -u $SOCK_PATH > /dev/null 2>&1 &
+STALLED_PID=$!
+sleep 0.5
+kill -STOP $STALLED_PID
+MESSAGE=$(head -c 1000 /dev/zero | tr '\0' 'x')
+BROADCAST=$( (sleep 0.3; for i in $(seq 1 300); do echo "broadcast $i $MESSAGE"; done; sleep 1; echo "quit") | \
+    timeout 20 ./build/client -u $ADMIN_SOCK 2>&1)
+FULL=$(admin "pool")
+if echo "$BROADCAST" | grep -q "缓冲池已达内存上限" && echo "$FULL" | grep -q "超限拒绝 [1-9]"; then
+    echo "✓ 超出内存上限时分配失败并计数"
+else
+    echo "✗ 未观察到超限拒绝：$FULL"
+fi
+
+kill -CONT $STALLED_PID
+sleep 1
+kill $STALLED_PID 2>/dev/null
+sleep 0.3
+RESUMED=$(admin "pool")
+if echo "$RESUMED" | grep -q "在用 0 字节" && echo "$RESUMED" | grep -q "复用 [1-9]"; then
+    echo "✓ 滞留的缓冲区写出后全部归还，之后的分配复用空闲缓存"
+else
+    echo "✗ 缓冲区未归还：$RESUMED"
+fi
+
+# 清理
+for fd in 5 6 7 8; do
+    eval "exec $fd<&-"
+done
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG $SOCK_PATH $ADMIN_SOCK
+
+echo ""
+echo "测试完成！"
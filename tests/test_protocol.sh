@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# 测试连接协议判定：协议由连接上最先到达的字节判定一次，之后按各自的分帧方式处理
+# Modbus TCP 按 MBAP 长度字段分帧（头部被拆开、一次读到多帧都能正确处理），文本按换行拆分
+
+PORT=15594
+SERVER_LOG=test_protocol_server.log
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+echo ""
+echo "=== 验证 ==="
+
+# 第一帧的 MBAP 头在第 3 字节处被拆开；第二次写入包含第一帧剩余部分、完整的第二帧和第三帧的开头
+RESP=$(exec 3<>/dev/tcp/127.0.0.1/$PORT
+       printf '\x00\x01\x00' >&3; sleep 0.2
+       printf '\x00\x00\x06\x01\x03\x00\x00\x00\x01\x00\x02\x00\x00\x00\x06\x01\x03\x00\x01\x00\x01\x00\x03\x00\x00' >&3; sleep 0.2
+       printf '\x00\x06\x01\x03\x00\x02\x00\x01' >&3
+       timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+if [[ "$RESP" == *"000100000005010302000000020000000501030200010003000000050103020002" ]]; then
+    echo "✓ 拆开的 MBAP 头和一次读到的多帧按长度字段分帧，依次应答"
+else
+    echo "✗ Modbus 分帧错误：$RESP"
+fi
+if grep -q "连接协议判定为 Modbus TCP" $SERVER_LOG && ! grep -q "消息：" $SERVER_LOG; then
+    echo "✓ 协议只判定一次，半帧数据没有被当作文本回显"
+else
+    echo "✗ 协议判定错误"
+fi
+
+# 只有 1 字节时无法区分，等后续数据到达后与之拼接；一批数据按换行拆成多条消息
+TEXT=$(exec 3<>/dev/tcp/127.0.0.1/$PORT
+       printf 'h' >&3; sleep 0.2
+       printf 'ello\nworld\r\n' >&3
+       timeout 0.5 cat <&3)
+if echo "$TEXT" | grep -q "\] hello$" && echo "$TEXT" | grep -q "\] world$"; then
+    echo "✓ 文本连接按换行拆分消息并回显"
+else
+    echo "✗ 文本回显错误：$TEXT"
+fi
+
+# 已判定为 Modbus 的连接收到非法 MBAP 头时丢弃缓冲数据，之后的合法帧照常应答
+RESP=$(exec 3<>/dev/tcp/127.0.0.1/$PORT
+       printf '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01' >&3; sleep 0.2
+       printf '\x00\x02\x12\x34\x00\x06\x01\x03\x00\x00\x00\x01' >&3; sleep 0.2
+       printf '\x00\x03\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01' >&3
+       timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+if grep -q "MBAP 头非法（协议标识符=0x1234" $SERVER_LOG && [[ "$RESP" == *"0003000000050103020000" ]] && \
+   [[ "$RESP" != *"000200000005"* ]]; then
+    echo "✓ 非法 MBAP 头被丢弃，连接继续可用"
+else
+    echo "✗ 非法 MBAP 头处理错误：$RESP"
+fi
+
+# 清理
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,65 @@
+#!/bin/bash
+
+# 测试分页寄存器组：FC04 读输入寄存器、FC10 跨页原子写入多个寄存器
+
+PORT=15568
+SERVER_LOG=test_bank_server.log
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+# FC04 读输入寄存器 11-12：初值为 1000+i（避开 0x0a，bash printf 遇到换行符会分段写出）
+RESP=$(modbus_tcp '\x00\x01\x00\x00\x00\x06\x01\x04\x00\x0b\x00\x02')
+if [[ "$RESP" == *"00010000000701040403f303f4" ]]; then
+    echo "✓ FC04 读输入寄存器响应正确"
+else
+    echo "✗ FC04 响应错误：$RESP"
+fi
+
+# FC10 写寄存器 63-64（跨越第 0 页和第 1 页的边界）= 0x1234 0x5678
+RESP=$(modbus_tcp '\x00\x02\x00\x00\x00\x0b\x01\x10\x00\x3f\x00\x02\x04\x12\x34\x56\x78')
+if [[ "$RESP" == *"0002000000060110003f0002" ]]; then
+    echo "✓ FC10 跨页写入响应正确"
+else
+    echo "✗ FC10 响应错误：$RESP"
+fi
+
+# FC03 读回寄存器 63-64
+RESP=$(modbus_tcp '\x00\x03\x00\x00\x00\x06\x01\x03\x00\x3f\x00\x02')
+if [[ "$RESP" == *"00030000000701030412345678" ]]; then
+    echo "✓ FC03 读回了 FC10 写入的 32 位值"
+else
+    echo "✗ FC03 读回结果错误：$RESP"
+fi
+
+# FC10 字节计数与数量不符时返回非法数据值异常
+RESP=$(modbus_tcp '\x00\x04\x00\x00\x00\x0b\x01\x10\x00\x3f\x00\x02\x03\x12\x34\x56\x78')
+if [[ "$RESP" == *"000400000003019003" ]]; then
+    echo "✓ FC10 无效请求返回异常响应"
+else
+    echo "✗ FC10 无效请求响应错误：$RESP"
+fi
+
+# FC04 地址越界时返回非法数据地址异常
+RESP=$(modbus_tcp '\x00\x05\x00\x00\x00\x06\x01\x04\x03\xe7\x00\x02')
+if [[ "$RESP" == *"000500000003018402" ]]; then
+    echo "✓ FC04 越界请求返回异常响应"
+else
+    echo "✗ FC04 越界请求响应错误：$RESP"
+fi
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+# 清理
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# 测试寄存器映射文件：初值、访问模式和 unit 段设备按文件设置；
+# SIGHUP 后台重新加载并切换，已有连接不断开；语法错误时保留旧映射；十万个点的映射在毫秒级加载
+
+PORT=15630
+ADMIN_SOCK=/tmp/test_register_map_admin_$$.sock
+MAP=/tmp/test_register_map_$$.map
+BIG_MAP=/tmp/test_register_map_big_$$.map
+SERVER_LOG=test_register_map_server.log
+
+cat > $MAP <<EOF
+# 默认寄存器
+holding 0-9 = 7
+holding 10 = 1 2 3
+holding 20-29 = 0x99 ro
+input 0-4 = 500
+gen input:100-109:const:value=42
+
+unit 5                      # 单元 5 的模拟设备
+holding 0 = 4242
+EOF
+
+echo "启动服务器（端口 $PORT，寄存器映射 $MAP）..."
+stdbuf -oL ./build/server -a $ADMIN_SOCK -R $MAP $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 在描述符 5 上发送一帧请求（参数为 printf 格式的帧），输出响应的十六进制
+send_frame() {
+    printf "$1" >&5
+    timeout 0.3 cat <&5 | od -An -tx1 | tr -d ' \n'
+}
+
+echo ""
+echo "=== 验证 ==="
+
+# 这条连接贯穿整个测试，重新加载时不应断开
+exec 5<>/dev/tcp/127.0.0.1/$PORT
+INITIAL=$(send_frame '\x00\x01\x00\x00\x00\x06\x01\x03\x00\x00\x00\x0d')
+INPUT=$(send_frame '\x00\x02\x00\x00\x00\x06\x01\x04\x00\x64\x00\x01')
+UNIT5=$(send_frame '\x00\x03\x00\x00\x00\x06\x05\x03\x00\x00\x00\x01')
+if [[ "$INITIAL" == *"00010000001d01031a0007000700070007000700070007000700070007000100020003"* ]] && \
+   [[ "$INPUT" == *"000200000005010402002a"* ]] && [[ "$UNIT5" == *"0003000000050503021092"* ]]; then
+    echo "✓ 初值、生成器和 unit 段设备按映射文件设置"
+else
+    echo "✗ 映射初值错误：$INITIAL / $INPUT / $UNIT5"
+fi
+
+READONLY=$(send_frame '\x00\x04\x00\x00\x00\x06\x01\x06\x00\x15\x00\x01')
+WRITABLE=$(send_frame '\x00\x05\x00\x00\x00\x06\x01\x06\x00\x1e\x00\x01')
+if [[ "$READONLY" == *"000400000003018602"* ]] && [[ "$WRITABLE" == *"000500000006010600"* ]]; then
+    echo "✓ 只读寄存器拒绝写入（异常码 02），范围外的寄存器照常写入"
+else
+    echo "✗ 访问模式错误：$READONLY / $WRITABLE"
+fi
+
+# 修改映射后发送 SIGHUP：默认寄存器和 unit 段设备换成新初值，连接不断开
+sed -i 's/holding 0-9 = 7/holding 0-9 = 8/; s/holding 0 = 4242/holding 0 = 4243/' $MAP
+kill -HUP $SERVER_PID
+sleep 0.5
+RELOADED=$(send_frame '\x00\x06\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01')
+UNIT5=$(send_frame '\x00\x07\x00\x00\x00\x06\x05\x03\x00\x00\x00\x01')
+if grep -q "寄存器映射已重新加载：第 2 版" $SERVER_LOG && [[ "$RELOADED" == *"0006000000050103020008" ]] && \
+   [[ "$UNIT5" == *"0007000000050503021093" ]]; then
+    echo "✓ SIGHUP 后台重新加载，已有连接看到新初值"
+else
+    echo "✗ 重新加载错误：$RELOADED / $UNIT5 / $(grep 映射 $SERVER_LOG)"
+fi
+
+# 语法错误：保留旧映射
+echo "holding 0 = oops" >> $MAP
+admin "map reload" > /dev/null
+sleep 0.3
+STILL=$(send_frame '\x00\x08\x00\x00\x00\x06\x01\x03\x00\x00\x00\x01')
+if grep -q "重新加载失败，继续使用第 2 版：.*第 10 行" $SERVER_LOG && [[ "$STILL" == *"0008000000050103020008" ]]; then
+    echo "✓ 映射有语法错误时保留旧映射并报告行号"
+else
+    echo "✗ 语法错误处理错误：$STILL / $(grep 映射 $SERVER_LOG)"
+fi
+exec 5<&-
+
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+# 十万个点：50 个 unit 段，每段 1000 个保持寄存器和 1000 个输入寄存器，逐行赋值
+awk 'BEGIN {
+    for (u = 1; u <= 50; u++) {
+        print "unit " u
+        for (a = 0; a < 1000; a++) { print "holding " a " = " (u * 7 + a) % 65536 }
+        for (a = 0; a < 1000; a++) { print "input " a " = " (u * 11 + a) % 65536 }
+    }
+}' > $BIG_MAP
+stdbuf -oL ./build/server -R $BIG_MAP $PORT < /dev/null > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+LOAD_USEC=$(grep -o "100000 个点，解析耗时 [0-9]* 微秒" $SERVER_LOG | grep -o "[0-9]* 微秒" | grep -o "[0-9]*")
+if [ -n "$LOAD_USEC" ] && [ "$LOAD_USEC" -lt 500000 ]; then
+    echo "✓ 十万个点的映射加载耗时 $LOAD_USEC 微秒"
+else
+    echo "✗ 大映射加载失败或过慢：$(head -5 $SERVER_LOG)"
+fi
+
+# 清理
+kill -INT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG $ADMIN_SOCK $MAP $BIG_MAP
+
+echo ""
+echo "测试完成！"
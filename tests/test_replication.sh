@@ -0,0 +1,144 @@
+#!/bin/bash
+
+# 测试主备复制：备机连上后收到完整快照，之后按批应用主机的写入；复制期间只读；
+# 输入寄存器的写入同样复制，设备寄存器的写入计入分歧；replica 命令显示序列号与延迟；未同步的备机读请求回复忙、未经强制拒绝提升；主机失效后提升备机，寄存器保持复制到的值；原主机以备机身份重新加入
+
+PORT=15660
+REPLICATION_PORT=15661
+BACKUP_PORT=15662
+BACKUP_REPLICATION_PORT=15663
+UNSYNCED_PORT=15664
+DEAD_PRIMARY_PORT=15665
+PRIMARY_ADMIN=/tmp/test_replication_primary_$$.sock
+BACKUP_ADMIN=/tmp/test_replication_backup_$$.sock
+PRIMARY_LOG=test_replication_primary.log
+BACKUP_LOG=test_replication_backup.log
+REJOIN_LOG=test_replication_rejoin.log
+UNSYNCED_ADMIN=/tmp/test_replication_unsynced_$$.sock
+UNSYNCED_LOG=test_replication_unsynced.log
+
+echo "启动主机（端口 $PORT，复制端口 $REPLICATION_PORT）..."
+stdbuf -oL ./build/server -a $PRIMARY_ADMIN -D 9=default -P $REPLICATION_PORT $PORT < /dev/null > $PRIMARY_LOG 2>&1 &
+PRIMARY_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+# 备机启动之前的写入随快照到达备机
+request $PORT '\x00\x01\x00\x00\x00\x06\x01\x06\x00\x05\x12\x34' > /dev/null
+echo "启动备机（端口 $BACKUP_PORT，跟随 127.0.0.1:$REPLICATION_PORT）..."
+stdbuf -oL ./build/server -a $BACKUP_ADMIN -F 127.0.0.1:$REPLICATION_PORT -P $BACKUP_REPLICATION_PORT \
+    $BACKUP_PORT < /dev/null > $BACKUP_LOG 2>&1 &
+BACKUP_PID=$!
+sleep 1
+SNAPSHOT=$(request $BACKUP_PORT '\x00\x02\x00\x00\x00\x06\x01\x03\x00\x05\x00\x01')
+if [[ "$SNAPSHOT" == *"0002000000050103021234" ]] && grep -q "已应用主机 127.0.0.1:$REPLICATION_PORT 的快照（序列号 1）" $BACKUP_LOG; then
+    echo "✓ 备机连上后以完整快照同步已有的写入"
+else
+    echo "✗ 快照同步错误：$SNAPSHOT"
+fi
+
+# 主机的写入推给备机：FC10 的 3 个寄存器在同一批中，流水线的 10 个 FC06 同样成批推送
+request $PORT '\x00\x03\x00\x00\x00\x0d\x01\x10\x00\x0a\x00\x03\x06\xaa\xaa\xbb\xbb\xcc\xcc' > /dev/null
+BATCH=""
+for i in 0 1 2 3 4 5 6 7 8 9; do
+    BATCH="$BATCH\\x00\\x2$i\\x00\\x00\\x00\\x06\\x01\\x06\\x00\\x2$i\\x00\\x0$i"
+done
+request $PORT "$BATCH" > /dev/null
+sleep 0.3
+STREAMED=$(request $BACKUP_PORT '\x00\x04\x00\x00\x00\x06\x01\x03\x00\x0a\x00\x03')
+PIPELINED=$(request $BACKUP_PORT '\x00\x05\x00\x00\x00\x06\x01\x03\x00\x29\x00\x01')
+if [[ "$STREAMED" == *"000400000009010306aaaabbbbcccc" ]] && [[ "$PIPELINED" == *"0005000000050103020009" ]]; then
+    echo "✓ 主机的写入推送到备机并按序应用"
+else
+    echo "✗ 写入复制错误：$STREAMED / $PIPELINED"
+fi
+
+# 复制期间备机只读：写请求回复异常 01，reg set 被拒绝
+REJECTED=$(request $BACKUP_PORT '\x00\x06\x00\x00\x00\x06\x01\x06\x00\x05\x00\x01')
+REG_SET=$(admin_at $BACKUP_ADMIN "reg set holding 5 1")
+if [[ "$REJECTED" == *"000600000003018601" ]] && [[ "$REG_SET" == *"只读"* ]]; then
+    echo "✓ 复制中的备机拒绝写入（异常 01）"
+else
+    echo "✗ 备机只读错误：$REJECTED / $REG_SET"
+fi
+
+PRIMARY_STATUS=$(admin_at $PRIMARY_ADMIN "replica")
+BACKUP_STATUS=$(admin_at $BACKUP_ADMIN "replica")
+BATCHES=$(echo "$PRIMARY_STATUS" | grep -o "批次 [0-9]* 个" | grep -o "[0-9]*")
+if echo "$PRIMARY_STATUS" | grep -q "序列号 14，记录 14 条" && [ -n "$BATCHES" ] && [ "$BATCHES" -lt 14 ] && \
+   echo "$PRIMARY_STATUS" | grep -q "已确认序列号 14，落后 0 条" && \
+   echo "$BACKUP_STATUS" | grep -q "复制中；已应用序列号 14" && echo "$BACKUP_STATUS" | grep -q "复制延迟：最近 [0-9]* 微秒"; then
+    echo "✓ replica 命令显示序列号、批次、备机确认和复制延迟（14 条记录 $BATCHES 批）"
+else
+    echo "✗ 复制状态错误：$PRIMARY_STATUS / $BACKUP_STATUS"
+fi
+
+# reg set input 写入的输入寄存器推给备机；单元 9 的设备寄存器不复制，主机的 replica 显示未复制的写入
+INPUT_SET=$(admin_at $PRIMARY_ADMIN "reg set input 7 4242")
+request $PORT '\x00\x0d\x00\x00\x00\x06\x09\x06\x00\x05\x00\x01' > /dev/null
+sleep 0.3
+INPUT_READ=$(request $BACKUP_PORT '\x00\x0e\x00\x00\x00\x06\x01\x04\x00\x07\x00\x01')
+DIVERGED=$(admin_at $PRIMARY_ADMIN "replica")
+if [[ "$INPUT_READ" == *"000e000000050104021092" ]] && \
+   echo "$DIVERGED" | grep -q "未复制的写入：设备寄存器 1 个" && echo "$DIVERGED" | grep -q "已确认序列号 15，落后 0 条"; then
+    echo "✓ 输入寄存器的写入复制到备机，设备寄存器的写入显示为未复制"
+else
+    echo "✗ 输入寄存器复制或分歧统计错误：$INPUT_SET / $INPUT_READ / $DIVERGED"
+fi
+
+# 主机失效：提升后接受写入，寄存器保持复制到的值而不回到初值
+kill -9 $PRIMARY_PID
+wait $PRIMARY_PID 2>/dev/null
+sleep 0.3
+PROMOTE=$(admin_at $BACKUP_ADMIN "replica promote")
+AFTER_FAILOVER=$(request $BACKUP_PORT '\x00\x07\x00\x00\x00\x06\x01\x03\x00\x0a\x00\x01')
+WRITE=$(request $BACKUP_PORT '\x00\x08\x00\x00\x00\x06\x01\x06\x00\x05\x56\x78')
+if [[ "$PROMOTE" == *"已提升为主机"* ]] && [[ "$AFTER_FAILOVER" == *"000700000005010302aaaa" ]] && \
+   [[ "$WRITE" == *"000800000006010600055678" ]]; then
+    echo "✓ 提升后的备机保留复制到的寄存器并接受写入"
+else
+    echo "✗ 提升错误：$PROMOTE / $AFTER_FAILOVER / $WRITE"
+fi
+
+# 原主机以备机身份重新加入新主机，拿到的是新主机的寄存器而不是初值
+stdbuf -oL ./build/server -F 127.0.0.1:$BACKUP_REPLICATION_PORT $PORT < /dev/null > $REJOIN_LOG 2>&1 &
+REJOIN_PID=$!
+sleep 1
+REJOINED=$(request $PORT '\x00\x09\x00\x00\x00\x06\x01\x03\x00\x05\x00\x01')
+PROMOTED_STATUS=$(admin_at $BACKUP_ADMIN "replica")
+if [[ "$REJOINED" == *"0009000000050103025678" ]] && [[ "$PROMOTED_STATUS" == *"由备机提升"* ]] && \
+   [[ "$PROMOTED_STATUS" == *"已确认序列号 16，落后 0 条"* ]]; then
+    echo "✓ 原主机以备机身份重新加入并同步到新主机的寄存器"
+else
+    echo "✗ 重新加入错误：$REJOINED"
+fi
+
+# 主机连不上的备机从未收到快照：读请求回复异常 06，不带 force 的提升被拒绝，强制提升后以初值应答
+stdbuf -oL ./build/server -a $UNSYNCED_ADMIN -F 127.0.0.1:$DEAD_PRIMARY_PORT $UNSYNCED_PORT \
+    < /dev/null > $UNSYNCED_LOG 2>&1 &
+UNSYNCED_PID=$!
+sleep 1
+BUSY=$(request $UNSYNCED_PORT '\x00\x0a\x00\x00\x00\x06\x01\x03\x00\x05\x00\x01')
+BUSY_INPUT=$(request $UNSYNCED_PORT '\x00\x0b\x00\x00\x00\x06\x01\x04\x00\x05\x00\x01')
+REFUSED=$(admin_at $UNSYNCED_ADMIN "replica promote")
+FORCED=$(admin_at $UNSYNCED_ADMIN "replica promote force")
+SERVED=$(request $UNSYNCED_PORT '\x00\x0c\x00\x00\x00\x06\x01\x03\x00\x05\x00\x01')
+if [[ "$BUSY" == *"000a00000003018306" ]] && [[ "$BUSY_INPUT" == *"000b00000003018406" ]] && \
+   [[ "$REFUSED" == *"尚未应用过主机"* ]] && [[ "$FORCED" == *"已提升为主机"* ]] && \
+   [[ "$SERVED" == *"000c0000000501030200"* ]]; then
+    echo "✓ 未同步的备机读请求回复忙（异常 06），未应用快照时须强制提升"
+else
+    echo "✗ 未同步备机错误：$BUSY / $BUSY_INPUT / $REFUSED / $FORCED / $SERVED"
+fi
+
+# 清理
+kill -INT $BACKUP_PID $REJOIN_PID $UNSYNCED_PID 2>/dev/null
+wait $BACKUP_PID $REJOIN_PID $UNSYNCED_PID 2>/dev/null
+rm -f $PRIMARY_LOG $BACKUP_LOG $REJOIN_LOG $UNSYNCED_LOG $PRIMARY_ADMIN $BACKUP_ADMIN $UNSYNCED_ADMIN
+
+echo ""
+echo "测试完成！"
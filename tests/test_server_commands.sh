@@ -79,8 +79,9 @@ echo ""
 
 echo "=== 验证 ==="
 
-# 验证list命令输出
-if grep -q '\[fd:[0-9]\+\] (地址=' $SERVER_LOG; then
+# 验证list命令输出：表格每行以 fd 开头，后接客户端地址
+if grep -q '^ *fd  地址' $SERVER_LOG && grep -q "^ *$CLIENT1_FD  127\.0\.0\.1:[0-9]\+ " $SERVER_LOG && \
+   grep -q "^ *$CLIENT2_FD  127\.0\.0\.1:[0-9]\+ " $SERVER_LOG; then
     echo "✓ list命令显示fd格式"
 else
     echo "✗ list命令格式错误"
@@ -0,0 +1,92 @@
+#!/bin/bash
+
+# 测试寄存器快照：SIGUSR1 触发，fork 子进程在后台写出快照文件
+
+PORT=15570
+SNAP_PREFIX=/tmp/modbus_snap_$$
+REG_FILE=/tmp/modbus_snap_regs_$$.bin
+SERVER_LOG=test_snapshot_server.log
+
+# 以十进制输出快照文件中指定偏移处的 16 位寄存器值（主机字节序）
+read_u16() {
+    od -An -tu2 -j "$2" -N 2 "$1" | tr -d ' '
+}
+
+# 启动服务器，写入寄存器 400 = 4242，发送 SIGUSR1 后再写入 400 = 1111
+run_case() {
+    stdbuf -oL ./build/server -S $SNAP_PREFIX "$@" $PORT > $SERVER_LOG 2>&1 &
+    SERVER_PID=$!
+    sleep 1
+    (sleep 0.5; echo "modbus write 400 4242"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /dev/null 2>&1
+    kill -USR1 $SERVER_PID
+    (sleep 0.3; echo "modbus write 400 1111"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /dev/null 2>&1
+    sleep 0.5
+    kill -SIGINT $SERVER_PID 2>/dev/null
+    wait $SERVER_PID 2>/dev/null
+}
+
+check_case() {
+    local label=$1
+    local snap
+    snap=$(ls $SNAP_PREFIX-*.snap 2>/dev/null | head -1)
+
+    if grep -q "快照完成：$SNAP_PREFIX-" $SERVER_LOG && [ -n "$snap" ]; then
+        echo "✓ [$label] 后台快照已完成：$(basename $snap)"
+    else
+        echo "✗ [$label] 快照未完成"
+        return
+    fi
+
+    # 文件头 40 字节 + 保持寄存器 1000*2 + 输入寄存器 1000*2
+    if [ "$(stat -c %s $snap)" = "4040" ] && [ "$(head -c 4 $snap | od -An -tx1 | tr -d ' ')" = "4e53424d" ]; then
+        echo "✓ [$label] 快照大小与魔数正确"
+    else
+        echo "✗ [$label] 快照格式错误"
+    fi
+
+    # 保持寄存器 400 位于偏移 40+800，输入寄存器 5 位于偏移 40+2000+10
+    if [ "$(read_u16 $snap 840)" = "4242" ] && [ "$(read_u16 $snap 2050)" = "1005" ]; then
+        echo "✓ [$label] 快照内容为触发时刻的寄存器值（之后的写入未混入）"
+    else
+        echo "✗ [$label] 快照内容错误：[400]=$(read_u16 $snap 840) 输入[5]=$(read_u16 $snap 2050)"
+    fi
+
+    ls $SNAP_PREFIX-*.tmp > /dev/null 2>&1 && echo "✗ [$label] 残留临时文件" || echo "✓ [$label] 无残留临时文件"
+    rm -f $SNAP_PREFIX-*.snap $SNAP_PREFIX-*.tmp
+}
+
+echo "情况一：寄存器位于进程内存（fork 写时复制）..."
+run_case
+echo ""
+echo "=== 验证 ==="
+check_case "进程内存"
+
+echo ""
+echo "情况二：寄存器位于持久化映射（先复制再 fork）..."
+run_case -p $REG_FILE
+echo ""
+echo "=== 验证 ==="
+check_case "持久化映射"
+
+echo ""
+echo "情况三：快照目录不存在（子进程只以退出状态报告失败原因）..."
+stdbuf -oL ./build/server -S /nonexistent_$$/snap $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+kill -USR1 $SERVER_PID
+sleep 0.5
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+echo ""
+echo "=== 验证 ==="
+if grep -q "快照失败：/nonexistent_$$/snap-.*（无法创建临时文件）" $SERVER_LOG; then
+    echo "✓ [目录不存在] 父进程回收子进程时输出失败原因"
+else
+    echo "✗ [目录不存在] 未输出快照失败原因"
+fi
+
+# 清理
+rm -f $SERVER_LOG $REG_FILE
+
+echo ""
+echo "测试完成！"
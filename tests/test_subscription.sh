@@ -0,0 +1,79 @@
+#!/bin/bash
+
+# 测试寄存器变化订阅：FC41 订阅后，其他主站的写入以 FC42 帧推送，订阅范围外的写入不推送
+
+PORT=15576
+SERVER_LOG=test_subscription_server.log
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+# 订阅者：订阅保持寄存器 100-108（数量避开 0x0a，bash printf 遇到换行符会分段写出）
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf '\x00\x01\x00\x00\x00\x07\x01\x41\x03\x00\x64\x00\x09' >&3
+sleep 0.3
+
+echo "其他主站写入订阅范围内外的寄存器..."
+# FC10 写 100-101 = 0x1234 0x5678
+modbus_tcp '\x00\x02\x00\x00\x00\x0b\x01\x10\x00\x64\x00\x02\x04\x12\x34\x56\x78' > /dev/null
+# FC06 写 200 = 0x0007（订阅范围外）
+modbus_tcp '\x00\x03\x00\x00\x00\x06\x01\x06\x00\xc8\x00\x07' > /dev/null
+# FC06 写 105 = 0x0007
+modbus_tcp '\x00\x04\x00\x00\x00\x06\x01\x06\x00\x69\x00\x07' > /dev/null
+
+PUSHED=$(timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+
+# 取消订阅后再写入，不应再收到推送
+printf '\x00\x05\x00\x00\x00\x07\x01\x41\x03\x00\x00\x00\x00' >&3
+sleep 0.3
+modbus_tcp '\x00\x06\x00\x00\x00\x06\x01\x06\x00\x66\x00\x01' > /dev/null
+AFTER=$(timeout 0.5 cat <&3 | od -An -tx1 | tr -d ' \n')
+exec 3<&-
+
+echo ""
+echo "=== 验证 ==="
+
+if [[ "$PUSHED" == *"00010000000701410300640009"* ]]; then
+    echo "✓ FC41 订阅响应回显请求"
+else
+    echo "✗ FC41 订阅响应错误：$PUSHED"
+fi
+
+# 连续地址的两个寄存器合并为一段：读功能码 03，1 段，起始 100，数量 2
+if [[ "$PUSHED" == *"00000000000b014203010064021234""5678"* ]]; then
+    echo "✓ FC10 写入的两个寄存器合并为一段推送"
+else
+    echo "✗ FC10 写入未正确推送：$PUSHED"
+fi
+
+if [[ "$PUSHED" == *"000000000009014203010069010007" ]] && [[ "$PUSHED" != *"00c8"* ]]; then
+    echo "✓ 只推送订阅范围内的写入"
+else
+    echo "✗ 订阅范围过滤错误：$PUSHED"
+fi
+
+if [[ "$AFTER" == "00050000000701410300000000" ]]; then
+    echo "✓ 取消订阅后不再推送"
+else
+    echo "✗ 取消订阅后仍收到数据：$AFTER"
+fi
+
+# 越界订阅返回非法数据地址异常
+RESP=$(modbus_tcp '\x00\x07\x00\x00\x00\x07\x01\x41\x03\x03\xe0\x00\x20')
+if [[ "$RESP" == *"00070000000301c102" ]]; then
+    echo "✓ 越界订阅返回异常响应"
+else
+    echo "✗ 越界订阅响应错误：$RESP"
+fi
+
+# 清理
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# 测试 Modbus/TCP Security（TLS）监听：握手、Modbus 请求、会话复用
+# 依赖 openssl 命令行工具生成临时证书并充当 TLS 主站
+
+PORT=15564
+TLS_PORT=15565
+SERVER_LOG=test_tls_server.log
+TMP_DIR=$(mktemp -d)
+
+echo "生成临时自签名证书..."
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj /CN=localhost \
+    -keyout $TMP_DIR/key.pem -out $TMP_DIR/cert.pem > /dev/null 2>&1
+
+echo "启动服务器（TLS 端口 $TLS_PORT）..."
+stdbuf -oL ./build/server -t $TLS_PORT -C $TMP_DIR/cert.pem -K $TMP_DIR/key.pem $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+# FC03 读取地址 5 开始的 2 个寄存器
+REQUEST='\x00\x01\x00\x00\x00\x06\x01\x03\x00\x05\x00\x02'
+
+echo ""
+echo "=== 验证 ==="
+
+RESP=$( (printf "$REQUEST"; sleep 0.5) | timeout 3 openssl s_client -connect 127.0.0.1:$TLS_PORT \
+    -quiet -no_ign_eof -sess_out $TMP_DIR/session.pem 2>/dev/null | od -An -tx1 | tr -d ' \n')
+if [ "$RESP" = "00010000000701030400050006" ]; then
+    echo "✓ TLS 连接上的 FC03 响应正确"
+else
+    echo "✗ TLS 连接上的 FC03 响应错误：$RESP"
+fi
+
+RESUMED=$( (printf "$REQUEST"; sleep 0.5) | timeout 3 openssl s_client -connect 127.0.0.1:$TLS_PORT \
+    -sess_in $TMP_DIR/session.pem 2>&1 | grep -a -c "^Reused")
+if [ "$RESUMED" -ge 1 ]; then
+    echo "✓ 第二次连接通过会话票据复用"
+else
+    echo "✗ 第二次连接未复用会话"
+fi
+
+if grep -q "TLS 握手完成.*会话复用" $SERVER_LOG; then
+    echo "✓ 服务器记录了会话复用握手"
+else
+    echo "✗ 服务器未记录会话复用握手"
+fi
+
+grep "TLS 握手完成" $SERVER_LOG | head -1 | sed 's/^/  /'
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+# 清理
+rm -rf $TMP_DIR $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# 测试 Unix 域套接字监听：同一服务器同时服务 TCP 和 Unix 域客户端
+
+PORT=15560
+SOCK_PATH=/tmp/modbus_test_$$.sock
+SERVER_LOG=test_unix_server.log
+
+echo "启动服务器（TCP 端口 $PORT，Unix 套接字 $SOCK_PATH）..."
+./build/server -u $SOCK_PATH $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+echo "通过 Unix 域套接字写入寄存器..."
+(sleep 0.5; echo "modbus write 200 4321"; sleep 0.5; echo "quit") | timeout 3 ./build/client -u $SOCK_PATH > /tmp/unix_client1.log 2>&1
+
+echo "通过 TCP 读取同一寄存器..."
+(sleep 0.5; echo "modbus read 200 1"; sleep 0.5; echo "quit") | timeout 3 ./build/client 127.0.0.1 $PORT > /tmp/unix_client2.log 2>&1
+
+kill -SIGINT $SERVER_PID 2>/dev/null
+wait $SERVER_PID 2>/dev/null
+
+echo ""
+echo "=== 验证 ==="
+
+if grep -q "客户端已连接，来自 unix:$SOCK_PATH" $SERVER_LOG; then
+    echo "✓ 服务器接受了 Unix 域连接"
+else
+    echo "✗ 未找到 Unix 域连接记录"
+fi
+
+if grep -q "FC06 写入成功：寄存器\[200\] = 4321" /tmp/unix_client1.log; then
+    echo "✓ Unix 域客户端写入成功"
+else
+    echo "✗ Unix 域客户端写入失败"
+fi
+
+if grep -q "寄存器\[0\] = 4321" /tmp/unix_client2.log; then
+    echo "✓ TCP 客户端读到了 Unix 域客户端写入的值"
+else
+    echo "✗ TCP 客户端读取结果不一致"
+fi
+
+if [ ! -e $SOCK_PATH ]; then
+    echo "✓ 服务器退出时已删除套接字文件"
+else
+    echo "✗ 套接字文件残留"
+    rm -f $SOCK_PATH
+fi
+
+# 清理
+rm -f $SERVER_LOG /tmp/unix_client1.log /tmp/unix_client2.log
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# 测试厂商扩展 FC43 分散读和 FC44 原子多点写（含 RTU-over-TCP 分帧）
+
+PORT=15578
+RTU_PORT=15579
+SERVER_LOG=test_vector_server.log
+
+echo "启动服务器（端口 $PORT）..."
+stdbuf -oL ./build/server -r $RTU_PORT $PORT > $SERVER_LOG 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+source "$(dirname "$0")/lib.sh"
+
+echo ""
+echo "=== 验证 ==="
+
+# FC44 写 100=0x1111、700=0x2222、5=0x3333（分布在三个页上）
+RESP=$(modbus_tcp '\x00\x01\x00\x00\x00\x0f\x01\x44\x03\x00\x64\x11\x11\x02\xbc\x22\x22\x00\x05\x33\x33')
+if [[ "$RESP" == *"000100000003014403" ]]; then
+    echo "✓ FC44 原子多点写响应正确"
+else
+    echo "✗ FC44 响应错误：$RESP"
+fi
+
+# FC43 读保持寄存器 (100,1) (700,1) (5,2)，结果按段顺序拼接
+RESP=$(modbus_tcp '\x00\x02\x00\x00\x00\x10\x01\x43\x03\x03\x00\x64\x00\x01\x02\xbc\x00\x01\x00\x05\x00\x02')
+if [[ "$RESP" == *"00020000000c01430308111122223333""0006" ]]; then
+    echo "✓ FC43 一次读回多段不相邻寄存器"
+else
+    echo "✗ FC43 响应错误：$RESP"
+fi
+
+# FC44 中有一个地址越界：整个请求被拒绝，100 保持原值
+RESP=$(modbus_tcp '\x00\x03\x00\x00\x00\x0b\x01\x44\x02\x00\x64\x44\x44\x03\xe8\x00\x01')
+READ_BACK=$(modbus_tcp '\x00\x04\x00\x00\x00\x08\x01\x43\x03\x01\x00\x64\x00\x01')
+if [[ "$RESP" == *"00030000000301c402" ]] && [[ "$READ_BACK" == *"000400000006014303021111" ]]; then
+    echo "✓ FC44 越界时不写入任何寄存器"
+else
+    echo "✗ FC44 越界处理错误：$RESP / $READ_BACK"
+fi
+
+# FC43 读输入寄存器 (11,1) (13,1)：初值为 1000+i
+RESP=$(modbus_tcp '\x00\x05\x00\x00\x00\x0c\x01\x43\x04\x02\x00\x0b\x00\x01\x00\x0d\x00\x01')
+if [[ "$RESP" == *"00050000000801430404""03f303f5" ]]; then
+    echo "✓ FC43 读输入寄存器"
+else
+    echo "✗ FC43 读输入寄存器响应错误：$RESP"
+fi
+
+# 客户端命令 modbus writev / modbus readv
+CLIENT_OUTPUT=$( (sleep 0.5; echo "modbus writev 300=7 900=8"; sleep 0.3; echo "modbus readv 300:1 900:1"; sleep 0.3; echo "quit") | \
+    timeout 5 ./build/client 127.0.0.1 $PORT 2>&1)
+if echo "$CLIENT_OUTPUT" | grep -q "FC44 原子多点写成功：2 个寄存器" && \
+   echo "$CLIENT_OUTPUT" | grep -q "值\[0\] = 7" && echo "$CLIENT_OUTPUT" | grep -q "值\[1\] = 8"; then
+    echo "✓ 客户端 writev/readv 命令"
+else
+    echo "✗ 客户端 writev/readv 命令失败"
+fi
+
+# RTU-over-TCP：FC44 与 FC43 在一次写入中流水发出，按点数/段数字节分帧后各自应答
+# 请求帧中的 CRC 为预先计算好的值（低字节在前）
+exec 4<>/dev/tcp/127.0.0.1/$RTU_PORT
+printf '\x01\x44\x02\x00\x14\xab\xcd\x00\x15\x12\x34\x24\xc0\x01\x43\x03\x02\x00\x0a\x00\x01\x00\x14\x00\x02\x7c\x2e' >&4
+RESP=$(timeout 0.5 cat <&4 | od -An -tx1 | tr -d ' \n')
+exec 4<&-
+if [ "$RESP" = "01440292c101430306000aabcd12340649" ]; then
+    echo "✓ RTU-over-TCP 流水发出的 FC44 和 FC43 分别应答"
+else
+    echo "✗ RTU-over-TCP FC44/FC43 分帧错误：$RESP"
+fi
+
+# RTU-over-TCP：FC41 订阅帧拆成两次写入，拼接后按固定长度应答
+exec 4<>/dev/tcp/127.0.0.1/$RTU_PORT
+printf '\x01\x41\x03\x00' >&4
+sleep 0.2
+printf '\x0a\x00\x01\xa1\x13' >&4
+RESP=$(timeout 0.5 cat <&4 | od -An -tx1 | tr -d ' \n')
+exec 4<&-
+if [ "$RESP" = "014103000a0001a113" ]; then
+    echo "✓ RTU-over-TCP 拆成两次写入的 FC41 拼接后应答"
+else
+    echo "✗ RTU-over-TCP FC41 分帧错误：$RESP"
+fi
+
+# 清理
+kill -SIGINT $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+rm -f $SERVER_LOG
+
+echo ""
+echo "测试完成！"
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# 测试事件循环看门狗：控制台命令阻塞在打开 FIFO 上时，看门狗报告卡住的处理函数和调用栈
+# 需要 script 命令为服务器提供伪终端，使控制台可用
+
+PORT=15586
+FIFO=/tmp/modbus_watchdog_$$.fifo
+SERVER_LOG=test_watchdog_server.log
+
+rm -f $FIFO
+mkfifo $FIFO
+
+echo "启动服务器（端口 $PORT，看门狗阈值 100 毫秒）..."
+# gen add 打开回放文件时阻塞，直到 FIFO 的写端打开
+( (sleep 1; echo "gen add holding:0:replay:file=$FIFO"; sleep 1.5; echo "watchdog"; sleep 0.5) | \
+    timeout 6 script -qfc "./build/server -W 100 $PORT" /dev/null > $SERVER_LOG 2>&1 ) &
+RUNNER_PID=$!
+
+sleep 2
+echo "解除阻塞..."
+echo "5 7" > $FIFO
+wait $RUNNER_PID 2>/dev/null
+pkill -x server 2>/dev/null
+
+OUTPUT=$(tr -d '\r' < $SERVER_LOG)
+
+echo ""
+echo "=== 验证 ==="
+
+if echo "$OUTPUT" | grep -q "看门狗已启动"; then
+    echo "✓ 看门狗线程已启动"
+else
+    echo "✗ 看门狗未启动"
+fi
+
+if echo "$OUTPUT" | grep -q "\[看门狗\] 事件循环第 [0-9]* 轮已运行 [0-9]* 毫秒.*当前处理函数 handle_stdin_input（fd:0）"; then
+    echo "✓ 卡顿期间报告了正在运行的处理函数和描述符"
+else
+    echo "✗ 未报告卡顿的处理函数"
+fi
+
+if echo "$OUTPUT" | grep -q "__open\|_IO_file_fopen"; then
+    echo "✓ 调用栈采样指向阻塞的 open"
+else
+    echo "✗ 调用栈采样缺失"
+fi
+
+if echo "$OUTPUT" | grep -q "卡顿 1 轮（看门狗报告 1 次）"; then
+    echo "✓ 每轮卡顿只报告一次，统计正确"
+else
+    echo "✗ 卡顿统计错误"
+fi
+
+# 清理
+rm -f $FIFO $SERVER_LOG
+
+echo ""
+echo "测试完成！"